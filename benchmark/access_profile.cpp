@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <access_profile.h>
+#include <db_file.h>
+#include <writer.h>
+
+// Random lookups of zipfian skewed keys in the balanced sorted binary tree (v0), and in the trees laid out by the
+// access profile sampled from the same distribution by a reader (`DbReader::Options::accessSampleInterval`): the
+// weight-balanced tree, and the weight-balanced tree with the hot nodes copied to its start
+// (`DbWriter::Options::hotNodesSize`). Prints the expected number of nodes a lookup visits (from the tree shapes)
+// and the measured latency. The hot keys are spread over the whole key space.
+// Usage: benchmark-access-profile [KEYS] [LOOKUPS] [ZIPF_EXPONENT]
+
+static std::string makeKey(uint64_t i) {
+    return "shops-7f00b33a8134aa21f40d1295bc80b5ee/item/" + std::to_string(i * 7919 % 1000000007);
+}
+
+// keys by rank, drawn with the probability `1 / rank^exponent`
+class ZipfianKeys {
+    std::vector<double> cumulative;
+    std::vector<uint64_t> keyOfRank;
+
+public:
+    ZipfianKeys(uint64_t keyCount, double exponent, std::mt19937_64& random) : cumulative(keyCount), keyOfRank(keyCount) {
+        double sum = 0;
+        for (uint64_t rank = 0; rank < keyCount; rank++) {
+            sum += 1 / std::pow(static_cast<double>(rank + 1), exponent);
+            cumulative[rank] = sum;
+        }
+        std::iota(keyOfRank.begin(), keyOfRank.end(), 0);
+        std::shuffle(keyOfRank.begin(), keyOfRank.end(), random);
+    }
+
+    uint64_t next(std::mt19937_64& random) const {
+        auto point = std::uniform_real_distribution<double>(0, cumulative.back())(random);
+        auto rank = std::upper_bound(cumulative.begin(), cumulative.end(), point) - cumulative.begin();
+        return keyOfRank[std::min<uint64_t>(rank, keyOfRank.size() - 1)];
+    }
+};
+
+// nodes visited by the lookups of `lookups`, averaged, from the depths of the keys in the tree
+static double getExpectedVisits(const RoflDb::DbReader& dbReader, const std::vector<std::string>& lookups) {
+    std::unordered_map<std::string, uint64_t> lookupCounts;
+    for (const auto& key : lookups) {
+        lookupCounts[key]++;
+    }
+    uint64_t visits = 0;
+    for (unsigned depth = 0; ; depth++) {
+        bool any = dbReader.forEachTreeNodeAtDepth(depth, [&](std::span<const std::byte> node) {
+            // the node size, the key size and the key
+            uint16_t keySize;
+            std::memcpy(&keySize, node.data() + sizeof(uint16_t), sizeof keySize);
+            auto found = lookupCounts.find(std::string(reinterpret_cast<const char*>(node.data()) + 2 * sizeof(uint16_t), keySize));
+            if (found != lookupCounts.end()) {
+                visits += found->second * (depth + 1);
+            }
+            return true;
+        });
+        if (!any) {
+            break;
+        }
+    }
+    return static_cast<double>(visits) / static_cast<double>(lookups.size());
+}
+
+int main(int argc, char* argv[]) {
+    using clock = std::chrono::steady_clock;
+
+    uint64_t keyCount = argc > 1 ? std::stoull(argv[1]) : 5000000;
+    uint64_t lookupCount = argc > 2 ? std::stoull(argv[2]) : 2000000;
+    double exponent = argc > 3 ? std::stod(argv[3]) : 0.99;
+
+    std::mt19937_64 random(42);
+    ZipfianKeys zipfian(keyCount, exponent, random);
+    auto makeLookups = [&]() {
+        std::vector<std::string> lookups;
+        lookups.reserve(lookupCount);
+        for (uint64_t i = 0; i < lookupCount; i++) {
+            lookups.push_back(makeKey(zipfian.next(random)));
+        }
+        return lookups;
+    };
+    // the profile is sampled from other lookups than the measured ones
+    auto productionLookups = makeLookups();
+    auto lookups = makeLookups();
+
+    auto directory = std::filesystem::temp_directory_path();
+    auto build = [&](const std::filesystem::path& path, const RoflDb::DbWriter::Options& options) {
+        RoflDb::DbWriter writer(path, options);
+        for (uint64_t i = 0; i < keyCount; i++) {
+            writer.put(makeKey(i), std::to_string(i));
+        }
+        return writer.finish();
+    };
+    auto measure = [&](const RoflDb::DbReader& dbReader, const std::vector<std::string>& keys) {
+        uint64_t checksum = 0;
+        auto start = clock::now();
+        for (const auto& key : keys) {
+            auto value = dbReader.get(key);
+            if (!value) [[unlikely]] {
+                std::cerr << "ERROR: key " << key << " not found\n";
+                std::exit(1);
+            }
+            checksum += static_cast<uint8_t>(value->get()[0]);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+        return std::make_pair(elapsed.count() / static_cast<int64_t>(keys.size()), checksum);
+    };
+
+    RoflDb::DbFile::Options fileOptions;
+    fileOptions.populate = true;
+
+    // the "production" reader of the balanced tree, sampling its lookups
+    auto balancedPath = directory / "rofldb-benchmark-access-profile-balanced.rofldb";
+    build(balancedPath, {});
+    auto profile = std::make_shared<RoflDb::AccessProfile>();
+    {
+        RoflDb::DbFile plainFile(balancedPath, fileOptions);
+        auto [plainNanos, plainChecksum] = measure(plainFile.getReader(), productionLookups);
+
+        auto sampledOptions = fileOptions;
+        sampledOptions.readerOptions.accessSampleInterval = 64;
+        RoflDb::DbFile sampledFile(balancedPath, sampledOptions);
+        auto [sampledNanos, sampledChecksum] = measure(sampledFile.getReader(), productionLookups);
+        *profile = sampledFile.getReader().getAccessProfile();
+        std::cout << "access log (1 in 64 lookups): " << plainNanos << " ns per lookup without it, " << sampledNanos
+                  << " ns with it; profile of " << profile->getEntries().size() << " keys, " << profile->getTotalCount()
+                  << " samples (checksums " << plainChecksum << ", " << sampledChecksum << ")\n";
+    }
+    auto profilePath = directory / "rofldb-benchmark-access-profile.rflp";
+    profile->save(profilePath);
+    *profile = RoflDb::AccessProfile::load(profilePath);
+    std::filesystem::remove(profilePath);
+
+    struct Layout {
+        const char* name;
+        std::filesystem::path path;
+        RoflDb::DbWriter::Stats stats;
+    };
+    std::vector<Layout> layouts {{"balanced", balancedPath, {}}};
+    {
+        RoflDb::DbWriter::Options options;
+        options.accessProfile = profile;
+        options.hotNodesSize = 0;
+        auto path = directory / "rofldb-benchmark-access-profile-weighted.rofldb";
+        layouts.push_back({"weight-balanced", path, build(path, options)});
+        options.hotNodesSize = 2 * 1024 * 1024;
+        path = directory / "rofldb-benchmark-access-profile-hot.rofldb";
+        layouts.push_back({"weight-balanced, 2 MiB of hot nodes first", path, build(path, options)});
+    }
+
+    for (const auto& layout : layouts) {
+        RoflDb::DbFile dbFile(layout.path, fileOptions);
+        auto expectedVisits = getExpectedVisits(dbFile.getReader(), lookups);
+        // twice, the first round warms the caches up
+        measure(dbFile.getReader(), lookups);
+        auto [nanos, checksum] = measure(dbFile.getReader(), lookups);
+        std::cout << "[" << layout.name << "] " << expectedVisits << " nodes visited per lookup, " << nanos
+                  << " ns per zipfian lookup (" << layout.stats.hotNodes << " hot nodes, checksum " << checksum << ")\n";
+    }
+    for (const auto& layout : layouts) {
+        std::filesystem::remove(layout.path);
+    }
+    return 0;
+}
@@ -0,0 +1,588 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <db_file.h>
+#include <hash.h>
+#include <writer.h>
+
+#include "bench_backends.h"
+#include "bench_stats.h"
+
+// Point lookup benchmark harness: builds every backend from the same dataset, runs the same lookups against each of
+// them from several threads, and reports the throughput, the latency percentiles and the hardware counters per lookup,
+// as text or as JSON (to be kept for tracking regressions).
+// Usage: rofldb-bench [options], see `usage`.
+
+static const char* const BACKENDS[] = {
+    "rofldb",
+#if ROFLDB_BENCH_WITH_LSM1
+    "lsm1",
+#endif
+#if ROFLDB_BENCH_WITH_LMDB
+    "lmdb",
+#endif
+};
+
+static int usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [options]\n"
+              << "Builds the databases from a dataset and benchmarks point lookups in them.\n"
+              << "\n"
+              << "  --dataset=PATH       the records of an existing .rofldb file (default: a synthetic dataset)\n"
+              << "  --keys=N             synthetic dataset size (default: 1000000)\n"
+              << "  --key-size=N         synthetic key size, at least 20 (default: 24)\n"
+              << "  --value-size=N       synthetic value size (default: 100)\n"
+              << "  --distribution=D     uniform, zipfian or sequential (default: uniform)\n"
+              << "  --zipf-theta=F       skew of the zipfian distribution, below 1 (default: 0.99)\n"
+              << "  --miss-ratio=F       share of the lookups of absent keys (default: 0)\n"
+              << "  --threads=N          lookup threads (default: 1)\n"
+              << "  --batch=N            keys per lookup call, `DbReader::getMany` for rofldb (default: 1)\n"
+              << "  --ops=N              lookups per thread (default: 1000000)\n"
+              << "  --backends=LIST      comma separated, of:";
+    for (const char* backend : BACKENDS) {
+        std::cerr << " " << backend;
+    }
+    std::cerr << " (default: all of them)\n"
+              << "  --dir=DIR            where the databases are built (default: system temporary directory)\n"
+              << "  --format-version=N   rofldb tree layout, see RoflDb::FormatVersion (default: 0)\n"
+              << "  --filter-bits=N      rofldb Bloom filter bits per key (default: 0, none)\n"
+              << "  --perfect-hash       rofldb perfect hash index\n"
+              << "  --value-block-size=KB\n"
+              << "                       rofldb value compression block size (default: 0, uncompressed)\n"
+              << "  --json               print a JSON document instead of the text report\n";
+    return 2;
+}
+
+struct Config {
+    std::optional<std::filesystem::path> datasetPath;
+    uint64_t keyCount = 1000000;
+    std::size_t keySize = 24;
+    std::size_t valueSize = 100;
+    std::string distribution = "uniform";
+    double zipfTheta = 0.99;
+    double missRatio = 0;
+    unsigned threads = 1;
+    std::size_t batch = 1;
+    uint64_t ops = 1000000;
+    std::vector<std::string> backends;
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    RoflDb::DbWriter::Options writerOptions;
+    bool json = false;
+};
+
+// Datasets ============================================================================================================
+
+// "user", zero padding and the 16 hex digits of a bijective hash of the record index, so that the keys are unique and
+// their order is unrelated to the indexes; the absent keys are the ones of the indexes past the dataset.
+class SyntheticDataset : public BenchDataset {
+    uint64_t keyCount;
+    std::size_t keySize;
+    std::size_t valueSize;
+
+public:
+    static constexpr std::size_t MIN_KEY_SIZE = 20;
+
+    SyntheticDataset(uint64_t keyCount, std::size_t keySize, std::size_t valueSize)
+        : keyCount(keyCount), keySize(keySize), valueSize(valueSize) {}
+
+    [[nodiscard]] uint64_t size() const override {
+        return keyCount;
+    }
+
+    void appendKey(uint64_t idx, bool miss, std::string& output) const override {
+        char hex[17];
+        std::snprintf(hex, sizeof hex, "%016llx", static_cast<unsigned long long>(RoflDb::Utils::mixBits(miss ? keyCount + idx : idx)));
+        output += "user";
+        output.append(keySize - MIN_KEY_SIZE, '0');
+        output.append(hex, 16);
+    }
+
+    void forEach(const std::function<void(std::string_view, std::string_view)>& callback) const override {
+        std::string key, value(valueSize, ' ');
+        for (uint64_t idx = 0; idx < keyCount; idx++) {
+            key.clear();
+            appendKey(idx, false, key);
+            // lowercase letters, compressible about as well as text
+            uint64_t state = RoflDb::Utils::mixBits(idx + 1);
+            for (auto& byte : value) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                byte = static_cast<char>('a' + state % 26);
+            }
+            callback(key, value);
+        }
+    }
+};
+
+// The records of an existing file, e.g. a production one; its keys with a suffix are the absent ones.
+class FileDataset : public BenchDataset {
+    RoflDb::DbFile dbFile;
+    std::string keys;
+    std::vector<uint64_t> keyOffsets;
+
+public:
+    explicit FileDataset(const std::filesystem::path& path) : dbFile(path) {
+        auto cursor = dbFile.getReader().getCursor();
+        for (bool valid = cursor.seekFirst(); valid; valid = cursor.next()) {
+            auto key = cursor.getKey();
+            keyOffsets.push_back(keys.size());
+            keys.append(reinterpret_cast<const char*>(key.get()), key.size());
+        }
+        keyOffsets.push_back(keys.size());
+    }
+
+    [[nodiscard]] uint64_t size() const override {
+        return keyOffsets.size() - 1;
+    }
+
+    void appendKey(uint64_t idx, bool miss, std::string& output) const override {
+        output.append(keys, keyOffsets[idx], keyOffsets[idx + 1] - keyOffsets[idx]);
+        if (miss) {
+            output += "\xff-absent";
+        }
+    }
+
+    void forEach(const std::function<void(std::string_view, std::string_view)>& callback) const override {
+        auto cursor = dbFile.getReader().getCursor();
+        for (bool valid = cursor.seekFirst(); valid; valid = cursor.next()) {
+            auto key = cursor.getKey();
+            auto value = cursor.getValue();
+            callback({reinterpret_cast<const char*>(key.get()), key.size()}, {reinterpret_cast<const char*>(value.get()), value.size()});
+        }
+    }
+};
+
+// END Datasets ========================================================================================================
+
+// Workload ============================================================================================================
+
+// YCSB zipfian generator (Gray et al., "Quickly generating billion-record synthetic databases"): rank `0` is the most
+// popular one.
+class ZipfianGenerator {
+    uint64_t count;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
+
+public:
+    ZipfianGenerator(uint64_t count, double theta) : count(count), theta(theta), alpha(1 / (1 - theta)), zetan(0) {
+        for (uint64_t rank = 1; rank <= count; rank++) {
+            zetan += 1 / std::pow(static_cast<double>(rank), theta);
+        }
+        double zeta2 = 1 + std::pow(0.5, theta);
+        eta = (1 - std::pow(2.0 / count, 1 - theta)) / (1 - zeta2 / zetan);
+    }
+
+    uint64_t operator()(std::mt19937_64& random) const {
+        double uniform = std::uniform_real_distribution<double>(0, 1)(random);
+        double uz = uniform * zetan;
+        if (uz < 1) {
+            return 0;
+        }
+        if (uz < 1 + std::pow(0.5, theta)) {
+            return 1;
+        }
+        return std::min(count - 1, static_cast<uint64_t>(count * std::pow(eta * uniform - eta + 1, alpha)));
+    }
+};
+
+// the keys a thread looks up, generated before the measurement
+struct Workload {
+    std::string arena;
+    std::vector<std::string_view> keys;
+    // whether the key is in the dataset
+    std::vector<bool> expected;
+};
+
+static Workload makeWorkload(const Config& config, const BenchDataset& dataset, const ZipfianGenerator* zipfian, unsigned threadIdx) {
+    const auto count = dataset.size();
+    std::mt19937_64 random(threadIdx + 1);
+    std::uniform_int_distribution<uint64_t> uniform(0, count - 1);
+    std::bernoulli_distribution miss(config.missRatio);
+    uint64_t sequential = count * threadIdx / config.threads;
+
+    Workload workload;
+    std::vector<std::size_t> offsets;
+    offsets.reserve(config.ops + 1);
+    workload.expected.reserve(config.ops);
+    for (uint64_t op = 0; op < config.ops; op++) {
+        uint64_t idx;
+        if (config.distribution == "zipfian") {
+            // scrambled, so that the popular keys are spread over the key space instead of being the first ones
+            idx = RoflDb::Utils::mixBits((*zipfian)(random)) % count;
+        } else if (config.distribution == "sequential") {
+            idx = sequential++ % count;
+        } else {
+            idx = uniform(random);
+        }
+        bool isMiss = miss(random);
+        offsets.push_back(workload.arena.size());
+        dataset.appendKey(idx, isMiss, workload.arena);
+        workload.expected.push_back(!isMiss);
+    }
+    offsets.push_back(workload.arena.size());
+
+    workload.keys.reserve(config.ops);
+    for (uint64_t op = 0; op < config.ops; op++) {
+        workload.keys.emplace_back(workload.arena.data() + offsets[op], offsets[op + 1] - offsets[op]);
+    }
+    return workload;
+}
+
+// END Workload ========================================================================================================
+
+// Measurement =========================================================================================================
+
+struct ThreadResult {
+    LatencyHistogram latency;
+    PerfCounters::Values counters {};
+    uint64_t found = 0;
+    // hits which were not found, or the other way around
+    uint64_t wrong = 0;
+    std::exception_ptr error;
+};
+
+struct Result {
+    std::string backend;
+    std::chrono::steady_clock::duration buildTime {};
+    uint64_t diskBytes = 0;
+    std::chrono::steady_clock::duration time {};
+    uint64_t ops = 0;
+    uint64_t found = 0;
+    uint64_t wrong = 0;
+    LatencyHistogram latency;
+    // summed over the threads, `-1` if unavailable in any of them
+    PerfCounters::Values counters {};
+
+    [[nodiscard]] double getOpsPerSecond() const {
+        return ops / std::chrono::duration<double>(time).count();
+    }
+
+    [[nodiscard]] std::optional<double> getCounterPerOp(std::size_t idx) const {
+        if (counters[idx] < 0) {
+            return std::nullopt;
+        }
+        return static_cast<double>(counters[idx]) / ops;
+    }
+};
+
+static void runThread(const Config& config, BenchBackend& backend, const Workload& workload, std::latch& ready,
+                      std::latch& start, ThreadResult& result) {
+    using clock = std::chrono::steady_clock;
+
+    std::unique_ptr<BenchReader> reader;
+    try {
+        reader = backend.newReader();
+    } catch (...) {
+        result.error = std::current_exception();
+    }
+    PerfCounters perfCounters;
+    auto found = std::make_unique<bool[]>(config.batch);
+    ready.count_down();
+    start.wait();
+    if (result.error) {
+        return;
+    }
+
+    try {
+        perfCounters.start();
+        std::span<const std::string_view> keys(workload.keys);
+        for (std::size_t offset = 0; offset < keys.size(); offset += config.batch) {
+            auto size = std::min(config.batch, keys.size() - offset);
+            auto startedAt = clock::now();
+            reader->get(keys.subspan(offset, size), std::span(found.get(), size));
+            result.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - startedAt).count());
+            for (std::size_t idx = 0; idx < size; idx++) {
+                result.found += found[idx];
+                result.wrong += found[idx] != workload.expected[offset + idx];
+            }
+        }
+        result.counters = perfCounters.stop();
+    } catch (...) {
+        result.error = std::current_exception();
+    }
+}
+
+static uint64_t getDiskBytes(const std::filesystem::path& path) {
+    if (!std::filesystem::is_directory(path)) {
+        return std::filesystem::exists(path) ? std::filesystem::file_size(path) : 0;
+    }
+    uint64_t bytes = 0;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+        if (entry.is_regular_file()) {
+            bytes += entry.file_size();
+        }
+    }
+    return bytes;
+}
+
+static Result runBackend(const Config& config, const std::string& name, const BenchDataset& dataset, const std::vector<Workload>& workloads) {
+    using clock = std::chrono::steady_clock;
+
+    std::unique_ptr<BenchBackend> backend;
+    std::filesystem::path path = config.directory / ("rofldb-bench." + name);
+    if (name == "rofldb") {
+        backend = std::make_unique<RoflDbBackend>(path, config.writerOptions);
+#if ROFLDB_BENCH_WITH_LSM1
+    } else if (name == "lsm1") {
+        backend = std::make_unique<Lsm1Backend>(path);
+#endif
+#if ROFLDB_BENCH_WITH_LMDB
+    } else if (name == "lmdb") {
+        backend = std::make_unique<LmdbBackend>(path);
+#endif
+    } else {
+        throw std::invalid_argument("Unknown backend " + name);
+    }
+
+    Result result;
+    result.backend = name;
+    auto buildStartedAt = clock::now();
+    backend->build(dataset);
+    result.buildTime = clock::now() - buildStartedAt;
+    result.diskBytes = getDiskBytes(path);
+
+    std::vector<ThreadResult> threadResults(config.threads);
+    std::latch ready(config.threads), start(1);
+    std::vector<std::thread> threads;
+    for (unsigned idx = 0; idx < config.threads; idx++) {
+        threads.emplace_back(runThread, std::cref(config), std::ref(*backend), std::cref(workloads[idx]), std::ref(ready),
+                             std::ref(start), std::ref(threadResults[idx]));
+    }
+    ready.wait();
+    auto startedAt = clock::now();
+    start.count_down();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    result.time = clock::now() - startedAt;
+
+    for (const auto& threadResult : threadResults) {
+        if (threadResult.error) {
+            std::rethrow_exception(threadResult.error);
+        }
+        result.latency.merge(threadResult.latency);
+        result.found += threadResult.found;
+        result.wrong += threadResult.wrong;
+        for (std::size_t idx = 0; idx < PerfCounters::EVENT_COUNT; idx++) {
+            result.counters[idx] = result.counters[idx] < 0 || threadResult.counters[idx] < 0 ? -1 : result.counters[idx] + threadResult.counters[idx];
+        }
+    }
+    result.ops = config.ops * config.threads;
+
+    backend.reset();
+    // along with the side files of the backend (e.g. the lsm1 log)
+    for (const auto& entry : std::filesystem::directory_iterator(config.directory)) {
+        if (entry.path().filename().string().starts_with(path.filename().string())) {
+            std::filesystem::remove_all(entry.path());
+        }
+    }
+    return result;
+}
+
+// END Measurement =====================================================================================================
+
+// Report ==============================================================================================================
+
+static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+static const char* const QUANTILE_NAMES[] = {"p50", "p90", "p99", "p999"};
+
+static void printText(const Config& config, const std::vector<Result>& results) {
+    std::cout << (config.datasetPath ? config.datasetPath->string() : "synthetic") << " dataset, " << config.distribution
+              << " lookups, " << config.missRatio * 100 << "% misses, " << config.threads << " threads, "
+              << config.batch << " keys per call\n";
+    for (const auto& result : results) {
+        std::cout << "[" << result.backend << "] built in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(result.buildTime).count() << " ms, "
+                  << result.diskBytes << " bytes; " << static_cast<uint64_t>(result.getOpsPerSecond()) << " lookups/s, "
+                  << result.found << " found";
+        if (result.wrong > 0) {
+            std::cout << ", " << result.wrong << " WRONG";
+        }
+        std::cout << "\n  latency per call:";
+        for (std::size_t idx = 0; idx < std::size(QUANTILES); idx++) {
+            std::cout << " " << QUANTILE_NAMES[idx] << " " << result.latency.getQuantile(QUANTILES[idx]) << " ns,";
+        }
+        std::cout << " max " << result.latency.getMax() << " ns\n  per lookup:";
+        for (std::size_t idx = 0; idx < PerfCounters::EVENT_COUNT; idx++) {
+            if (auto value = result.getCounterPerOp(idx)) {
+                std::cout << " " << PerfCounters::EVENTS[idx].name << " " << std::round(*value * 10) / 10;
+            } else {
+                std::cout << " " << PerfCounters::EVENTS[idx].name << " n/a";
+            }
+        }
+        std::cout << "\n";
+    }
+}
+
+static std::string jsonString(std::string_view string) {
+    std::string result = "\"";
+    for (char character : string) {
+        if (character == '"' || character == '\\') {
+            result += '\\';
+            result += character;
+        } else if (static_cast<unsigned char>(character) < 0x20) {
+            char escaped[7];
+            std::snprintf(escaped, sizeof escaped, "\\u%04x", character);
+            result += escaped;
+        } else {
+            result += character;
+        }
+    }
+    return result + "\"";
+}
+
+static void printJson(const Config& config, const std::vector<Result>& results) {
+    std::cout << "{\n  \"config\": {"
+              << "\"dataset\": " << jsonString(config.datasetPath ? config.datasetPath->string() : "synthetic")
+              << ", \"keys\": " << config.keyCount << ", \"key_size\": " << config.keySize << ", \"value_size\": " << config.valueSize
+              << ", \"distribution\": " << jsonString(config.distribution) << ", \"zipf_theta\": " << config.zipfTheta
+              << ", \"miss_ratio\": " << config.missRatio << ", \"threads\": " << config.threads << ", \"batch\": " << config.batch
+              << ", \"ops_per_thread\": " << config.ops
+              << ", \"format_version\": " << static_cast<unsigned>(config.writerOptions.version)
+              << ", \"filter_bits\": " << config.writerOptions.filterBitsPerKey
+              << ", \"perfect_hash\": " << (config.writerOptions.perfectHashIndex ? "true" : "false")
+              << ", \"value_block_size\": " << config.writerOptions.valueBlockSize << "},\n  \"results\": [";
+    for (std::size_t resultIdx = 0; resultIdx < results.size(); resultIdx++) {
+        const auto& result = results[resultIdx];
+        std::cout << (resultIdx > 0 ? "," : "") << "\n    {\"backend\": " << jsonString(result.backend)
+                  << ", \"build_seconds\": " << std::chrono::duration<double>(result.buildTime).count()
+                  << ", \"disk_bytes\": " << result.diskBytes
+                  << ", \"seconds\": " << std::chrono::duration<double>(result.time).count()
+                  << ", \"ops\": " << result.ops << ", \"ops_per_second\": " << result.getOpsPerSecond()
+                  << ", \"found\": " << result.found << ", \"wrong\": " << result.wrong
+                  << ",\n     \"latency_ns\": {\"mean\": " << result.latency.getMean();
+        for (std::size_t idx = 0; idx < std::size(QUANTILES); idx++) {
+            std::cout << ", \"" << QUANTILE_NAMES[idx] << "\": " << result.latency.getQuantile(QUANTILES[idx]);
+        }
+        std::cout << ", \"max\": " << result.latency.getMax() << ", \"histogram\": [";
+        auto buckets = result.latency.getBuckets();
+        for (std::size_t idx = 0; idx < buckets.size(); idx++) {
+            std::cout << (idx > 0 ? ", " : "") << "[" << buckets[idx].first << ", " << buckets[idx].second << "]";
+        }
+        std::cout << "]},\n     \"counters_per_op\": {";
+        for (std::size_t idx = 0; idx < PerfCounters::EVENT_COUNT; idx++) {
+            std::cout << (idx > 0 ? ", " : "") << "\"" << PerfCounters::EVENTS[idx].name << "\": ";
+            if (auto value = result.getCounterPerOp(idx)) {
+                std::cout << *value;
+            } else {
+                std::cout << "null";
+            }
+        }
+        std::cout << "}}";
+    }
+    std::cout << "\n  ]\n}\n";
+}
+
+// END Report ==========================================================================================================
+
+int main(int argc, char* argv[]) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        auto value = [&arg]() {
+            return std::string(arg.substr(arg.find('=') + 1));
+        };
+        if (arg.starts_with("--dataset=")) {
+            config.datasetPath = value();
+        } else if (arg.starts_with("--keys=")) {
+            config.keyCount = std::stoull(value());
+        } else if (arg.starts_with("--key-size=")) {
+            config.keySize = std::stoull(value());
+        } else if (arg.starts_with("--value-size=")) {
+            config.valueSize = std::stoull(value());
+        } else if (arg.starts_with("--distribution=")) {
+            config.distribution = value();
+        } else if (arg.starts_with("--zipf-theta=")) {
+            config.zipfTheta = std::stod(value());
+        } else if (arg.starts_with("--miss-ratio=")) {
+            config.missRatio = std::stod(value());
+        } else if (arg.starts_with("--threads=")) {
+            config.threads = std::stoul(value());
+        } else if (arg.starts_with("--batch=")) {
+            config.batch = std::stoull(value());
+        } else if (arg.starts_with("--ops=")) {
+            config.ops = std::stoull(value());
+        } else if (arg.starts_with("--backends=")) {
+            std::string_view list = arg.substr(std::strlen("--backends="));
+            while (!list.empty()) {
+                auto comma = std::min(list.find(','), list.size());
+                config.backends.emplace_back(list.substr(0, comma));
+                list.remove_prefix(std::min(comma + 1, list.size()));
+            }
+        } else if (arg.starts_with("--dir=")) {
+            config.directory = value();
+        } else if (arg.starts_with("--format-version=")) {
+            config.writerOptions.version = static_cast<RoflDb::FormatVersion>(std::stoul(value()));
+        } else if (arg.starts_with("--filter-bits=")) {
+            config.writerOptions.filterBitsPerKey = std::stoul(value());
+        } else if (arg == "--perfect-hash") {
+            config.writerOptions.perfectHashIndex = true;
+        } else if (arg.starts_with("--value-block-size=")) {
+            config.writerOptions.valueBlockSize = std::stoull(value()) * 1024;
+        } else if (arg == "--json") {
+            config.json = true;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (config.backends.empty()) {
+        config.backends.assign(std::begin(BACKENDS), std::end(BACKENDS));
+    }
+    if (config.keySize < SyntheticDataset::MIN_KEY_SIZE || config.threads == 0 || config.batch == 0
+        || (config.distribution != "uniform" && config.distribution != "zipfian" && config.distribution != "sequential")
+        || config.zipfTheta <= 0 || config.zipfTheta >= 1 || config.missRatio < 0 || config.missRatio > 1) {
+        return usage(argv[0]);
+    }
+
+    std::unique_ptr<BenchDataset> dataset;
+    if (config.datasetPath) {
+        dataset = std::make_unique<FileDataset>(*config.datasetPath);
+        config.keyCount = dataset->size();
+    } else {
+        dataset = std::make_unique<SyntheticDataset>(config.keyCount, config.keySize, config.valueSize);
+    }
+    if (dataset->size() == 0) {
+        std::cerr << "The dataset is empty\n";
+        return 2;
+    }
+
+    std::optional<ZipfianGenerator> zipfian;
+    if (config.distribution == "zipfian") {
+        zipfian.emplace(dataset->size(), config.zipfTheta);
+    }
+    std::vector<Workload> workloads;
+    for (unsigned idx = 0; idx < config.threads; idx++) {
+        workloads.push_back(makeWorkload(config, *dataset, zipfian ? &*zipfian : nullptr, idx));
+    }
+
+    std::vector<Result> results;
+    bool wrong = false;
+    for (const auto& backend : config.backends) {
+        results.push_back(runBackend(config, backend, *dataset, workloads));
+        wrong |= results.back().wrong > 0;
+    }
+
+    if (config.json) {
+        printJson(config, results);
+    } else {
+        printText(config, results);
+    }
+    return wrong ? 1 : 0;
+}
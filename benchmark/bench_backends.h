@@ -0,0 +1,277 @@
+#pragma once
+
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <db_file.h>
+#include <writer.h>
+
+#if ROFLDB_BENCH_WITH_LSM1
+#include "sqlite/ext/lsm1/lsm.h"
+#endif
+#if ROFLDB_BENCH_WITH_LMDB
+#include "lmdb/libraries/liblmdb/lmdb.h"
+#endif
+
+// Records to build the benchmarked databases from.
+class BenchDataset {
+public:
+    virtual ~BenchDataset() = default;
+
+    [[nodiscard]] virtual uint64_t size() const = 0;
+    // Appends the key of the record `idx`, or with `miss` a key derived from it which is not in the dataset.
+    virtual void appendKey(uint64_t idx, bool miss, std::string& output) const = 0;
+    // all the records, in no particular order
+    virtual void forEach(const std::function<void(std::string_view key, std::string_view value)>& callback) const = 0;
+};
+
+// Looks keys up on behalf of a single benchmark thread.
+class BenchReader {
+public:
+    virtual ~BenchReader() = default;
+
+    // `found[i]` is whether `keys[i]` is in the database
+    virtual void get(std::span<const std::string_view> keys, std::span<bool> found) = 0;
+};
+
+// A database under benchmark, built from the dataset in its own file or directory.
+class BenchBackend {
+public:
+    virtual ~BenchBackend() = default;
+
+    virtual void build(const BenchDataset& dataset) = 0;
+    // called by every benchmark thread after `build`
+    [[nodiscard]] virtual std::unique_ptr<BenchReader> newReader() = 0;
+};
+
+// RoflDb ==============================================================================================================
+
+class RoflDbBackend : public BenchBackend {
+    std::filesystem::path path;
+    RoflDb::DbWriter::Options writerOptions;
+    std::optional<RoflDb::DbFile> dbFile;
+
+    class Reader : public BenchReader {
+        const RoflDb::DbReader& dbReader;
+        std::vector<RoflDb::Key> keys;
+        std::vector<std::optional<RoflDb::Value>> values;
+
+    public:
+        explicit Reader(const RoflDb::DbReader& dbReader) : dbReader(dbReader) {}
+
+        void get(std::span<const std::string_view> batch, std::span<bool> found) override {
+            if (batch.size() == 1) {
+                found[0] = dbReader.get(RoflDb::Key(reinterpret_cast<const std::byte*>(batch[0].data()), batch[0].size())).has_value();
+                return;
+            }
+            keys.clear();
+            for (auto key : batch) {
+                keys.emplace_back(reinterpret_cast<const std::byte*>(key.data()), key.size());
+            }
+            values.resize(batch.size());
+            dbReader.getMany(keys, values);
+            for (std::size_t idx = 0; idx < batch.size(); idx++) {
+                found[idx] = values[idx].has_value();
+            }
+        }
+    };
+
+public:
+    RoflDbBackend(std::filesystem::path path, const RoflDb::DbWriter::Options& writerOptions)
+        : path(std::move(path)), writerOptions(writerOptions) {}
+
+    void build(const BenchDataset& dataset) override {
+        dbFile.reset();
+        RoflDb::DbWriter writer(path, writerOptions);
+        dataset.forEach([&writer](std::string_view key, std::string_view value) {
+            writer.put(key, value);
+        });
+        (void)writer.finish();
+        dbFile.emplace(path);
+    }
+
+    std::unique_ptr<BenchReader> newReader() override {
+        return std::make_unique<Reader>(dbFile->getReader());
+    }
+};
+
+// END RoflDb ==========================================================================================================
+
+#if ROFLDB_BENCH_WITH_LSM1
+
+// lsm1 ================================================================================================================
+
+#define CHECK_LSM_RC(stmt) if (auto rc = (stmt)) { \
+                               throw std::runtime_error(std::string(#stmt) + " failed (" + std::string(__FILE__) + ":" + std::to_string(__LINE__) + "): error #" + std::to_string(rc)); \
+                           }
+
+class Lsm1Backend : public BenchBackend {
+    // records inserted per transaction while building
+    static constexpr uint64_t BUILD_TRANSACTION_SIZE = 100000;
+
+    std::filesystem::path path;
+
+    // lsm1 connections are single-threaded, so every reader opens its own
+    class Reader : public BenchReader {
+        lsm_db* db = nullptr;
+        lsm_cursor* cursor = nullptr;
+
+    public:
+        explicit Reader(const std::filesystem::path& path) {
+            int zero = 0;
+            int one = 1;
+            CHECK_LSM_RC(lsm_new(lsm_default_env(), &db));
+            CHECK_LSM_RC(lsm_config(db, LSM_CONFIG_READONLY, &one));
+            CHECK_LSM_RC(lsm_config(db, LSM_CONFIG_MMAP, &zero));
+            CHECK_LSM_RC(lsm_open(db, path.c_str()));
+            CHECK_LSM_RC(lsm_csr_open(db, &cursor));
+        }
+        Reader(const Reader& other) = delete;
+        ~Reader() override {
+            lsm_csr_close(cursor);
+            lsm_close(db);
+        }
+
+        void get(std::span<const std::string_view> batch, std::span<bool> found) override {
+            for (std::size_t idx = 0; idx < batch.size(); idx++) {
+                CHECK_LSM_RC(lsm_csr_seek(cursor, batch[idx].data(), static_cast<int>(batch[idx].size()), LSM_SEEK_EQ));
+                found[idx] = lsm_csr_valid(cursor);
+                if (found[idx]) {
+                    const void* value;
+                    int valueSize;
+                    CHECK_LSM_RC(lsm_csr_value(cursor, &value, &valueSize));
+                }
+            }
+        }
+    };
+
+public:
+    explicit Lsm1Backend(std::filesystem::path path) : path(std::move(path)) {}
+
+    void build(const BenchDataset& dataset) override {
+        std::filesystem::remove(path);
+        lsm_db* db;
+        CHECK_LSM_RC(lsm_new(lsm_default_env(), &db));
+        CHECK_LSM_RC(lsm_open(db, path.c_str()));
+        uint64_t inserted = 0;
+        CHECK_LSM_RC(lsm_begin(db, 1));
+        dataset.forEach([&](std::string_view key, std::string_view value) {
+            CHECK_LSM_RC(lsm_insert(db, key.data(), static_cast<int>(key.size()), value.data(), static_cast<int>(value.size())));
+            if (++inserted % BUILD_TRANSACTION_SIZE == 0) {
+                CHECK_LSM_RC(lsm_commit(db, 0));
+                CHECK_LSM_RC(lsm_begin(db, 1));
+            }
+        });
+        CHECK_LSM_RC(lsm_commit(db, 0));
+        // merged into a single segment, as the read-only files repacked from the production data are
+        CHECK_LSM_RC(lsm_flush(db));
+        CHECK_LSM_RC(lsm_work(db, 1, -1, nullptr));
+        CHECK_LSM_RC(lsm_close(db));
+    }
+
+    std::unique_ptr<BenchReader> newReader() override {
+        return std::make_unique<Reader>(path);
+    }
+};
+
+// END lsm1 ============================================================================================================
+
+#endif
+
+#if ROFLDB_BENCH_WITH_LMDB
+
+// LMDB ================================================================================================================
+
+#define CHECK_LMDB_RC(stmt) if (auto rc = (stmt)) { \
+                                throw std::runtime_error(std::string(#stmt) + " failed (" + std::string(__FILE__) + ":" + std::to_string(__LINE__) + "): error #" + mdb_strerror(rc)); \
+                            }
+
+class LmdbBackend : public BenchBackend {
+    // records put per transaction while building
+    static constexpr uint64_t BUILD_TRANSACTION_SIZE = 100000;
+
+    std::filesystem::path path;
+    MDB_env* env = nullptr;
+    MDB_dbi dbi = 0;
+
+    // the environment is shared, every reader has its own read-only transaction
+    class Reader : public BenchReader {
+        MDB_dbi dbi;
+        MDB_txn* txn = nullptr;
+
+    public:
+        Reader(MDB_env* env, MDB_dbi dbi) : dbi(dbi) {
+            CHECK_LMDB_RC(mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn));
+        }
+        Reader(const Reader& other) = delete;
+        ~Reader() override {
+            mdb_txn_abort(txn);
+        }
+
+        void get(std::span<const std::string_view> batch, std::span<bool> found) override {
+            for (std::size_t idx = 0; idx < batch.size(); idx++) {
+                MDB_val key {batch[idx].size(), const_cast<char*>(batch[idx].data())};
+                MDB_val value;
+                int rc = mdb_get(txn, dbi, &key, &value);
+                if (rc != 0 && rc != MDB_NOTFOUND) {
+                    throw std::runtime_error(std::string("mdb_get failed: ") + mdb_strerror(rc));
+                }
+                found[idx] = rc == 0;
+            }
+        }
+    };
+
+    void close() {
+        if (env) {
+            mdb_env_close(env);
+            env = nullptr;
+        }
+    }
+
+public:
+    explicit LmdbBackend(std::filesystem::path path) : path(std::move(path)) {}
+    ~LmdbBackend() override {
+        close();
+    }
+
+    void build(const BenchDataset& dataset) override {
+        close();
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+
+        CHECK_LMDB_RC(mdb_env_create(&env));
+        // only reserves the address space
+        CHECK_LMDB_RC(mdb_env_set_mapsize(env, std::size_t(1) << 40));
+        CHECK_LMDB_RC(mdb_env_open(env, path.c_str(), 0, 0644));
+        MDB_txn* txn;
+        CHECK_LMDB_RC(mdb_txn_begin(env, nullptr, 0, &txn));
+        CHECK_LMDB_RC(mdb_dbi_open(txn, nullptr, 0, &dbi));
+        uint64_t inserted = 0;
+        dataset.forEach([&](std::string_view key, std::string_view value) {
+            MDB_val mdbKey {key.size(), const_cast<char*>(key.data())};
+            MDB_val mdbValue {value.size(), const_cast<char*>(value.data())};
+            CHECK_LMDB_RC(mdb_put(txn, dbi, &mdbKey, &mdbValue, 0));
+            if (++inserted % BUILD_TRANSACTION_SIZE == 0) {
+                CHECK_LMDB_RC(mdb_txn_commit(txn));
+                CHECK_LMDB_RC(mdb_txn_begin(env, nullptr, 0, &txn));
+            }
+        });
+        CHECK_LMDB_RC(mdb_txn_commit(txn));
+    }
+
+    std::unique_ptr<BenchReader> newReader() override {
+        return std::make_unique<Reader>(env, dbi);
+    }
+};
+
+// END LMDB ============================================================================================================
+
+#endif
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Latency histogram with log-linear buckets: exact below 16 ns, then 16 buckets per power of two (at most 6% off).
+class LatencyHistogram {
+    static constexpr unsigned SUB_BUCKET_BITS = 4;
+    static constexpr unsigned SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr std::size_t BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    std::array<uint64_t, BUCKETS> counts {};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    static std::size_t getBucket(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return value;
+        }
+        unsigned exponent = std::bit_width(value) - 1;
+        return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + ((value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    }
+
+    static uint64_t getBucketLowerBound(std::size_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        unsigned exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+        return (SUB_BUCKETS + bucket % SUB_BUCKETS) << (exponent - SUB_BUCKET_BITS);
+    }
+
+public:
+    // the largest value of the bucket
+    static uint64_t getBucketUpperBound(std::size_t bucket) {
+        return bucket + 1 < BUCKETS ? getBucketLowerBound(bucket + 1) - 1 : UINT64_MAX;
+    }
+
+    void record(uint64_t value) {
+        counts[getBucket(value)]++;
+        count++;
+        sum += value;
+        max = std::max(max, value);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (std::size_t bucket = 0; bucket < BUCKETS; bucket++) {
+            counts[bucket] += other.counts[bucket];
+        }
+        count += other.count;
+        sum += other.sum;
+        max = std::max(max, other.max);
+    }
+
+    // upper bound of the bucket the quantile falls into (`quantile` in [0, 1])
+    [[nodiscard]] uint64_t getQuantile(double quantile) const {
+        if (count == 0) {
+            return 0;
+        }
+        auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(quantile * count + 0.5));
+        uint64_t seen = 0;
+        for (std::size_t bucket = 0; bucket < BUCKETS; bucket++) {
+            seen += counts[bucket];
+            if (seen >= rank) {
+                return std::min(getBucketUpperBound(bucket), max);
+            }
+        }
+        return max;
+    }
+
+    [[nodiscard]] uint64_t getCount() const {
+        return count;
+    }
+
+    [[nodiscard]] double getMean() const {
+        return count > 0 ? static_cast<double>(sum) / count : 0;
+    }
+
+    [[nodiscard]] uint64_t getMax() const {
+        return max;
+    }
+
+    // non-empty buckets: the bucket upper bound and the count
+    [[nodiscard]] std::vector<std::pair<uint64_t, uint64_t>> getBuckets() const {
+        std::vector<std::pair<uint64_t, uint64_t>> buckets;
+        for (std::size_t bucket = 0; bucket < BUCKETS; bucket++) {
+            if (counts[bucket] > 0) {
+                buckets.emplace_back(getBucketUpperBound(bucket), counts[bucket]);
+            }
+        }
+        return buckets;
+    }
+};
+
+// Hardware counters of the calling thread (`perf_event_open`, userspace only). A counter which can not be opened
+// (no PMU in a VM, `perf_event_paranoid`, seccomp) is reported as unavailable rather than failing the run.
+class PerfCounters {
+public:
+    struct Event {
+        const char* name;
+        uint32_t type;
+        uint64_t config;
+    };
+
+    static constexpr Event EVENTS[] = {
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {"dtlb_load_misses", PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    };
+    static constexpr std::size_t EVENT_COUNT = std::size(EVENTS);
+
+    // `-1` for the unavailable counters
+    using Values = std::array<int64_t, EVENT_COUNT>;
+
+private:
+    std::array<int, EVENT_COUNT> fds;
+
+public:
+    PerfCounters() {
+        for (std::size_t idx = 0; idx < EVENT_COUNT; idx++) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof attr);
+            attr.size = sizeof attr;
+            attr.type = EVENTS[idx].type;
+            attr.config = EVENTS[idx].config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[idx] = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+    }
+    PerfCounters(const PerfCounters& other) = delete;
+    ~PerfCounters() {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    }
+
+    void start() {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    [[nodiscard]] Values stop() {
+        Values values;
+        for (std::size_t idx = 0; idx < EVENT_COUNT; idx++) {
+            uint64_t value;
+            if (fds[idx] < 0 || ::ioctl(fds[idx], PERF_EVENT_IOC_DISABLE, 0) != 0
+                || ::read(fds[idx], &value, sizeof value) != sizeof value) {
+                values[idx] = -1;
+            } else {
+                values[idx] = static_cast<int64_t>(value);
+            }
+        }
+        return values;
+    }
+};
@@ -0,0 +1,127 @@
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+
+#include <db_file.h>
+#include <writer.h>
+
+// Measures how long random lookups take to reach the steady state latency after opening a file which is not in the
+// page cache, with various `DbFile` policies. The file is evicted from the page cache with `POSIX_FADV_DONTNEED`.
+// Usage: benchmark-cold-start [KEYS] [FORMAT_VERSION]
+
+static std::string makeKey(uint64_t i) {
+    return "shops-7f00b33a8134aa21f40d1295bc80b5ee/item/" + std::to_string(i * 7919 % 1000000007);
+}
+
+static void evictFromPageCache(const std::filesystem::path& path) {
+    auto file = RoflDb::Utils::FileDescriptor::open(path);
+    if (posix_fadvise(file.get(), 0, 0, POSIX_FADV_DONTNEED) != 0) {
+        throw std::runtime_error("posix_fadvise failed");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    using clock = std::chrono::steady_clock;
+
+    uint64_t keyCount = argc > 1 ? std::stoull(argv[1]) : 5000000;
+    auto version = static_cast<RoflDb::FormatVersion>(argc > 2 ? std::stoul(argv[2]) : 2);
+    constexpr uint64_t WINDOW_LOOKUPS = 10000;
+    constexpr auto MAX_DURATION = std::chrono::seconds(30);
+    // the latency is steady when a window is within this factor of the warm one
+    constexpr double STEADY_FACTOR = 1.5;
+
+    auto path = std::filesystem::temp_directory_path() / "rofldb-benchmark-cold-start.rofldb";
+    auto profilePath = std::filesystem::temp_directory_path() / "rofldb-benchmark-cold-start.hotpages";
+    {
+        RoflDb::DbWriter::Options options;
+        options.version = version;
+        RoflDb::DbWriter writer(path, options);
+        for (uint64_t i = 0; i < keyCount; i++) {
+            writer.put(makeKey(i), "value" + std::to_string(i));
+        }
+        auto stats = writer.finish();
+        std::cout << keyCount << " keys, file " << stats.fileBytes << " bytes, tree " << stats.treeBytes << " bytes\n";
+    }
+
+    std::mt19937_64 random(42);
+    // average ns per lookup of a window
+    auto runWindow = [&](const RoflDb::DbReader& dbReader) {
+        std::vector<std::string> keys;
+        keys.reserve(WINDOW_LOOKUPS);
+        for (uint64_t i = 0; i < WINDOW_LOOKUPS; i++) {
+            keys.push_back(makeKey(random() % keyCount));
+        }
+        auto start = clock::now();
+        for (const auto& key : keys) {
+            if (!dbReader.get(key)) [[unlikely]] {
+                throw std::runtime_error("Key " + key + " not found");
+            }
+        }
+        return std::chrono::duration<double, std::nano>(clock::now() - start).count() / WINDOW_LOOKUPS;
+    };
+
+    double warmLatency;
+    {
+        RoflDb::DbFile::Options options;
+        options.populate = true;
+        RoflDb::DbFile dbFile(path, options);
+        for (int i = 0; i < 10; i++) {
+            runWindow(dbFile.getReader());
+        }
+        warmLatency = runWindow(dbFile.getReader());
+        std::cout << "warm: " << static_cast<uint64_t>(warmLatency) << " ns per lookup\n";
+    }
+
+    // the profile of a process which served some traffic after a cold start
+    {
+        evictFromPageCache(path);
+        RoflDb::DbFile dbFile(path);
+        for (int i = 0; i < 20; i++) {
+            runWindow(dbFile.getReader());
+        }
+        dbFile.saveHotPageProfile(profilePath);
+    }
+
+    const std::pair<const char*, std::function<void(RoflDb::DbFile::Options&)>> policies[] = {
+        {"default", [](auto&) {}},
+        {"MADV_RANDOM", [](auto& options) { options.advice = RoflDb::DbFile::Advice::RANDOM; }},
+        {"MADV_WILLNEED", [](auto& options) { options.advice = RoflDb::DbFile::Advice::WILLNEED; }},
+        {"MAP_POPULATE", [](auto& options) { options.populate = true; }},
+        {"mlock tree", [](auto& options) { options.lockTree = true; }},
+        {"tree warmup", [](auto& options) { options.warmupTree = true; }},
+        {"hot page profile", [&](auto& options) { options.hotPageProfile = profilePath; }},
+        {"hot page profile + tree warmup", [&](auto& options) { options.hotPageProfile = profilePath; options.warmupTree = true; }},
+    };
+    for (const auto& [name, configure] : policies) {
+        evictFromPageCache(path);
+        RoflDb::DbFile::Options options;
+        configure(options);
+
+        auto openedAt = clock::now();
+        RoflDb::DbFile dbFile(path, options);
+        auto openTime = clock::now() - openedAt;
+
+        double firstLatency = runWindow(dbFile.getReader());
+        double latency = firstLatency;
+        uint64_t lookups = WINDOW_LOOKUPS;
+        while (latency > warmLatency * STEADY_FACTOR && clock::now() - openedAt < MAX_DURATION) {
+            latency = runWindow(dbFile.getReader());
+            lookups += WINDOW_LOOKUPS;
+        }
+        auto steadyTime = clock::now() - openedAt;
+
+        std::cout << "[" << name << "] open " << std::chrono::duration_cast<std::chrono::milliseconds>(openTime).count() << " ms, "
+                  << "first " << WINDOW_LOOKUPS << " lookups " << static_cast<uint64_t>(firstLatency) << " ns per lookup, "
+                  << (latency > warmLatency * STEADY_FACTOR ? "not steady after " : "steady after ")
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(steadyTime).count() << " ms and " << lookups << " lookups\n";
+    }
+
+    std::filesystem::remove(profilePath);
+    std::filesystem::remove(path);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <db_handle.h>
+#include <writer.h>
+
+// Measures the lookup throughput and latency percentiles of reader threads while another thread keeps swapping the
+// file they read: `DbHandle` without swaps, `DbHandle` with swaps, and for comparison a `std::shared_mutex` around a
+// `std::shared_ptr` to the file, the lock-based way of swapping.
+// Usage: benchmark-hot-swap [KEYS] [SECONDS] [SWAP_INTERVAL_MS] [THREADS]
+
+static std::string makeKey(uint64_t i) {
+    return "shops-7f00b33a8134aa21f40d1295bc80b5ee/item/" + std::to_string(i * 7919 % 1000000007);
+}
+
+int main(int argc, char* argv[]) {
+    using clock = std::chrono::steady_clock;
+
+    uint64_t keyCount = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    auto duration = std::chrono::duration<double>(argc > 2 ? std::stod(argv[2]) : 3);
+    auto swapInterval = std::chrono::milliseconds(argc > 3 ? std::stoul(argv[3]) : 10);
+    unsigned threadCount = argc > 4 ? std::stoul(argv[4]) : std::max(1u, std::thread::hardware_concurrency());
+    // a lookup in this many is timed on its own
+    constexpr uint64_t SAMPLE_EVERY = 16;
+
+    // two versions of the file, with different values
+    std::filesystem::path paths[2];
+    for (int version = 0; version < 2; version++) {
+        paths[version] = std::filesystem::temp_directory_path() / ("rofldb-benchmark-hot-swap-" + std::to_string(version) + ".rofldb");
+        RoflDb::DbWriter::Options options;
+        options.version = RoflDb::FormatVersion::WIDE_TREE;
+        RoflDb::DbWriter writer(paths[version], options);
+        for (uint64_t i = 0; i < keyCount; i++) {
+            writer.put(makeKey(i), (version == 0 ? "a/" : "b/") + std::to_string(i));
+        }
+        (void)writer.finish();
+    }
+    std::vector<std::string> keys;
+    keys.reserve(keyCount);
+    for (uint64_t i = 0; i < keyCount; i++) {
+        keys.push_back(makeKey(i));
+    }
+
+    // runs `lookup(key)` on the reader threads for the duration while `swap(version)` runs every interval (if any),
+    // `setUp()` gives the lookup function of a thread
+    auto measure = [&](const char* name, auto&& setUp, auto&& swap, bool swapping) {
+        std::atomic<bool> stop = false;
+        std::atomic<uint64_t> lookups = 0;
+        std::vector<std::vector<uint64_t>> latencies(threadCount);
+        std::vector<std::thread> threads;
+        for (unsigned idx = 0; idx < threadCount; idx++) {
+            threads.emplace_back([&, idx]() {
+                auto lookup = setUp();
+                std::mt19937_64 random(idx);
+                uint64_t count = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    const auto& key = keys[random() % keyCount];
+                    if (count % SAMPLE_EVERY == 0) {
+                        auto start = clock::now();
+                        lookup(key);
+                        latencies[idx].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+                    } else {
+                        lookup(key);
+                    }
+                    count++;
+                }
+                lookups += count;
+            });
+        }
+
+        uint64_t swaps = 0;
+        auto start = clock::now();
+        while (clock::now() - start < duration) {
+            std::this_thread::sleep_for(swapInterval);
+            if (swapping) {
+                swap(++swaps % 2);
+            }
+        }
+        stop = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+        std::vector<uint64_t> all;
+        for (const auto& threadLatencies : latencies) {
+            all.insert(all.end(), threadLatencies.begin(), threadLatencies.end());
+        }
+        std::sort(all.begin(), all.end());
+        auto percentile = [&all](double fraction) {
+            return all.empty() ? 0 : all[std::min(all.size() - 1, static_cast<std::size_t>(fraction * all.size()))];
+        };
+        std::cout << "[" << name << "] " << swaps << " swaps, " << static_cast<uint64_t>(lookups / elapsed) << " lookups/s, latency p50 "
+                  << percentile(0.5) << " ns, p99 " << percentile(0.99) << " ns, p99.9 " << percentile(0.999) << " ns, max "
+                  << (all.empty() ? 0 : all.back()) << " ns\n";
+    };
+    auto check = [](const std::optional<RoflDb::Value>& value) {
+        if (!value || value->size() < 2) [[unlikely]] {
+            std::cerr << "ERROR: key not found\n";
+            std::exit(1);
+        }
+    };
+
+    // the new mappings are populated by the swapping thread, so that the readers do not fault their pages in
+    RoflDb::DbFile::Options fileOptions;
+    fileOptions.populate = true;
+
+    {
+        RoflDb::DbHandle handle(paths[0], fileOptions);
+        auto setUp = [&handle, &check]() {
+            return [&check, reader = handle.registerReader()](const std::string& key) {
+                auto guard = reader.pin();
+                check(guard->get(key));
+            };
+        };
+        auto swap = [&handle, &paths](int version) {
+            handle.swap(paths[version]);
+        };
+        measure("DbHandle, no swaps", setUp, swap, false);
+        measure("DbHandle, swapping", setUp, swap, true);
+        std::cout << "files still pinned after the swaps: " << handle.collect() << "\n";
+    }
+    {
+        std::shared_mutex mutex;
+        std::shared_ptr<const RoflDb::DbFile> current = std::make_shared<const RoflDb::DbFile>(paths[0], fileOptions);
+        auto setUp = [&]() {
+            return [&](const std::string& key) {
+                std::shared_lock lock(mutex);
+                check(current->getReader().get(key));
+            };
+        };
+        auto swap = [&](int version) {
+            auto file = std::make_shared<const RoflDb::DbFile>(paths[version], fileOptions);
+            std::unique_lock lock(mutex);
+            current = std::move(file);
+        };
+        measure("shared_mutex, swapping", setUp, swap, true);
+    }
+
+    for (const auto& path : paths) {
+        std::filesystem::remove(path);
+    }
+    return 0;
+}
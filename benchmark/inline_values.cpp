@@ -0,0 +1,79 @@
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <db_file.h>
+#include <writer.h>
+
+// Compares random lookups with the small values stored in the value collection and inline in the tree nodes
+// (`DbWriter::Options::inlineValueSize`), for every tree layout. The dataset is larger than the caches, so the hop to
+// the value collection is a miss of its own.
+// Usage: benchmark-inline-values [KEYS] [LOOKUPS] [VALUE_SIZE]
+
+static std::string makeKey(uint64_t i) {
+    return "shops-7f00b33a8134aa21f40d1295bc80b5ee/item/" + std::to_string(i * 7919 % 1000000007);
+}
+
+int main(int argc, char* argv[]) {
+    using clock = std::chrono::steady_clock;
+
+    uint64_t keyCount = argc > 1 ? std::stoull(argv[1]) : 5000000;
+    uint64_t lookupCount = argc > 2 ? std::stoull(argv[2]) : 2000000;
+    std::size_t valueSize = argc > 3 ? std::stoull(argv[3]) : 24;
+
+    std::mt19937_64 random(42);
+    std::vector<std::string> lookups;
+    lookups.reserve(lookupCount);
+    for (uint64_t i = 0; i < lookupCount; i++) {
+        lookups.push_back(makeKey(random() % keyCount));
+    }
+    auto makeValue = [valueSize](uint64_t i) {
+        auto value = std::to_string(i);
+        value.resize(valueSize, '.');
+        return value;
+    };
+
+    const std::pair<RoflDb::FormatVersion, const char*> versions[] = {
+        {RoflDb::FormatVersion::SORTED_BINARY_TREE, "sorted binary tree (v0)"},
+        {RoflDb::FormatVersion::EYTZINGER_TREE, "eytzinger tree (v1)"},
+        {RoflDb::FormatVersion::WIDE_TREE, "wide tree (v2)"},
+        {RoflDb::FormatVersion::PREFIX_COMPRESSED_WIDE_TREE, "prefix compressed wide tree (v3)"},
+    };
+    auto path = std::filesystem::temp_directory_path() / "rofldb-benchmark-inline-values.rofldb";
+    for (auto [version, name] : versions) {
+        for (bool inlineValues : {false, true}) {
+            RoflDb::DbWriter::Options options;
+            options.version = version;
+            options.inlineValueSize = inlineValues ? valueSize : 0;
+            RoflDb::DbWriter writer(path, options);
+            for (uint64_t i = 0; i < keyCount; i++) {
+                writer.put(makeKey(i), makeValue(i));
+            }
+            auto stats = writer.finish();
+
+            RoflDb::DbFile::Options fileOptions;
+            fileOptions.populate = true;
+            RoflDb::DbFile dbFile(path, fileOptions);
+            const auto& dbReader = dbFile.getReader();
+            uint64_t checksum = 0;
+            auto start = clock::now();
+            for (const auto& key : lookups) {
+                auto value = dbReader.get(key);
+                if (!value) [[unlikely]] {
+                    std::cerr << "ERROR: key " << key << " not found\n";
+                    return 1;
+                }
+                checksum += static_cast<uint8_t>(value->get()[0]);
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+            std::cout << "[" << name << (inlineValues ? ", inline values" : "") << "] tree " << stats.treeBytes
+                      << " bytes, values " << stats.storedValueBytes << " bytes: " << elapsed.count() / lookupCount
+                      << " ns per random lookup (checksum " << checksum << ")\n";
+        }
+    }
+    std::filesystem::remove(path);
+    return 0;
+}
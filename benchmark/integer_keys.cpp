@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <db_file.h>
+#include <writer.h>
+
+// Compares the 64-bit id lookups in `FormatVersion::INTEGER_KEYS` with the same ids stored in the trees, both as
+// decimal strings (the way they are usually stringified) and as the same 8-byte big endian keys.
+// Usage: benchmark-integer-keys [KEYS] [LOOKUPS]
+
+int main(int argc, char* argv[]) {
+    using clock = std::chrono::steady_clock;
+
+    uint64_t keyCount = argc > 1 ? std::stoull(argv[1]) : 5000000;
+    uint64_t lookupCount = argc > 2 ? std::stoull(argv[2]) : 2000000;
+    constexpr std::size_t BATCH_SIZE = 64;
+
+    // sparse ids, as the ones generated from a timestamp and a sequence number
+    std::mt19937_64 random(42);
+    std::vector<uint64_t> ids(keyCount);
+    uint64_t id = uint64_t(1) << 40;
+    for (auto& item : ids) {
+        id += 1 + random() % 1000;
+        item = id;
+    }
+    std::vector<uint64_t> lookups(lookupCount);
+    for (auto& lookup : lookups) {
+        lookup = ids[random() % keyCount];
+    }
+
+    struct Layout {
+        RoflDb::FormatVersion version;
+        bool decimalKeys;
+        const char* name;
+    };
+    const Layout layouts[] = {
+        {RoflDb::FormatVersion::SORTED_BINARY_TREE, true, "sorted binary tree (v0), decimal keys"},
+        {RoflDb::FormatVersion::WIDE_TREE, true, "wide tree (v2), decimal keys"},
+        {RoflDb::FormatVersion::WIDE_TREE, false, "wide tree (v2), 8-byte keys"},
+        {RoflDb::FormatVersion::INTEGER_KEYS, false, "integer keys (v4)"},
+    };
+    for (const auto& layout : layouts) {
+        auto path = std::filesystem::temp_directory_path() / "rofldb-benchmark-integer-keys.rofldb";
+        RoflDb::DbWriter::Stats stats;
+        {
+            RoflDb::DbWriter::Options options;
+            options.version = layout.version;
+            RoflDb::DbWriter writer(path, options);
+            for (auto item : ids) {
+                if (layout.decimalKeys) {
+                    writer.put(std::to_string(item), "value" + std::to_string(item));
+                } else {
+                    writer.put(item, "value" + std::to_string(item));
+                }
+            }
+            stats = writer.finish();
+        }
+
+        RoflDb::DbFile::Options fileOptions;
+        fileOptions.populate = true;
+        RoflDb::DbFile dbFile(path, fileOptions);
+        const auto& dbReader = dbFile.getReader();
+
+        // the keys are encoded before the clock starts, as a caller keeping them in that form would
+        std::vector<std::string> keyStrings;
+        keyStrings.reserve(lookupCount);
+        for (auto lookup : lookups) {
+            if (layout.decimalKeys) {
+                keyStrings.push_back(std::to_string(lookup));
+            } else {
+                keyStrings.emplace_back(RoflDb::priv::LearnedTree::KEY_SIZE, '\0');
+                RoflDb::priv::LearnedTree::encodeKey(lookup, reinterpret_cast<std::byte*>(keyStrings.back().data()));
+            }
+        }
+        std::vector<RoflDb::Key> keys;
+        keys.reserve(lookupCount);
+        for (const auto& key : keyStrings) {
+            keys.emplace_back(reinterpret_cast<const std::byte*>(key.data()), key.size());
+        }
+
+        auto start = clock::now();
+        for (const auto& key : keys) {
+            if (!dbReader.get(key)) [[unlikely]] {
+                std::cerr << "ERROR: key not found\n";
+                return 1;
+            }
+        }
+        auto getElapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+        std::vector<std::optional<RoflDb::Value>> values(lookupCount);
+        start = clock::now();
+        for (std::size_t offset = 0; offset < lookupCount; offset += BATCH_SIZE) {
+            auto size = std::min<std::size_t>(BATCH_SIZE, lookupCount - offset);
+            dbReader.getMany(std::span(keys).subspan(offset, size), std::span(values).subspan(offset, size));
+        }
+        auto getManyElapsed = std::chrono::duration<double>(clock::now() - start).count();
+        if (!std::all_of(values.begin(), values.end(), [](const auto& value) { return value.has_value(); })) [[unlikely]] {
+            std::cerr << "ERROR: key not found\n";
+            return 1;
+        }
+
+        std::cout << "[" << layout.name << "] tree " << stats.treeBytes << " bytes ("
+                  << static_cast<double>(stats.treeBytes) / keyCount << " per key), get: "
+                  << static_cast<uint64_t>(getElapsed * 1e9 / lookupCount) << " ns, getMany: "
+                  << static_cast<uint64_t>(lookupCount / getManyElapsed) << " lookups/s\n";
+        std::filesystem::remove(path);
+    }
+    return 0;
+}
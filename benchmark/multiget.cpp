@@ -0,0 +1,97 @@
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <library.h>
+#include <writer.h>
+
+// Compares the throughput of `DbReader::get` called in a loop with `DbReader::getMany` at various batch sizes.
+// Usage: benchmark-multiget [KEYS] [LOOKUPS]
+
+static std::string makeKey(uint64_t i) {
+    return "shops-7f00b33a8134aa21f40d1295bc80b5ee/item/" + std::to_string(i * 7919 % 1000000007);
+}
+
+int main(int argc, char* argv[]) {
+    using clock = std::chrono::steady_clock;
+
+    uint64_t keyCount = argc > 1 ? std::stoull(argv[1]) : 5000000;
+    uint64_t lookupCount = argc > 2 ? std::stoull(argv[2]) : 2000000;
+
+    std::mt19937_64 random(42);
+    std::vector<std::string> lookupStrings;
+    lookupStrings.reserve(lookupCount);
+    for (uint64_t i = 0; i < lookupCount; i++) {
+        lookupStrings.push_back(makeKey(random() % keyCount));
+    }
+    std::vector<RoflDb::Key> lookups;
+    lookups.reserve(lookupCount);
+    for (const auto& key : lookupStrings) {
+        lookups.emplace_back(reinterpret_cast<const std::byte*>(key.data()), key.size());
+    }
+    std::vector<std::optional<RoflDb::Value>> values(lookupCount);
+
+    const std::pair<RoflDb::FormatVersion, const char*> versions[] = {
+        {RoflDb::FormatVersion::SORTED_BINARY_TREE, "sorted binary tree (v0)"},
+        {RoflDb::FormatVersion::EYTZINGER_TREE, "eytzinger tree (v1)"},
+        {RoflDb::FormatVersion::WIDE_TREE, "wide tree (v2)"},
+        {RoflDb::FormatVersion::PREFIX_COMPRESSED_WIDE_TREE, "prefix compressed wide tree (v3)"},
+    };
+    for (auto [version, name] : versions) {
+        auto path = std::filesystem::temp_directory_path() / ("rofldb-benchmark-multiget-" + std::to_string(static_cast<int>(version)) + ".rofldb");
+
+        RoflDb::DbWriter::Options options;
+        options.version = version;
+        RoflDb::DbWriter writer(path, options);
+        for (uint64_t i = 0; i < keyCount; i++) {
+            writer.put(makeKey(i), "value" + std::to_string(i));
+        }
+        auto stats = writer.finish();
+
+        int fd = open(path.c_str(), O_RDONLY);
+        auto* data = static_cast<std::byte*>(mmap(nullptr, stats.fileBytes, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0));
+        if (data == MAP_FAILED) {
+            throw std::runtime_error(std::strerror(errno));
+        }
+        close(fd);
+        RoflDb::DbReader dbReader(data, stats.fileBytes);
+
+        auto start = clock::now();
+        for (const auto& key : lookups) {
+            if (!dbReader.get(key)) [[unlikely]] {
+                std::cerr << "ERROR: key not found\n";
+                return 1;
+            }
+        }
+        auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        std::cout << "[" << name << "] get: " << static_cast<uint64_t>(lookupCount / elapsed) << " lookups/s\n";
+
+        for (std::size_t batchSize : {1, 2, 4, 8, 16, 32, 64, 128, 256, 512}) {
+            start = clock::now();
+            for (std::size_t offset = 0; offset < lookupCount; offset += batchSize) {
+                auto size = std::min<std::size_t>(batchSize, lookupCount - offset);
+                dbReader.getMany(std::span(lookups).subspan(offset, size), std::span(values).subspan(offset, size));
+            }
+            elapsed = std::chrono::duration<double>(clock::now() - start).count();
+            for (const auto& value : values) {
+                if (!value) [[unlikely]] {
+                    std::cerr << "ERROR: key not found\n";
+                    return 1;
+                }
+            }
+            std::cout << "[" << name << "] getMany, batch " << batchSize << ": " << static_cast<uint64_t>(lookupCount / elapsed) << " lookups/s\n";
+        }
+
+        munmap(data, stats.fileBytes);
+        std::filesystem::remove(path);
+    }
+    return 0;
+}
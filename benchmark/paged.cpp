@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+
+#include <db_file.h>
+#include <paged.h>
+#include <writer.h>
+
+// Measures random lookups on a file which is not in the page cache: the mapped `DbFile`, which blocks on a page fault
+// per miss, against `PagedDbFile` with synchronous `pread` and with `io_uring` keeping many lookups in flight. To see
+// the files larger than the memory, run it in a memory limited cgroup with a cache size below the limit, e.g.
+//   systemd-run --scope -p MemoryMax=256M benchmark-paged 50000000 2 128
+// Usage: benchmark-paged [KEYS] [FORMAT_VERSION] [CACHE_MIB] [LOOKUPS] [IN_FLIGHT] [DIRECT_IO]
+
+static std::string makeKey(uint64_t i) {
+    return "shops-7f00b33a8134aa21f40d1295bc80b5ee/item/" + std::to_string(i * 7919 % 1000000007);
+}
+
+static void evictFromPageCache(const std::filesystem::path& path) {
+    auto file = RoflDb::Utils::FileDescriptor::open(path);
+    if (posix_fadvise(file.get(), 0, 0, POSIX_FADV_DONTNEED) != 0) {
+        throw std::runtime_error("posix_fadvise failed");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    using clock = std::chrono::steady_clock;
+
+    uint64_t keyCount = argc > 1 ? std::stoull(argv[1]) : 5000000;
+    auto version = static_cast<RoflDb::FormatVersion>(argc > 2 ? std::stoul(argv[2]) : 2);
+    std::size_t cacheBytes = (argc > 3 ? std::stoull(argv[3]) : 128) * 1024 * 1024;
+    uint64_t lookupCount = argc > 4 ? std::stoull(argv[4]) : 200000;
+    unsigned inFlight = std::max(1ul, argc > 5 ? std::stoul(argv[5]) : 64);
+    bool directIo = argc > 6 && std::stoul(argv[6]) != 0;
+
+    auto path = std::filesystem::temp_directory_path() / "rofldb-benchmark-paged.rofldb";
+    {
+        RoflDb::DbWriter::Options options;
+        options.version = version;
+        RoflDb::DbWriter writer(path, options);
+        for (uint64_t i = 0; i < keyCount; i++) {
+            writer.put(makeKey(i), "value" + std::to_string(i));
+        }
+        auto stats = writer.finish();
+        std::cout << keyCount << " keys, file " << stats.fileBytes << " bytes, tree " << stats.treeBytes << " bytes, cache "
+                  << cacheBytes << " bytes\n";
+    }
+
+    std::vector<std::string> keys;
+    keys.reserve(lookupCount);
+    std::mt19937_64 random(42);
+    for (uint64_t i = 0; i < lookupCount; i++) {
+        keys.push_back(makeKey(random() % keyCount));
+    }
+    auto report = [lookupCount](const char* name, clock::time_point start) {
+        auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+        std::cout << "[" << name << "] " << static_cast<uint64_t>(lookupCount / seconds) << " lookups/s, "
+                  << static_cast<uint64_t>(seconds * 1e9 / lookupCount) << " ns per lookup\n";
+    };
+    auto reportStats = [](const RoflDb::PagedDbFile& file) {
+        const auto& stats = file.getStats();
+        std::cout << "    page hits " << stats.pageHits << ", misses " << stats.pageMisses << ", reads " << stats.reads << " ("
+                  << stats.readBytes << " bytes), evictions " << stats.evictions << ", pinned " << stats.pinnedPages
+                  << " pages, resident " << stats.residentPages << " pages\n";
+    };
+    auto check = [](bool found) {
+        if (!found) [[unlikely]] {
+            std::cerr << "ERROR: key not found\n";
+            std::exit(1);
+        }
+    };
+
+    {
+        evictFromPageCache(path);
+        RoflDb::DbFile dbFile(path);
+        auto start = clock::now();
+        for (const auto& key : keys) {
+            check(dbFile.getReader().get(key).has_value());
+        }
+        report("mmap", start);
+    }
+
+    RoflDb::PagedDbFile::Options options;
+    options.cacheBytes = cacheBytes;
+    options.directIo = directIo;
+    {
+        evictFromPageCache(path);
+        options.ioBackend = RoflDb::PagedDbFile::IoBackend::PREAD;
+        RoflDb::PagedDbFile file(path, options);
+        auto start = clock::now();
+        for (const auto& key : keys) {
+            check(file.get(key).has_value());
+        }
+        report("paged, pread", start);
+        reportStats(file);
+    }
+    {
+        evictFromPageCache(path);
+        options.ioBackend = RoflDb::PagedDbFile::IoBackend::IO_URING;
+        options.queueDepth = inFlight;
+        RoflDb::PagedDbFile file(path, options);
+        if (!file.usesIoUring()) {
+            std::cout << "io_uring is not available\n";
+        }
+        auto start = clock::now();
+        for (const auto& key : keys) {
+            // at most `inFlight` lookups at once, the page reads of each of them overlap with the others
+            file.wait(inFlight - 1);
+            file.getAsync({reinterpret_cast<const std::byte*>(key.data()), key.size()}, [&check](std::optional<RoflDb::Value> value) {
+                check(value.has_value());
+            });
+        }
+        file.wait();
+        report(("paged, io_uring, " + std::to_string(inFlight) + " in flight").c_str(), start);
+        reportStats(file);
+    }
+
+    std::filesystem::remove(path);
+    return 0;
+}
@@ -0,0 +1,127 @@
+"""Lookups through the Python module (rofldb.Reader) against the lmdb module on the same dataset.
+
+Usage: python3 python_binding.py BUILD_DIR [WORK_DIR] [KEY_COUNT]
+
+BUILD_DIR is a CMake build with -DROFLDB_WITH_PYTHON=ON (rofldb-build and the module are taken from there),
+WORK_DIR gets the dataset files (a temporary directory by default).
+"""
+import gc
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+BATCH_SIZE = 1000
+LOOKUPS = 1_000_000
+
+
+def make_dataset(key_count: int) -> dict:
+    rng = random.Random(42)
+    return {
+        f'key{rng.randrange(10 ** 12):012d}'.encode(): os.urandom(rng.randrange(8, 200))
+        for _ in range(key_count)
+    }
+
+
+def build_rofldb(build_dir: str, path: str, dataset: dict) -> None:
+    with tempfile.TemporaryFile() as records:
+        for key, value in dataset.items():
+            records.write(len(key).to_bytes(4, 'little') + key + len(value).to_bytes(4, 'little') + value)
+        records.seek(0)
+        subprocess.run([os.path.join(build_dir, 'rofldb-build'), '--format=binary', '--format-version=2', path],
+                       stdin=records, check=True, stderr=subprocess.DEVNULL)
+
+
+def build_lmdb(lmdb, path: str, dataset: dict) -> None:
+    with lmdb.open(path, map_size=4 * 1024 ** 3, subdir=False) as env:
+        with env.begin(write=True) as txn:
+            for key, value in sorted(dataset.items()):
+                txn.put(key, value, append=True)
+
+
+def measure(name: str, lookup, keys: list, threads: int = 1) -> None:
+    """`lookup(keys)` looks a slice of the keys up, the slices are split among the threads"""
+    per_thread = len(keys) // threads
+    slices = [keys[idx * per_thread:(idx + 1) * per_thread] for idx in range(threads)]
+    workers = [threading.Thread(target=lookup, args=(part,)) for part in slices]
+    started = time.perf_counter()
+    for worker in workers:
+        worker.start()
+    for worker in workers:
+        worker.join()
+    elapsed = time.perf_counter() - started
+    print(f'{name:<40} {threads:>2} threads: {elapsed / (per_thread * threads) * 1e9:8.0f} ns/lookup')
+
+
+def main(build_dir: str, work_dir: str, key_count: int) -> None:
+    sys.path.insert(0, build_dir)
+    import rofldb
+    try:
+        import lmdb
+    except ImportError:
+        lmdb = None
+        print('lmdb module is not installed, measuring rofldb only')
+
+    dataset = make_dataset(key_count)
+    rofldb_path = os.path.join(work_dir, 'python_binding.rofldb')
+    lmdb_path = os.path.join(work_dir, 'python_binding.lmdb')
+    build_rofldb(build_dir, rofldb_path, dataset)
+    if lmdb:
+        if os.path.exists(lmdb_path):
+            os.unlink(lmdb_path)
+        build_lmdb(lmdb, lmdb_path, dataset)
+
+    rng = random.Random(1)
+    keys = rng.choices(list(dataset), k=LOOKUPS)
+    thread_counts = sorted({1, 2, 4, os.cpu_count() or 1})
+    # the collections triggered by the values (memoryviews are tracked) would otherwise traverse the dataset every time
+    gc.freeze()
+
+    reader = rofldb.Reader(rofldb_path, populate=True)
+
+    def rofldb_get(part):
+        get = reader.get
+        for key in part:
+            get(key)
+
+    def rofldb_get_many(part):
+        for idx in range(0, len(part), BATCH_SIZE):
+            reader.get_many(part[idx:idx + BATCH_SIZE])
+
+    measure('rofldb Reader.get', rofldb_get, keys)
+    for threads in thread_counts:
+        measure(f'rofldb Reader.get_many ({BATCH_SIZE})', rofldb_get_many, keys, threads)
+
+    if lmdb:
+        env = lmdb.open(lmdb_path, subdir=False, readonly=True, lock=False, max_readers=256)
+
+        def lmdb_get(part):
+            with env.begin(buffers=True) as txn:
+                get = txn.get
+                for key in part:
+                    get(key)
+
+        def lmdb_getmulti(part):
+            with env.begin(buffers=True) as txn, txn.cursor() as cursor:
+                for idx in range(0, len(part), BATCH_SIZE):
+                    cursor.getmulti(part[idx:idx + BATCH_SIZE])
+
+        for threads in thread_counts:
+            measure('lmdb Transaction.get (buffers)', lmdb_get, keys, threads)
+        if hasattr(lmdb.Cursor, 'getmulti'):
+            for threads in thread_counts:
+                measure(f'lmdb Cursor.getmulti ({BATCH_SIZE})', lmdb_getmulti, keys, threads)
+        env.close()
+
+    # the values have to be gone before the reader can be closed
+    reader.close()
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    with tempfile.TemporaryDirectory() as temporary:
+        main(sys.argv[1], sys.argv[2] if len(sys.argv) > 2 else temporary, int(sys.argv[3]) if len(sys.argv) > 3 else 1_000_000)
@@ -0,0 +1,189 @@
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <client.h>
+#include <server.h>
+#include <writer.h>
+
+#include "bench_stats.h"
+
+// Random gets through `rofldb-serve` (a `DbServer` run in this process, its clients connected over the Unix socket)
+// against the same gets of `DbReader::get` in the process: one key per request, batches of keys per request, and
+// batches with several requests in flight on a connection. Prints the keys per second over all the threads, and the
+// latency per request (from queueing it to receiving its response).
+// Usage: benchmark-serve [KEYS] [LOOKUPS_PER_THREAD] [THREADS]
+
+static std::string makeKey(uint64_t i) {
+    return "shops-7f00b33a8134aa21f40d1295bc80b5ee/item/" + std::to_string(i * 7919 % 1000000007);
+}
+
+struct Result {
+    double keysPerSecond = 0;
+    LatencyHistogram latency;
+    uint64_t checksum = 0;
+};
+
+// `work(thread, latency)` returns a checksum of the values found
+template<class WorkT>
+static Result runThreads(unsigned threadCount, uint64_t keysPerThread, WorkT work) {
+    using clock = std::chrono::steady_clock;
+    std::vector<LatencyHistogram> latencies(threadCount);
+    std::vector<uint64_t> checksums(threadCount);
+    auto start = clock::now();
+    {
+        std::vector<std::jthread> threads;
+        for (unsigned thread = 0; thread < threadCount; thread++) {
+            threads.emplace_back([&, thread]() {
+                checksums[thread] = work(thread, latencies[thread]);
+            });
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    Result result;
+    result.keysPerSecond = static_cast<double>(keysPerThread * threadCount) / elapsed;
+    for (unsigned thread = 0; thread < threadCount; thread++) {
+        result.latency.merge(latencies[thread]);
+        result.checksum += checksums[thread];
+    }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    using clock = std::chrono::steady_clock;
+
+    uint64_t keyCount = argc > 1 ? std::stoull(argv[1]) : 5000000;
+    uint64_t lookupCount = argc > 2 ? std::stoull(argv[2]) : 1000000;
+    unsigned threadCount = argc > 3 ? std::stoul(argv[3]) : std::max(1u, std::thread::hardware_concurrency() / 2);
+
+    auto directory = std::filesystem::temp_directory_path();
+    auto path = directory / "rofldb-benchmark-serve.rofldb";
+    auto socketPath = directory / "rofldb-benchmark-serve.sock";
+    {
+        RoflDb::DbWriter writer(path, {});
+        for (uint64_t i = 0; i < keyCount; i++) {
+            writer.put(makeKey(i), std::to_string(i));
+        }
+        writer.finish();
+    }
+
+    // per thread, the same keys for all the runs
+    std::vector<std::vector<std::string>> threadKeys(threadCount);
+    for (unsigned thread = 0; thread < threadCount; thread++) {
+        std::mt19937_64 random(thread);
+        std::uniform_int_distribution<uint64_t> distribution(0, keyCount - 1);
+        for (uint64_t i = 0; i < lookupCount; i++) {
+            threadKeys[thread].push_back(makeKey(distribution(random)));
+        }
+    }
+
+    RoflDb::DbServer::Options serverOptions;
+    serverOptions.threadCount = threadCount;
+    RoflDb::DbServer server(socketPath, std::span(&path, 1), serverOptions);
+    std::jthread serverThread([&server]() {
+        server.run();
+    });
+    RoflDb::DbFile dbFile(path, serverOptions.fileOptions);
+    const auto& dbReader = dbFile.getReader();
+
+    std::vector<unsigned> threadCounts {1};
+    if (threadCount > 1) {
+        threadCounts.push_back(threadCount);
+    }
+    auto print = [](const std::string& name, unsigned threads, const Result& result) {
+        std::cout << "[" << name << ", " << threads << " threads] " << static_cast<uint64_t>(result.keysPerSecond) << " keys/s, "
+                  << static_cast<uint64_t>(1e9 / result.keysPerSecond * threads) << " ns per key per thread; per request p50 "
+                  << result.latency.getQuantile(0.5) << " ns, p99 " << result.latency.getQuantile(0.99) << " ns (checksum "
+                  << result.checksum << ")\n";
+    };
+
+    for (unsigned threads : threadCounts) {
+        auto result = runThreads(threads, lookupCount, [&](unsigned thread, LatencyHistogram& latency) {
+            uint64_t checksum = 0;
+            for (const auto& key : threadKeys[thread]) {
+                auto start = clock::now();
+                auto value = dbReader.get(key);
+                latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+                checksum += static_cast<uint8_t>(value->get()[0]);
+            }
+            return checksum;
+        });
+        print("in-process DbReader::get", threads, result);
+
+        // the batches of a request, without the socket
+        result = runThreads(threads, lookupCount, [&](unsigned thread, LatencyHistogram& latency) {
+            std::vector<RoflDb::Key> keys;
+            for (const auto& key : threadKeys[thread]) {
+                keys.emplace_back(reinterpret_cast<const std::byte*>(key.data()), key.size());
+            }
+            std::vector<std::optional<RoflDb::Value>> values(64);
+            uint64_t checksum = 0;
+            for (std::size_t offset = 0; offset < keys.size(); offset += values.size()) {
+                auto batchSize = std::min(values.size(), keys.size() - offset);
+                auto start = clock::now();
+                dbReader.getMany(std::span(keys).subspan(offset, batchSize), std::span(values).first(batchSize));
+                latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+                for (std::size_t idx = 0; idx < batchSize; idx++) {
+                    checksum += static_cast<uint8_t>(values[idx]->get()[0]);
+                }
+            }
+            return checksum;
+        });
+        print("in-process DbReader::getMany, 64 keys per call", threads, result);
+    }
+
+    struct Mode {
+        std::string name;
+        std::size_t batchSize;
+        // requests in flight per connection
+        std::size_t depth;
+    };
+    for (const auto& mode : {Mode {"served, 1 key per request", 1, 1}, Mode {"served, 64 keys per request", 64, 1},
+                             Mode {"served, 64 keys per request, 16 in flight", 64, 16}}) {
+        for (unsigned threads : threadCounts) {
+            auto result = runThreads(threads, lookupCount, [&](unsigned thread, LatencyHistogram& latency) {
+                RoflDb::DbClient client(socketPath);
+                std::vector<std::string_view> keys(threadKeys[thread].begin(), threadKeys[thread].end());
+                std::deque<clock::time_point> starts;
+                uint64_t checksum = 0;
+                auto receive = [&]() {
+                    const auto& response = client.receive();
+                    latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - starts.front()).count());
+                    starts.pop_front();
+                    for (const auto& value : response.values) {
+                        checksum += static_cast<uint8_t>(value->front());
+                    }
+                };
+                for (std::size_t offset = 0; offset < keys.size(); offset += mode.batchSize) {
+                    if (starts.size() == mode.depth) {
+                        receive();
+                    }
+                    auto batch = std::span(keys).subspan(offset, std::min(mode.batchSize, keys.size() - offset));
+                    starts.push_back(clock::now());
+                    client.queueGet(0, batch);
+                    client.flush();
+                }
+                while (!starts.empty()) {
+                    receive();
+                }
+                return checksum;
+            });
+            print(mode.name, threads, result);
+        }
+    }
+
+    server.stop();
+    serverThread.join();
+    auto stats = server.getStats();
+    std::cout << "server: " << stats.connections << " connections, " << stats.requests << " requests, " << stats.keys
+              << " keys, " << stats.errors << " errors\n";
+    std::filesystem::remove(path);
+    return 0;
+}
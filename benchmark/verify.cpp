@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <db_file.h>
+#include <writer.h>
+
+// Measures the throughput of `DbReader::verify` on a single thread and on all of them, and compares the lookups with
+// the bounds checks to the unchecked ones of the verified file.
+// Usage: benchmark-verify [KEYS] [LOOKUPS]
+
+static std::string makeKey(uint64_t i) {
+    return "shops-7f00b33a8134aa21f40d1295bc80b5ee/item/" + std::to_string(i * 7919 % 1000000007);
+}
+
+int main(int argc, char* argv[]) {
+    using clock = std::chrono::steady_clock;
+
+    uint64_t keyCount = argc > 1 ? std::stoull(argv[1]) : 5000000;
+    uint64_t lookupCount = argc > 2 ? std::stoull(argv[2]) : 2000000;
+    constexpr std::size_t BATCH_SIZE = 64;
+
+    std::mt19937_64 random(42);
+    std::vector<std::string> lookupStrings;
+    lookupStrings.reserve(lookupCount);
+    for (uint64_t i = 0; i < lookupCount; i++) {
+        lookupStrings.push_back(makeKey(random() % keyCount));
+    }
+    std::vector<RoflDb::Key> lookups;
+    lookups.reserve(lookupCount);
+    for (const auto& key : lookupStrings) {
+        lookups.emplace_back(reinterpret_cast<const std::byte*>(key.data()), key.size());
+    }
+    std::vector<std::optional<RoflDb::Value>> values(lookupCount);
+
+    const std::pair<RoflDb::FormatVersion, const char*> versions[] = {
+        {RoflDb::FormatVersion::SORTED_BINARY_TREE, "sorted binary tree (v0)"},
+        {RoflDb::FormatVersion::EYTZINGER_TREE, "eytzinger tree (v1)"},
+        {RoflDb::FormatVersion::WIDE_TREE, "wide tree (v2)"},
+        {RoflDb::FormatVersion::PREFIX_COMPRESSED_WIDE_TREE, "prefix compressed wide tree (v3)"},
+    };
+    for (auto [version, name] : versions) {
+        auto path = std::filesystem::temp_directory_path() / ("rofldb-benchmark-verify-" + std::to_string(static_cast<int>(version)) + ".rofldb");
+        {
+            RoflDb::DbWriter::Options options;
+            options.version = version;
+            options.filterBitsPerKey = 10;
+            options.perfectHashIndex = true;
+            RoflDb::DbWriter writer(path, options);
+            for (uint64_t i = 0; i < keyCount; i++) {
+                writer.put(makeKey(i), "value" + std::to_string(i));
+            }
+            (void)writer.finish();
+        }
+
+        RoflDb::DbFile::Options fileOptions;
+        fileOptions.populate = true;
+        RoflDb::DbFile dbFile(path, fileOptions);
+        auto fileBytes = static_cast<double>(dbFile.getData().size());
+        // a copy, to verify it
+        auto dbReader = dbFile.getReader();
+
+        std::vector<unsigned> threadCounts {1};
+        if (std::thread::hardware_concurrency() > 1) {
+            threadCounts.push_back(std::thread::hardware_concurrency());
+        }
+        for (auto threadCount : threadCounts) {
+            auto start = clock::now();
+            dbReader.verify(threadCount);
+            auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+            std::cout << "[" << name << "] verify, " << threadCount << " threads: " << fileBytes / elapsed / 1e9 << " GB/s ("
+                      << elapsed * 1000 << " ms for " << fileBytes / 1e6 << " MB)\n";
+        }
+        auto unchecked = dbReader.getUnchecked();
+
+        auto measure = [&](const char* what, auto&& lookup) {
+            auto start = clock::now();
+            if (!lookup()) [[unlikely]] {
+                std::cerr << "ERROR: key not found\n";
+                std::exit(1);
+            }
+            auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+            std::cout << "[" << name << "] " << what << ": " << static_cast<uint64_t>(lookupCount / elapsed) << " lookups/s\n";
+        };
+        auto getAll = [&](const auto& reader) {
+            return [&]() {
+                for (const auto& key : lookups) {
+                    if (!reader.get(key)) [[unlikely]] {
+                        return false;
+                    }
+                }
+                return true;
+            };
+        };
+        auto getManyAll = [&](const auto& reader) {
+            return [&]() {
+                for (std::size_t offset = 0; offset < lookupCount; offset += BATCH_SIZE) {
+                    auto size = std::min<std::size_t>(BATCH_SIZE, lookupCount - offset);
+                    reader.getMany(std::span(lookups).subspan(offset, size), std::span(values).subspan(offset, size));
+                }
+                return std::all_of(values.begin(), values.end(), [](const auto& value) { return value.has_value(); });
+            };
+        };
+        measure("get, checked", getAll(dbReader));
+        measure("get, unchecked", getAll(unchecked));
+        measure("getMany, checked", getManyAll(dbReader));
+        measure("getMany, unchecked", getManyAll(unchecked));
+
+        std::filesystem::remove(path);
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "library.h"
+
+namespace RoflDb {
+
+// How often the keys are looked up, e.g. sampled from production by a reader (`DbReader::Options::accessSampleInterval`,
+// `DbReader::getAccessProfile`), for laying a new file out around the hot keys (`DbWriter::Options::accessProfile`).
+// File layout (little endian):
+//   "RFLP", u16 version (`0`), u64 entry count, the entries in key order (u16 key size, the key, u64 count).
+class AccessProfile {
+public:
+    static constexpr std::byte MAGIC[4] = {
+        static_cast<const std::byte>('R'),
+        static_cast<const std::byte>('F'),
+        static_cast<const std::byte>('L'),
+        static_cast<const std::byte>('P'),
+    };
+
+    struct Entry {
+        std::string key;
+        uint64_t count;
+    };
+
+protected:
+    // sorted by key, no duplicates and no zero counts
+    std::vector<Entry> entries;
+    uint64_t totalCount = 0;
+
+public:
+    AccessProfile() = default;
+    // The counts of the same key are summed, the keys counted zero times are dropped. Throws `std::invalid_argument`
+    // for a key longer than `Key::SizeType` allows.
+    explicit AccessProfile(std::vector<Entry> entries);
+
+    [[nodiscard]] static AccessProfile load(const std::filesystem::path& path);
+    // Writes a temporary file next to `path` and renames it over `path`.
+    void save(const std::filesystem::path& path) const;
+
+    // sorted by key
+    [[nodiscard]] const std::vector<Entry>& getEntries() const {
+        return entries;
+    }
+
+    [[nodiscard]] uint64_t getTotalCount() const {
+        return totalCount;
+    }
+
+    // `0` for the keys not in the profile
+    [[nodiscard]] uint64_t getCount(std::string_view key) const;
+};
+
+namespace priv {
+
+    // Sampled log of the keys looked up by a `DbReader` and its copies: every `interval`-th lookup of a thread (at
+    // random, about) counts its key, up to `capacity` distinct keys. The lookups not sampled only decrement a countdown
+    // of the thread for the log.
+    class AccessLog {
+        // the countdowns a thread keeps for the last logs it looked up with, a log evicted starts a new countdown
+        struct Countdown {
+            uint64_t logId;
+            uint64_t remaining;
+        };
+        static constexpr std::size_t COUNTDOWN_SLOTS = 8;
+
+        // unique (never `0`), so that the countdowns of a log are not taken over by another one
+        const uint64_t id;
+        const uint64_t interval;
+        const std::size_t capacity;
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, uint64_t> counts;
+        // sampled keys not counted, as the log was full
+        uint64_t dropped = 0;
+
+        void sample(const Key& key) noexcept;
+
+    public:
+        AccessLog(uint64_t interval, std::size_t capacity);
+        AccessLog(const AccessLog& other) = delete;
+
+        inline void record(const Key& key) noexcept {
+            auto& countdown = getCountdown();
+            if (countdown > 1) [[likely]] {
+                countdown--;
+                return;
+            }
+            countdown = nextCountdown();
+            sample(key);
+        }
+
+        // of the calling thread for this log
+        [[nodiscard]] inline uint64_t& getCountdown() const noexcept {
+            thread_local std::array<Countdown, COUNTDOWN_SLOTS> countdowns {};
+            thread_local std::size_t nextEvicted = 0;
+            for (auto& countdown : countdowns) {
+                if (countdown.logId == id) [[likely]] {
+                    return countdown.remaining;
+                }
+            }
+            auto& countdown = countdowns[nextEvicted++ % COUNTDOWN_SLOTS];
+            countdown = {id, nextCountdown()};
+            return countdown.remaining;
+        }
+        // uniform within `[1, 2 * interval)`, so that the sampling does not follow a periodic access pattern
+        [[nodiscard]] uint64_t nextCountdown() const noexcept;
+        [[nodiscard]] AccessProfile getProfile() const;
+        [[nodiscard]] uint64_t getDropped() const;
+    };
+
+}
+
+}
@@ -12,7 +12,7 @@ protected:
 public:
     ZeroCopyCharVector(const std::byte* memAddress, std::size_t length) : memAddress(memAddress), length(length) {};
 
-    [[nodiscard]] const inline std::byte* get() {
+    [[nodiscard]] inline const std::byte* get() const {
         return memAddress;
     }
 
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "file_io.h"
+#include "protocol.h"
+
+namespace RoflDb {
+
+// Connection to a `DbServer` (`rofldb-serve`). The requests are queued and sent by `flush` (or by `receive`), so
+// that any number of them go out together and are answered together; the responses come in the order of the requests.
+// Not thread safe, a connection per thread.
+class DbClient {
+public:
+    struct Response {
+        uint32_t requestId = 0;
+        // per key of the request, pointing into the client, valid until the next call of the client
+        std::vector<std::optional<std::string_view>> values;
+    };
+
+protected:
+    Utils::FileDescriptor socket;
+    uint32_t nextRequestId = 0;
+    // requests queued or sent, the responses of which were not received yet
+    std::size_t pendingRequests = 0;
+    // queued requests, sent up to `outputSent`
+    std::vector<std::byte> output;
+    std::size_t outputSent = 0;
+    // received bytes from `inputOffset` (the first response not returned yet) up to `inputSize`
+    std::vector<std::byte> input;
+    std::size_t inputOffset = 0;
+    std::size_t inputSize = 0;
+    Response response;
+
+    // sends what it can, then receives what is there (waiting for either if `wait`), `false` if nothing moved
+    bool exchange(bool wait);
+
+public:
+    explicit DbClient(const std::filesystem::path& socketPath);
+    DbClient(const DbClient& other) = delete;
+    DbClient(DbClient&& other) = default;
+
+    // Queues a get of `keys` in the file `fileIndex` of the server, returns the request id.
+    uint32_t queueGet(uint16_t fileIndex, std::span<const std::string_view> keys);
+    // Sends the queued requests (receiving the responses meanwhile, so that the server never waits for the client).
+    void flush();
+    // The response to the oldest request not received yet, sends the queued requests first. Throws
+    // `std::runtime_error` with the message of an `ERROR` response and `Exceptions::io_error` if the server is gone.
+    const Response& receive();
+
+    // One request, waiting for its response. The responses to the requests queued before are received and dropped.
+    std::optional<std::string> get(uint16_t fileIndex, std::string_view key);
+    const Response& getMany(uint16_t fileIndex, std::span<const std::string_view> keys);
+};
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+#ifndef ROFLDB_WITH_ZSTD
+#define ROFLDB_WITH_ZSTD false
+#endif
+
+namespace RoflDb::Utils {
+
+    // Whether the library is built with zstd (`ROFLDB_WITH_ZSTD`). Without it the files with compressed values can be
+    // neither written nor read, and all of the below throw `Exceptions::unsupported_error`.
+    [[nodiscard]] bool isCompressionSupported();
+
+    // Trains a dictionary of up to `capacity` bytes on the samples (stored one after another in `samples`).
+    // Returns an empty dictionary if there is too little to train on.
+    [[nodiscard]] std::vector<std::byte> trainDictionary(std::span<const std::byte> samples, std::span<const std::size_t> sampleSizes,
+                                                         std::size_t capacity);
+
+    // Compresses blocks with a shared (possibly empty) dictionary. Not thread-safe.
+    class BlockCompressor {
+        struct State;
+        std::unique_ptr<State> state;
+
+    public:
+        BlockCompressor(std::span<const std::byte> dictionary, int level);
+        BlockCompressor(const BlockCompressor& other) = delete;
+        ~BlockCompressor();
+
+        // Replaces the contents of `output` with the compressed `data`.
+        void compress(std::span<const std::byte> data, std::vector<std::byte>& output);
+    };
+
+    // Decompresses blocks with a shared (possibly empty) dictionary. Thread-safe.
+    class BlockDecompressor {
+        struct State;
+        std::unique_ptr<State> state;
+
+    public:
+        explicit BlockDecompressor(std::span<const std::byte> dictionary);
+        BlockDecompressor(const BlockDecompressor& other) = delete;
+        ~BlockDecompressor();
+
+        // `output` has to be exactly of the decompressed size.
+        void decompress(std::span<const std::byte> data, std::span<std::byte> output) const;
+    };
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "file_io.h"
+#include "library.h"
+
+namespace RoflDb {
+
+// Owning opener of `.rofldb` files: maps the file with the chosen policies and keeps the `DbReader` over the mapping.
+// A freshly opened file is served from the disk until its hot pages get into the page cache, which takes a while
+// with random lookups; the policies trade the open time and memory for getting there sooner.
+class DbFile {
+public:
+    enum class Advice {
+        // kernel readahead around the faults
+        NORMAL,
+        // `MADV_RANDOM`: no readahead, a fault reads a single page (for files much larger than the memory)
+        RANDOM,
+        // `MADV_WILLNEED`: the whole file is read asynchronously in the background
+        WILLNEED,
+    };
+
+    struct Options {
+        // `MAP_POPULATE`: the whole file is read while it is being opened
+        bool populate = false;
+        Advice advice = Advice::NORMAL;
+        // `MADV_HUGEPAGE`: has an effect only with the kernel support of huge pages in the page cache
+        bool hugePages = false;
+        // `mlock` the tree section, so that it is read in right away and never evicted (see `RLIMIT_MEMLOCK`)
+        bool lockTree = false;
+        // touch the tree in a background thread, level by level from the root, so the hottest pages come first
+        bool warmupTree = false;
+        // replayed in the background before the tree warmup (see `saveHotPageProfile`), ignored if it does not exist
+        std::optional<std::filesystem::path> hotPageProfile;
+        // `DbReader::verify` the whole file while it is being opened (on all the hardware threads), which reads it all
+        // and allows `DbReader::getUnchecked`
+        bool verify = false;
+        DbReader::Options readerOptions;
+    };
+
+protected:
+    Utils::FileDescriptor file;
+    std::byte* data = nullptr;
+    std::size_t size = 0;
+    std::optional<DbReader> reader;
+
+    std::atomic<bool> warmedUp = true;
+    std::jthread warmupThread;
+
+    // runs of pages: the first page and the page count
+    using PageRuns = std::vector<std::pair<uint64_t, uint64_t>>;
+
+    [[nodiscard]] PageRuns loadHotPageProfile(const std::filesystem::path& path) const;
+    void warmup(const std::stop_token& stopToken, const PageRuns& hotPages, bool warmupTree) const;
+
+public:
+    explicit DbFile(const std::filesystem::path& path) : DbFile(path, Options()) {}
+    DbFile(const std::filesystem::path& path, Options options);
+    DbFile(const DbFile& other) = delete;
+    ~DbFile();
+
+    [[nodiscard]] const DbReader& getReader() const {
+        return *reader;
+    }
+
+    [[nodiscard]] std::span<const std::byte> getData() const {
+        return {data, size};
+    }
+
+    // of the mapped file, e.g. for copying its sections within the kernel
+    [[nodiscard]] int getFileDescriptor() const {
+        return file.get();
+    }
+
+    // whether the background warmup is over (`true` if there was none)
+    [[nodiscard]] bool isWarmedUp() const {
+        return warmedUp.load(std::memory_order_acquire);
+    }
+
+    // Blocks until the background warmup is over.
+    void waitForWarmup();
+
+    // Records the pages of the file which are in the page cache now, typically after serving the traffic for a while,
+    // to be read in right after the next open (`Options::hotPageProfile`). Profile layout (little endian):
+    //   u64 file size, u64 page size, u64 run count, then runs of u64 first page, u64 page count.
+    void saveHotPageProfile(const std::filesystem::path& path) const;
+};
+
+}
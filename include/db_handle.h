@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "db_file.h"
+
+namespace RoflDb {
+
+// Holder of the current version of a database file which can be swapped for a new one while other threads look it
+// up. The lookups pin the current file with a `Guard`, and a swapped out file is unmapped only once no guard pins it
+// any more (epoch based reclamation): pinning stores the current epoch into the slot of the reader thread, which is a
+// plain store with no atomic read-modify-write and no shared cache line, the swapping thread pays for the ordering
+// with `membarrier(2)` instead (or a fence per pin where it is not available).
+//
+//   DbHandle handle(path);
+//   // per thread
+//   auto reader = handle.registerReader();
+//   {
+//       auto guard = reader.pin();
+//       auto value = guard->get(key);  // valid until the guard is gone
+//   }
+//   // any thread
+//   handle.swap(newPath);
+class DbHandle {
+protected:
+    static constexpr uint64_t IDLE = std::numeric_limits<uint64_t>::max();
+
+    // written only by its reader thread, on a cache line of its own
+    struct alignas(64) Slot {
+        // the epoch the thread pinned the file at, `IDLE` when it is not pinning
+        std::atomic<uint64_t> epoch = IDLE;
+        // nested guards of the thread
+        unsigned depth = 0;
+        bool registered = false;
+    };
+
+    struct Retired {
+        std::unique_ptr<const DbFile> file;
+        // the epoch the file was swapped out at: the guards pinned at this epoch or later do not see it
+        uint64_t epoch;
+    };
+
+    DbFile::Options fileOptions;
+    // readers use a compiler barrier instead of a fence while pinning, `collect` issues `membarrier(2)`
+    bool asymmetricFences;
+
+    std::atomic<const DbFile*> current;
+    std::atomic<uint64_t> epoch = 0;
+
+    // guards the slot list, the retired files and the swaps
+    std::mutex mutex;
+    // stable addresses, the slots of the unregistered readers are reused
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<Retired> retired;
+
+    // unmaps the retired files no guard pins any more, the mutex has to be held
+    std::size_t collectLocked();
+
+public:
+    class Reader;
+
+    // Keeps the file pinned: the values read from it stay valid until the guard is destroyed. Guards are not to be
+    // handed over to other threads.
+    class Guard {
+        const DbFile* file;
+        Slot* slot;
+
+        Guard(const DbFile* file, Slot* slot) : file(file), slot(slot) {}
+        friend class Reader;
+
+    public:
+        Guard(const Guard& other) = delete;
+        Guard(Guard&& other) noexcept : file(other.file), slot(std::exchange(other.slot, nullptr)) {}
+
+        ~Guard() {
+            if (slot != nullptr && --slot->depth == 0) {
+                slot->epoch.store(IDLE, std::memory_order_release);
+            }
+        }
+
+        [[nodiscard]] const DbFile& getFile() const {
+            return *file;
+        }
+
+        [[nodiscard]] const DbReader& getReader() const {
+            return file->getReader();
+        }
+
+        const DbReader* operator->() const {
+            return &file->getReader();
+        }
+    };
+
+    // Registration of a reader thread, to be kept by the thread for many lookups (it takes the handle mutex).
+    class Reader {
+        DbHandle* handle;
+        Slot* slot;
+
+        Reader(DbHandle* handle, Slot* slot) : handle(handle), slot(slot) {}
+        friend class DbHandle;
+
+    public:
+        Reader(const Reader& other) = delete;
+        Reader(Reader&& other) noexcept : handle(other.handle), slot(std::exchange(other.slot, nullptr)) {}
+        // the guards have to be gone
+        ~Reader();
+
+        // Pins the current file. Guards of a thread nest: the file pinned first is unmapped only once the outermost
+        // guard is gone.
+        [[nodiscard]] Guard pin() const {
+            if (slot->depth++ == 0) {
+                slot->epoch.store(handle->epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+                // the epoch store has to be visible before the file is read: `collect` either sees it or swapped the
+                // file before this read
+                if (handle->asymmetricFences) {
+                    std::atomic_signal_fence(std::memory_order_seq_cst);
+                } else {
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                }
+            }
+            return {handle->current.load(std::memory_order_acquire), slot};
+        }
+    };
+
+    explicit DbHandle(const std::filesystem::path& path) : DbHandle(path, DbFile::Options()) {}
+    // the options are kept for `swap(path)`
+    DbHandle(const std::filesystem::path& path, DbFile::Options fileOptions);
+    explicit DbHandle(std::unique_ptr<const DbFile> file);
+    DbHandle(const DbHandle& other) = delete;
+    // the readers have to be gone
+    ~DbHandle();
+
+    [[nodiscard]] Reader registerReader();
+
+    // Makes the file current: the guards pinned from now on see it. The previous file is unmapped as soon as no
+    // guard pins it, which is checked now and by the following swaps and `collect` calls.
+    void swap(std::unique_ptr<const DbFile> file);
+    // opens the file with the handle options first, so the lookups go on meanwhile
+    void swap(const std::filesystem::path& path);
+
+    // Unmaps the swapped out files no guard pins any more, returns how many files are still pinned.
+    std::size_t collect();
+};
+
+}
@@ -18,4 +18,19 @@ public:
     explicit magic_error(auto reason) : std::runtime_error(reason) {};
 };
 
+class io_error : public std::runtime_error {
+public:
+    explicit io_error(auto reason) : std::runtime_error(reason) {};
+};
+
+class unsupported_error : public std::runtime_error {
+public:
+    explicit unsupported_error(auto reason) : std::runtime_error(reason) {};
+};
+
+class duplicate_key_error : public std::invalid_argument {
+public:
+    explicit duplicate_key_error(auto reason) : std::invalid_argument(reason) {};
+};
+
 }
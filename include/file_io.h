@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+namespace RoflDb::Utils {
+
+    // Owning file descriptor. Temporary files are unlinked right after creation,
+    // so they are gone as soon as the descriptor is closed (even after a crash).
+    class FileDescriptor {
+        int fd = -1;
+
+    public:
+        FileDescriptor() = default;
+        explicit FileDescriptor(int fd) : fd(fd) {}
+        FileDescriptor(const FileDescriptor& other) = delete;
+        FileDescriptor(FileDescriptor&& other) noexcept : fd(other.release()) {}
+        FileDescriptor& operator=(FileDescriptor&& other) noexcept;
+        ~FileDescriptor();
+
+        static FileDescriptor create(const std::filesystem::path& path);
+        // `directIo`: `O_DIRECT`, the reads bypass the kernel page cache and have to be aligned
+        static FileDescriptor open(const std::filesystem::path& path, bool directIo = false);
+        static FileDescriptor createTemporary(const std::filesystem::path& directory);
+        // a new file named `path` and a unique suffix (`mkstemp`), which is kept: `path` is set to its name
+        static FileDescriptor createUnique(std::filesystem::path& path);
+
+        [[nodiscard]] inline int get() const {
+            return fd;
+        }
+
+        [[nodiscard]] uint64_t size() const;
+        void truncate(uint64_t size) const;
+
+        inline int release() {
+            int result = fd;
+            fd = -1;
+            return result;
+        }
+    };
+
+    // Sequential writer with a large userspace buffer. Integers are written in the file byte order (little endian).
+    class BufferedFileWriter {
+        int fd;
+        std::vector<std::byte> buffer;
+        std::size_t buffered = 0;
+        uint64_t position;
+
+    public:
+        BufferedFileWriter(int fd, std::size_t bufferSize, uint64_t position = 0);
+        BufferedFileWriter(const BufferedFileWriter& other) = delete;
+        BufferedFileWriter(BufferedFileWriter&& other) noexcept = default;
+        BufferedFileWriter& operator=(BufferedFileWriter&& other) noexcept = default;
+
+        void write(const std::byte* data, std::size_t size);
+
+        template<class WriteT, std::enable_if_t<std::is_integral_v<WriteT>, bool> = true>
+        inline void write(WriteT value) {
+            if constexpr (sizeof(WriteT) > 1 && std::endian::native == std::endian::big) {
+                auto* bytesPtr = reinterpret_cast<std::byte*>(&value);
+                std::reverse(bytesPtr, bytesPtr + sizeof(WriteT));
+            }
+            write(reinterpret_cast<const std::byte*>(&value), sizeof(WriteT));
+        }
+
+        // Overwrites already written bytes (e.g. a size field reserved before the payload was known).
+        void writeAt(uint64_t offset, const std::byte* data, std::size_t size);
+
+        template<class WriteT, std::enable_if_t<std::is_integral_v<WriteT>, bool> = true>
+        inline void writeAt(uint64_t offset, WriteT value) {
+            if constexpr (sizeof(WriteT) > 1 && std::endian::native == std::endian::big) {
+                auto* bytesPtr = reinterpret_cast<std::byte*>(&value);
+                std::reverse(bytesPtr, bytesPtr + sizeof(WriteT));
+            }
+            writeAt(offset, reinterpret_cast<const std::byte*>(&value), sizeof(WriteT));
+        }
+
+        void flush();
+
+        // Appends `size` bytes of another file from `offset` on (see `copyFileRange`), returns the bytes copied within
+        // the kernel.
+        uint64_t copyFrom(int fromFd, uint64_t offset, uint64_t size);
+
+        [[nodiscard]] inline uint64_t tell() const {
+            return position;
+        }
+    };
+
+    // Sequential reader over a file region with a large userspace buffer.
+    class BufferedFileReader {
+        int fd;
+        std::vector<std::byte> buffer;
+        std::size_t bufferPosition = 0;
+        std::size_t bufferEnd = 0;
+        uint64_t position;
+        uint64_t end;
+
+        bool fill();
+
+    public:
+        BufferedFileReader(int fd, std::size_t bufferSize, uint64_t begin, uint64_t end);
+
+        // Returns `false` if the region is exhausted before the first byte was read.
+        bool read(std::byte* data, std::size_t size);
+
+        template<class ReadT, std::enable_if_t<std::is_integral_v<ReadT>, bool> = true>
+        inline bool read(ReadT& value) {
+            if (!read(reinterpret_cast<std::byte*>(&value), sizeof(ReadT))) {
+                return false;
+            }
+            if constexpr (sizeof(ReadT) > 1 && std::endian::native == std::endian::big) {
+                auto* bytesPtr = reinterpret_cast<std::byte*>(&value);
+                std::reverse(bytesPtr, bytesPtr + sizeof(ReadT));
+            }
+            return true;
+        }
+    };
+
+    void* mapShared(int fd, std::size_t size);
+    // private anonymous memory, which takes no memory until it is written
+    void* mapAnonymous(std::size_t size);
+    void unmap(void* address, std::size_t size);
+    // Reads until `size` bytes are read or the end of the file, returns the bytes read.
+    std::size_t readAt(int fd, std::byte* data, std::size_t size, uint64_t offset);
+    // Copies `size` bytes between the files within the kernel (`copy_file_range`, which may even share the blocks on
+    // the file systems supporting it), falling back to reading and writing where it is not supported. Returns the bytes
+    // copied within the kernel.
+    uint64_t copyFileRange(int fromFd, uint64_t fromOffset, int toFd, uint64_t toOffset, uint64_t size);
+
+    // Minimal `io_uring` for reads, on the raw system calls: the reads are queued, submitted in batches and reaped
+    // as they complete, so that many of them can be in flight from a single thread.
+    class IoRing {
+        FileDescriptor ring;
+        unsigned entries;
+        unsigned inFlight = 0;
+        // queued and not submitted yet
+        unsigned queued = 0;
+
+        void* submissionRing = nullptr;
+        std::size_t submissionRingSize = 0;
+        void* completionRing = nullptr;
+        std::size_t completionRingSize = 0;
+        void* submissionEntries = nullptr;
+        std::size_t submissionEntriesSize = 0;
+
+        unsigned* submissionTail;
+        unsigned* submissionMask;
+        unsigned* submissionArray;
+        unsigned* completionHead;
+        unsigned* completionTail;
+        unsigned* completionMask;
+        std::byte* completionEntries;
+
+        void unmapRings();
+
+    public:
+        // Throws `io_error` if the kernel does not allow `io_uring`.
+        explicit IoRing(unsigned entries);
+        IoRing(const IoRing& other) = delete;
+        ~IoRing();
+
+        // `false` if `entries` reads are in flight already
+        bool queueRead(int fd, std::byte* data, uint32_t size, uint64_t offset, uint64_t userData);
+        // Submits the queued reads, then waits until at least `minCompleted` reads complete (if that many are in
+        // flight) and calls `callback(userData, result)` for every completed one: the bytes read or `-errno`.
+        void submitAndReap(unsigned minCompleted, const std::function<void(uint64_t userData, int result)>& callback);
+
+        [[nodiscard]] inline unsigned getInFlight() const {
+            return inFlight;
+        }
+    };
+
+    // Fixed-size array backed by a shared mapping of an unlinked temporary file, so that its pages are written back
+    // to disk under memory pressure instead of counting against the process memory.
+    template<class T>
+    class TemporaryArray {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        FileDescriptor file;
+        T* data = nullptr;
+        std::size_t length = 0;
+
+    public:
+        TemporaryArray(const std::filesystem::path& directory, std::size_t length) : file(FileDescriptor::createTemporary(directory)), length(length) {
+            if (length > 0) {
+                file.truncate(length * sizeof(T));
+                data = static_cast<T*>(mapShared(file.get(), length * sizeof(T)));
+            }
+        }
+        TemporaryArray(const TemporaryArray& other) = delete;
+        ~TemporaryArray() {
+            if (data) {
+                unmap(data, length * sizeof(T));
+            }
+        }
+
+        [[nodiscard]] inline T& operator[](std::size_t idx) {
+            return data[idx];
+        }
+
+        [[nodiscard]] inline const T& operator[](std::size_t idx) const {
+            return data[idx];
+        }
+
+        [[nodiscard]] inline std::size_t size() const {
+            return length;
+        }
+    };
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "mmaped.h"
+
+namespace RoflDb::Utils {
+
+    // MurmurHash3 finalizer: every input bit affects every output bit.
+    [[nodiscard]] inline uint64_t mixBits(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xFF51AFD7ED558CCD;
+        value ^= value >> 33;
+        value *= 0xC4CEB9FE1A85EC53;
+        value ^= value >> 33;
+        return value;
+    }
+
+    // 64-bit hash of a byte string. Not cryptographic; stable across platforms, as it is a part of the file format.
+    [[nodiscard]] inline uint64_t hashBytes(const std::byte* data, std::size_t size, uint64_t seed = 0) {
+        constexpr uint64_t PRIME_1 = 0x9E3779B97F4A7C15;
+        constexpr uint64_t PRIME_2 = 0x87C37B91114253D5;
+
+        uint64_t hash = seed ^ (size * PRIME_1);
+        auto mix = [&hash](uint64_t word) {
+            hash ^= std::rotl(word * PRIME_2, 31) * PRIME_1;
+            hash = std::rotl(hash, 27) * PRIME_1 + PRIME_2;
+        };
+        for (; size >= sizeof(uint64_t); data += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+            mix(Utils::read<uint64_t>(data));
+        }
+        if (size > 0) {
+            std::byte tail[sizeof(uint64_t)] = {};
+            std::memcpy(tail, data, size);
+            mix(Utils::read<uint64_t>(tail));
+        }
+        return mixBits(hash);
+    }
+
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// Lookup instrumentation (see `DbReader::getLookupStats`), off unless the library is built with
+// `ROFLDB_WITH_INSTRUMENTATION`: the tracing points compile to nothing then.
+#ifndef ROFLDB_INSTRUMENTATION
+#define ROFLDB_INSTRUMENTATION false
+#endif
+
+#if ROFLDB_INSTRUMENTATION
+#define ROFLDB_TRACE(call) do { if (auto* roflDbTrace = ::RoflDb::priv::LookupTrace::current) { roflDbTrace->call; } } while (false)
+#else
+#define ROFLDB_TRACE(call) do {} while (false)
+#endif
+
+namespace RoflDb {
+
+// Totals over the lookups (`get` and `getMany`) of a `DbReader` and its copies.
+struct LookupStats {
+    // lookups deeper than that are counted in the last bucket of the histogram
+    static constexpr unsigned MAX_DEPTH = 64;
+
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // tree nodes read, including the ones checked at the positions from the perfect hash index
+    uint64_t nodeVisits = 0;
+    // bytes of the keys compared with the looked up ones (a wide tree node counts 8 bytes for each key prefix ranked)
+    uint64_t keyBytesCompared = 0;
+    // distinct pages (of `LookupTrace::PAGE_SIZE`) overlapped by the filter blocks, index entries, nodes and values
+    // read by each lookup, summed
+    uint64_t pagesTouched = 0;
+    // lookups by the number of tree levels descended (`0` for the ones rejected by the filter or served by the index)
+    std::array<uint64_t, MAX_DEPTH + 1> depthHistogram {};
+};
+
+namespace priv {
+
+    // What a single lookup did, recorded by the `ROFLDB_TRACE` points into the trace of the lookup running on the
+    // thread (`current`, set by `LookupScope`).
+    struct LookupTrace {
+        static constexpr std::size_t PAGE_SIZE = 4096;
+        // pages beyond that are not told apart
+        static constexpr std::size_t MAX_PAGES = 32;
+
+        inline static thread_local LookupTrace* current = nullptr;
+
+        // Makes the trace the current one during its lifetime, e.g. while advancing one of the interleaved lookups.
+        class Activation {
+            LookupTrace* previous;
+
+        public:
+            explicit Activation(LookupTrace* trace) : previous(current) {
+                current = trace;
+            }
+            Activation(const Activation& other) = delete;
+            ~Activation() {
+                current = previous;
+            }
+        };
+
+        unsigned depth = 0;
+        unsigned nodeVisits = 0;
+        uint64_t keyBytesCompared = 0;
+        unsigned pageCount = 0;
+        std::array<uintptr_t, MAX_PAGES> pages;
+        bool hit = false;
+
+        inline void touch(const void* address, std::size_t size) {
+            auto firstPage = reinterpret_cast<uintptr_t>(address) / PAGE_SIZE;
+            auto lastPage = (reinterpret_cast<uintptr_t>(address) + std::max<std::size_t>(size, 1) - 1) / PAGE_SIZE;
+            for (auto page = firstPage; page <= lastPage; page++) {
+                auto seenEnd = pages.begin() + std::min<std::size_t>(pageCount, MAX_PAGES);
+                if (std::find(pages.begin(), seenEnd, page) != seenEnd) {
+                    continue;
+                }
+                if (pageCount < MAX_PAGES) {
+                    pages[pageCount] = page;
+                }
+                pageCount++;
+            }
+        }
+
+        inline void visitNode(const void* node, std::size_t size, bool descend) {
+            nodeVisits++;
+            depth += descend;
+            touch(node, size);
+        }
+
+        // the bytes up to the first difference
+        template<class KeyT>
+        inline void compareKeys(const KeyT& key, const KeyT& other) {
+            auto size = std::min(key.size(), other.size());
+            auto mismatch = std::mismatch(key.get(), key.get() + size, other.get()).first - key.get();
+            keyBytesCompared += std::min<std::size_t>(mismatch + 1, size);
+        }
+
+        inline void compareBytes(std::size_t bytes) {
+            keyBytesCompared += bytes;
+        }
+
+        inline void setHit() {
+            hit = true;
+        }
+    };
+
+    // Lookup counters of a `DbReader`: every thread counts into its own shard, so that the lookups running on
+    // different threads do not share cache lines; the shards are only summed up by `getStats`.
+    class LookupCounters {
+        struct Shard {
+            // written by the owning thread only, hence no read-modify-write
+            std::atomic<uint64_t> lookups = 0;
+            std::atomic<uint64_t> hits = 0;
+            std::atomic<uint64_t> nodeVisits = 0;
+            std::atomic<uint64_t> keyBytesCompared = 0;
+            std::atomic<uint64_t> pagesTouched = 0;
+            std::array<std::atomic<uint64_t>, LookupStats::MAX_DEPTH + 1> depthHistogram {};
+        };
+
+        // unique across the process, to find the shard of the thread without keeping pointers to the counters
+        const uint64_t id;
+        mutable std::mutex mutex;
+        std::vector<std::unique_ptr<Shard>> shards;
+
+        [[nodiscard]] Shard& getShard();
+
+    public:
+        LookupCounters();
+        LookupCounters(const LookupCounters& other) = delete;
+
+        void record(const LookupTrace& trace);
+        [[nodiscard]] LookupStats getStats() const;
+    };
+
+    // Traces the lookup running on the thread during its lifetime and records it into the counters (if any).
+    class LookupScope {
+        LookupCounters* counters;
+        LookupTrace trace;
+        std::optional<LookupTrace::Activation> activation;
+
+    public:
+        explicit LookupScope(LookupCounters* counters) : counters(counters) {
+            activation.emplace(&trace);
+        }
+        LookupScope(const LookupScope& other) = delete;
+        ~LookupScope() {
+            activation.reset();
+            if (counters) {
+                counters->record(trace);
+            }
+        }
+    };
+
+}
+
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "db_file.h"
+#include "writer.h"
+
+namespace RoflDb {
+
+// Small file listing the layers of a `LayeredDbReader`. Layout (little endian):
+//   "RFLL", u16 version (`0`), u64 next file number, the base file name (u16 size, bytes), u32 delta count, the delta
+//   file names from the oldest one (u16 size, bytes). The names are relative to the manifest directory.
+struct LayeredManifest {
+    static constexpr std::byte MAGIC[4] = {
+        static_cast<const std::byte>('R'),
+        static_cast<const std::byte>('F'),
+        static_cast<const std::byte>('L'),
+        static_cast<const std::byte>('L'),
+    };
+
+    std::filesystem::path basePath;
+    std::vector<std::filesystem::path> deltaPaths;
+    // numbers the files written by `LayeredDbReader`, so that their names are never reused
+    uint64_t nextFileNumber = 0;
+
+    [[nodiscard]] static LayeredManifest load(const std::filesystem::path& path);
+    // Writes a temporary file next to `path` and renames it over `path`, so that a crash leaves either manifest.
+    void save(const std::filesystem::path& path) const;
+    // Throws `std::invalid_argument` unless the paths are valid.
+    void validate() const;
+};
+
+// Updatable database on top of an immutable `.rofldb` base: the puts and removals go to an in-memory memtable, which
+// `flush` writes out as a small delta file, and `compact` merges the base and the deltas into a new base. A lookup
+// checks the layers from the newest one (the memtable) down to the base and stops at the first one having the key or
+// its tombstone; the base lookups are the plain `DbReader` ones, so the values there still point into the mapping.
+//
+// A layered database is created by saving a `LayeredManifest` naming an existing base file. The files written by
+// `flush` and `compact` go next to the manifest, as `<manifest stem>.delta-<number>.rofldb` and
+// `<manifest stem>.base-<number>.rofldb`, and are removed once they are merged into a newer base (a base given by the
+// user is kept). The memtable is not persisted until it is flushed.
+//
+// Delta files are regular `.rofldb` files whose values start with an `EntryKind` byte. All the methods are thread
+// safe; the returned values stay valid even when their layer is compacted away.
+class LayeredDbReader {
+public:
+    enum class EntryKind : uint8_t {
+        PUT = 0,
+        TOMBSTONE = 1,
+    };
+
+    struct Options {
+        // for opening the base and the delta files
+        DbFile::Options fileOptions;
+        // for the new base written by `compact` (e.g. the format of the base)
+        DbWriter::Options baseOptions;
+        // For the deltas: a lookup of a key which is not in the newer layers passes all the deltas, their filters
+        // let it skip most of them.
+        DbWriter::Options deltaOptions = []() {
+            DbWriter::Options options;
+            options.filterBitsPerKey = 10;
+            options.memoryLimit = 16 * 1024 * 1024;
+            return options;
+        }();
+        // a put or removal flushes the memtable once it holds about this many bytes (`0`: flushed only by `flush`)
+        std::size_t memtableLimit = 64 * 1024 * 1024;
+        // a flush starts a compaction in the background once there are this many deltas (`0`: only by `compact`)
+        std::size_t compactionDeltaCount = 8;
+    };
+
+protected:
+    // estimated bytes taken by a memtable entry besides its key and value
+    static constexpr std::size_t MEMTABLE_ENTRY_OVERHEAD = 96;
+
+    // `nullptr` values are tombstones
+    using Memtable = std::map<std::string, std::shared_ptr<const std::string>, std::less<>>;
+
+    // the file layers at some point, immutable once published so that the lookups can go on without the lock
+    struct Layers {
+        std::shared_ptr<const DbFile> base;
+        // from the oldest one
+        std::vector<std::shared_ptr<const DbFile>> deltas;
+        // the memtable being written as the next delta, if any
+        std::shared_ptr<const Memtable> flushing;
+    };
+
+    Options options;
+    std::filesystem::path manifestPath;
+
+    // guards `memtable`, `memtableBytes` and the `layers` pointer
+    mutable std::shared_mutex mutex;
+    Memtable memtable;
+    std::size_t memtableBytes = 0;
+    std::shared_ptr<const Layers> layers;
+
+    // serializes the flushes and the manifest updates, guards `manifest`
+    mutable std::mutex manifestMutex;
+    LayeredManifest manifest;
+
+    // serializes the compactions
+    std::mutex compactionMutex;
+    // guards the background compaction state below
+    std::mutex backgroundMutex;
+    bool compactionRunning = false;
+    std::exception_ptr compactionError;
+    // the last background compaction (the last member, so that it is joined before the rest is destroyed)
+    std::jthread compactionThread;
+
+    [[nodiscard]] std::filesystem::path resolve(const std::filesystem::path& path) const;
+    [[nodiscard]] std::filesystem::path makeFileName(const char* kind, uint64_t number) const;
+    // the entry of the key in a memtable: empty if there is none, else an empty value for a tombstone
+    [[nodiscard]] static std::optional<std::optional<Value>> findIn(const Memtable& memtable, const Key& key);
+    void update(const Key& key, std::shared_ptr<const std::string> value);
+    void startCompaction();
+
+public:
+    explicit LayeredDbReader(const std::filesystem::path& manifestPath) : LayeredDbReader(manifestPath, Options()) {}
+    LayeredDbReader(const std::filesystem::path& manifestPath, Options options);
+    LayeredDbReader(const LayeredDbReader& other) = delete;
+    // waits for the background compaction, the memtable is dropped
+    ~LayeredDbReader() = default;
+
+    [[nodiscard]] std::optional<Value> get(const Key& key) const;
+    [[nodiscard]] std::optional<Value> get(const std::string& key) const;
+    // see `DbReader::get(uint64_t)`
+    [[nodiscard]] std::optional<Value> get(uint64_t key) const;
+
+    void put(const Key& key, const Value& value);
+    void put(std::string_view key, std::string_view value);
+    // leaves a tombstone hiding the key in the older layers
+    void remove(const Key& key);
+    void remove(std::string_view key);
+
+    // Writes the memtable out as a new delta and adds it to the manifest. The memtable entries stay visible to the
+    // lookups meanwhile.
+    void flush();
+    // Merges the base and the current deltas into a new base (the newest entry of a key wins, the tombstones are
+    // dropped), then swaps it in. The deltas flushed meanwhile are kept.
+    void compact();
+    // Waits for the background compaction and rethrows its error, if any.
+    void waitForCompaction();
+
+    [[nodiscard]] std::size_t getDeltaCount() const;
+    [[nodiscard]] std::size_t getMemtableBytes() const;
+    [[nodiscard]] std::filesystem::path getBasePath() const;
+};
+
+}
@@ -1,13 +1,24 @@
 #pragma once
 
+#include <bit>
+#include <compare>
+#include <iterator>
+#include <memory>
 #include <cstdint>
+#include <cstring>
+#include <functional>
 #include <optional>
+#include <span>
 #include <tuple>
 #include <variant>
 #include <string>
+#include <vector>
 
 #include "char_vector.h"
+#include "hash.h"
+#include "instrumentation.h"
 #include "mmaped.h"
+#include "prefix_search.h"
 
 
 namespace RoflDb {
@@ -19,25 +30,107 @@ public:
     Key(const std::byte* memAddress, std::size_t length) : ZeroCopyCharVector(memAddress, length) {};
     [[nodiscard]] inline std::strong_ordering operator<=>(const Key& other) const;
     [[nodiscard]] inline bool operator==(const Key& other) const;
+    [[nodiscard]] inline bool startsWith(const Key& prefix) const;
 };
 
 
 struct Value : public Utils::ZeroCopyCharVector {
+protected:
+    // keeps the memory of a value decompressed from a block alive, empty for the values pointing into the mapping
+    std::shared_ptr<const void> owner;
+
 public:
     using SizeType = uint32_t;
 
     Value(const std::byte* memAddress, std::size_t length) : ZeroCopyCharVector(memAddress, length) {};
+    Value(const std::byte* memAddress, std::size_t length, std::shared_ptr<const void> owner)
+        : ZeroCopyCharVector(memAddress, length), owner(std::move(owner)) {};
+
+    // the value without its first `offset` bytes, kept alive by the same owner
+    [[nodiscard]] Value dropPrefix(std::size_t offset) const {
+        return {memAddress + offset, length - offset, owner};
+    }
+
+    // the value also keeping `keepAlive` alive, unless it has an owner already
+    [[nodiscard]] Value withOwner(std::shared_ptr<const void> keepAlive) const {
+        return {memAddress, length, owner ? owner : std::move(keepAlive)};
+    }
 };
 
 
+enum class FormatVersion : uint16_t {
+    // binary tree with nodes stored in key order, children are referenced by offsets
+    SORTED_BINARY_TREE = 0,
+    // binary tree with nodes stored in breadth-first (Eytzinger) order, children positions are computed
+    EYTZINGER_TREE = 1,
+    // B+-tree with up to 255 keys per node, searched by comparing fixed-width key prefixes
+    WIDE_TREE = 2,
+    // `WIDE_TREE` with the keys stored in nodes without the prefix shared by the node subtree, which is stored once
+    PREFIX_COMPRESSED_WIDE_TREE = 3,
+    // fixed 8-byte keys (big endian integers, see `DbWriter::put(uint64_t, ...)`) in a sorted array, with a piecewise
+    // linear model of the key positions instead of a tree
+    INTEGER_KEYS = 4,
+};
+
+// Optional sections following the tree, each is a `u16` tag and then the section itself (starting with its `u64`
+// size). Readers skip the sections they do not know, so adding one keeps the file readable by older versions.
+enum class SectionTag : uint16_t {
+    BLOOM_FILTER = 1,
+    PERFECT_HASH_INDEX = 2,
+    VALUE_BLOCKS = 3,
+};
+
+// see `DbReader::getAccessProfile`
+class AccessProfile;
+
 namespace priv {
+    // Storage for the keys which are not stored contiguously in the file and have to be assembled to be returned.
+    using KeyBuffer = std::vector<std::byte>;
+    // returns `false` to stop the walk
+    using NodeCallback = std::function<bool(std::span<const std::byte> node)>;
+    // whether a packed tree position (see `Tree::packPosition`) is the position of a key
+    using PositionCheck = std::function<bool(uint64_t packedPosition)>;
+
+    // Checks shared by the sections while verifying a file, see `DbReader::verify`.
+    class Verifier;
+
+    // see `DbReader::Options::accessSampleInterval`
+    class AccessLog;
+
+    // The bytes a lookup step is about to read, for the readers which have to load them first (see `PagedDbFile`):
+    // `size` bytes from `address`, and as many more as the little endian number in the first `sizeFieldBytes` bytes
+    // says (`0`: none), which is only known once the first bytes are in.
+    struct PendingRead {
+        const std::byte* address;
+        std::size_t size;
+        uint8_t sizeFieldBytes = 0;
+    };
+
     class ValueCollection : public Utils::Mmaped<ValueCollection, uint64_t> {
     public:
         using ValueOffsetType = SizeType;
 
+        // Set in the value offsets of the values stored within the tree (see `DbReader::INLINE_VALUES_FLAG`): the
+        // other bits are the offset of the value (stored as here) from the start of the tree payload.
+        static constexpr ValueOffsetType INLINE_VALUE_BIT = ValueOffsetType(1) << 63;
+
+        [[nodiscard]] static inline bool isInline(ValueOffsetType offset) {
+            return offset & INLINE_VALUE_BIT;
+        }
+
+        template<bool Checked = Utils::CHECK_BOUNDS>
         [[nodiscard]] inline Value getByOffset(ValueOffsetType offset) const;
+        // `getByOffset` with the bounds checks, for the readers outside of the library translation unit
+        [[nodiscard]] Value getByOffsetChecked(ValueOffsetType offset) const;
+        inline void prefetch(ValueOffsetType offset) const;
+        // the size and the bytes of the value
+        [[nodiscard]] PendingRead getPendingRead(ValueOffsetType offset) const;
+        // reader of the payload from `offset` on
+        [[nodiscard]] Utils::PayloadReader getReaderAt(uint64_t offset) const;
     };
 
+    // Node payload is the key, the value offset, the value itself if it is inline (see `ValueCollection::isInline`)
+    // and the offsets of the children present.
     class Tree : public Utils::Mmaped<Tree, uint32_t> {
     public:
 
@@ -60,30 +153,800 @@ namespace priv {
             };
 
             using Match = std::variant<ValueMatch, DropDownMatch>;
+            template<bool Checked = Utils::CHECK_BOUNDS>
             [[nodiscard]] inline std::optional<Match> match(const Key& key) const;
+
+            template<bool Checked = Utils::CHECK_BOUNDS>
+            [[nodiscard]] inline Key getKey() const;
+            template<bool Checked = Utils::CHECK_BOUNDS>
+            [[nodiscard]] inline ValueCollection::ValueOffsetType getValueOffset() const;
+            // `0` if there is no such child
+            [[nodiscard]] inline Node::OffsetType getChildOffset(bool greater) const;
+        };
+
+        // Nodes are stored in key order, so the position is the node offset and the next node directly follows it.
+        using Position = Node::OffsetType;
+        // the ancestors of a position from the root down, kept by a cursor stepping backwards
+        using Path = std::vector<Node::OffsetType>;
+
+        // as stored in `PerfectHashIndex`
+        [[nodiscard]] static inline uint64_t packPosition(Position position) {
+            return position;
+        }
+        [[nodiscard]] static inline Position unpackPosition(uint64_t packed) {
+            return static_cast<Position>(packed);
+        }
+
+        // Lookup state for interleaving many lookups on a single thread: every `advance` visits a single node
+        // and prefetches whatever the next `advance` will need, so the other lookups can proceed meanwhile.
+        struct Search {
+            // `0` when the lookup is done
+            Node::OffsetType nodeOffset;
+            std::optional<ValueCollection::ValueOffsetType> valueOffset;
+
+            [[nodiscard]] inline bool isDone() const {
+                return nodeOffset == 0;
+            }
         };
 
+        // The lookup path is also instantiated without the bounds checks, for the verified files.
+        template<bool Checked = Utils::CHECK_BOUNDS>
         [[nodiscard]] std::optional<ValueCollection::ValueOffsetType> get(const Key& key) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] Search startSearch() const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        void advance(Search& search, const Key& key) const;
+        // what the next `advance` reads (besides the tree header)
+        [[nodiscard]] PendingRead getPendingRead(const Search& search) const;
+
+        // Ordered access. Positions compare as `false` when out of range (before the first or after the last key).
+        [[nodiscard]] Position first() const;
+        [[nodiscard]] Position last() const;
+        [[nodiscard]] Position seekGE(const Key& key) const;
+        [[nodiscard]] Position seekLT(const Key& key) const;
+        [[nodiscard]] Position next(Position position) const;
+        // not stored sequentially backwards, so it is a `seekLT` of the current key
+        [[nodiscard]] Position prev(Position position) const;
+        // Steps back along `path`, the ancestors of `position` (found by a single descent when empty), which is
+        // kept for the next step: the steps walk only up and down the nodes between neighbours.
+        [[nodiscard]] Position prev(Position position, Path& path) const;
+        [[nodiscard]] Key getKey(Position position, KeyBuffer& buffer) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] bool hasKeyAt(Position position, const Key& key) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] ValueCollection::ValueOffsetType getValueOffset(Position position) const;
+        // Calls `callback` with the bytes of every node at `depth` (`0` is the root). Returns `false` if there are
+        // no nodes that deep or the callback stopped the walk.
+        bool forEachNodeAtDepth(unsigned depth, const NodeCallback& callback) const;
+        // Checks everything the lookups read (throws `data_corrupted_error`), see `DbReader::verify`.
+        [[nodiscard]] PositionCheck verify(const Verifier& verifier) const;
+
+    protected:
+        // the walks from `rootOffset`, which the nodes from `nodesOffset` on are the tree of
+        [[nodiscard]] Position lastFrom(Node::OffsetType rootOffset) const;
+        [[nodiscard]] Position seekGEFrom(Node::OffsetType rootOffset, const Key& key) const;
+        [[nodiscard]] Position seekLTFrom(Node::OffsetType rootOffset, const Key& key) const;
+        [[nodiscard]] Position prevFrom(Node::OffsetType rootOffset, Position position, Path& path) const;
+        [[nodiscard]] PositionCheck verifyFrom(const Verifier& verifier, uint64_t nodesOffset, Node::OffsetType rootOffset) const;
+        // checks the node fields and its value offset, `isChild(offset)` tells the valid children
+        template<class IsChild>
+        const Node* verifyNode(const Verifier& verifier, Node::OffsetType nodeOffset, IsChild&& isChild) const;
+    };
+
+    // `Tree` whose lookups start in copies of its hottest nodes, packed together in front of the nodes in key order
+    // (`DbReader::HOT_NODES_FLAG`, see `DbWriter::Options::hotNodesSize`). Payload is the offset of the root the
+    // lookups start at (the hot copy of the root), the offset of the root among the nodes in key order, the offset of
+    // the first node in key order, the hot copies (every one before its children) and the nodes in key order. A hot
+    // copy is the node with its own inline value, its children are hot copies or nodes in key order.
+    // The lookups are the `Tree` ones, the ordered access and the positions only use the nodes in key order.
+    class HotTree : public Tree {
+    public:
+        // the offsets in front of the hot copies
+        static constexpr uint64_t HEADER_SIZE = 3 * sizeof(Node::OffsetType);
+
+        [[nodiscard]] Position first() const;
+        [[nodiscard]] Position last() const;
+        [[nodiscard]] Position seekGE(const Key& key) const;
+        [[nodiscard]] Position seekLT(const Key& key) const;
+        [[nodiscard]] Position prev(Position position) const;
+        [[nodiscard]] Position prev(Position position, Path& path) const;
+        [[nodiscard]] PositionCheck verify(const Verifier& verifier) const;
+
+    protected:
+        [[nodiscard]] Node::OffsetType getOrderedRoot() const;
+    };
+
+    // Payload is the node count, then the offsets of the nodes in breadth-first order, then the nodes themselves
+    // (key and value offset, followed by the value if it is inline) in the same order. The children of the node `k` (1-based) are `2k` and `2k + 1`, so the
+    // top levels of the tree (both offsets and nodes) are packed together into the first cache lines and pages.
+    class EytzingerTree : public Utils::Mmaped<EytzingerTree, uint32_t> {
+    public:
+        using CountType = uint32_t;
+        using NodeOffsetType = SizeType;
+
+        // 1-based breadth-first index of a node, the neighbours in key order are computed from it.
+        using Position = uint64_t;
+
+        // as stored in `PerfectHashIndex`
+        [[nodiscard]] static inline uint64_t packPosition(Position position) {
+            return position;
+        }
+        [[nodiscard]] static inline Position unpackPosition(uint64_t packed) {
+            return packed;
+        }
+
+        // Lookup state for interleaving many lookups on a single thread: every `advance` visits a single node
+        // and prefetches whatever the next `advance` will need, so the other lookups can proceed meanwhile.
+        struct Search {
+            // 1-based breadth-first index of the current node, `0` when the lookup is done
+            uint64_t k;
+            // `0` until loaded from the offsets table
+            NodeOffsetType nodeOffset;
+            std::optional<ValueCollection::ValueOffsetType> valueOffset;
+
+            [[nodiscard]] inline bool isDone() const {
+                return k == 0;
+            }
+        };
+
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] std::optional<ValueCollection::ValueOffsetType> get(const Key& key) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] Search startSearch() const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        void advance(Search& search, const Key& key) const;
+        // what the next `advance` reads (besides the tree header)
+        [[nodiscard]] PendingRead getPendingRead(const Search& search) const;
+
+        // Ordered access. Positions compare as `false` when out of range (before the first or after the last key).
+        [[nodiscard]] Position first() const;
+        [[nodiscard]] Position last() const;
+        [[nodiscard]] Position seekGE(const Key& key) const;
+        [[nodiscard]] Position seekLT(const Key& key) const;
+        [[nodiscard]] Position next(Position position) const;
+        [[nodiscard]] Position prev(Position position) const;
+        [[nodiscard]] Key getKey(Position position, KeyBuffer& buffer) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] bool hasKeyAt(Position position, const Key& key) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] ValueCollection::ValueOffsetType getValueOffset(Position position) const;
+        // Calls `callback` with the bytes of every node at `depth` (`0` is the root). Returns `false` if there are
+        // no nodes that deep or the callback stopped the walk.
+        bool forEachNodeAtDepth(unsigned depth, const NodeCallback& callback) const;
+        // Checks everything the lookups read (throws `data_corrupted_error`), see `DbReader::verify`.
+        [[nodiscard]] PositionCheck verify(const Verifier& verifier) const;
+
+    protected:
+        [[nodiscard]] inline uint64_t getCount() const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] inline Utils::BasicPayloadReader<Checked> getNodeReader(Position position) const;
+    };
+
+    // Payload is the root node offset (`0` for an empty tree), then the nodes. Every node holds up to 255 keys in
+    // order; for a leaf they come with value offsets, for an internal node every key is the smallest key of the
+    // corresponding child subtree. Node layout:
+    //   u8 kind, u8 count, u16 skip,
+    //   u64 prefixes[count] (see `Utils::getKeyPrefix`, starting after the `skip` bytes shared by the whole subtree),
+    //   u64 valueOffsets[count] (leaf) or childOffsets[count] (internal, of `OffsetT`),
+    //   u32 keyOffsets[count] (from the node payload start), then the keys, then the inline values of a leaf (see
+    //   `ValueCollection::isInline`) in key order.
+    // In `PREFIX_COMPRESSED_WIDE_TREE` the kind has `Node::COMPRESSED_KEYS` set, the `skip` bytes shared by the subtree
+    // are stored once right after the key offsets and the keys are stored without them.
+    // A child is picked by ranking the searched prefix among the node prefixes at once, key suffixes (past `skip`) are
+    // only compared for the ties. A looked up key is only checked to share the skipped prefix at the leaf: if it does
+    // not share the prefix of some node on the way, it is not in the tree and the leaf check fails anyway.
+    // The section size and the node offsets are `OffsetT`: 32-bit (`WideTree`) unless the file has
+    // `DbReader::LARGE_TREE_FLAG` (`WideTree64`).
+    template<class OffsetT>
+    class BasicWideTree : public Utils::Mmaped<BasicWideTree<OffsetT>, OffsetT> {
+    public:
+        using SizeType = OffsetT;
+
+        class Node : public Utils::Mmaped<Node, uint32_t> {
+        public:
+            using SizeType = uint32_t;
+            using OffsetType = OffsetT;
+            using CountType = uint8_t;
+
+            enum class Kind : uint8_t {
+                LEAF = 0,
+                INTERNAL = 1,
+            };
+            // flag of the kind byte
+            static constexpr uint8_t COMPRESSED_KEYS = 0x80;
+
+            struct ValueMatch {
+                const ValueCollection::ValueOffsetType valueOffset;
+            protected:
+                inline explicit ValueMatch(ValueCollection::ValueOffsetType valueOffset) : valueOffset(valueOffset) {}
+                friend class Node;
+            };
+
+            struct DropDownMatch {
+                const Node::OffsetType nodeOffset;
+            protected:
+                inline explicit DropDownMatch(Node::OffsetType nodeOffset) : nodeOffset(nodeOffset) {}
+                friend class Node;
+            };
+
+            using Match = std::variant<ValueMatch, DropDownMatch>;
+            template<bool Checked = Utils::CHECK_BOUNDS>
+            [[nodiscard]] inline std::optional<Match> match(const Key& key) const;
+            inline void prefetch() const;
+
+            [[nodiscard]] inline Kind getKind() const;
+            [[nodiscard]] inline bool hasCompressedKeys() const;
+            [[nodiscard]] inline unsigned getCount() const;
+            // the `skip` bytes shared by all the keys of the subtree
+            template<bool Checked = Utils::CHECK_BOUNDS>
+            [[nodiscard]] inline Key getSharedPrefix() const;
+            // the key without the shared prefix
+            template<bool Checked = Utils::CHECK_BOUNDS>
+            [[nodiscard]] inline Key getKeySuffix(unsigned idx) const;
+            // points into the node, or into `buffer` for compressed keys
+            [[nodiscard]] inline Key getKey(unsigned idx, KeyBuffer& buffer) const;
+            // leaf only
+            template<bool Checked = Utils::CHECK_BOUNDS>
+            [[nodiscard]] inline ValueCollection::ValueOffsetType getValueOffset(unsigned idx) const;
+            // internal only
+            [[nodiscard]] inline Node::OffsetType getChildOffset(unsigned idx) const;
+            // number of keys in the node less than (or equal to) `key`
+            [[nodiscard]] inline unsigned countLess(const Key& key, bool orEqual) const;
+        };
+
+        // Leaves are stored in key order, followed by the internal nodes, so the next leaf directly follows a leaf.
+        struct Position {
+            // `0` when out of range
+            Node::OffsetType leafOffset;
+            unsigned idx;
+
+            [[nodiscard]] inline explicit operator bool() const {
+                return leafOffset != 0;
+            }
+        };
+
+        // as stored in `PerfectHashIndex`, the index within a node fits into a byte
+        [[nodiscard]] static inline uint64_t packPosition(Position position) {
+            return (uint64_t(position.leafOffset) << 8) | position.idx;
+        }
+        [[nodiscard]] static inline Position unpackPosition(uint64_t packed) {
+            return {static_cast<Node::OffsetType>(packed >> 8), static_cast<unsigned>(packed & 0xFF)};
+        }
+
+        // Lookup state for interleaving many lookups on a single thread: every `advance` visits a single node
+        // and prefetches whatever the next `advance` will need, so the other lookups can proceed meanwhile.
+        struct Search {
+            // `0` when the lookup is done
+            Node::OffsetType nodeOffset;
+            std::optional<ValueCollection::ValueOffsetType> valueOffset;
+
+            [[nodiscard]] inline bool isDone() const {
+                return nodeOffset == 0;
+            }
+        };
+
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] std::optional<ValueCollection::ValueOffsetType> get(const Key& key) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] Search startSearch() const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        void advance(Search& search, const Key& key) const;
+        // what the next `advance` reads (besides the tree header)
+        [[nodiscard]] PendingRead getPendingRead(const Search& search) const;
+
+        // Ordered access. Positions compare as `false` when out of range (before the first or after the last key).
+        [[nodiscard]] Position first() const;
+        [[nodiscard]] Position last() const;
+        [[nodiscard]] Position seekGE(const Key& key) const;
+        [[nodiscard]] Position seekLT(const Key& key) const;
+        [[nodiscard]] Position next(Position position) const;
+        // a `seekLT` of the current key when crossing to the previous leaf
+        [[nodiscard]] Position prev(Position position) const;
+        // points into the tree, or into `buffer` for compressed keys
+        [[nodiscard]] Key getKey(Position position, KeyBuffer& buffer) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] bool hasKeyAt(Position position, const Key& key) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] ValueCollection::ValueOffsetType getValueOffset(Position position) const;
+        // Calls `callback` with the bytes of every node at `depth` (`0` is the root). Returns `false` if there are
+        // no nodes that deep or the callback stopped the walk.
+        bool forEachNodeAtDepth(unsigned depth, const NodeCallback& callback) const;
+        // Checks everything the lookups read (throws `data_corrupted_error`), see `DbReader::verify`.
+        [[nodiscard]] PositionCheck verify(const Verifier& verifier) const;
+
+    protected:
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] inline const Node* getNode(Node::OffsetType offset) const;
+    };
+
+    using WideTree = BasicWideTree<uint32_t>;
+    using WideTree64 = BasicWideTree<uint64_t>;
+
+    // Not a tree, but stored in the tree section of `FormatVersion::INTEGER_KEYS`: the keys are 8 bytes, read as big
+    // endian numbers (so their order is the byte-wise one), and stored as a sorted array. A piecewise linear model
+    // (as in PGM / RadixSpline) predicts the position of a key within `searchRadius` of the actual one: a radix table
+    // on the high bits of the key narrows down the segments to a few, the segment containing the key gives the
+    // prediction, and the prediction window is ranked at once with `Utils::rankPrefix`. The model takes a few bytes
+    // per segment, so a lookup costs the miss in the keys window and the one in the value offsets. Payload:
+    //   u64 count, u64 min key, u64 segment count, u32 search radius, u8 radix bits, u8 radix shift, u8 padding size,
+    //   u32 radix[(1 << radix bits) + 1] (the number of segments starting in the buckets before, see `findSegment`),
+    //   u64 segmentKeys[segment count] (the first key of the segment),
+    //   segments[segment count] (u64 first position, f64 slope),
+    //   padding (aligning the keys to `KEYS_ALIGNMENT` within the file),
+    //   u64 keys[count], u64 valueOffsets[count]
+    // (all little endian).
+    class LearnedTree : public Utils::Mmaped<LearnedTree, uint64_t> {
+    public:
+        // the header fields and the array addresses
+        struct Layout {
+            uint64_t count;
+            uint64_t minKey;
+            uint64_t segmentCount;
+            unsigned searchRadius;
+            unsigned radixBits;
+            unsigned radixShift;
+            const std::byte* radix;
+            const std::byte* segmentKeys;
+            const std::byte* segments;
+            const std::byte* keys;
+            const std::byte* valueOffsets;
+        };
+
+        static constexpr std::size_t KEY_SIZE = sizeof(uint64_t);
+        static constexpr std::size_t HEADER_SIZE = 3 * sizeof(uint64_t) + sizeof(uint32_t) + 3 * sizeof(uint8_t);
+        static constexpr std::size_t SEGMENT_SIZE = sizeof(uint64_t) + sizeof(double);
+        static constexpr std::size_t KEYS_ALIGNMENT = 64;
+        static constexpr unsigned MAX_RADIX_BITS = 24;
+        // a larger prediction error is rather a corrupted file
+        static constexpr unsigned MAX_SEARCH_RADIUS = 1 << 16;
+
+        // 1-based index into the keys array.
+        using Position = uint64_t;
+
+        // as stored in `PerfectHashIndex`
+        [[nodiscard]] static inline uint64_t packPosition(Position position) {
+            return position;
+        }
+        [[nodiscard]] static inline Position unpackPosition(uint64_t packed) {
+            return packed;
+        }
+
+        // the key as a number, `std::nullopt` unless it is `KEY_SIZE` bytes long
+        [[nodiscard]] static inline std::optional<uint64_t> decodeKey(const Key& key) {
+            if (key.size() != KEY_SIZE) {
+                return std::nullopt;
+            }
+            return Utils::getKeyPrefix(key.get(), KEY_SIZE, 0);
+        }
+        static inline void encodeKey(uint64_t key, std::byte* buffer) {
+            if constexpr (std::endian::native == std::endian::little) {
+                key = __builtin_bswap64(key);
+            }
+            std::memcpy(buffer, &key, KEY_SIZE);
+        }
+        // The position within the segment the model predicts for a key `keyDelta` past the first key of the segment,
+        // the writer measures the search radius with the same computation. Clamped to the segment whatever the slope.
+        [[nodiscard]] static inline uint64_t predict(double slope, uint64_t keyDelta, uint64_t segmentSize) {
+            auto prediction = slope * static_cast<double>(keyDelta);
+            if (!(prediction < static_cast<double>(segmentSize - 1))) {
+                return segmentSize - 1;
+            }
+            return prediction > 0 ? static_cast<uint64_t>(prediction) : 0;
+        }
+
+        // Lookup state for interleaving many lookups on a single thread: the first `advance` predicts the window and
+        // prefetches it, the second one searches it and prefetches the value offset, the third one reads it.
+        struct Search {
+            enum class Stage : uint8_t {
+                PREDICT,
+                SEARCH,
+                READ_VALUE_OFFSET,
+                DONE,
+            };
+            Stage stage;
+            uint64_t key;
+            // the keys window, then `begin` is the position found
+            uint64_t begin;
+            uint64_t end;
+            std::optional<ValueCollection::ValueOffsetType> valueOffset;
+
+            [[nodiscard]] inline bool isDone() const {
+                return stage == Stage::DONE;
+            }
+        };
+
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] std::optional<ValueCollection::ValueOffsetType> get(const Key& key) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] Search startSearch() const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        void advance(Search& search, const Key& key) const;
+        // what the next `advance` reads (besides the tree header)
+        [[nodiscard]] PendingRead getPendingRead(const Search& search) const;
+
+        // Ordered access. Positions compare as `false` when out of range (before the first or after the last key).
+        // The model only bounds the error for the keys which are there, so the seeks are binary searches.
+        [[nodiscard]] Position first() const;
+        [[nodiscard]] Position last() const;
+        [[nodiscard]] Position seekGE(const Key& key) const;
+        [[nodiscard]] Position seekLT(const Key& key) const;
+        [[nodiscard]] Position next(Position position) const;
+        [[nodiscard]] Position prev(Position position) const;
+        // assembled into `buffer`
+        [[nodiscard]] Key getKey(Position position, KeyBuffer& buffer) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] bool hasKeyAt(Position position, const Key& key) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] ValueCollection::ValueOffsetType getValueOffset(Position position) const;
+        // The model is the root (`0`), the keys array and the value offsets array are the levels below it.
+        bool forEachNodeAtDepth(unsigned depth, const NodeCallback& callback) const;
+        // Checks everything the lookups read (throws `data_corrupted_error`), see `DbReader::verify`, including that
+        // every key is found within the search radius of its prediction.
+        [[nodiscard]] PositionCheck verify(const Verifier& verifier) const;
+
+    protected:
+        // segments ranked at once by `predictWindow`, a binary search narrows down more of them
+        static constexpr uint64_t SEGMENT_SCAN_SIZE = 16;
+
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] inline Layout getLayout() const;
+        // the keys window `[begin, end)` (0-based) the key is in, if it is there; empty if it is out of the key range
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] inline std::pair<uint64_t, uint64_t> predictWindow(const Layout& layout, uint64_t key) const;
+        // 0-based position of `key` within the window, `std::nullopt` if it is not there
+        [[nodiscard]] static inline std::optional<uint64_t> searchWindow(const Layout& layout, uint64_t begin, uint64_t end, uint64_t key);
+        // number of keys less than `key` (or equal to it)
+        [[nodiscard]] uint64_t countLess(uint64_t key, bool orEqual) const;
+    };
+
+    // Blocked Bloom filter: all the bits of a key are set within a single cache line sized block, so a probe costs
+    // at most one cache miss. Payload is the `u64` block count, `u8` hash count, `u8` padding size, the padding
+    // (aligning the blocks to `BLOCK_SIZE` within the file) and the blocks as little endian `u64` words.
+    class BloomFilter : public Utils::Mmaped<BloomFilter, uint64_t> {
+    public:
+        static constexpr std::size_t BLOCK_SIZE = 64;
+        static constexpr unsigned BLOCK_BITS = BLOCK_SIZE * 8;
+        static constexpr unsigned MAX_HASH_COUNT = 16;
+
+        [[nodiscard]] static inline uint64_t hashKey(const Key& key);
+        [[nodiscard]] static inline uint64_t getBlockIdx(uint64_t hash, uint64_t blockCount);
+        // Calls `callback(bitIdx)` for every bit of the key within its block (bits may repeat).
+        template<class Callback>
+        static inline void forEachBit(uint64_t hash, unsigned hashCount, Callback&& callback);
+
+        // `false` if the key is definitely absent
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] bool mayContain(const Key& key) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] bool mayContain(uint64_t hash) const;
+        void prefetch(uint64_t hash) const;
+
+        [[nodiscard]] uint64_t getBlockCount() const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] unsigned getHashCount() const;
+        void verify() const;
+
+    protected:
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] inline const std::byte* getBlock(uint64_t hash) const;
+    };
+
+    // Values of a file with compressed values (`DbReader::COMPRESSED_VALUES_FLAG`): the `ValueCollection` payload is
+    // a sequence of blocks of values (stored as in an uncompressed `ValueCollection`), each is
+    //   u8 kind, u32 raw size, u32 stored size, then the stored bytes,
+    // compressed with the dictionary of this section, or raw if that did not pay off (these values are returned
+    // without copying). A value offset is the block index shifted by `BLOCK_OFFSET_BITS` plus the offset within the
+    // block. Payload: u32 dictionary size, the dictionary (may be empty), u64 block count, u64 blockOffsets[block count]
+    // (within the `ValueCollection` payload).
+    class ValueBlocks : public Utils::Mmaped<ValueBlocks, uint64_t> {
+    public:
+        static constexpr unsigned BLOCK_OFFSET_BITS = 20;
+        // values starting within a block, a block can be larger if its last value is
+        static constexpr std::size_t MAX_BLOCK_SIZE = std::size_t(1) << BLOCK_OFFSET_BITS;
+        static constexpr std::size_t BLOCK_HEADER_SIZE = sizeof(uint8_t) + 2 * sizeof(uint32_t);
+
+        enum class BlockKind : uint8_t {
+            RAW = 0,
+            COMPRESSED = 1,
+        };
+
+        [[nodiscard]] std::span<const std::byte> getDictionary() const;
+        [[nodiscard]] uint64_t getBlockCount() const;
+        [[nodiscard]] uint64_t getBlockOffset(uint64_t blockIdx) const;
+        // the block headers and the stored bytes within the values
+        void verify(const ValueCollection* valueCollection) const;
+    };
+
+    class ValueBlockCache;
+
+    // Minimal perfect hash (PTHash) of the keys to their packed tree positions (see `Tree::packPosition` etc.),
+    // for point lookups without descending the tree. Keys are hashed with the seed and split into buckets (skewed:
+    // 60% of the keys go to 30% of the buckets); a key lands on the slot given by its hash and the pilot of its
+    // bucket, the pilots are chosen at build time so that all the keys land on distinct slots. The table has
+    // slightly more slots than keys, which makes the pilots small; the keys landing past the key count are remapped
+    // to the free slots below it. Payload:
+    //   u64 seed, u64 key count, u64 table size, u64 bucket count, u8 pilot size, u8 remap size, u8 entry size,
+    //   pilots[bucket count], remap[table size - key count], entries[key count]
+    // (all little endian numbers of the given byte sizes, up to 8). Any key maps to some entry, so a hit has to be confirmed
+    // by comparing the key at the position.
+    class PerfectHashIndex : public Utils::Mmaped<PerfectHashIndex, uint64_t> {
+    public:
+        // share of the table slots occupied by keys
+        static constexpr double LOAD_FACTOR = 0.99;
+
+        struct Header {
+            uint64_t seed;
+            uint64_t keyCount;
+            uint64_t tableSize;
+            uint64_t bucketCount;
+            unsigned pilotSize;
+            unsigned remapSize;
+            unsigned entrySize;
+        };
+
+        [[nodiscard]] static inline uint64_t getBucket(uint64_t hash, uint64_t bucketCount);
+        [[nodiscard]] static inline uint64_t getSlot(uint64_t hash, uint64_t pilot, uint64_t tableSize);
+
+        // Packed tree position of the only key which may be equal to `key`, `std::nullopt` if there are no keys.
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] std::optional<uint64_t> lookup(const Key& key) const;
+
+        // Parts of `lookup` for interleaving many of them: the hash, then the pilot address to prefetch,
+        // then the entry address to prefetch, then the entry.
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] uint64_t hashKey(const Key& key) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] const std::byte* getPilotAddress(uint64_t hash) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] const std::byte* getEntryAddress(uint64_t hash) const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] uint64_t getEntry(uint64_t hash) const;
+
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] Header getHeader() const;
+        template<bool Checked = Utils::CHECK_BOUNDS>
+        [[nodiscard]] bool isEmpty() const;
+        // the tables and every entry being a position of the tree
+        void verify(const Verifier& verifier, const PositionCheck& isPosition) const;
+
+    protected:
+        static constexpr std::size_t PILOTS_OFFSET = 4 * sizeof(uint64_t) + 3 * sizeof(uint8_t);
     };
 }
 
 class DbReader {
-protected:
+public:
     static constexpr std::byte MAGIC[4] = {
         static_cast<const std::byte>('R'),
         static_cast<const std::byte>('O'),
         static_cast<const std::byte>('F'),
         static_cast<const std::byte>('L'),
     };
+    // flag of the format version field (the low byte is `FormatVersion`), see `priv::ValueBlocks`
+    static constexpr uint16_t COMPRESSED_VALUES_FLAG = 0x100;
+    // flag of the format version field: the `WIDE_TREE` / `PREFIX_COMPRESSED_WIDE_TREE` is a `priv::WideTree64`
+    static constexpr uint16_t LARGE_TREE_FLAG = 0x200;
+    // flag of the format version field: the small values are stored within the tree nodes, next to their keys (see
+    // `priv::ValueCollection::INLINE_VALUE_BIT`), so a hit does not touch the value collection
+    static constexpr uint16_t INLINE_VALUES_FLAG = 0x400;
+    // flag of the format version field: the `SORTED_BINARY_TREE` is a `priv::HotTree`
+    static constexpr uint16_t HOT_NODES_FLAG = 0x800;
+    // whether the library counts the lookups, see `getLookupStats`
+    static constexpr bool INSTRUMENTED = ROFLDB_INSTRUMENTATION;
+
+    struct Options {
+        // memory for the decompressed value blocks of a file with compressed values
+        std::size_t valueBlockCacheSize = 64 * 1024 * 1024;
+        // about one in this many lookups (`get` and `getMany`) counts its key in the access log (`0` for no log), see
+        // `getAccessProfile`
+        uint64_t accessSampleInterval = 0;
+        // distinct keys the access log counts at most, the samples of the other keys are dropped
+        std::size_t accessLogCapacity = 1024 * 1024;
+    };
 
+protected:
+    // number of lookups `getMany` keeps in flight at once
+    static constexpr std::size_t GET_MANY_IN_FLIGHT = 16;
+
+    // the whole file, the sections are checked to be within it by `verify`
+    std::span<const std::byte> file;
+    uint16_t versionField;
+    // set by `verify`
+    bool verified = false;
     const priv::ValueCollection* valueCollection;
-    const priv::Tree* tree;
+    std::variant<const priv::Tree*, const priv::HotTree*, const priv::EytzingerTree*, const priv::WideTree*, const priv::WideTree64*, const priv::LearnedTree*> tree;
+    // the tree payload, which the inline values are stored within
+    std::span<const std::byte> treePayload;
+    // `nullptr` if the file has no filter
+    const priv::BloomFilter* filter = nullptr;
+    // `nullptr` if the file has no index, lookups descend the tree then
+    const priv::PerfectHashIndex* index = nullptr;
+    // `nullptr` unless the values are compressed
+    const priv::ValueBlocks* valueBlocks = nullptr;
+    // `nullptr` unless the values are compressed, shared by the copies of the reader and its cursors
+    std::shared_ptr<priv::ValueBlockCache> valueBlockCache;
+    // `nullptr` unless `INSTRUMENTED`, shared by the copies of the reader
+    std::shared_ptr<priv::LookupCounters> lookupCounters;
+    // `nullptr` unless `Options::accessSampleInterval` is set, shared by the copies of the reader
+    std::shared_ptr<priv::AccessLog> accessLog;
+
+    // The lookups are instantiated both with the bounds checks and without them (see `Unchecked`).
+    template<bool Checked>
+    [[nodiscard]] inline Value getValue(priv::ValueCollection::ValueOffsetType offset) const;
+    template<bool Checked>
+    [[nodiscard]] std::optional<Value> lookup(const Key& key) const;
+    template<bool Checked>
+    void lookupMany(std::span<const Key> keys, std::span<std::optional<Value>> values) const;
+
+    template<bool Checked, class TreeT>
+    [[nodiscard]] std::optional<priv::ValueCollection::ValueOffsetType> getIndexed(const TreeT& tree, const Key& key) const;
+    template<bool Checked, class TreeT>
+    void getMany(const TreeT& tree, std::span<const Key> keys, std::span<std::optional<Value>> values) const;
+    template<bool Checked, class TreeT>
+    void getManyIndexed(const TreeT& tree, std::span<const Key> keys, std::span<std::optional<Value>> values) const;
+
+    // runs the lookup steps over its own page cache
+    friend class PagedDbFile;
 
 public:
-    DbReader(std::byte* memAddress, std::size_t memLength);
+    DbReader(std::byte* memAddress, std::size_t memLength) : DbReader(memAddress, memLength, Options()) {}
+    DbReader(std::byte* memAddress, std::size_t memLength, Options options);
     [[nodiscard]] std::optional<Value> get(const Key& key) const;
     [[nodiscard]] std::optional<Value> get(const std::string& key) const;
     [[nodiscard]] std::optional<Value> get(const std::vector<std::byte>& key) const;
+    // the 8-byte big endian key, as put by `DbWriter::put(uint64_t, ...)` (see `FormatVersion::INTEGER_KEYS`)
+    [[nodiscard]] std::optional<Value> get(uint64_t key) const;
+
+    [[nodiscard]] bool hasFilter() const {
+        return filter != nullptr;
+    }
+
+    [[nodiscard]] bool hasIndex() const {
+        return index != nullptr;
+    }
+
+    // `FormatVersion` in the low byte, and the flags
+    [[nodiscard]] uint16_t getVersionField() const {
+        return versionField;
+    }
+
+    // including its size field, e.g. to lock it in memory
+    [[nodiscard]] std::span<const std::byte> getTreeSection() const;
+    // see `priv::Tree::forEachNodeAtDepth`
+    bool forEachTreeNodeAtDepth(unsigned depth, const priv::NodeCallback& callback) const;
+
+    struct Section {
+        const char* name;
+        // including its size field
+        std::span<const std::byte> bytes;
+    };
+    // the value collection, the tree and the optional sections present, in file order
+    [[nodiscard]] std::vector<Section> getSections() const;
+
+    // Checks the whole file once, on `threadCount` threads (`0` for all the hardware threads): the sections are within
+    // the file, the tree nodes and keys are within the tree, the children are nodes of the tree, the keys are sorted
+    // (so the tree has no cycles), the value offsets are within the values, the filter and index tables are complete
+    // and the index entries are positions of the tree. Throws `data_corrupted_error` on the first violation found.
+    // The lookups of a verified reader can skip all the bounds checks, see `getUnchecked`.
+    void verify(unsigned threadCount = 0);
+
+    [[nodiscard]] bool isVerified() const {
+        return verified;
+    }
+
+    // Lookups without any bounds checks, for a file which passed `verify`: no reads can go outside the mapping, the
+    // tree descents end and nothing throws. Compressed values are not supported, their blocks are only checked when
+    // decompressed.
+    class Unchecked {
+        const DbReader* dbReader;
+
+        explicit Unchecked(const DbReader* dbReader) : dbReader(dbReader) {}
+        friend class DbReader;
+
+    public:
+        [[nodiscard]] std::optional<Value> get(const Key& key) const noexcept;
+        [[nodiscard]] std::optional<Value> get(const std::string& key) const noexcept;
+        // as `DbReader::getMany`, `keys` and `values` have to be of the same size
+        void getMany(std::span<const Key> keys, std::span<std::optional<Value>> values) const noexcept;
+    };
+
+    // Throws `std::logic_error` unless `verify` passed, `Exceptions::unsupported_error` if the values are compressed.
+    // The view is valid as long as the reader.
+    [[nodiscard]] Unchecked getUnchecked() const;
+
+    // Counts of the lookups done so far by this reader and its copies, all zeros unless `INSTRUMENTED` (the library
+    // built with `ROFLDB_WITH_INSTRUMENTATION`).
+    [[nodiscard]] LookupStats getLookupStats() const;
+
+    // Keys sampled from the lookups done so far by this reader and its copies (see `Options::accessSampleInterval`),
+    // for laying out the next file built from the same keys (`DbWriter::Options::accessProfile`). Empty unless the
+    // sampling is on.
+    [[nodiscard]] AccessProfile getAccessProfile() const;
+
+    // Ordered iteration over the keys. Values point into the mapping (as the ones returned by `get`), so do the keys
+    // unless they are stored compressed and have to be assembled.
+    class Cursor {
+    protected:
+        template<class TreeT>
+        struct TreePosition {
+            const TreeT* tree;
+            typename TreeT::Position position;
+        };
+
+        const priv::ValueCollection* valueCollection;
+        std::span<const std::byte> treePayload;
+        std::shared_ptr<priv::ValueBlockCache> valueBlockCache;
+        std::variant<TreePosition<priv::Tree>, TreePosition<priv::HotTree>, TreePosition<priv::EytzingerTree>, TreePosition<priv::WideTree>,
+                     TreePosition<priv::WideTree64>, TreePosition<priv::LearnedTree>> state;
+        // for the keys which have to be assembled (see `FormatVersion::PREFIX_COMPRESSED_WIDE_TREE`)
+        mutable priv::KeyBuffer keyBuffer;
+        // the ancestors of the position in a `priv::Tree` while stepping backwards, cleared by any other move
+        priv::Tree::Path treePath;
+
+        explicit Cursor(const DbReader& dbReader);
+        friend class DbReader;
+
+    public:
+        // all the methods return whether the cursor ended up at a key (`isValid`)
+        bool seekFirst();
+        bool seekLast();
+        // to the smallest key greater than or equal to `key`
+        bool seekGE(const Key& key);
+        // to the greatest key less than or equal to `key`
+        bool seekLE(const Key& key);
+        bool next();
+        bool prev();
+
+        [[nodiscard]] bool isValid() const;
+        // valid until the cursor is moved
+        [[nodiscard]] Key getKey() const;
+        [[nodiscard]] Value getValue() const;
+        // as stored in the tree: within the `ValueCollection` payload, unless the value is inline
+        // (`priv::ValueCollection::isInline`) or the values are compressed (`COMPRESSED_VALUES_FLAG`)
+        [[nodiscard]] priv::ValueCollection::ValueOffsetType getValueOffset() const;
+    };
+
+    // All the keys starting with the prefix, in order: `for (auto [key, value] : dbReader.scanPrefix(prefix))`.
+    // The prefix memory has to outlive the iteration.
+    class PrefixScan {
+        Cursor cursor;
+        Key prefix;
+
+    public:
+        class Iterator {
+            Cursor* cursor;
+            const Key* prefix;
+
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using difference_type = std::ptrdiff_t;
+            using value_type = std::pair<Key, Value>;
+
+            Iterator(Cursor* cursor, const Key* prefix) : cursor(cursor), prefix(prefix) {}
+
+            [[nodiscard]] value_type operator*() const;
+            Iterator& operator++();
+            void operator++(int) {
+                ++*this;
+            }
+            [[nodiscard]] bool operator==(std::default_sentinel_t) const;
+        };
+
+        PrefixScan(Cursor cursor, const Key& prefix) : cursor(cursor), prefix(prefix) {}
+
+        [[nodiscard]] Iterator begin();
+        [[nodiscard]] std::default_sentinel_t end() const {
+            return std::default_sentinel;
+        }
+    };
+
+    // Not positioned anywhere until one of the `seek` methods is called.
+    [[nodiscard]] Cursor getCursor() const;
+    [[nodiscard]] PrefixScan scanPrefix(const Key& prefix) const;
+
+    // Looks all the `keys` up at once (`values[i]` is the result for `keys[i]`), interleaving the lookups so that
+    // their cache and TLB misses overlap instead of stalling one after another.
+    void getMany(std::span<const Key> keys, std::span<std::optional<Value>> values) const;
 };
 
 
@@ -112,3 +975,59 @@ namespace RoflDb::Utils {
         return Value(address + sizeof(Value::SizeType), Utils::read<Value::SizeType>(address));
     }
 }
+
+namespace RoflDb {
+    std::strong_ordering Key::operator<=>(const Key& other) const {
+        int cmpResult = std::memcmp(this->memAddress, other.memAddress, std::min(this->length, other.length));
+        if (cmpResult > 0) [[unlikely]] {
+            return std::strong_ordering::greater;
+        } else if (cmpResult < 0) [[likely]] {
+            return std::strong_ordering::less;
+        } else [[ unlikely ]] {
+            return this->length <=> other.length;
+        }
+    }
+
+    bool Key::operator==(const Key& other) const {
+        return this->operator<=>(other) == std::strong_ordering::equal;
+    }
+
+    bool Key::startsWith(const Key& prefix) const {
+        return this->length >= prefix.length && std::memcmp(this->memAddress, prefix.memAddress, prefix.length) == 0;
+    }
+
+    uint64_t priv::BloomFilter::hashKey(const Key& key) {
+        return Utils::hashBytes(key.get(), key.size());
+    }
+
+    uint64_t priv::BloomFilter::getBlockIdx(uint64_t hash, uint64_t blockCount) {
+        // multiply-shift instead of a modulo, takes the high bits of the hash
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(hash) * blockCount) >> 64);
+    }
+
+    uint64_t priv::PerfectHashIndex::getBucket(uint64_t hash, uint64_t bucketCount) {
+        // the low half of the hash picks between the dense and the sparse buckets, the high half picks the bucket
+        constexpr uint64_t DENSE_KEYS_THRESHOLD = uint64_t(0.6 * (uint64_t(1) << 32));
+        auto denseBucketCount = bucketCount * 3 / 10;
+        auto high = hash >> 32;
+        if ((hash & 0xFFFFFFFF) < DENSE_KEYS_THRESHOLD && denseBucketCount > 0) {
+            return (high * denseBucketCount) >> 32;
+        }
+        return denseBucketCount + ((high * (bucketCount - denseBucketCount)) >> 32);
+    }
+
+    uint64_t priv::PerfectHashIndex::getSlot(uint64_t hash, uint64_t pilot, uint64_t tableSize) {
+        return (Utils::mixBits(hash) ^ Utils::mixBits(pilot + 0x9E3779B97F4A7C15)) % tableSize;
+    }
+
+    template<class Callback>
+    void priv::BloomFilter::forEachBit(uint64_t hash, unsigned hashCount, Callback&& callback) {
+        // double hashing on the low half of the hash (the block is picked by the high bits), as in LevelDB
+        auto bits = static_cast<uint32_t>(hash);
+        auto delta = std::rotr(bits, 17);
+        for (unsigned i = 0; i < hashCount; i++) {
+            callback(bits % BLOCK_BITS);
+            bits += delta;
+        }
+    }
+}
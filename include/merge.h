@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "db_file.h"
+#include "writer.h"
+
+namespace RoflDb {
+
+// Merge of several `.rofldb` files into one (e.g. compacting the outputs of separate builds), which never sorts
+// anything: the sorted key sequences of the inputs are streamed by cursors and merged by a loser tree.
+// The value sections of the inputs are copied into the output whole (within the kernel where possible, see
+// `DbWriter::appendValues`) and the merged keys point into the copies, so the values are neither read nor written
+// (the ones of the dropped duplicates stay as dead space). The key space is split into ranges of about the same number
+// of keys (sampled by a pass over the keys of the inputs), merged in parallel into scratch files of keys in order, and
+// the ranges are appended to the output one after another, the keys streamed to the tree as they come
+// (`DbWriter::Options::presorted`). The output is written to a uniquely named temporary file next to it, which
+// replaces it once complete.
+class DbMerger {
+public:
+    // Which entry is kept of a key found in several inputs, the later inputs being the newer ones.
+    enum class Duplicates : uint8_t {
+        NEWEST = 0,
+        OLDEST = 1,
+        // throw `Exceptions::duplicate_key_error`
+        FAIL = 2,
+    };
+
+    struct Options {
+        DbWriter::Options outputOptions;
+        Duplicates duplicates = Duplicates::NEWEST;
+        // threads merging the key ranges (`0` for all the hardware threads)
+        unsigned threadCount = 0;
+        // key ranges per thread, so that a thread stuck with a slow range does not hold the others up
+        unsigned rangesPerThread = 4;
+        DbFile::Options inputOptions;
+    };
+
+    struct Stats {
+        // of the output file, including `elapsed` of the whole merge
+        DbWriter::Stats output;
+        // the entries of all the inputs, and the ones dropped in favour of a newer (or older) entry of the same key
+        uint64_t inputKeys = 0;
+        uint64_t droppedDuplicates = 0;
+        std::size_t ranges = 0;
+        // the inputs whose value sections were copied as they are (not with compressed or inline output values, or
+        // from compressed inputs, which are `put`), see `DbWriter::Stats::kernelCopiedValueBytes` for how
+        std::size_t copiedValueSections = 0;
+        // of the copied value sections, the values of the dropped duplicates (left as dead space in the output)
+        uint64_t droppedValueBytes = 0;
+    };
+
+protected:
+    // one in this many keys of the inputs is sampled for splitting the key space
+    static constexpr uint64_t SAMPLE_INTERVAL = 256;
+
+    struct Range;
+
+    Options options;
+    std::vector<std::unique_ptr<DbFile>> inputs;
+
+    [[nodiscard]] std::vector<std::string> sampleSplitKeys(std::size_t rangeCount) const;
+    void mergeRange(Range& range, const std::vector<bool>& copiedInputs, const std::atomic<bool>& cancelled) const;
+
+public:
+    explicit DbMerger(std::span<const std::filesystem::path> inputPaths) : DbMerger(inputPaths, Options()) {}
+    // the inputs are ordered from the oldest to the newest
+    DbMerger(std::span<const std::filesystem::path> inputPaths, Options options);
+    DbMerger(const DbMerger& other) = delete;
+
+    // Writes the merged file, throws `Exceptions::duplicate_key_error` for a duplicate key with `Duplicates::FAIL`. A file
+    // at `outputPath` is only replaced once the merge succeeded.
+    Stats merge(const std::filesystem::path& outputPath);
+};
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <bit>
 #include <type_traits>
 #include "exceptions.h"
@@ -52,13 +53,19 @@ namespace RoflDb::Utils {
         return *resPtr;
     }
 
-    class PayloadReader {
+    // whether the payload readers check the bounds unless asked otherwise
+    inline constexpr bool CHECK_BOUNDS = ROFLDB_SECURITY;
+
+    // Reads the fields of a payload one after another. A `Checked` reader throws `data_corrupted_error` rather than
+    // reading past the bound, an unchecked one is for the files which passed `DbReader::verify`.
+    template<bool Checked>
+    class BasicPayloadReader {
         const std::byte* address;
         std::size_t remaining;
 
     public:
-        PayloadReader(const PayloadReader& other) = default;
-        PayloadReader(const std::byte* address, std::size_t boundSize) : address(address), remaining(boundSize) {}
+        BasicPayloadReader(const BasicPayloadReader& other) = default;
+        BasicPayloadReader(const std::byte* address, std::size_t boundSize) : address(address), remaining(boundSize) {}
 
         template<class ReadT>
         [[nodiscard]] inline ReadT read(std::size_t offset = 0) {
@@ -67,12 +74,12 @@ namespace RoflDb::Utils {
             return Utils::read<ReadT>(skip(size));
         }
 
-        inline const std::byte* skip(std::size_t bytes) {
-#if ROFLDB_SECURITY
-            if (bytes > remaining) [[unlikely]] {
-                throw Exceptions::data_corrupted_error("Out of bounds");
+        inline const std::byte* skip(std::size_t bytes) noexcept(!Checked) {
+            if constexpr (Checked) {
+                if (bytes > remaining) [[unlikely]] {
+                    throw Exceptions::data_corrupted_error("Out of bounds");
+                }
             }
-#endif
             address += bytes;
             remaining -= bytes;
             return address - bytes;
@@ -101,6 +108,9 @@ namespace RoflDb::Utils {
         }
     };
 
+    using PayloadReader = BasicPayloadReader<CHECK_BOUNDS>;
+    using UncheckedPayloadReader = BasicPayloadReader<false>;
+
     template<class ThisT, class SizeT = void>
     class Mmaped {
         static_assert(!std::is_pointer_v<SizeT> && std::is_unsigned_v<SizeT>);
@@ -118,8 +128,9 @@ namespace RoflDb::Utils {
         [[nodiscard]] inline std::byte* getPayloadAddress() const {
             return (std::byte*)this + PAYLOAD_OFFSET;
         }
-        [[nodiscard]] inline PayloadReader getPayloadReader() const {
-            return PayloadReader(getPayloadAddress(), getSize());
+        template<bool Checked = CHECK_BOUNDS>
+        [[nodiscard]] inline BasicPayloadReader<Checked> getPayloadReader() const {
+            return BasicPayloadReader<Checked>(getPayloadAddress(), getSize());
         }
     };
 }
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "file_io.h"
+#include "library.h"
+
+namespace RoflDb {
+
+// Reader of a `.rofldb` file which reads the file into a page cache of its own instead of mapping it, for files much
+// larger than the memory: the lookups never block on a page fault, the memory used is bounded by the cache size and
+// the hottest pages stay in (the top tree levels are pinned, the other pages are evicted by CLOCK).
+//
+// The cache is a private anonymous mapping as large as the file, which the pages are read into at their file offsets
+// (and dropped from with `MADV_DONTNEED`), so the `DbReader` lookup code runs over it unchanged: before every step of
+// a lookup the pages it is about to read (see `priv::PendingRead`) are loaded, with `pread` or with `io_uring` while
+// the other lookups go on. Lookups descend the tree, the perfect hash index is not used. Files with compressed values
+// are not supported.
+//
+// Not thread safe, meant as one per thread (the lookups of a thread go on while its reads are in flight):
+//
+//   PagedDbFile file(path);
+//   file.getAsync(key, [](std::optional<Value> value) { ... });  // the value is valid within the callback only
+//   file.wait();
+class PagedDbFile {
+public:
+    static constexpr std::size_t PAGE_SIZE = 4096;
+
+    enum class IoBackend {
+        // the pages are read synchronously, one lookup at a time
+        PREAD,
+        // up to `queueDepth` reads in flight, falls back to `PREAD` if the kernel does not allow `io_uring`
+        IO_URING,
+    };
+
+    struct Options {
+        // memory for the pages, exceeded only while the pinned pages do not fit in
+        std::size_t cacheBytes = 256 * 1024 * 1024;
+        // the pages read by the lookups within these top tree levels are never evicted
+        unsigned pinnedTreeLevels = 3;
+        // `O_DIRECT`: no second copy of the pages in the kernel page cache
+        bool directIo = false;
+        IoBackend ioBackend = IoBackend::IO_URING;
+        unsigned queueDepth = 256;
+    };
+
+    struct Stats {
+        uint64_t lookups = 0;
+        // page accesses of the lookup steps which found the page in the cache, and which had to wait for it
+        uint64_t pageHits = 0;
+        uint64_t pageMisses = 0;
+        uint64_t reads = 0;
+        uint64_t readBytes = 0;
+        uint64_t evictions = 0;
+        uint64_t pinnedPages = 0;
+        uint64_t residentPages = 0;
+    };
+
+    // called with the value of the key, which is valid only until the callback returns
+    using Callback = std::function<void(std::optional<Value>)>;
+
+protected:
+    enum PageFlags : uint8_t {
+        LOADING = 1,
+        RESIDENT = 2,
+        PINNED = 4,
+        // set by every access, cleared by the CLOCK hand passing by
+        REFERENCED = 8,
+    };
+
+    // pages read at once at most
+    static constexpr uint64_t MAX_READ_PAGES = 32;
+
+    using Search = std::variant<priv::Tree::Search, priv::EytzingerTree::Search, priv::WideTree::Search, priv::WideTree64::Search, priv::LearnedTree::Search>;
+
+    struct Lookup {
+        // of the key
+        const std::byte* keyAddress;
+        std::size_t keySize;
+        Callback callback;
+        Search search;
+        // the `advance` calls so far
+        unsigned step = 0;
+        bool filterChecked = false;
+    };
+
+    Options options;
+    Utils::FileDescriptor file;
+    uint64_t fileSize = 0;
+    std::byte* data = nullptr;
+    std::size_t mappingSize = 0;
+    std::optional<DbReader> reader;
+    std::unique_ptr<Utils::IoRing> ioRing;
+
+    std::vector<uint8_t> pages;
+    // resident pages which are not pinned (lazily removed once they are), and the CLOCK hand
+    std::vector<uint64_t> clock;
+    std::size_t clockHand = 0;
+    uint64_t cachePages;
+    uint64_t loadingPages = 0;
+    // the pages the current lookup step reads, which must not be evicted to make room for each other
+    uint64_t protectedBegin = 0;
+    uint64_t protectedEnd = 0;
+
+    // lookups waiting for a page being loaded (on its first page missing, re-checked when it is in)
+    std::unordered_map<uint64_t, std::vector<Lookup*>> waiters;
+    std::deque<Lookup*> ready;
+    // reused once done
+    std::vector<std::unique_ptr<Lookup>> lookups;
+    std::vector<Lookup*> freeLookups;
+    bool draining = false;
+    Stats stats;
+
+    // the bytes are loaded synchronously and kept (the headers the reader is constructed over)
+    void loadPinned(uint64_t offset, uint64_t size);
+    template<class T>
+    [[nodiscard]] T readPinned(uint64_t offset);
+
+    // whether the bytes of the read are in, otherwise their loading is started and the lookup waits for it
+    [[nodiscard]] bool ensure(Lookup& lookup, const priv::PendingRead& read, bool pin);
+    [[nodiscard]] bool ensureRange(Lookup& lookup, uint64_t begin, uint64_t end, bool pin);
+    void load(uint64_t firstPage, uint64_t pageCount, bool pin);
+    void makeRoom(uint64_t pageCount);
+    [[nodiscard]] bool evictOne();
+    void completeRead(uint64_t userData, int result);
+    void markLoaded(uint64_t firstPage, uint64_t pageCount);
+
+    // runs the lookup until it waits for a page or is done (returns `true` then)
+    [[nodiscard]] bool resume(Lookup& lookup);
+    void release(Lookup* lookup);
+    void drain();
+    void reap(unsigned minCompleted);
+
+public:
+    explicit PagedDbFile(const std::filesystem::path& path) : PagedDbFile(path, Options()) {}
+    PagedDbFile(const std::filesystem::path& path, Options options);
+    PagedDbFile(const PagedDbFile& other) = delete;
+    // the lookups in flight are dropped without their callbacks being called
+    ~PagedDbFile();
+
+    // Starts the lookup, which goes on within the following calls of this file until its callback is called. The key
+    // memory has to outlive the lookup. Can be called from the callbacks.
+    void getAsync(const Key& key, Callback callback);
+    // Goes on with the lookups without blocking, returns how many are still in flight.
+    std::size_t poll();
+    // Goes on with the lookups until at most `maxInFlight` of them are left.
+    void wait(std::size_t maxInFlight = 0);
+    // A copy of the value (blocks until it is read), not to be called from the callbacks.
+    [[nodiscard]] std::optional<Value> get(const Key& key);
+    [[nodiscard]] std::optional<Value> get(const std::string& key);
+
+    [[nodiscard]] const Stats& getStats() const {
+        return stats;
+    }
+
+    [[nodiscard]] bool usesIoUring() const {
+        return ioRing != nullptr;
+    }
+};
+
+}
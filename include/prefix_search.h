@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace RoflDb::Utils {
+
+    // Fixed-width key prefix: up to 8 bytes of the key starting at `skip`, zero-padded and read as a big endian number,
+    // so that comparing prefixes as integers is consistent with comparing the keys byte-wise (equal prefixes are ties).
+    [[nodiscard]] inline uint64_t getKeyPrefix(const std::byte* key, std::size_t keySize, std::size_t skip) {
+        std::byte bytes[sizeof(uint64_t)] = {};
+        if (keySize > skip) {
+            std::memcpy(bytes, key + skip, std::min(keySize - skip, sizeof bytes));
+        }
+        uint64_t prefix;
+        std::memcpy(&prefix, bytes, sizeof prefix);
+        if constexpr (std::endian::native == std::endian::little) {
+            prefix = __builtin_bswap64(prefix);
+        }
+        return prefix;
+    }
+
+    struct PrefixRank {
+        // number of prefixes less than the searched one
+        unsigned less;
+        // number of prefixes less than or equal to the searched one (so `[less, lessOrEqual)` are the ties)
+        unsigned lessOrEqual;
+    };
+
+    // Ranks `prefix` among `count` sorted prefixes stored as little endian `uint64_t`s (possibly unaligned).
+    // The kernel (AVX2, SSE4.2 or scalar) is chosen once by the CPU features.
+    [[nodiscard]] PrefixRank rankPrefix(const std::byte* prefixes, unsigned count, uint64_t prefix);
+
+    [[nodiscard]] const char* getPrefixRankKernelName();
+
+}
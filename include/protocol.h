@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Wire format of `rofldb-serve` (`DbServer` and `DbClient`) over a Unix stream socket, little endian. A connection
+// carries requests answered in order, and a client may send any number of them before reading the responses.
+//   request:  u32 size of the rest, u8 `Opcode`, u32 request id (echoed in the response), then per opcode
+//     GET:    u16 file index (in the order the server was given the files), u32 key count, the keys (u16 size, bytes)
+//   response: u32 size of the rest, u32 request id, u8 `Status`, then per status
+//     OK:     u32 value count, the values (u8 `Lookup`, then for `FOUND` the u32 size and the bytes)
+//     ERROR:  the message, up to the end of the response
+// A request the server can not parse closes the connection, one it can not answer gets an `ERROR` response.
+// A client shutting its side down (`shutdown(SHUT_WR)`) after its last request still gets all the responses.
+namespace RoflDb::Protocol {
+
+    enum class Opcode : uint8_t {
+        GET = 1,
+    };
+
+    enum class Status : uint8_t {
+        OK = 0,
+        ERROR = 1,
+    };
+
+    // per value of an `OK` response, as any u32 is a valid value size
+    enum class Lookup : uint8_t {
+        NOT_FOUND = 0,
+        FOUND = 1,
+    };
+
+    // the largest request (without its size field) a server takes
+    inline constexpr uint32_t MAX_REQUEST_SIZE = 64 * 1024 * 1024;
+    inline constexpr std::size_t REQUEST_HEADER_SIZE = sizeof(uint32_t) + sizeof(Opcode) + sizeof(uint32_t);
+    inline constexpr std::size_t RESPONSE_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(Status);
+
+    // Appends the fields of the messages to a buffer, integers in the wire byte order.
+    class MessageWriter {
+        std::vector<std::byte>& buffer;
+
+    public:
+        explicit MessageWriter(std::vector<std::byte>& buffer) : buffer(buffer) {}
+
+        template<class WriteT, std::enable_if_t<std::is_integral_v<WriteT> || std::is_enum_v<WriteT>, bool> = true>
+        inline void write(WriteT value) {
+            writeAt(buffer.size(), value);
+        }
+
+        inline void write(const std::byte* data, std::size_t size) {
+            buffer.insert(buffer.end(), data, data + size);
+        }
+
+        // Overwrites or appends at `offset` (e.g. a size field reserved before the rest was known).
+        template<class WriteT, std::enable_if_t<std::is_integral_v<WriteT> || std::is_enum_v<WriteT>, bool> = true>
+        inline void writeAt(std::size_t offset, WriteT value) {
+            if constexpr (sizeof(WriteT) > 1 && std::endian::native == std::endian::big) {
+                auto* bytesPtr = reinterpret_cast<std::byte*>(&value);
+                std::reverse(bytesPtr, bytesPtr + sizeof(WriteT));
+            }
+            buffer.resize(std::max(buffer.size(), offset + sizeof(WriteT)));
+            std::memcpy(buffer.data() + offset, &value, sizeof(WriteT));
+        }
+
+        [[nodiscard]] inline std::size_t tell() const {
+            return buffer.size();
+        }
+    };
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+/* Stable C interface of the `.rofldb` reader (`RoflDb::DbFile` and `RoflDb::DbReader`), for the other languages.
+ * Nothing but the opaque handle crosses the boundary, so the layout of the C++ classes may change without breaking
+ * the callers: additions bump `ROFLDB_ABI_VERSION`, the existing functions keep their meaning.
+ *
+ * The values returned point into the mapping of the file and stay valid until the handle is closed. A handle may
+ * be used by any number of threads at once, except for `rofldb_close`. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ROFLDB_ABI_VERSION 1
+
+#if defined(__GNUC__)
+#define ROFLDB_API __attribute__((visibility("default")))
+#else
+#define ROFLDB_API
+#endif
+
+typedef struct rofldb rofldb;
+
+typedef enum rofldb_status {
+    ROFLDB_OK = 0,
+    ROFLDB_NOT_FOUND = 1,
+    /* see `rofldb_last_error` for the details of the errors */
+    ROFLDB_ERROR = -1,
+    ROFLDB_ERROR_IO = -2,
+    /* not a `.rofldb` file */
+    ROFLDB_ERROR_MAGIC = -3,
+    ROFLDB_ERROR_CORRUPTED = -4,
+    /* e.g. the format version of a newer library, or compressed values, which can not be returned without copying */
+    ROFLDB_ERROR_UNSUPPORTED = -5,
+    ROFLDB_ERROR_INVALID_ARGUMENT = -6,
+} rofldb_status;
+
+/* `rofldb_open` flags, see `RoflDb::DbFile::Options` */
+enum {
+    /* read the whole file while opening it */
+    ROFLDB_OPEN_POPULATE = 1 << 0,
+    /* no readahead around the page faults, for files much larger than the memory */
+    ROFLDB_OPEN_RANDOM = 1 << 1,
+    /* check the whole file while opening it (reading it all), the lookups then skip all the bounds checks */
+    ROFLDB_OPEN_VERIFY = 1 << 2,
+};
+
+/* `ROFLDB_ABI_VERSION` of the library loaded, which may be newer than the header compiled against */
+ROFLDB_API uint32_t rofldb_abi_version(void);
+
+/* Message of the last error returned on the calling thread, valid until its next call. */
+ROFLDB_API const char* rofldb_last_error(void);
+
+ROFLDB_API rofldb_status rofldb_open(const char* path, uint32_t flags, rofldb** db);
+
+/* `ROFLDB_OK` with the value, or `ROFLDB_NOT_FOUND` */
+ROFLDB_API rofldb_status rofldb_get(const rofldb* db, const void* key, size_t key_size, const void** value, size_t* value_size);
+
+/* Looks all the keys up at once, interleaving the lookups (see `RoflDb::DbReader::getMany`): `values[i]` is `NULL`
+ * for a key not found. The arrays are of `count` items each. */
+ROFLDB_API rofldb_status rofldb_get_many(const rofldb* db, size_t count, const void* const* keys, const size_t* key_sizes,
+                                         const void** values, size_t* value_sizes);
+
+/* The whole mapping of the file, which all the values returned point into. */
+ROFLDB_API void rofldb_get_data(const rofldb* db, const void** data, size_t* size);
+
+/* Unmaps the file, so all the values returned are gone. `NULL` is ignored. */
+ROFLDB_API void rofldb_close(rofldb* db);
+
+#ifdef __cplusplus
+}
+#endif
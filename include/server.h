@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "db_file.h"
+#include "file_io.h"
+#include "protocol.h"
+
+namespace RoflDb {
+
+// Local query daemon (`rofldb-serve`): holds the readers of a set of files, so that the processes of a host share a
+// single mapping warmed up once instead of each mapping and warming the files up, and answers batched gets over a
+// Unix stream socket (see `protocol.h`).
+// Every worker thread runs its own epoll loop over the connections it accepted; the listening socket is in all the
+// loops (`EPOLLEXCLUSIVE`), so the connections spread over the threads. The keys of a request are looked up together
+// (`DbReader::getMany`), and the responses to the requests pipelined on a connection are sent together.
+class DbServer {
+public:
+    struct Options {
+        // worker threads (`0` for one per hardware thread)
+        unsigned threadCount = 0;
+        // how the files are opened, populated by default so that the clients never take the page faults
+        DbFile::Options fileOptions = [] {
+            DbFile::Options options;
+            options.populate = true;
+            return options;
+        }();
+        // responses kept for a connection before its requests are no longer read (until the client reads them)
+        std::size_t maxPendingResponseBytes = 16 * 1024 * 1024;
+    };
+
+    struct Stats {
+        uint64_t connections = 0;
+        uint64_t requests = 0;
+        uint64_t keys = 0;
+        // the requests answered with `Protocol::Status::ERROR`
+        uint64_t errors = 0;
+    };
+
+protected:
+    // written by the owning worker only
+    struct WorkerCounters {
+        alignas(64) std::atomic<uint64_t> connections = 0;
+        std::atomic<uint64_t> requests = 0;
+        std::atomic<uint64_t> keys = 0;
+        std::atomic<uint64_t> errors = 0;
+    };
+
+    struct Connection;
+
+    Options options;
+    std::filesystem::path socketPath;
+    std::vector<std::unique_ptr<DbFile>> files;
+    // per file, set for the verified files the lookups of which skip the bounds checks
+    std::vector<std::optional<DbReader::Unchecked>> uncheckedReaders;
+    Utils::FileDescriptor listener;
+    // `eventfd` signalled by `stop`, never read, so that it wakes all the workers up
+    Utils::FileDescriptor stopEvent;
+    std::vector<std::unique_ptr<WorkerCounters>> counters;
+
+    void serve(WorkerCounters& workerCounters) const;
+    // the requests complete in the input of the connection, `false` if the connection has to be closed
+    bool answerRequests(Connection& connection, WorkerCounters& workerCounters) const;
+    // the requests come from other processes, so their readers always check the bounds
+    void answerGet(uint32_t requestId, Utils::BasicPayloadReader<true>& request, Connection& connection, WorkerCounters& workerCounters) const;
+
+public:
+    // Opens the files (numbered in this order by the requests) and starts listening at `socketPath`. A socket file
+    // left there by a server which is gone is replaced, throws `Exceptions::io_error` if a server is listening there.
+    DbServer(const std::filesystem::path& socketPath, std::span<const std::filesystem::path> paths, Options options);
+    DbServer(const DbServer& other) = delete;
+    // removes the socket file
+    ~DbServer();
+
+    // Serves on `Options::threadCount` threads until `stop` (once per server).
+    void run();
+    // Makes `run` return once the workers finish the requests at hand. Async signal safe.
+    void stop() const;
+    // totals so far, over all the workers
+    [[nodiscard]] Stats getStats() const;
+};
+
+}
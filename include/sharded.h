@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "db_file.h"
+#include "writer.h"
+
+namespace RoflDb {
+
+// How the keys of a sharded database are distributed among its shards.
+enum class Partitioning : uint8_t {
+    // by a hash of the key: even shards for any key distribution
+    HASH = 0,
+    // by key ranges: shard `i` holds the keys from `splitKeys[i - 1]` (inclusive) up to `splitKeys[i]` (exclusive)
+    RANGE = 1,
+};
+
+// Small file describing a database split into several `.rofldb` shards. Layout (little endian):
+//   "RFLS", u16 version (`0`), u8 `Partitioning`, u32 shard count, the shard file names (u16 size, bytes; relative to
+//   the manifest directory), then for `Partitioning::RANGE` the shard count - 1 increasing split keys (u16 size, bytes).
+struct ShardManifest {
+    static constexpr std::byte MAGIC[4] = {
+        static_cast<const std::byte>('R'),
+        static_cast<const std::byte>('F'),
+        static_cast<const std::byte>('L'),
+        static_cast<const std::byte>('S'),
+    };
+    // `Partitioning::HASH` seed, so that the shards are independent from the hashes used inside the files
+    static constexpr uint64_t HASH_SEED = 0x5348415244;
+
+    Partitioning partitioning = Partitioning::HASH;
+    std::vector<std::filesystem::path> shardPaths;
+    std::vector<std::string> splitKeys;
+
+    // Shard paths are resolved relative to the manifest directory.
+    [[nodiscard]] static ShardManifest load(const std::filesystem::path& path);
+    void save(const std::filesystem::path& path) const;
+    // Throws `std::invalid_argument` unless the split keys match the partitioning and the shard count.
+    void validate() const;
+
+    // the shard the key belongs to
+    [[nodiscard]] std::size_t getShardIdx(const Key& key) const;
+};
+
+// Reader of a database split into shards (see `ShardedDbWriter`), with the `DbReader` lookup API. Every lookup goes
+// to the single shard the key is routed to by the manifest.
+class ShardedDbReader {
+protected:
+    ShardManifest manifest;
+    std::vector<std::unique_ptr<DbFile>> shards;
+
+public:
+    explicit ShardedDbReader(const std::filesystem::path& manifestPath) : ShardedDbReader(manifestPath, DbFile::Options()) {}
+    // the options are applied to every shard
+    ShardedDbReader(const std::filesystem::path& manifestPath, const DbFile::Options& shardOptions);
+    ShardedDbReader(const ShardedDbReader& other) = delete;
+
+    [[nodiscard]] std::optional<Value> get(const Key& key) const;
+    [[nodiscard]] std::optional<Value> get(const std::string& key) const;
+    [[nodiscard]] std::optional<Value> get(const std::vector<std::byte>& key) const;
+    // see `DbReader::get(uint64_t)`
+    [[nodiscard]] std::optional<Value> get(uint64_t key) const;
+
+    // See `DbReader::getMany`: the keys are grouped by shard, and every shard looks its group up at once.
+    void getMany(std::span<const Key> keys, std::span<std::optional<Value>> values) const;
+
+    [[nodiscard]] const ShardManifest& getManifest() const {
+        return manifest;
+    }
+
+    [[nodiscard]] std::size_t getShardCount() const {
+        return shards.size();
+    }
+
+    [[nodiscard]] const DbFile& getShard(std::size_t idx) const {
+        return *shards[idx];
+    }
+};
+
+// Builder of a database split into shards: the records are routed to a `DbWriter` per shard, each fed by its own
+// thread, so that the shards are sorted and written in parallel. The shards are written next to the manifest, as
+// `<manifest stem>.<shard index>.rofldb`.
+class ShardedDbWriter {
+public:
+    struct Options {
+        // one shard per core by default
+        unsigned shardCount = std::max(1u, std::thread::hardware_concurrency());
+        Partitioning partitioning = Partitioning::HASH;
+        // `shardCount - 1` increasing keys for `Partitioning::RANGE`
+        std::vector<std::string> splitKeys;
+        // for every shard, including `DbWriter::Options::memoryLimit`
+        DbWriter::Options shardOptions;
+        // the records are handed over to the shard threads in batches of about this size
+        std::size_t batchSize = 1024 * 1024;
+    };
+
+    // summed over the shards, except for `elapsed`
+    using Stats = DbWriter::Stats;
+
+protected:
+    // batches a shard thread may lag behind `put` before it blocks
+    static constexpr std::size_t MAX_QUEUED_BATCHES = 4;
+
+    struct Shard {
+        DbWriter writer;
+        // batch being filled by `put`: repeated <key size><key><value size><value>, host byte order
+        std::vector<std::byte> batch;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<std::vector<std::byte>> queue;
+        // no more batches (`cancelled`: without finishing the file)
+        bool closed = false;
+        bool cancelled = false;
+        std::exception_ptr error;
+        Stats stats;
+        std::thread thread;
+
+        Shard(const std::filesystem::path& path, const DbWriter::Options& options) : writer(path, options) {}
+        void run();
+    };
+
+    Options options;
+    std::filesystem::path manifestPath;
+    ShardManifest manifest;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::chrono::steady_clock::time_point startedAt;
+    bool finished = false;
+
+    void submitBatch(Shard& shard);
+    void stopShards(bool cancel);
+
+public:
+    explicit ShardedDbWriter(const std::filesystem::path& manifestPath) : ShardedDbWriter(manifestPath, Options()) {}
+    ShardedDbWriter(const std::filesystem::path& manifestPath, Options options);
+    ShardedDbWriter(const ShardedDbWriter& other) = delete;
+    ~ShardedDbWriter();
+
+    void put(const Key& key, const Value& value);
+    void put(std::string_view key, std::string_view value);
+    // see `DbWriter::put(uint64_t, ...)`
+    void put(uint64_t key, const Value& value);
+    void put(uint64_t key, std::string_view value);
+
+    // Finishes all the shards in parallel and writes the manifest. Throws the first error of any shard (e.g.
+    // `Exceptions::duplicate_key_error`).
+    Stats finish();
+};
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "compression.h"
+#include "library.h"
+
+namespace RoflDb::priv {
+
+    // Thread-safe LRU of decompressed `ValueBlocks`, bounded by their total size. It is split into shards by the block
+    // index, each with its own lock, so that concurrent readers rarely contend; blocks are decompressed outside the
+    // lock. Values of the compressed blocks are returned as copies owning their memory, so they outlive the eviction.
+    class ValueBlockCache {
+        static constexpr std::size_t SHARD_COUNT = 16;
+
+        using Block = std::shared_ptr<const std::vector<std::byte>>;
+
+        struct Shard {
+            std::mutex mutex;
+            // the most recently used first
+            std::list<std::pair<uint64_t, Block>> blocks;
+            std::unordered_map<uint64_t, std::list<std::pair<uint64_t, Block>>::iterator> blockIdxs;
+            std::size_t size = 0;
+        };
+
+        const ValueCollection* valueCollection;
+        const ValueBlocks* valueBlocks;
+        Utils::BlockDecompressor decompressor;
+        const std::size_t shardCapacity;
+        std::array<Shard, SHARD_COUNT> shards;
+
+        [[nodiscard]] Block getBlock(uint64_t blockIdx, Utils::PayloadReader blockReader);
+
+    public:
+        ValueBlockCache(const ValueCollection* valueCollection, const ValueBlocks* valueBlocks, std::size_t capacity);
+        ValueBlockCache(const ValueBlockCache& other) = delete;
+
+        [[nodiscard]] Value getValue(ValueCollection::ValueOffsetType offset);
+    };
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "exceptions.h"
+#include "library.h"
+
+namespace RoflDb::priv {
+
+    // Checks shared by the sections while verifying a file (see `DbReader::verify`), and the threads they run on.
+    class Verifier {
+        // items handed to a thread at once by `parallelFor`
+        static constexpr uint64_t MIN_CHUNK_SIZE = 256;
+
+        const ValueCollection* valueCollection;
+        // `nullptr` unless the values are compressed
+        const ValueBlocks* valueBlocks;
+        // the tree payload, empty unless the file has inline values
+        std::span<const std::byte> inlineValues;
+        unsigned threadCount;
+        // the bytes a value can start within, by block (for the compressed values)
+        std::vector<uint64_t> blockSizes;
+
+    public:
+        // `valueBlocks` (if any) has to be verified already
+        Verifier(const ValueCollection* valueCollection, const ValueBlocks* valueBlocks, std::span<const std::byte> inlineValues,
+                 unsigned threadCount);
+
+        static inline void require(bool condition, const char* what) {
+            if (!condition) [[unlikely]] {
+                throw Exceptions::data_corrupted_error(what);
+            }
+        }
+
+        // The value has to be within the values (or within the tree, if it is inline). Only the start of a compressed
+        // one can be checked, the rest is checked when its block is decompressed.
+        void checkValueOffset(ValueCollection::ValueOffsetType offset) const;
+
+        // Calls `body(begin, end)` for the chunks of `[0, count)` on the threads, rethrows the first exception thrown
+        // (the remaining chunks are skipped then).
+        void parallelFor(uint64_t count, const std::function<void(uint64_t begin, uint64_t end)>& body,
+                         uint64_t minChunkSize = MIN_CHUNK_SIZE) const;
+    };
+
+}
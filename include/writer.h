@@ -0,0 +1,201 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "compression.h"
+#include "file_io.h"
+#include "library.h"
+
+
+namespace RoflDb {
+
+// Streaming builder of `.rofldb` files.
+// Values are appended to the `ValueCollection` section as soon as they are `put`, keys are buffered in memory and
+// spilled to disk as sorted runs whenever `Options::memoryLimit` is exceeded. `finish` merges the runs and writes
+// the `Tree` section sequentially, so input does not need to be sorted and memory usage does not depend on its size.
+// Input known to be sorted skips the buffering and the sort altogether, see `Options::presorted`.
+class DbWriter {
+public:
+    using ValueOffsetType = priv::ValueCollection::ValueOffsetType;
+
+    // the longest key `put` takes: a `priv::Tree` node (its key size, the key, the value offset and at most two
+    // children) has to fit its 16-bit size
+    static constexpr std::size_t MAX_KEY_SIZE = std::numeric_limits<priv::Tree::Node::SizeType>::max() - sizeof(Key::SizeType)
+                                                - sizeof(priv::ValueCollection::ValueOffsetType) - 2 * sizeof(priv::Tree::Node::OffsetType);
+
+    // the largest `Options::inlineValueSize`
+    static constexpr std::size_t MAX_INLINE_VALUE_SIZE = 1024;
+
+    struct Options {
+        FormatVersion version = FormatVersion::SORTED_BINARY_TREE;
+        // maximum number of keys per node of `FormatVersion::WIDE_TREE` (and `PREFIX_COMPRESSED_WIDE_TREE`)
+        unsigned wideTreeFanout = 32;
+        // 64-bit offsets in the tree (`DbReader::LARGE_TREE_FLAG`), needed for the trees over 4 GiB (else `finish`
+        // throws `std::length_error`); wide trees only
+        bool largeTree = false;
+        // maximum distance of a key from the position predicted by the model of `FormatVersion::INTEGER_KEYS`: the
+        // lookups rank `2 * learnedTreeMaxError + 1` keys at most, the model gets a segment per about as many keys
+        unsigned learnedTreeMaxError = 16;
+        // values of up to this many bytes are stored within the tree nodes next to their keys instead of in the value
+        // collection (`DbReader::INLINE_VALUES_FLAG`), so a hit takes no extra access (`0` for none, up to
+        // `MAX_INLINE_VALUE_SIZE`); not supported by `FormatVersion::INTEGER_KEYS`
+        std::size_t inlineValueSize = 0;
+        // How often the keys are looked up (see `DbReader::getAccessProfile`), `FormatVersion::SORTED_BINARY_TREE` only:
+        // the tree is weight-balanced rather than balanced, so a key looked up a share `p` of the time is within a few
+        // levels of depth `log2(1 / p)` (the nodes stay in key order, the lookups are unchanged).
+        std::shared_ptr<const AccessProfile> accessProfile;
+        // share of the key weights given by `accessProfile`, the rest is spread evenly over all the keys, which keeps
+        // the keys missing from the profile within about `log2(keys / (1 - accessProfileShare))` levels (below `1`)
+        double accessProfileShare = 0.9;
+        // with `accessProfile`, the bytes of the most visited nodes copied to the start of the tree
+        // (`DbReader::HOT_NODES_FLAG`, see `priv::HotTree`), so the hot lookups touch a few pages only (`0` for none)
+        std::size_t hotNodesSize = 2 * 1024 * 1024;
+        // size of the Bloom filter section (`0` for no filter): 10 bits per key give about 1% false positives
+        unsigned filterBitsPerKey = 0;
+        // whether to add the perfect hash index section, which takes point lookups to a few memory accesses
+        // (at about 4 bits per key plus a packed tree position per key)
+        bool perfectHashIndex = false;
+        // size of the blocks the values are compressed in (`0` for no compression, up to `ValueBlocks::MAX_BLOCK_SIZE`),
+        // see `priv::ValueBlocks`: larger blocks compress better, but a read missing the block cache decompresses the
+        // whole block. Requires a build with zstd.
+        std::size_t valueBlockSize = 0;
+        // capacity of the dictionary trained on the first values and shared by all the blocks (`0` for none)
+        std::size_t valueDictionarySize = 64 * 1024;
+        // zstd compression level
+        int compressionLevel = 3;
+        // approximate amount of memory used for buffering keys before a sorted run is spilled to disk
+        std::size_t memoryLimit = 256 * 1024 * 1024;
+        // The keys are put in the sorted order (checked by `put`): they are streamed to a single scratch file which
+        // the tree is written from as it is, instead of being buffered, sorted and spilled as runs (`memoryLimit` is
+        // not used then).
+        bool presorted = false;
+        // size of the userspace buffer for every file written or read sequentially
+        std::size_t ioBufferSize = 4 * 1024 * 1024;
+        // where sorted runs and other scratch data are stored (the files are unlinked right after creation)
+        std::filesystem::path temporaryDirectory = std::filesystem::temp_directory_path();
+    };
+
+    struct Stats {
+        uint64_t keys = 0;
+        uint64_t valueBytes = 0;
+        // the values as stored, with their sizes, blocks and dictionary
+        uint64_t storedValueBytes = 0;
+        // the values stored within the tree, see `Options::inlineValueSize`
+        uint64_t inlineValues = 0;
+        uint64_t treeBytes = 0;
+        // the hot copies of the nodes, see `Options::hotNodesSize`
+        uint64_t hotNodes = 0;
+        uint64_t filterBytes = 0;
+        uint64_t indexBytes = 0;
+        uint64_t fileBytes = 0;
+        uint64_t spilledRuns = 0;
+        // of the values added by `appendValues`, the bytes copied within the kernel (the rest was read and written)
+        uint64_t appendedValueBytes = 0;
+        uint64_t kernelCopiedValueBytes = 0;
+        std::chrono::steady_clock::duration elapsed {};
+
+        [[nodiscard]] double keysPerSecond() const;
+        [[nodiscard]] double megabytesPerSecond() const;
+    };
+
+protected:
+    // Until the tree is written, the value offset of an inline value is its size with `INLINE_VALUE_BIT` set, and the
+    // value follows the key (in the arena and in the sorted runs).
+    struct PendingKey {
+        uint64_t arenaOffset;
+        ValueOffsetType valueOffset;
+        Key::SizeType size;
+    };
+
+    struct Run {
+        Utils::FileDescriptor file;
+        uint64_t size;
+    };
+
+    class SortedKeys;
+
+    Options options;
+    Utils::FileDescriptor file;
+    Utils::BufferedFileWriter output;
+    uint64_t valueCollectionOffset;
+
+    std::vector<std::byte> keyArena;
+    std::vector<PendingKey> pendingKeys;
+    std::vector<Run> runs;
+    // with `Options::presorted`, the keys as in a run, which becomes the only run in `finish`
+    Utils::FileDescriptor presortedFile;
+    std::optional<Utils::BufferedFileWriter> presortedKeys;
+    std::vector<std::byte> lastKey;
+    // hashes of all the keys in the `put` order, for building the filter
+    Utils::FileDescriptor keyHashFile;
+    std::optional<Utils::BufferedFileWriter> keyHashes;
+
+    // values put since the last finished block (see `Options::valueBlockSize`)
+    std::vector<std::byte> pendingBlock;
+    // finished blocks kept until there is enough of them to train the dictionary on
+    std::vector<std::vector<std::byte>> untrainedBlocks;
+    std::size_t untrainedBytes = 0;
+    std::vector<std::byte> valueDictionary;
+    std::optional<Utils::BlockCompressor> compressor;
+    std::vector<std::byte> compressedBlock;
+    // within the `ValueCollection` payload
+    std::vector<uint64_t> valueBlockOffsets;
+
+    Stats stats;
+    std::chrono::steady_clock::time_point startedAt;
+    bool finished = false;
+
+    void checkKey(const Key& key) const;
+    // `inlineValue` is only read if the value offset is inline
+    void addPendingKey(const Key& key, ValueOffsetType valueOffset, const Value& inlineValue);
+    void sortPendingKeys();
+    void spillRun();
+    void finishValueBlock();
+    void trainValueDictionary();
+    void writeValueBlock(std::span<const std::byte> block);
+    void writeValueBlocks();
+    void writeTree(SortedKeys& sortedKeys);
+    void writeBinaryTree(SortedKeys& sortedKeys);
+    void writeWeightedBinaryTree(SortedKeys& sortedKeys);
+    void writeEytzingerTree(SortedKeys& sortedKeys);
+    template<class WideTree>
+    void writeWideTree(SortedKeys& sortedKeys);
+    void writeLearnedTree(SortedKeys& sortedKeys);
+    void writeFilter();
+    void writePerfectHashIndex(uint64_t treeOffset);
+
+public:
+    explicit DbWriter(const std::filesystem::path& path) : DbWriter(path, Options()) {}
+    DbWriter(const std::filesystem::path& path, Options options);
+    // writes to `file` from its start
+    DbWriter(Utils::FileDescriptor file, Options options);
+    DbWriter(const DbWriter& other) = delete;
+
+    void put(const Key& key, const Value& value);
+    void put(std::string_view key, std::string_view value);
+    // the 8-byte big endian key, so that the keys sort as numbers (required by `FormatVersion::INTEGER_KEYS`)
+    void put(uint64_t key, const Value& value);
+    void put(uint64_t key, std::string_view value);
+
+    // Appends values already stored as in the `ValueCollection` section (the size and the bytes of each): `size` bytes
+    // of `fd` from `offset` on, copied within the kernel where possible (see `Utils::copyFileRange`). Returns the value
+    // offset of the first of them, their keys are then added by `putAppended`. Not supported with
+    // `Options::valueBlockSize`.
+    ValueOffsetType appendValues(int fd, uint64_t offset, uint64_t size);
+    // `put` of a key whose value of `valueSize` bytes was appended by `appendValues` at `valueOffset`
+    void putAppended(const Key& key, ValueOffsetType valueOffset, Value::SizeType valueSize);
+
+    // Writes the tree and flushes the file. Throws `Exceptions::duplicate_key_error` if some key was put twice (with
+    // `Options::presorted`, `put` throws it right away, and `std::invalid_argument` for a key out of order).
+    Stats finish();
+};
+
+}
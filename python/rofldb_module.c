@@ -0,0 +1,353 @@
+/* CPython binding of the C interface (`rofldb.h`):
+ *
+ *     with rofldb.Reader("data.rofldb") as reader:
+ *         value = reader.get(b"key")             # memoryview into the mapping, or None
+ *         values = reader.get_many([b"a", "b"])  # the lookups interleaved, without holding the GIL
+ *
+ * The values are read-only slices of a memoryview of the whole mapping, nothing is copied. They keep the mapping
+ * alive: `close` only unmaps the file once the last of them (and the batch lookups of the other threads) is gone. */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "rofldb.h"
+
+static PyObject* RoflDbError;
+
+/* Owner of the open file, exporting its whole mapping as a buffer: it is gone (and the file unmapped) once the last
+ * memoryview of the mapping is. */
+typedef struct {
+    PyObject_HEAD
+    rofldb* db;
+    const char* data;
+    Py_ssize_t size;
+} MappingObject;
+
+typedef struct {
+    PyObject_HEAD
+    /* memoryview of the whole `MappingObject`, the values are sliced from it (`NULL` once closed) */
+    PyObject* mapping;
+    const rofldb* db;
+    const char* data;
+} ReaderObject;
+
+/* a key as bytes: of a `bytes` or `str` object (UTF-8) held by the caller, or of any other buffer */
+typedef struct {
+    const char* data;
+    Py_ssize_t size;
+    Py_buffer buffer;
+    int hasBuffer;
+} KeyBytes;
+
+static PyObject* setError(rofldb_status status) {
+    PyObject* type = RoflDbError;
+    if (status == ROFLDB_ERROR_IO) {
+        type = PyExc_OSError;
+    } else if (status == ROFLDB_ERROR_INVALID_ARGUMENT) {
+        type = PyExc_ValueError;
+    }
+    PyErr_SetString(type, rofldb_last_error());
+    return NULL;
+}
+
+static int checkOpen(ReaderObject* self) {
+    if (!self->mapping) {
+        PyErr_SetString(PyExc_ValueError, "Reader is closed");
+        return 0;
+    }
+    return 1;
+}
+
+static int getKeyBytes(PyObject* key, KeyBytes* result) {
+    result->hasBuffer = 0;
+    if (PyBytes_Check(key)) {
+        result->data = PyBytes_AS_STRING(key);
+        result->size = PyBytes_GET_SIZE(key);
+        return 1;
+    }
+    if (PyUnicode_Check(key)) {
+        result->data = PyUnicode_AsUTF8AndSize(key, &result->size);
+        return result->data != NULL;
+    }
+    if (PyObject_GetBuffer(key, &result->buffer, PyBUF_SIMPLE) != 0) {
+        return 0;
+    }
+    result->data = result->buffer.buf;
+    result->size = result->buffer.len;
+    result->hasBuffer = 1;
+    return 1;
+}
+
+static void releaseKeyBytes(KeyBytes* key) {
+    if (key->hasBuffer) {
+        PyBuffer_Release(&key->buffer);
+        key->hasBuffer = 0;
+    }
+}
+
+
+// Mapping =============================================================================================================
+
+static int Mapping_getbuffer(MappingObject* self, Py_buffer* view, int flags) {
+    return PyBuffer_FillInfo(view, (PyObject*)self, (void*)self->data, self->size, 1, flags);
+}
+
+static void Mapping_dealloc(MappingObject* self) {
+    rofldb_close(self->db);
+    PyObject_Free(self);
+}
+
+static PyBufferProcs Mapping_as_buffer = {
+    .bf_getbuffer = (getbufferproc)Mapping_getbuffer,
+};
+
+static PyTypeObject MappingType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "rofldb._Mapping",
+    .tp_basicsize = sizeof(MappingObject),
+    .tp_dealloc = (destructor)Mapping_dealloc,
+    .tp_as_buffer = &Mapping_as_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+};
+
+// END Mapping =========================================================================================================
+
+
+// Reader ==============================================================================================================
+
+/* the slice of `mapping` (starting at `data`) */
+static PyObject* makeValue(PyObject* mapping, const char* data, const void* value, size_t valueSize) {
+    Py_ssize_t offset = (const char*)value - data;
+    return PySequence_GetSlice(mapping, offset, offset + (Py_ssize_t)valueSize);
+}
+
+static int Reader_init(ReaderObject* self, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = {"path", "populate", "random", "verify", NULL};
+    PyObject* path = NULL;
+    int populate = 0;
+    int random = 0;
+    int verify = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&|$ppp", keywords, PyUnicode_FSConverter, &path, &populate, &random, &verify)) {
+        return -1;
+    }
+    if (self->mapping) {
+        Py_DECREF(path);
+        PyErr_SetString(PyExc_RuntimeError, "Reader is already open");
+        return -1;
+    }
+
+    uint32_t flags = (populate ? ROFLDB_OPEN_POPULATE : 0) | (random ? ROFLDB_OPEN_RANDOM : 0) | (verify ? ROFLDB_OPEN_VERIFY : 0);
+    rofldb* db;
+    rofldb_status status;
+    /* the file may be read in and verified whole */
+    Py_BEGIN_ALLOW_THREADS
+    status = rofldb_open(PyBytes_AS_STRING(path), flags, &db);
+    Py_END_ALLOW_THREADS
+    Py_DECREF(path);
+    if (status != ROFLDB_OK) {
+        setError(status);
+        return -1;
+    }
+
+    MappingObject* owner = PyObject_New(MappingObject, &MappingType);
+    if (!owner) {
+        rofldb_close(db);
+        return -1;
+    }
+    owner->db = db;
+    const void* data;
+    size_t size;
+    rofldb_get_data(db, &data, &size);
+    owner->data = data;
+    owner->size = (Py_ssize_t)size;
+
+    self->mapping = PyMemoryView_FromObject((PyObject*)owner);
+    Py_DECREF(owner);
+    if (!self->mapping) {
+        return -1;
+    }
+    self->db = db;
+    self->data = data;
+    return 0;
+}
+
+static void Reader_dealloc(ReaderObject* self) {
+    Py_XDECREF(self->mapping);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* Reader_get(ReaderObject* self, PyObject* key) {
+    if (!checkOpen(self)) {
+        return NULL;
+    }
+    KeyBytes keyBytes;
+    if (!getKeyBytes(key, &keyBytes)) {
+        return NULL;
+    }
+    /* a single lookup is shorter than handing the GIL over */
+    const void* value;
+    size_t valueSize;
+    rofldb_status status = rofldb_get(self->db, keyBytes.data, (size_t)keyBytes.size, &value, &valueSize);
+    releaseKeyBytes(&keyBytes);
+    if (status == ROFLDB_NOT_FOUND) {
+        Py_RETURN_NONE;
+    }
+    if (status != ROFLDB_OK) {
+        return setError(status);
+    }
+    return makeValue(self->mapping, self->data, value, valueSize);
+}
+
+static PyObject* Reader_get_many(ReaderObject* self, PyObject* keys) {
+    if (!checkOpen(self)) {
+        return NULL;
+    }
+    /* a tuple of the keys, which no other thread can change while the GIL is released */
+    PyObject* keyTuple = PySequence_Tuple(keys);
+    if (!keyTuple) {
+        return NULL;
+    }
+    /* the file stays mapped even if another thread closes the reader meanwhile */
+    PyObject* mapping = Py_NewRef(self->mapping);
+    Py_ssize_t count = PyTuple_GET_SIZE(keyTuple);
+    PyObject* result = NULL;
+    KeyBytes* keyBytes = PyMem_Calloc(count > 0 ? count : 1, sizeof(KeyBytes));
+    const void** keyData = PyMem_Malloc((count > 0 ? count : 1) * sizeof(const void*));
+    size_t* keySizes = PyMem_Malloc((count > 0 ? count : 1) * sizeof(size_t));
+    const void** values = PyMem_Malloc((count > 0 ? count : 1) * sizeof(const void*));
+    size_t* valueSizes = PyMem_Malloc((count > 0 ? count : 1) * sizeof(size_t));
+    Py_ssize_t converted = 0;
+    if (!keyBytes || !keyData || !keySizes || !values || !valueSizes) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (; converted < count; converted++) {
+        if (!getKeyBytes(PyTuple_GET_ITEM(keyTuple, converted), &keyBytes[converted])) {
+            goto done;
+        }
+        keyData[converted] = keyBytes[converted].data;
+        keySizes[converted] = (size_t)keyBytes[converted].size;
+    }
+
+    const rofldb* db = self->db;
+    const char* data = self->data;
+    rofldb_status status;
+    Py_BEGIN_ALLOW_THREADS
+    status = rofldb_get_many(db, (size_t)count, keyData, keySizes, values, valueSizes);
+    Py_END_ALLOW_THREADS
+    if (status != ROFLDB_OK) {
+        setError(status);
+        goto done;
+    }
+
+    result = PyList_New(count);
+    if (!result) {
+        goto done;
+    }
+    for (Py_ssize_t idx = 0; idx < count; idx++) {
+        PyObject* value;
+        if (values[idx]) {
+            value = makeValue(mapping, data, values[idx], valueSizes[idx]);
+            if (!value) {
+                Py_CLEAR(result);
+                goto done;
+            }
+        } else {
+            value = Py_NewRef(Py_None);
+        }
+        PyList_SET_ITEM(result, idx, value);
+    }
+
+done:
+    for (Py_ssize_t idx = 0; idx < converted; idx++) {
+        releaseKeyBytes(&keyBytes[idx]);
+    }
+    PyMem_Free(keyBytes);
+    PyMem_Free(keyData);
+    PyMem_Free(keySizes);
+    PyMem_Free(values);
+    PyMem_Free(valueSizes);
+    Py_DECREF(keyTuple);
+    Py_DECREF(mapping);
+    return result;
+}
+
+static PyObject* Reader_close(ReaderObject* self, PyObject* Py_UNUSED(ignored)) {
+    /* unmapped right away, unless some values are still around */
+    Py_CLEAR(self->mapping);
+    self->db = NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject* Reader_enter(ReaderObject* self, PyObject* Py_UNUSED(ignored)) {
+    if (!checkOpen(self)) {
+        return NULL;
+    }
+    return Py_NewRef(self);
+}
+
+static PyObject* Reader_exit(ReaderObject* self, PyObject* Py_UNUSED(args)) {
+    return Reader_close(self, NULL);
+}
+
+static PyObject* Reader_get_closed(ReaderObject* self, void* Py_UNUSED(closure)) {
+    return PyBool_FromLong(self->mapping == NULL);
+}
+
+static PyMethodDef Reader_methods[] = {
+    {"get", (PyCFunction)Reader_get, METH_O, "get(key) -> memoryview | None\n\nThe value of the key (bytes, str or a buffer), a read-only view of the file."},
+    {"get_many", (PyCFunction)Reader_get_many, METH_O,
+     "get_many(keys) -> list[memoryview | None]\n\nLooks all the keys up at once, with the lookups interleaved and the GIL released."},
+    {"close", (PyCFunction)Reader_close, METH_NOARGS, "close()\n\nUnmaps the file as soon as none of its values is referenced any more."},
+    {"__enter__", (PyCFunction)Reader_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)Reader_exit, METH_VARARGS, NULL},
+    {NULL},
+};
+
+static PyGetSetDef Reader_getset[] = {
+    {"closed", (getter)Reader_get_closed, NULL, "Whether the reader is closed.", NULL},
+    {NULL},
+};
+
+static PyTypeObject ReaderType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "rofldb.Reader",
+    .tp_doc = "Reader(path, *, populate=False, random=False, verify=False)\n\n"
+              "Reader of a .rofldb file: `populate` reads the whole file in while opening, `random` turns the readahead off\n"
+              "(for files much larger than the memory), `verify` checks the whole file, so the lookups skip the bounds checks.",
+    .tp_basicsize = sizeof(ReaderObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)Reader_init,
+    .tp_dealloc = (destructor)Reader_dealloc,
+    .tp_methods = Reader_methods,
+    .tp_getset = Reader_getset,
+};
+
+// END Reader ==========================================================================================================
+
+
+static struct PyModuleDef module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "rofldb",
+    .m_doc = "Zero-copy reader of .rofldb files.",
+    .m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_rofldb(void) {
+    if (PyType_Ready(&MappingType) < 0 || PyType_Ready(&ReaderType) < 0) {
+        return NULL;
+    }
+    PyObject* result = PyModule_Create(&module);
+    if (!result) {
+        return NULL;
+    }
+    RoflDbError = PyErr_NewException("rofldb.Error", NULL, NULL);
+    if (PyModule_AddObjectRef(result, "Error", RoflDbError) < 0
+        || PyModule_AddObjectRef(result, "Reader", (PyObject*)&ReaderType) < 0
+        || PyModule_AddIntConstant(result, "ABI_VERSION", rofldb_abi_version()) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+#include "../include/access_profile.h"
+#include "../include/exceptions.h"
+#include "../include/file_io.h"
+
+namespace RoflDb {
+
+namespace {
+    constexpr uint16_t PROFILE_VERSION = 0;
+    constexpr std::size_t PROFILE_BUFFER_SIZE = 1024 * 1024;
+
+    std::atomic<uint64_t> nextLogId = 1;
+}
+
+// AccessProfile =======================================================================================================
+
+    AccessProfile::AccessProfile(std::vector<Entry> unsortedEntries) {
+        std::sort(unsortedEntries.begin(), unsortedEntries.end(), [](const Entry& left, const Entry& right) {
+            return left.key < right.key;
+        });
+        for (auto& entry : unsortedEntries) {
+            if (entry.key.size() > std::numeric_limits<Key::SizeType>::max()) {
+                throw std::invalid_argument("Profiled key too long");
+            }
+            if (entry.count == 0) {
+                continue;
+            }
+            totalCount += entry.count;
+            if (!entries.empty() && entries.back().key == entry.key) {
+                entries.back().count += entry.count;
+            } else {
+                entries.push_back(std::move(entry));
+            }
+        }
+    }
+
+    AccessProfile AccessProfile::load(const std::filesystem::path& path) {
+        auto file = Utils::FileDescriptor::open(path);
+        Utils::BufferedFileReader reader(file.get(), PROFILE_BUFFER_SIZE, 0, file.size());
+        auto truncated = [&path]() {
+            return Exceptions::data_corrupted_error("Truncated access profile " + path.string());
+        };
+
+        std::byte magic[sizeof MAGIC];
+        if (!reader.read(magic, sizeof magic) || std::memcmp(magic, MAGIC, sizeof MAGIC) != 0) {
+            throw Exceptions::magic_error("Not an access profile: " + path.string());
+        }
+        uint16_t version;
+        uint64_t count;
+        if (!reader.read(version) || !reader.read(count)) {
+            throw truncated();
+        }
+        if (version != PROFILE_VERSION) {
+            throw Exceptions::unsupported_error("Unsupported access profile version " + std::to_string(version));
+        }
+
+        AccessProfile profile;
+        for (uint64_t idx = 0; idx < count; idx++) {
+            Key::SizeType keySize;
+            Entry entry;
+            if (!reader.read(keySize)) {
+                throw truncated();
+            }
+            entry.key.resize(keySize);
+            if ((keySize > 0 && !reader.read(reinterpret_cast<std::byte*>(entry.key.data()), keySize)) || !reader.read(entry.count)) {
+                throw truncated();
+            }
+            if (!profile.entries.empty() && !(profile.entries.back().key < entry.key)) {
+                throw Exceptions::data_corrupted_error("Access profile keys out of order in " + path.string());
+            }
+            // never stored (see the constructor), it would weigh the key as never looked up
+            if (entry.count == 0) {
+                throw Exceptions::data_corrupted_error("Access profile entry with a zero count in " + path.string());
+            }
+            profile.totalCount += entry.count;
+            profile.entries.push_back(std::move(entry));
+        }
+        return profile;
+    }
+
+    void AccessProfile::save(const std::filesystem::path& path) const {
+        auto temporaryPath = path;
+        temporaryPath += ".tmp";
+        {
+            auto file = Utils::FileDescriptor::create(temporaryPath);
+            Utils::BufferedFileWriter writer(file.get(), PROFILE_BUFFER_SIZE);
+            writer.write(MAGIC, sizeof MAGIC);
+            writer.write<uint16_t>(PROFILE_VERSION);
+            writer.write<uint64_t>(entries.size());
+            for (const auto& entry : entries) {
+                writer.write<Key::SizeType>(entry.key.size());
+                writer.write(reinterpret_cast<const std::byte*>(entry.key.data()), entry.key.size());
+                writer.write<uint64_t>(entry.count);
+            }
+            writer.flush();
+        }
+        std::filesystem::rename(temporaryPath, path);
+    }
+
+    uint64_t AccessProfile::getCount(std::string_view key) const {
+        auto found = std::lower_bound(entries.begin(), entries.end(), key, [](const Entry& entry, std::string_view key) {
+            return entry.key < key;
+        });
+        return found != entries.end() && found->key == key ? found->count : 0;
+    }
+
+// END AccessProfile ===================================================================================================
+
+
+// priv::AccessLog =====================================================================================================
+
+    priv::AccessLog::AccessLog(uint64_t interval, std::size_t capacity)
+        : id(nextLogId.fetch_add(1, std::memory_order_relaxed)), interval(std::max<uint64_t>(interval, 1)), capacity(capacity) {}
+
+    uint64_t priv::AccessLog::nextCountdown() const noexcept {
+        thread_local std::minstd_rand random(std::random_device{}());
+        return 1 + random() % (2 * interval - 1);
+    }
+
+    void priv::AccessLog::sample(const Key& key) noexcept {
+        std::lock_guard lock(mutex);
+        try {
+            std::string keyString(reinterpret_cast<const char*>(key.get()), key.size());
+            auto found = counts.find(keyString);
+            if (found != counts.end()) {
+                found->second++;
+            } else if (counts.size() < capacity) {
+                counts.emplace(std::move(keyString), 1);
+            } else {
+                dropped++;
+            }
+        } catch (const std::bad_alloc&) {
+            // the lookups go on, the sample is lost
+            dropped++;
+        }
+    }
+
+    AccessProfile priv::AccessLog::getProfile() const {
+        std::vector<AccessProfile::Entry> entries;
+        {
+            std::lock_guard lock(mutex);
+            entries.reserve(counts.size());
+            for (const auto& [key, count] : counts) {
+                entries.push_back({key, count});
+            }
+        }
+        return AccessProfile(std::move(entries));
+    }
+
+    uint64_t priv::AccessLog::getDropped() const {
+        std::lock_guard lock(mutex);
+        return dropped;
+    }
+
+// END priv::AccessLog =================================================================================================
+
+}
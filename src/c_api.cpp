@@ -0,0 +1,139 @@
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../include/db_file.h"
+#include "../include/exceptions.h"
+#include "../include/rofldb.h"
+
+struct rofldb {
+    RoflDb::DbFile file;
+    // the bounds checks are skipped for the files verified while opening
+    std::optional<RoflDb::DbReader::Unchecked> unchecked;
+
+    rofldb(const char* path, const RoflDb::DbFile::Options& options) : file(path, options) {}
+};
+
+namespace {
+    thread_local std::string lastError;
+    // reused by the batches of a thread
+    thread_local std::vector<RoflDb::Key> batchKeys;
+    thread_local std::vector<std::optional<RoflDb::Value>> batchValues;
+
+    // No exception may cross the C boundary: they are turned into the statuses here.
+    template<class Callback>
+    rofldb_status translateErrors(Callback&& callback) noexcept {
+        try {
+            return callback();
+        } catch (const RoflDb::Exceptions::io_error& error) {
+            lastError = error.what();
+            return ROFLDB_ERROR_IO;
+        } catch (const RoflDb::Exceptions::magic_error& error) {
+            lastError = error.what();
+            return ROFLDB_ERROR_MAGIC;
+        } catch (const RoflDb::Exceptions::data_corrupted_error& error) {
+            lastError = error.what();
+            return ROFLDB_ERROR_CORRUPTED;
+        } catch (const RoflDb::Exceptions::unsupported_error& error) {
+            lastError = error.what();
+            return ROFLDB_ERROR_UNSUPPORTED;
+        } catch (const std::invalid_argument& error) {
+            lastError = error.what();
+            return ROFLDB_ERROR_INVALID_ARGUMENT;
+        } catch (const std::exception& error) {
+            lastError = error.what();
+            return ROFLDB_ERROR;
+        } catch (...) {
+            lastError = "Unknown error";
+            return ROFLDB_ERROR;
+        }
+    }
+
+    RoflDb::Key makeKey(const void* key, size_t keySize) {
+        return {static_cast<const std::byte*>(key), keySize};
+    }
+}
+
+extern "C" {
+
+    uint32_t rofldb_abi_version(void) {
+        return ROFLDB_ABI_VERSION;
+    }
+
+    const char* rofldb_last_error(void) {
+        return lastError.c_str();
+    }
+
+    rofldb_status rofldb_open(const char* path, uint32_t flags, rofldb** db) {
+        return translateErrors([&]() {
+            if (!path || !db) {
+                throw std::invalid_argument("No path or handle to open");
+            }
+            *db = nullptr;
+            RoflDb::DbFile::Options options;
+            options.populate = flags & ROFLDB_OPEN_POPULATE;
+            options.advice = flags & ROFLDB_OPEN_RANDOM ? RoflDb::DbFile::Advice::RANDOM : RoflDb::DbFile::Advice::NORMAL;
+            options.verify = flags & ROFLDB_OPEN_VERIFY;
+
+            auto result = std::make_unique<rofldb>(path, options);
+            const auto& reader = result->file.getReader();
+            // a decompressed value lives in the block cache only as long as something holds it
+            if (reader.getVersionField() & RoflDb::DbReader::COMPRESSED_VALUES_FLAG) {
+                throw RoflDb::Exceptions::unsupported_error("Compressed values can not be returned without copying");
+            }
+            if (reader.isVerified()) {
+                result->unchecked = reader.getUnchecked();
+            }
+            *db = result.release();
+            return ROFLDB_OK;
+        });
+    }
+
+    rofldb_status rofldb_get(const rofldb* db, const void* key, size_t key_size, const void** value, size_t* value_size) {
+        return translateErrors([&]() {
+            auto result = db->unchecked ? db->unchecked->get(makeKey(key, key_size)) : db->file.getReader().get(makeKey(key, key_size));
+            if (!result) {
+                return ROFLDB_NOT_FOUND;
+            }
+            *value = result->get();
+            *value_size = result->size();
+            return ROFLDB_OK;
+        });
+    }
+
+    rofldb_status rofldb_get_many(const rofldb* db, size_t count, const void* const* keys, const size_t* key_sizes,
+                                  const void** values, size_t* value_sizes) {
+        return translateErrors([&]() {
+            batchKeys.clear();
+            for (size_t idx = 0; idx < count; idx++) {
+                batchKeys.push_back(makeKey(keys[idx], key_sizes[idx]));
+            }
+            batchValues.clear();
+            batchValues.resize(count);
+            if (db->unchecked) {
+                db->unchecked->getMany(batchKeys, batchValues);
+            } else {
+                db->file.getReader().getMany(batchKeys, batchValues);
+            }
+            for (size_t idx = 0; idx < count; idx++) {
+                values[idx] = batchValues[idx] ? batchValues[idx]->get() : nullptr;
+                value_sizes[idx] = batchValues[idx] ? batchValues[idx]->size() : 0;
+            }
+            return ROFLDB_OK;
+        });
+    }
+
+    void rofldb_get_data(const rofldb* db, const void** data, size_t* size) {
+        auto bytes = db->file.getData();
+        *data = bytes.data();
+        *size = bytes.size();
+    }
+
+    void rofldb_close(rofldb* db) {
+        delete db;
+    }
+
+}
@@ -0,0 +1,201 @@
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../include/client.h"
+#include "../include/exceptions.h"
+#include "../include/library.h"
+
+namespace RoflDb {
+
+namespace {
+    // received at once (at least)
+    constexpr std::size_t READ_SIZE = 64 * 1024;
+
+    Exceptions::io_error makeIoError(const std::string& what) {
+        return Exceptions::io_error(what + ": " + std::strerror(errno));
+    }
+}
+
+    DbClient::DbClient(const std::filesystem::path& socketPath) {
+        sockaddr_un address {};
+        address.sun_family = AF_UNIX;
+        if (socketPath.native().size() >= sizeof address.sun_path) {
+            throw std::invalid_argument("Socket path too long: " + socketPath.string());
+        }
+        std::memcpy(address.sun_path, socketPath.c_str(), socketPath.native().size() + 1);
+
+        socket = Utils::FileDescriptor(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (socket.get() < 0) {
+            throw makeIoError("socket failed");
+        }
+        if (::connect(socket.get(), reinterpret_cast<const sockaddr*>(&address), sizeof address) != 0) {
+            throw makeIoError("Could not connect to " + socketPath.string());
+        }
+    }
+
+    uint32_t DbClient::queueGet(uint16_t fileIndex, std::span<const std::string_view> keys) {
+        if (keys.size() > std::numeric_limits<uint32_t>::max()) {
+            throw std::invalid_argument("Too many keys");
+        }
+        Protocol::MessageWriter request(output);
+        auto requestOffset = request.tell();
+        auto requestId = nextRequestId++;
+        request.write<uint32_t>(0);  // will be filled in below
+        request.write(Protocol::Opcode::GET);
+        request.write(requestId);
+        request.write(fileIndex);
+        request.write<uint32_t>(keys.size());
+        for (const auto& key : keys) {
+            if (key.size() > std::numeric_limits<Key::SizeType>::max()) {
+                output.resize(requestOffset);
+                throw std::invalid_argument("Key too long");
+            }
+            request.write<Key::SizeType>(key.size());
+            request.write(reinterpret_cast<const std::byte*>(key.data()), key.size());
+        }
+        auto requestSize = request.tell() - requestOffset - sizeof(uint32_t);
+        if (requestSize > Protocol::MAX_REQUEST_SIZE) {
+            output.resize(requestOffset);
+            throw std::invalid_argument("Request too large");
+        }
+        request.writeAt<uint32_t>(requestOffset, requestSize);
+        pendingRequests++;
+        return requestId;
+    }
+
+    bool DbClient::exchange(bool wait) {
+        if (wait) {
+            pollfd event {socket.get(), static_cast<short>(POLLIN | (outputSent < output.size() ? POLLOUT : 0)), 0};
+            while (::poll(&event, 1, -1) < 0) {
+                if (errno != EINTR) {
+                    throw makeIoError("poll failed");
+                }
+            }
+        }
+
+        bool moved = false;
+        while (outputSent < output.size()) {
+            auto sent = ::send(socket.get(), output.data() + outputSent, output.size() - outputSent, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (sent < 0) {
+                throw makeIoError("send failed");
+            }
+            outputSent += sent;
+            moved = true;
+        }
+        if (outputSent == output.size()) {
+            output.clear();
+            outputSent = 0;
+        }
+
+        // the responses returned already make room
+        if (inputOffset == inputSize || inputOffset > input.size() / 2) {
+            std::memmove(input.data(), input.data() + inputOffset, inputSize - inputOffset);
+            inputSize -= inputOffset;
+            inputOffset = 0;
+        }
+        while (true) {
+            input.resize(std::max(input.size(), inputSize + READ_SIZE));
+            auto available = input.size() - inputSize;
+            auto received = ::recv(socket.get(), input.data() + inputSize, available, MSG_DONTWAIT);
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (received < 0) {
+                throw makeIoError("recv failed");
+            }
+            if (received == 0) {
+                throw Exceptions::io_error("The server closed the connection");
+            }
+            inputSize += received;
+            moved = true;
+            if (static_cast<std::size_t>(received) < available) {
+                break;
+            }
+        }
+        return moved;
+    }
+
+    void DbClient::flush() {
+        while (outputSent < output.size()) {
+            exchange(true);
+        }
+    }
+
+    const DbClient::Response& DbClient::receive() {
+        if (pendingRequests == 0) {
+            throw std::logic_error("No request to receive the response to");
+        }
+        auto complete = [this]() {
+            return inputSize - inputOffset >= sizeof(uint32_t)
+                && inputSize - inputOffset - sizeof(uint32_t) >= Utils::read<uint32_t>(input.data() + inputOffset);
+        };
+        // reads what is there before waiting
+        if (!complete()) {
+            exchange(false);
+        }
+        while (!complete()) {
+            exchange(true);
+        }
+
+        auto responseSize = Utils::read<uint32_t>(input.data() + inputOffset);
+        Utils::BasicPayloadReader<true> reader(input.data() + inputOffset + sizeof(uint32_t), responseSize);
+        inputOffset += sizeof(uint32_t) + responseSize;
+        pendingRequests--;
+        response.requestId = reader.read<uint32_t>();
+        response.values.clear();
+        auto status = static_cast<Protocol::Status>(reader.read<uint8_t>());
+        if (status == Protocol::Status::ERROR) {
+            throw std::runtime_error(std::string(reinterpret_cast<const char*>(reader.getAddress()), reader.getRemaining()));
+        }
+        if (status != Protocol::Status::OK) {
+            throw Exceptions::data_corrupted_error("Unknown response status " + std::to_string(static_cast<unsigned>(status)));
+        }
+        auto valueCount = reader.read<uint32_t>();
+        response.values.reserve(std::min<std::size_t>(valueCount, reader.getRemaining() / sizeof(Protocol::Lookup)));
+        for (uint32_t idx = 0; idx < valueCount; idx++) {
+            auto lookup = static_cast<Protocol::Lookup>(reader.read<uint8_t>());
+            if (lookup == Protocol::Lookup::NOT_FOUND) {
+                response.values.emplace_back();
+                continue;
+            }
+            if (lookup != Protocol::Lookup::FOUND) {
+                throw Exceptions::data_corrupted_error("Unknown lookup result " + std::to_string(static_cast<unsigned>(lookup)));
+            }
+            auto valueSize = reader.read<uint32_t>();
+            response.values.emplace_back(std::string_view(reinterpret_cast<const char*>(reader.skip(valueSize)), valueSize));
+        }
+        return response;
+    }
+
+    std::optional<std::string> DbClient::get(uint16_t fileIndex, std::string_view key) {
+        const auto& values = getMany(fileIndex, std::span(&key, 1)).values;
+        if (values.size() != 1) {
+            throw Exceptions::data_corrupted_error("Wrong number of values in the response");
+        }
+        return values[0] ? std::optional<std::string>(*values[0]) : std::nullopt;
+    }
+
+    const DbClient::Response& DbClient::getMany(uint16_t fileIndex, std::span<const std::string_view> keys) {
+        // the responses to the requests queued before
+        while (pendingRequests > 0) {
+            receive();
+        }
+        queueGet(fileIndex, keys);
+        return receive();
+    }
+
+}
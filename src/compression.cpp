@@ -0,0 +1,164 @@
+#include <string>
+
+#if ROFLDB_WITH_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
+
+#include "../include/compression.h"
+#include "../include/exceptions.h"
+
+namespace RoflDb::Utils {
+
+#if ROFLDB_WITH_ZSTD
+
+namespace {
+    void checkZstdResult(std::size_t result, const char* what) {
+        if (ZSTD_isError(result)) [[unlikely]] {
+            throw Exceptions::data_corrupted_error(std::string(what) + ": " + ZSTD_getErrorName(result));
+        }
+    }
+
+    struct ZstdContextDeleter {
+        void operator()(ZSTD_CCtx* context) const {
+            ZSTD_freeCCtx(context);
+        }
+        void operator()(ZSTD_DCtx* context) const {
+            ZSTD_freeDCtx(context);
+        }
+        void operator()(ZSTD_CDict* dictionary) const {
+            ZSTD_freeCDict(dictionary);
+        }
+        void operator()(ZSTD_DDict* dictionary) const {
+            ZSTD_freeDDict(dictionary);
+        }
+    };
+
+    // decompression contexts are not thread-safe, but are costly to create for every block
+    ZSTD_DCtx* getThreadDecompressionContext() {
+        thread_local std::unique_ptr<ZSTD_DCtx, ZstdContextDeleter> context(ZSTD_createDCtx());
+        return context.get();
+    }
+}
+
+    bool isCompressionSupported() {
+        return true;
+    }
+
+    std::vector<std::byte> trainDictionary(std::span<const std::byte> samples, std::span<const std::size_t> sampleSizes,
+                                           std::size_t capacity) {
+        std::vector<std::byte> dictionary(capacity);
+        auto size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), samples.data(), sampleSizes.data(), sampleSizes.size());
+        if (ZDICT_isError(size)) {
+            // not enough samples (or they are too uniform), compressing without a dictionary is fine then
+            return {};
+        }
+        dictionary.resize(size);
+        return dictionary;
+    }
+
+// BlockCompressor =====================================================================================================
+
+    struct BlockCompressor::State {
+        std::unique_ptr<ZSTD_CCtx, ZstdContextDeleter> context;
+        std::unique_ptr<ZSTD_CDict, ZstdContextDeleter> dictionary;
+        int level;
+    };
+
+    BlockCompressor::BlockCompressor(std::span<const std::byte> dictionary, int level)
+        : state(new State {std::unique_ptr<ZSTD_CCtx, ZstdContextDeleter>(ZSTD_createCCtx()), nullptr, level}) {
+        if (!dictionary.empty()) {
+            state->dictionary.reset(ZSTD_createCDict(dictionary.data(), dictionary.size(), level));
+        }
+    }
+
+    BlockCompressor::~BlockCompressor() = default;
+
+    void BlockCompressor::compress(std::span<const std::byte> data, std::vector<std::byte>& output) {
+        output.resize(ZSTD_compressBound(data.size()));
+        std::size_t size;
+        if (state->dictionary) {
+            size = ZSTD_compress_usingCDict(state->context.get(), output.data(), output.size(), data.data(), data.size(), state->dictionary.get());
+        } else {
+            size = ZSTD_compressCCtx(state->context.get(), output.data(), output.size(), data.data(), data.size(), state->level);
+        }
+        checkZstdResult(size, "Could not compress a block");
+        output.resize(size);
+    }
+
+// END BlockCompressor =================================================================================================
+
+
+// BlockDecompressor ===================================================================================================
+
+    struct BlockDecompressor::State {
+        std::unique_ptr<ZSTD_DDict, ZstdContextDeleter> dictionary;
+    };
+
+    BlockDecompressor::BlockDecompressor(std::span<const std::byte> dictionary) : state(new State {}) {
+        if (!dictionary.empty()) {
+            state->dictionary.reset(ZSTD_createDDict(dictionary.data(), dictionary.size()));
+        }
+    }
+
+    BlockDecompressor::~BlockDecompressor() = default;
+
+    void BlockDecompressor::decompress(std::span<const std::byte> data, std::span<std::byte> output) const {
+        auto* context = getThreadDecompressionContext();
+        std::size_t size;
+        if (state->dictionary) {
+            size = ZSTD_decompress_usingDDict(context, output.data(), output.size(), data.data(), data.size(), state->dictionary.get());
+        } else {
+            size = ZSTD_decompressDCtx(context, output.data(), output.size(), data.data(), data.size());
+        }
+        checkZstdResult(size, "Could not decompress a block");
+        if (size != output.size()) [[unlikely]] {
+            throw Exceptions::data_corrupted_error("Decompressed block size mismatch");
+        }
+    }
+
+// END BlockDecompressor ===============================================================================================
+
+#else
+
+namespace {
+    [[noreturn]] void throwUnsupported() {
+        throw Exceptions::unsupported_error("Compressed values are not supported by this build (see ROFLDB_WITH_ZSTD)");
+    }
+}
+
+    bool isCompressionSupported() {
+        return false;
+    }
+
+    std::vector<std::byte> trainDictionary(std::span<const std::byte>, std::span<const std::size_t>, std::size_t) {
+        throwUnsupported();
+    }
+
+    struct BlockCompressor::State {};
+
+    BlockCompressor::BlockCompressor(std::span<const std::byte>, int) {
+        throwUnsupported();
+    }
+
+    BlockCompressor::~BlockCompressor() = default;
+
+    void BlockCompressor::compress(std::span<const std::byte>, std::vector<std::byte>&) {
+        throwUnsupported();
+    }
+
+    struct BlockDecompressor::State {};
+
+    BlockDecompressor::BlockDecompressor(std::span<const std::byte>) {
+        throwUnsupported();
+    }
+
+    BlockDecompressor::~BlockDecompressor() = default;
+
+    void BlockDecompressor::decompress(std::span<const std::byte>, std::span<std::byte>) const {
+        throwUnsupported();
+    }
+
+#endif
+
+}
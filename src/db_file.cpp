@@ -0,0 +1,186 @@
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../include/db_file.h"
+#include "../include/exceptions.h"
+
+namespace RoflDb {
+
+namespace {
+    Exceptions::io_error makeIoError(const std::string& what) {
+        return Exceptions::io_error(what + ": " + std::strerror(errno));
+    }
+
+    std::size_t getPageSize() {
+        static const auto pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        return pageSize;
+    }
+
+    // the pages overlapping `bytes`
+    std::span<const std::byte> alignToPages(std::span<const std::byte> bytes) {
+        auto begin = reinterpret_cast<uintptr_t>(bytes.data()) / getPageSize() * getPageSize();
+        auto end = (reinterpret_cast<uintptr_t>(bytes.data()) + bytes.size() + getPageSize() - 1) / getPageSize() * getPageSize();
+        return {reinterpret_cast<const std::byte*>(begin), end - begin};
+    }
+
+    // faults the pages in, reading a byte of each
+    void touchPages(std::span<const std::byte> bytes) {
+        auto pages = alignToPages(bytes);
+        for (std::size_t offset = 0; offset < pages.size(); offset += getPageSize()) {
+            (void)*static_cast<const volatile std::byte*>(pages.data() + offset);
+        }
+    }
+}
+
+    DbFile::DbFile(const std::filesystem::path& path, Options options)
+        : file(Utils::FileDescriptor::open(path)),
+          size(file.size()) {
+        if (size == 0) {
+            throw Exceptions::magic_error("Empty file " + path.string());
+        }
+        void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE | (options.populate ? MAP_POPULATE : 0), file.get(), 0);
+        if (address == MAP_FAILED) {
+            throw makeIoError("Could not map " + path.string());
+        }
+        data = static_cast<std::byte*>(address);
+
+        try {
+            if (options.advice != Advice::NORMAL) {
+                int advice = options.advice == Advice::RANDOM ? MADV_RANDOM : MADV_WILLNEED;
+                if (::madvise(data, size, advice) != 0) {
+                    throw makeIoError("madvise failed");
+                }
+            }
+            if (options.hugePages) {
+                // fails where transparent huge pages are disabled, which is no reason not to open the file
+                ::madvise(data, size, MADV_HUGEPAGE);
+            }
+
+            reader.emplace(data, size, options.readerOptions);
+            if (options.verify) {
+                reader->verify();
+            }
+
+            if (options.lockTree) {
+                auto treePages = alignToPages(reader->getTreeSection());
+                if (::mlock(treePages.data(), treePages.size()) != 0) {
+                    throw makeIoError("Could not lock the tree of " + path.string());
+                }
+            }
+
+            PageRuns hotPages;
+            if (options.hotPageProfile && std::filesystem::exists(*options.hotPageProfile)) {
+                hotPages = loadHotPageProfile(*options.hotPageProfile);
+            }
+            if (!hotPages.empty() || options.warmupTree) {
+                warmedUp = false;
+                warmupThread = std::jthread([this, hotPages = std::move(hotPages), warmupTree = options.warmupTree](std::stop_token stopToken) {
+                    warmup(stopToken, hotPages, warmupTree);
+                    warmedUp.store(true, std::memory_order_release);
+                    warmedUp.notify_all();
+                });
+            }
+        } catch (...) {
+            ::munmap(data, size);
+            throw;
+        }
+    }
+
+    DbFile::~DbFile() {
+        if (warmupThread.joinable()) {
+            warmupThread.request_stop();
+            warmupThread.join();
+        }
+        reader.reset();
+        // unlocks the tree as well
+        ::munmap(data, size);
+    }
+
+    void DbFile::waitForWarmup() {
+        warmedUp.wait(false, std::memory_order_acquire);
+    }
+
+    void DbFile::warmup(const std::stop_token& stopToken, const PageRuns& hotPages, bool warmupTree) const {
+        // all the reads are queued first, so that the disk gets them at once
+        for (auto [firstPage, pageCount] : hotPages) {
+            ::madvise(data + firstPage * getPageSize(), pageCount * getPageSize(), MADV_WILLNEED);
+        }
+        for (auto [firstPage, pageCount] : hotPages) {
+            if (stopToken.stop_requested()) {
+                return;
+            }
+            touchPages({data + firstPage * getPageSize(), pageCount * getPageSize()});
+        }
+
+        if (!warmupTree) {
+            return;
+        }
+        auto touchNode = [&stopToken](std::span<const std::byte> node) {
+            touchPages(node);
+            return !stopToken.stop_requested();
+        };
+        for (unsigned depth = 0; reader->forEachTreeNodeAtDepth(depth, touchNode); depth++) {}
+    }
+
+    DbFile::PageRuns DbFile::loadHotPageProfile(const std::filesystem::path& path) const {
+        auto profileFile = Utils::FileDescriptor::open(path);
+        Utils::BufferedFileReader profileReader(profileFile.get(), 64 * 1024, 0, profileFile.size());
+        uint64_t fileSize, pageSize, runCount;
+        if (!profileReader.read(fileSize) || !profileReader.read(pageSize) || !profileReader.read(runCount)) {
+            throw Exceptions::data_corrupted_error("Truncated hot page profile " + path.string());
+        }
+        if (fileSize != size || pageSize != getPageSize()) {
+            // recorded for another file (e.g. the previous build of this one), replaying it would only waste I/O
+            return {};
+        }
+
+        auto pageCount = (size + getPageSize() - 1) / getPageSize();
+        PageRuns runs;
+        for (uint64_t idx = 0; idx < runCount; idx++) {
+            uint64_t firstPage, runPageCount;
+            if (!profileReader.read(firstPage) || !profileReader.read(runPageCount)) {
+                throw Exceptions::data_corrupted_error("Truncated hot page profile " + path.string());
+            }
+            if (firstPage > pageCount || runPageCount > pageCount - firstPage) {
+                throw Exceptions::data_corrupted_error("Hot page profile " + path.string() + " is out of bounds");
+            }
+            runs.emplace_back(firstPage, runPageCount);
+        }
+        return runs;
+    }
+
+    void DbFile::saveHotPageProfile(const std::filesystem::path& path) const {
+        auto pageCount = (size + getPageSize() - 1) / getPageSize();
+        std::vector<unsigned char> residency(pageCount);
+        if (::mincore(data, size, residency.data()) != 0) {
+            throw makeIoError("mincore failed");
+        }
+
+        PageRuns runs;
+        for (uint64_t page = 0; page < pageCount; page++) {
+            if (!(residency[page] & 1)) {
+                continue;
+            }
+            if (!runs.empty() && runs.back().first + runs.back().second == page) {
+                runs.back().second++;
+            } else {
+                runs.emplace_back(page, 1);
+            }
+        }
+
+        auto profileFile = Utils::FileDescriptor::create(path);
+        Utils::BufferedFileWriter profileWriter(profileFile.get(), 64 * 1024);
+        profileWriter.write<uint64_t>(size);
+        profileWriter.write<uint64_t>(getPageSize());
+        profileWriter.write<uint64_t>(runs.size());
+        for (auto [firstPage, runPageCount] : runs) {
+            profileWriter.write<uint64_t>(firstPage);
+            profileWriter.write<uint64_t>(runPageCount);
+        }
+        profileWriter.flush();
+    }
+
+}
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/db_handle.h"
+#include "../include/exceptions.h"
+
+namespace RoflDb {
+
+namespace {
+    int membarrier(int command) {
+        return static_cast<int>(syscall(SYS_membarrier, command, 0, 0));
+    }
+
+    // whether `MEMBARRIER_CMD_PRIVATE_EXPEDITED` can be used by this process (registered once)
+    bool registerMembarrier() {
+        static const bool registered = []() {
+            auto commands = membarrier(MEMBARRIER_CMD_QUERY);
+            return commands >= 0 && (commands & MEMBARRIER_CMD_PRIVATE_EXPEDITED) != 0
+                   && membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED) == 0;
+        }();
+        return registered;
+    }
+}
+
+// DbHandle ============================================================================================================
+
+    DbHandle::DbHandle(const std::filesystem::path& path, DbFile::Options fileOptions)
+        : fileOptions(std::move(fileOptions)),
+          asymmetricFences(registerMembarrier()),
+          current(new DbFile(path, this->fileOptions)) {}
+
+    DbHandle::DbHandle(std::unique_ptr<const DbFile> file)
+        : asymmetricFences(registerMembarrier()),
+          current(file.release()) {}
+
+    DbHandle::~DbHandle() {
+        delete current.load(std::memory_order_relaxed);
+    }
+
+    DbHandle::Reader DbHandle::registerReader() {
+        std::lock_guard lock(mutex);
+        auto slot = std::find_if(slots.begin(), slots.end(), [](const auto& slot) { return !slot->registered; });
+        if (slot == slots.end()) {
+            slot = slots.insert(slots.end(), std::make_unique<Slot>());
+        }
+        (*slot)->registered = true;
+        return {this, slot->get()};
+    }
+
+    DbHandle::Reader::~Reader() {
+        if (slot != nullptr) {
+            std::lock_guard lock(handle->mutex);
+            slot->registered = false;
+        }
+    }
+
+    void DbHandle::swap(std::unique_ptr<const DbFile> file) {
+        std::lock_guard lock(mutex);
+        auto previous = current.exchange(file.release(), std::memory_order_acq_rel);
+        // the guards pinning this epoch or a later one read the new file
+        auto swappedAt = epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+        retired.push_back({std::unique_ptr<const DbFile>(previous), swappedAt});
+        collectLocked();
+    }
+
+    void DbHandle::swap(const std::filesystem::path& path) {
+        swap(std::make_unique<const DbFile>(path, fileOptions));
+    }
+
+    std::size_t DbHandle::collect() {
+        std::lock_guard lock(mutex);
+        return collectLocked();
+    }
+
+    std::size_t DbHandle::collectLocked() {
+        if (retired.empty()) {
+            return 0;
+        }
+        // makes the epoch stores of the pinning threads visible here: a thread whose store is not seen yet reads the
+        // current file after this point
+        if (asymmetricFences) {
+            if (membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED) != 0) [[unlikely]] {
+                throw Exceptions::io_error(std::string("membarrier failed: ") + std::strerror(errno));
+            }
+        } else {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        auto oldestPinned = IDLE;
+        for (const auto& slot : slots) {
+            oldestPinned = std::min(oldestPinned, slot->epoch.load(std::memory_order_acquire));
+        }
+        std::erase_if(retired, [oldestPinned](const Retired& file) { return file.epoch <= oldestPinned; });
+        return retired.size();
+    }
+
+// END DbHandle ========================================================================================================
+
+}
@@ -0,0 +1,407 @@
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/exceptions.h"
+#include "../include/file_io.h"
+
+namespace RoflDb::Utils {
+
+    static Exceptions::io_error makeIoError(const std::string& what) {
+        return Exceptions::io_error(what + ": " + std::strerror(errno));
+    }
+
+    // for copying between the files `copy_file_range` does not support
+    static constexpr std::size_t COPY_BUFFER_SIZE = 1024 * 1024;
+
+// FileDescriptor ======================================================================================================
+
+    FileDescriptor& FileDescriptor::operator=(FileDescriptor&& other) noexcept {
+        if (this != &other) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            fd = other.release();
+        }
+        return *this;
+    }
+
+    FileDescriptor::~FileDescriptor() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    FileDescriptor FileDescriptor::create(const std::filesystem::path& path) {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw makeIoError("Could not create " + path.string());
+        }
+        return FileDescriptor(fd);
+    }
+
+    FileDescriptor FileDescriptor::open(const std::filesystem::path& path, bool directIo) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | (directIo ? O_DIRECT : 0));
+        if (fd < 0) {
+            throw makeIoError("Could not open " + path.string());
+        }
+        return FileDescriptor(fd);
+    }
+
+    FileDescriptor FileDescriptor::createTemporary(const std::filesystem::path& directory) {
+        std::string pathTemplate = (directory / "rofldb-XXXXXX").string();
+        int fd = ::mkstemp(pathTemplate.data());
+        if (fd < 0) {
+            throw makeIoError("Could not create temporary file in " + directory.string());
+        }
+        ::unlink(pathTemplate.c_str());
+        return FileDescriptor(fd);
+    }
+
+    FileDescriptor FileDescriptor::createUnique(std::filesystem::path& path) {
+        std::string pathTemplate = path.string() + ".XXXXXX";
+        int fd = ::mkstemp(pathTemplate.data());
+        if (fd < 0) {
+            throw makeIoError("Could not create a file next to " + path.string());
+        }
+        // as `create`, rather than the private mode of `mkstemp`
+        ::fchmod(fd, 0644);
+        path = pathTemplate;
+        return FileDescriptor(fd);
+    }
+
+    uint64_t FileDescriptor::size() const {
+        struct stat64 fileStat {};
+        if (::fstat64(fd, &fileStat) != 0) {
+            throw makeIoError("fstat failed");
+        }
+        return fileStat.st_size;
+    }
+
+    void FileDescriptor::truncate(uint64_t size) const {
+        if (::ftruncate64(fd, static_cast<off64_t>(size)) != 0) {
+            throw makeIoError("ftruncate failed");
+        }
+    }
+
+// END FileDescriptor ==================================================================================================
+
+
+// BufferedFileWriter ==================================================================================================
+
+    BufferedFileWriter::BufferedFileWriter(int fd, std::size_t bufferSize, uint64_t position)
+        : fd(fd), buffer(bufferSize), position(position) {}
+
+    void BufferedFileWriter::write(const std::byte* data, std::size_t size) {
+        if (buffered + size > buffer.size()) {
+            flush();
+            if (size >= buffer.size()) {
+                // too big to be worth copying into the buffer
+                while (size > 0) {
+                    auto written = ::pwrite64(fd, data, size, static_cast<off64_t>(position));
+                    if (written < 0) {
+                        throw makeIoError("write failed");
+                    }
+                    data += written;
+                    size -= written;
+                    position += written;
+                }
+                return;
+            }
+        }
+        std::memcpy(buffer.data() + buffered, data, size);
+        buffered += size;
+        position += size;
+    }
+
+    void BufferedFileWriter::writeAt(uint64_t offset, const std::byte* data, std::size_t size) {
+        flush();
+        while (size > 0) {
+            auto written = ::pwrite64(fd, data, size, static_cast<off64_t>(offset));
+            if (written < 0) {
+                throw makeIoError("write failed");
+            }
+            data += written;
+            size -= written;
+            offset += written;
+        }
+    }
+
+    void BufferedFileWriter::flush() {
+        const std::byte* data = buffer.data();
+        uint64_t offset = position - buffered;
+        while (buffered > 0) {
+            auto written = ::pwrite64(fd, data, buffered, static_cast<off64_t>(offset));
+            if (written < 0) {
+                throw makeIoError("write failed");
+            }
+            data += written;
+            buffered -= written;
+            offset += written;
+        }
+    }
+
+    uint64_t BufferedFileWriter::copyFrom(int fromFd, uint64_t offset, uint64_t size) {
+        flush();
+        auto copied = copyFileRange(fromFd, offset, fd, position, size);
+        position += size;
+        return copied;
+    }
+
+// END BufferedFileWriter ==============================================================================================
+
+
+// BufferedFileReader ==================================================================================================
+
+    BufferedFileReader::BufferedFileReader(int fd, std::size_t bufferSize, uint64_t begin, uint64_t end)
+        : fd(fd), buffer(bufferSize), position(begin), end(end) {}
+
+    bool BufferedFileReader::fill() {
+        auto toRead = static_cast<std::size_t>(std::min<uint64_t>(buffer.size(), end - position));
+        if (toRead == 0) {
+            return false;
+        }
+        auto got = ::pread64(fd, buffer.data(), toRead, static_cast<off64_t>(position));
+        if (got < 0) {
+            throw makeIoError("read failed");
+        } else if (got == 0) {
+            throw Exceptions::io_error("Unexpected end of file");
+        }
+        position += got;
+        bufferPosition = 0;
+        bufferEnd = got;
+        return true;
+    }
+
+    bool BufferedFileReader::read(std::byte* data, std::size_t size) {
+        bool first = true;
+        while (size > 0) {
+            if (bufferPosition == bufferEnd && !fill()) {
+                if (first) {
+                    return false;
+                }
+                throw Exceptions::io_error("Unexpected end of file");
+            }
+            auto chunk = std::min(size, bufferEnd - bufferPosition);
+            std::memcpy(data, buffer.data() + bufferPosition, chunk);
+            bufferPosition += chunk;
+            data += chunk;
+            size -= chunk;
+            first = false;
+        }
+        return true;
+    }
+
+// END BufferedFileReader ==============================================================================================
+
+
+    void* mapShared(int fd, std::size_t size) {
+        void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            throw makeIoError("mmap failed");
+        }
+        return address;
+    }
+
+    void* mapAnonymous(std::size_t size) {
+        void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (address == MAP_FAILED) {
+            throw makeIoError("mmap failed");
+        }
+        return address;
+    }
+
+    void unmap(void* address, std::size_t size) {
+        ::munmap(address, size);
+    }
+
+    std::size_t readAt(int fd, std::byte* data, std::size_t size, uint64_t offset) {
+        std::size_t done = 0;
+        while (done < size) {
+            auto result = ::pread64(fd, data + done, size - done, static_cast<off64_t>(offset + done));
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw makeIoError("pread failed");
+            }
+            if (result == 0) {
+                break;
+            }
+            done += result;
+        }
+        return done;
+    }
+
+    uint64_t copyFileRange(int fromFd, uint64_t fromOffset, int toFd, uint64_t toOffset, uint64_t size) {
+        uint64_t kernelCopied = 0;
+        while (size > 0) {
+            auto from = static_cast<off64_t>(fromOffset);
+            auto to = static_cast<off64_t>(toOffset);
+            auto copied = ::copy_file_range(fromFd, &from, toFd, &to, size, 0);
+            if (copied < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EXDEV && errno != ENOSYS && errno != EOPNOTSUPP && errno != EINVAL) {
+                    throw makeIoError("copy_file_range failed");
+                }
+                break;
+            }
+            if (copied == 0) {
+                throw Exceptions::io_error("copy_file_range: unexpected end of file");
+            }
+            fromOffset += copied;
+            toOffset += copied;
+            size -= copied;
+            kernelCopied += copied;
+        }
+
+        std::vector<std::byte> buffer(std::min<uint64_t>(size, COPY_BUFFER_SIZE));
+        while (size > 0) {
+            auto chunk = std::min<uint64_t>(size, buffer.size());
+            if (readAt(fromFd, buffer.data(), chunk, fromOffset) != chunk) {
+                throw Exceptions::io_error("Unexpected end of file while copying");
+            }
+            const std::byte* data = buffer.data();
+            for (auto left = chunk; left > 0;) {
+                auto written = ::pwrite64(toFd, data, left, static_cast<off64_t>(toOffset));
+                if (written < 0) {
+                    throw makeIoError("write failed");
+                }
+                data += written;
+                left -= written;
+                toOffset += written;
+            }
+            fromOffset += chunk;
+            size -= chunk;
+        }
+        return kernelCopied;
+    }
+
+// IoRing ==============================================================================================================
+
+    IoRing::IoRing(unsigned entries) {
+        io_uring_params params {};
+        int fd = static_cast<int>(::syscall(SYS_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            throw makeIoError("io_uring_setup failed");
+        }
+        ring = FileDescriptor(fd);
+        this->entries = params.sq_entries;
+
+        submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMapping = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMapping) {
+            submissionRingSize = completionRingSize = std::max(submissionRingSize, completionRingSize);
+        }
+        auto map = [fd](std::size_t size, off_t offset) {
+            void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+            if (address == MAP_FAILED) {
+                throw makeIoError("mmap of the io_uring failed");
+            }
+            return address;
+        };
+        try {
+            submissionRing = map(submissionRingSize, IORING_OFF_SQ_RING);
+            completionRing = singleMapping ? submissionRing : map(completionRingSize, IORING_OFF_CQ_RING);
+            submissionEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+            submissionEntries = map(submissionEntriesSize, IORING_OFF_SQES);
+        } catch (...) {
+            unmapRings();
+            throw;
+        }
+
+        auto* submission = static_cast<std::byte*>(submissionRing);
+        submissionTail = reinterpret_cast<unsigned*>(submission + params.sq_off.tail);
+        submissionMask = reinterpret_cast<unsigned*>(submission + params.sq_off.ring_mask);
+        submissionArray = reinterpret_cast<unsigned*>(submission + params.sq_off.array);
+        auto* completion = static_cast<std::byte*>(completionRing);
+        completionHead = reinterpret_cast<unsigned*>(completion + params.cq_off.head);
+        completionTail = reinterpret_cast<unsigned*>(completion + params.cq_off.tail);
+        completionMask = reinterpret_cast<unsigned*>(completion + params.cq_off.ring_mask);
+        completionEntries = completion + params.cq_off.cqes;
+    }
+
+    IoRing::~IoRing() {
+        unmapRings();
+    }
+
+    void IoRing::unmapRings() {
+        if (submissionEntries != nullptr) {
+            ::munmap(submissionEntries, submissionEntriesSize);
+            submissionEntries = nullptr;
+        }
+        if (completionRing != nullptr && completionRing != submissionRing) {
+            ::munmap(completionRing, completionRingSize);
+        }
+        completionRing = nullptr;
+        if (submissionRing != nullptr) {
+            ::munmap(submissionRing, submissionRingSize);
+            submissionRing = nullptr;
+        }
+    }
+
+    bool IoRing::queueRead(int fd, std::byte* data, uint32_t size, uint64_t offset, uint64_t userData) {
+        if (inFlight + queued >= entries) {
+            return false;
+        }
+        // only this thread writes the tail, the kernel reads it once it is submitted
+        auto tail = *submissionTail;
+        auto idx = tail & *submissionMask;
+        auto* entry = static_cast<io_uring_sqe*>(submissionEntries) + idx;
+        *entry = {};
+        entry->opcode = IORING_OP_READ;
+        entry->fd = fd;
+        entry->addr = reinterpret_cast<uint64_t>(data);
+        entry->len = size;
+        entry->off = offset;
+        entry->user_data = userData;
+        submissionArray[idx] = idx;
+        std::atomic_ref(*submissionTail).store(tail + 1, std::memory_order_release);
+        queued++;
+        return true;
+    }
+
+    void IoRing::submitAndReap(unsigned minCompleted, const std::function<void(uint64_t userData, int result)>& callback) {
+        minCompleted = std::min(minCompleted, inFlight + queued);
+        do {
+            if (queued > 0 || minCompleted > 0) {
+                unsigned flags = minCompleted > 0 ? IORING_ENTER_GETEVENTS : 0;
+                auto submitted = ::syscall(SYS_io_uring_enter, ring.get(), queued, minCompleted, flags, nullptr, 0);
+                if (submitted < 0) {
+                    if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                        throw makeIoError("io_uring_enter failed");
+                    }
+                    // the completions are reaped below, which makes room for the submissions
+                    submitted = 0;
+                }
+                queued -= submitted;
+                inFlight += submitted;
+            }
+
+            auto head = *completionHead;
+            auto tail = std::atomic_ref(*completionTail).load(std::memory_order_acquire);
+            for (; head != tail; head++) {
+                const auto* completed = reinterpret_cast<const io_uring_cqe*>(completionEntries) + (head & *completionMask);
+                auto userData = completed->user_data;
+                auto result = completed->res;
+                std::atomic_ref(*completionHead).store(head + 1, std::memory_order_release);
+                inFlight--;
+                minCompleted -= minCompleted > 0;
+                callback(userData, result);
+            }
+        } while (queued > 0 || minCompleted > 0);
+    }
+
+// END IoRing ==========================================================================================================
+
+}
@@ -0,0 +1,71 @@
+#include <unordered_map>
+
+#include "../include/instrumentation.h"
+
+
+namespace RoflDb {
+
+// priv::LookupCounters ================================================================================================
+
+namespace {
+    std::atomic<uint64_t> nextCountersId = 0;
+
+    // only ever written by the thread owning the shard
+    void add(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+}
+
+    priv::LookupCounters::LookupCounters() : id(nextCountersId.fetch_add(1, std::memory_order_relaxed)) {}
+
+    priv::LookupCounters::Shard& priv::LookupCounters::getShard() {
+        // The shards of the counters the thread has counted into. Ids are never reused, so the entries of destroyed
+        // counters are never looked up again.
+        thread_local std::unordered_map<uint64_t, Shard*> threadShards;
+        thread_local uint64_t lastId = UINT64_MAX;
+        thread_local Shard* lastShard = nullptr;
+
+        if (lastId == id) [[likely]] {
+            return *lastShard;
+        }
+        auto& shard = threadShards[id];
+        if (shard == nullptr) {
+            std::lock_guard lock(mutex);
+            shard = shards.emplace_back(std::make_unique<Shard>()).get();
+        }
+        lastId = id;
+        lastShard = shard;
+        return *shard;
+    }
+
+    void priv::LookupCounters::record(const LookupTrace& trace) {
+        auto& shard = getShard();
+        add(shard.lookups, 1);
+        add(shard.hits, trace.hit);
+        add(shard.nodeVisits, trace.nodeVisits);
+        add(shard.keyBytesCompared, trace.keyBytesCompared);
+        add(shard.pagesTouched, trace.pageCount);
+        add(shard.depthHistogram[std::min<unsigned>(trace.depth, LookupStats::MAX_DEPTH)], 1);
+    }
+
+    LookupStats priv::LookupCounters::getStats() const {
+        LookupStats stats;
+        std::lock_guard lock(mutex);
+        for (const auto& shard : shards) {
+            stats.lookups += shard->lookups.load(std::memory_order_relaxed);
+            stats.hits += shard->hits.load(std::memory_order_relaxed);
+            stats.nodeVisits += shard->nodeVisits.load(std::memory_order_relaxed);
+            stats.keyBytesCompared += shard->keyBytesCompared.load(std::memory_order_relaxed);
+            stats.pagesTouched += shard->pagesTouched.load(std::memory_order_relaxed);
+            for (std::size_t depth = 0; depth < stats.depthHistogram.size(); depth++) {
+                stats.depthHistogram[depth] += shard->depthHistogram[depth].load(std::memory_order_relaxed);
+            }
+        }
+        // the snapshot is not atomic, so a lookup may be counted but its hit not yet
+        stats.misses = stats.lookups - std::min(stats.hits, stats.lookups);
+        return stats;
+    }
+
+// END priv::LookupCounters ============================================================================================
+
+}
@@ -0,0 +1,461 @@
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include "../include/exceptions.h"
+#include "../include/layered.h"
+
+namespace RoflDb {
+
+namespace {
+    constexpr uint16_t MANIFEST_VERSION = 0;
+    constexpr std::size_t MANIFEST_BUFFER_SIZE = 64 * 1024;
+
+    // the value of a delta entry: empty for a tombstone
+    std::optional<Value> decodeDeltaEntry(const Value& entry) {
+        if (entry.size() == 0) [[unlikely]] {
+            throw Exceptions::data_corrupted_error("Delta entry without its kind");
+        }
+        switch (static_cast<LayeredDbReader::EntryKind>(entry.get()[0])) {
+            case LayeredDbReader::EntryKind::PUT:
+                return entry.dropPrefix(1);
+            case LayeredDbReader::EntryKind::TOMBSTONE:
+                return std::nullopt;
+        }
+        throw Exceptions::data_corrupted_error("Unknown delta entry kind");
+    }
+}
+
+// LayeredManifest =====================================================================================================
+
+    LayeredManifest LayeredManifest::load(const std::filesystem::path& path) {
+        auto file = Utils::FileDescriptor::open(path);
+        Utils::BufferedFileReader reader(file.get(), MANIFEST_BUFFER_SIZE, 0, file.size());
+        auto truncated = [&path]() {
+            return Exceptions::data_corrupted_error("Truncated layered manifest " + path.string());
+        };
+        auto readString = [&]() {
+            uint16_t size;
+            std::string result;
+            if (!reader.read(size)) {
+                throw truncated();
+            }
+            result.resize(size);
+            if (size > 0 && !reader.read(reinterpret_cast<std::byte*>(result.data()), size)) {
+                throw truncated();
+            }
+            return result;
+        };
+
+        std::byte magic[sizeof MAGIC];
+        if (!reader.read(magic, sizeof magic) || std::memcmp(magic, MAGIC, sizeof MAGIC) != 0) {
+            throw Exceptions::magic_error("Not a layered manifest: " + path.string());
+        }
+        uint16_t version;
+        LayeredManifest manifest;
+        if (!reader.read(version) || !reader.read(manifest.nextFileNumber)) {
+            throw truncated();
+        }
+        if (version != MANIFEST_VERSION) {
+            throw Exceptions::unsupported_error("Unsupported layered manifest version " + std::to_string(version));
+        }
+
+        manifest.basePath = readString();
+        uint32_t deltaCount;
+        if (!reader.read(deltaCount)) {
+            throw truncated();
+        }
+        for (uint32_t idx = 0; idx < deltaCount; idx++) {
+            manifest.deltaPaths.emplace_back(readString());
+        }
+        try {
+            manifest.validate();
+        } catch (const std::invalid_argument& error) {
+            throw Exceptions::data_corrupted_error("Invalid layered manifest " + path.string() + ": " + error.what());
+        }
+        return manifest;
+    }
+
+    void LayeredManifest::save(const std::filesystem::path& path) const {
+        validate();
+        auto temporaryPath = path;
+        temporaryPath += ".tmp";
+        {
+            auto file = Utils::FileDescriptor::create(temporaryPath);
+            Utils::BufferedFileWriter writer(file.get(), MANIFEST_BUFFER_SIZE);
+            auto writeString = [&writer](const std::string& string) {
+                writer.write<uint16_t>(string.size());
+                writer.write(reinterpret_cast<const std::byte*>(string.data()), string.size());
+            };
+
+            writer.write(MAGIC, sizeof MAGIC);
+            writer.write<uint16_t>(MANIFEST_VERSION);
+            writer.write<uint64_t>(nextFileNumber);
+            writeString(basePath.string());
+            writer.write<uint32_t>(deltaPaths.size());
+            for (const auto& deltaPath : deltaPaths) {
+                writeString(deltaPath.string());
+            }
+            writer.flush();
+        }
+        std::filesystem::rename(temporaryPath, path);
+    }
+
+    void LayeredManifest::validate() const {
+        if (deltaPaths.size() > std::numeric_limits<uint32_t>::max()) {
+            throw std::invalid_argument("Delta count must be below 2^32");
+        }
+        auto checkPath = [](const std::filesystem::path& path) {
+            if (path.empty() || path.string().size() > std::numeric_limits<uint16_t>::max()) {
+                throw std::invalid_argument("Invalid layer path " + path.string());
+            }
+        };
+        checkPath(basePath);
+        for (const auto& deltaPath : deltaPaths) {
+            checkPath(deltaPath);
+        }
+    }
+
+// END LayeredManifest =================================================================================================
+
+// LayeredDbReader =====================================================================================================
+
+    LayeredDbReader::LayeredDbReader(const std::filesystem::path& manifestPath, Options options)
+        : options(std::move(options)),
+          manifestPath(manifestPath),
+          manifest(LayeredManifest::load(manifestPath)) {
+        auto initial = std::make_shared<Layers>();
+        initial->base = std::make_shared<const DbFile>(resolve(manifest.basePath), this->options.fileOptions);
+        for (const auto& deltaPath : manifest.deltaPaths) {
+            initial->deltas.push_back(std::make_shared<const DbFile>(resolve(deltaPath), this->options.fileOptions));
+        }
+        layers = std::move(initial);
+    }
+
+    std::filesystem::path LayeredDbReader::resolve(const std::filesystem::path& path) const {
+        return manifestPath.parent_path() / path;
+    }
+
+    std::filesystem::path LayeredDbReader::makeFileName(const char* kind, uint64_t number) const {
+        return manifestPath.stem().string() + "." + kind + "-" + std::to_string(number) + ".rofldb";
+    }
+
+    std::optional<std::optional<Value>> LayeredDbReader::findIn(const Memtable& memtable, const Key& key) {
+        auto entry = memtable.find(std::string_view(reinterpret_cast<const char*>(key.get()), key.size()));
+        if (entry == memtable.end()) {
+            return std::nullopt;
+        }
+        if (!entry->second) {
+            return std::make_optional<std::optional<Value>>();
+        }
+        const auto& value = *entry->second;
+        return std::make_optional<std::optional<Value>>(Value(reinterpret_cast<const std::byte*>(value.data()), value.size(), entry->second));
+    }
+
+    std::optional<Value> LayeredDbReader::get(const Key& key) const {
+        std::shared_ptr<const Layers> current;
+        {
+            std::shared_lock lock(mutex);
+            if (auto entry = findIn(memtable, key)) {
+                return std::move(*entry);
+            }
+            current = layers;
+        }
+        if (current->flushing) {
+            if (auto entry = findIn(*current->flushing, key)) {
+                return std::move(*entry);
+            }
+        }
+        // the file values point into the mappings (or a block cache), which have to outlive them
+        for (auto delta = current->deltas.rbegin(); delta != current->deltas.rend(); ++delta) {
+            if (auto entry = (*delta)->getReader().get(key)) {
+                auto value = decodeDeltaEntry(*entry);
+                if (!value) {
+                    return std::nullopt;
+                }
+                return value->withOwner(current);
+            }
+        }
+        auto value = current->base->getReader().get(key);
+        if (!value) {
+            return std::nullopt;
+        }
+        return value->withOwner(std::move(current));
+    }
+
+    std::optional<Value> LayeredDbReader::get(const std::string& key) const {
+        return get(Key(reinterpret_cast<const std::byte*>(key.data()), key.size()));
+    }
+
+    std::optional<Value> LayeredDbReader::get(uint64_t key) const {
+        std::byte bytes[priv::LearnedTree::KEY_SIZE];
+        priv::LearnedTree::encodeKey(key, bytes);
+        return get(Key(bytes, sizeof bytes));
+    }
+
+    void LayeredDbReader::update(const Key& key, std::shared_ptr<const std::string> value) {
+        // checked now rather than when the memtable is flushed or compacted
+        if (key.size() > DbWriter::MAX_KEY_SIZE) [[unlikely]] {
+            throw std::length_error("Key is too long");
+        }
+        if (options.baseOptions.version == FormatVersion::INTEGER_KEYS && key.size() != priv::LearnedTree::KEY_SIZE) [[unlikely]] {
+            throw std::invalid_argument("Integer keys are 8 bytes long, see DbWriter::put(uint64_t, ...)");
+        }
+        // one byte is taken by the entry kind in the delta
+        if (value && value->size() >= std::numeric_limits<Value::SizeType>::max()) [[unlikely]] {
+            throw std::length_error("Value is too long");
+        }
+
+        std::string keyString(reinterpret_cast<const char*>(key.get()), key.size());
+        auto valueSize = value ? value->size() : 0;
+        bool full;
+        {
+            std::unique_lock lock(mutex);
+            auto [entry, inserted] = memtable.try_emplace(std::move(keyString));
+            if (inserted) {
+                memtableBytes += key.size() + MEMTABLE_ENTRY_OVERHEAD;
+            } else if (entry->second) {
+                memtableBytes -= entry->second->size();
+            }
+            memtableBytes += valueSize;
+            entry->second = std::move(value);
+            full = options.memtableLimit > 0 && memtableBytes >= options.memtableLimit;
+        }
+        if (full) {
+            flush();
+        }
+    }
+
+    void LayeredDbReader::put(const Key& key, const Value& value) {
+        update(key, std::make_shared<const std::string>(reinterpret_cast<const char*>(value.get()), value.size()));
+    }
+
+    void LayeredDbReader::put(std::string_view key, std::string_view value) {
+        update(Key(reinterpret_cast<const std::byte*>(key.data()), key.size()), std::make_shared<const std::string>(value));
+    }
+
+    void LayeredDbReader::remove(const Key& key) {
+        update(key, nullptr);
+    }
+
+    void LayeredDbReader::remove(std::string_view key) {
+        update(Key(reinterpret_cast<const std::byte*>(key.data()), key.size()), nullptr);
+    }
+
+    void LayeredDbReader::flush() {
+        std::size_t deltaCount;
+        {
+            std::lock_guard manifestLock(manifestMutex);
+            std::shared_ptr<const Memtable> flushing;
+            {
+                std::unique_lock lock(mutex);
+                if (memtable.empty()) {
+                    return;
+                }
+                flushing = std::make_shared<const Memtable>(std::move(memtable));
+                memtable.clear();
+                memtableBytes = 0;
+                auto next = std::make_shared<Layers>(*layers);
+                next->flushing = flushing;
+                layers = std::move(next);
+            }
+
+            auto fileName = makeFileName("delta", manifest.nextFileNumber);
+            std::shared_ptr<const DbFile> delta;
+            try {
+                DbWriter writer(resolve(fileName), options.deltaOptions);
+                std::string entry;
+                for (const auto& [key, value] : *flushing) {
+                    entry.assign(1, static_cast<char>(value ? EntryKind::PUT : EntryKind::TOMBSTONE));
+                    if (value) {
+                        entry += *value;
+                    }
+                    writer.put(key, entry);
+                }
+                (void)writer.finish();
+                delta = std::make_shared<const DbFile>(resolve(fileName), options.fileOptions);
+
+                auto updated = manifest;
+                updated.deltaPaths.push_back(fileName);
+                updated.nextFileNumber++;
+                updated.save(manifestPath);
+                manifest = std::move(updated);
+            } catch (...) {
+                // the entries go back to the memtable, below the ones put meanwhile
+                {
+                    std::unique_lock lock(mutex);
+                    for (const auto& [key, value] : *flushing) {
+                        if (memtable.emplace(key, value).second) {
+                            memtableBytes += key.size() + MEMTABLE_ENTRY_OVERHEAD + (value ? value->size() : 0);
+                        }
+                    }
+                    auto next = std::make_shared<Layers>(*layers);
+                    next->flushing = nullptr;
+                    layers = std::move(next);
+                }
+                std::error_code ignored;
+                std::filesystem::remove(resolve(fileName), ignored);
+                throw;
+            }
+
+            std::unique_lock lock(mutex);
+            auto next = std::make_shared<Layers>(*layers);
+            next->deltas.push_back(std::move(delta));
+            next->flushing = nullptr;
+            deltaCount = next->deltas.size();
+            layers = std::move(next);
+        }
+        if (options.compactionDeltaCount > 0 && deltaCount >= options.compactionDeltaCount) {
+            startCompaction();
+        }
+    }
+
+    void LayeredDbReader::compact() {
+        std::lock_guard compactionLock(compactionMutex);
+        std::shared_ptr<const Layers> merged;
+        {
+            std::shared_lock lock(mutex);
+            merged = layers;
+        }
+        if (merged->deltas.empty()) {
+            return;
+        }
+        uint64_t number;
+        {
+            std::lock_guard manifestLock(manifestMutex);
+            number = manifest.nextFileNumber++;
+        }
+
+        auto fileName = makeFileName("base", number);
+        std::shared_ptr<const DbFile> base;
+        try {
+            DbWriter writer(resolve(fileName), options.baseOptions);
+            // the base first, then the deltas from the oldest one, so that the last cursor at a key has the newest entry
+            std::vector<DbReader::Cursor> cursors;
+            cursors.push_back(merged->base->getReader().getCursor());
+            for (const auto& delta : merged->deltas) {
+                cursors.push_back(delta->getReader().getCursor());
+            }
+            for (auto& cursor : cursors) {
+                cursor.seekFirst();
+            }
+            while (true) {
+                std::optional<std::size_t> newest;
+                for (std::size_t idx = 0; idx < cursors.size(); idx++) {
+                    if (cursors[idx].isValid() && (!newest || cursors[idx].getKey() <= cursors[*newest].getKey())) {
+                        newest = idx;
+                    }
+                }
+                if (!newest) {
+                    break;
+                }
+                auto key = cursors[*newest].getKey();
+                if (*newest == 0) {
+                    writer.put(key, cursors[0].getValue());
+                } else if (auto value = decodeDeltaEntry(cursors[*newest].getValue())) {
+                    writer.put(key, *value);
+                }
+                // the older entries of the key are dropped, the newest cursor moves last as it holds the key
+                for (std::size_t idx = 0; idx < *newest; idx++) {
+                    if (cursors[idx].isValid() && cursors[idx].getKey() == key) {
+                        cursors[idx].next();
+                    }
+                }
+                cursors[*newest].next();
+            }
+            (void)writer.finish();
+            base = std::make_shared<const DbFile>(resolve(fileName), options.fileOptions);
+        } catch (...) {
+            std::error_code ignored;
+            std::filesystem::remove(resolve(fileName), ignored);
+            throw;
+        }
+
+        std::vector<std::filesystem::path> replaced;
+        {
+            std::lock_guard manifestLock(manifestMutex);
+            // the deltas are only appended meanwhile, so the merged ones are still the oldest
+            auto mergedCount = static_cast<std::ptrdiff_t>(merged->deltas.size());
+            auto updated = manifest;
+            replaced.assign(updated.deltaPaths.begin(), updated.deltaPaths.begin() + mergedCount);
+            if (updated.basePath.filename().string().starts_with(manifestPath.stem().string() + ".base-")) {
+                replaced.push_back(updated.basePath);
+            }
+            updated.basePath = fileName;
+            updated.deltaPaths.erase(updated.deltaPaths.begin(), updated.deltaPaths.begin() + mergedCount);
+            updated.save(manifestPath);
+            manifest = std::move(updated);
+
+            std::unique_lock lock(mutex);
+            auto next = std::make_shared<Layers>(*layers);
+            next->base = std::move(base);
+            next->deltas.erase(next->deltas.begin(), next->deltas.begin() + mergedCount);
+            layers = std::move(next);
+        }
+        // the mappings stay valid until the last lookup holding the old layers is done
+        for (const auto& path : replaced) {
+            std::error_code ignored;
+            std::filesystem::remove(resolve(path), ignored);
+        }
+    }
+
+    void LayeredDbReader::startCompaction() {
+        std::lock_guard lock(backgroundMutex);
+        if (compactionRunning) {
+            return;
+        }
+        compactionRunning = true;
+        // finished already
+        if (compactionThread.joinable()) {
+            compactionThread.join();
+        }
+        compactionThread = std::jthread([this]() {
+            std::exception_ptr error;
+            try {
+                compact();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::lock_guard lock(backgroundMutex);
+            if (error && !compactionError) {
+                compactionError = error;
+            }
+            compactionRunning = false;
+        });
+    }
+
+    void LayeredDbReader::waitForCompaction() {
+        std::jthread thread;
+        {
+            std::lock_guard lock(backgroundMutex);
+            thread = std::move(compactionThread);
+        }
+        if (thread.joinable()) {
+            thread.join();
+        }
+        std::lock_guard lock(backgroundMutex);
+        if (compactionError) {
+            std::rethrow_exception(std::exchange(compactionError, nullptr));
+        }
+    }
+
+    std::size_t LayeredDbReader::getDeltaCount() const {
+        std::shared_lock lock(mutex);
+        return layers->deltas.size();
+    }
+
+    std::size_t LayeredDbReader::getMemtableBytes() const {
+        std::shared_lock lock(mutex);
+        return memtableBytes;
+    }
+
+    std::filesystem::path LayeredDbReader::getBasePath() const {
+        std::lock_guard lock(manifestMutex);
+        return resolve(manifest.basePath);
+    }
+
+// END LayeredDbReader =================================================================================================
+
+}
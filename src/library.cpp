@@ -1,37 +1,47 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cstring>
 #include <limits>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
 #include <cassert>
 #include <vector>
 
+#include "../include/access_profile.h"
 #include "../include/exceptions.h"
 #include "../include/library.h"
+#include "../include/prefix_search.h"
+#include "../include/value_cache.h"
+#include "../include/verifier.h"
 
 namespace RoflDb {
 
-// Key =================================================================================================================
+// priv::ValueCollection ===============================================================================================
 
-    std::strong_ordering Key::operator<=>(const Key& other) const {
-        int cmpResult = std::memcmp(this->memAddress, other.memAddress, std::min(this->length, other.length));
-        if (cmpResult > 0) [[unlikely]] {
-            return std::strong_ordering::greater;
-        } else if (cmpResult < 0) [[likely]] {
-            return std::strong_ordering::less;
-        } else [[ unlikely ]] {
-            return this->length <=> other.length;
-        }
+    template<bool Checked>
+    Value priv::ValueCollection::getByOffset(ValueOffsetType offset) const {
+        return getPayloadReader<Checked>().template read<Value>(offset);
     }
 
-    bool Key::operator==(const Key& other) const {
-        return this->operator<=>(other) == std::strong_ordering::equal;
+    Value priv::ValueCollection::getByOffsetChecked(ValueOffsetType offset) const {
+        return getByOffset<true>(offset);
     }
 
-// END Key =============================================================================================================
-
+    void priv::ValueCollection::prefetch(ValueOffsetType offset) const {
+        __builtin_prefetch(getPayloadAddress() + offset);
+    }
 
-// priv::ValueCollection ===============================================================================================
+    priv::PendingRead priv::ValueCollection::getPendingRead(ValueOffsetType offset) const {
+        return {getPayloadAddress() + offset, sizeof(Value::SizeType), sizeof(Value::SizeType)};
+    }
 
-    Value priv::ValueCollection::getByOffset(ValueOffsetType offset) const {
-        return getPayloadReader().read<Value>(offset);
+    Utils::PayloadReader priv::ValueCollection::getReaderAt(uint64_t offset) const {
+        auto payloadReader = getPayloadReader();
+        payloadReader.skip(offset);
+        return payloadReader;
     }
 
 // END priv::ValueCollection ===========================================================================================
@@ -39,22 +49,28 @@ namespace RoflDb {
 
 // priv::Tree::Node ====================================================================================================
 
+    template<bool Checked>
     std::optional<priv::Tree::Node::Match> priv::Tree::Node::match(const Key& searchKey) const {
-        auto payloadReader = getPayloadReader();
+        ROFLDB_TRACE(visitNode(this, sizeof(SizeType) + getSize(), true));
+        auto payloadReader = getPayloadReader<Checked>();
 
-        auto nodeKey = payloadReader.read<Key>();
+        auto nodeKey = payloadReader.template read<Key>();
         auto keyCompareResult = searchKey.operator<=>(nodeKey);
+        ROFLDB_TRACE(compareKeys(searchKey, nodeKey));
 
-        auto valueOffset = payloadReader.read<ValueCollection::ValueOffsetType>();
+        auto valueOffset = payloadReader.template read<ValueCollection::ValueOffsetType>();
         if (keyCompareResult == std::strong_ordering::equal) [[unlikely]] {
             return ValueMatch(valueOffset);
         }
+        if (ValueCollection::isInline(valueOffset)) {
+            payloadReader.skip(Utils::getReadSize<Value>(payloadReader.getAddress()));
+        }
 
         // left
         if (!payloadReader) [[unlikely]] {
             return std::nullopt;
         }
-        auto leftOffset = payloadReader.read<Node::OffsetType>();
+        auto leftOffset = payloadReader.template read<Node::OffsetType>();
         if (keyCompareResult == std::strong_ordering::less) {
             return DropDownMatch(leftOffset);
         }
@@ -63,22 +79,54 @@ namespace RoflDb {
         if (!payloadReader) {
             return std::nullopt;
         }
-        auto rightOffset = payloadReader.read<Node::OffsetType>();
+        auto rightOffset = payloadReader.template read<Node::OffsetType>();
         return DropDownMatch(rightOffset);
     }
 
+    template<bool Checked>
+    Key priv::Tree::Node::getKey() const {
+        return getPayloadReader<Checked>().template read<Key>();
+    }
+
+    template<bool Checked>
+    priv::ValueCollection::ValueOffsetType priv::Tree::Node::getValueOffset() const {
+        auto payloadReader = getPayloadReader<Checked>();
+        payloadReader.skip(Utils::getReadSize<Key>(payloadReader.getAddress()));
+        return payloadReader.template read<ValueCollection::ValueOffsetType>();
+    }
+
+    priv::Tree::Node::OffsetType priv::Tree::Node::getChildOffset(bool greater) const {
+        auto payloadReader = getPayloadReader();
+        payloadReader.skip(Utils::getReadSize<Key>(payloadReader.getAddress()));
+        if (ValueCollection::isInline(payloadReader.read<ValueCollection::ValueOffsetType>())) {
+            payloadReader.skip(Utils::getReadSize<Value>(payloadReader.getAddress()));
+        }
+        if (!payloadReader) {
+            return 0;
+        }
+        auto leftOffset = payloadReader.read<Node::OffsetType>();
+        if (!greater) {
+            return leftOffset;
+        }
+        if (!payloadReader) {
+            return 0;
+        }
+        return payloadReader.read<Node::OffsetType>();
+    }
+
 // END priv::Tree::Node ================================================================================================
 
 
 // priv::Tree ==========================================================================================================
 
+    template<bool Checked>
     std::optional<priv::ValueCollection::ValueOffsetType> priv::Tree::get(const Key& key) const {
-        std::optional<Node::OffsetType> offset = getPayloadReader().read<Node::OffsetType>();
+        std::optional<Node::OffsetType> offset = getPayloadReader<Checked>().template read<Node::OffsetType>();
         if (offset == 0) {
             // empty tree
             return std::nullopt;
         }
-        while (auto optionalMatch = getPayloadReader().read<const Node*>(*offset)->match(key)) [[likely]] {
+        while (auto optionalMatch = getPayloadReader<Checked>().template read<const Node*>(*offset)->template match<Checked>(key)) [[likely]] {
             auto match = optionalMatch.value();
             if (holds_alternative<Node::ValueMatch>(match)) {
                 return std::get<Node::ValueMatch>(match).valueOffset;
@@ -88,38 +136,2278 @@ namespace RoflDb {
         return std::nullopt;
     }
 
+    template<bool Checked>
+    priv::Tree::Search priv::Tree::startSearch() const {
+        Search search {getPayloadReader<Checked>().template read<Node::OffsetType>(), std::nullopt};
+        __builtin_prefetch(getPayloadAddress() + search.nodeOffset);
+        return search;
+    }
+
+    template<bool Checked>
+    void priv::Tree::advance(Search& search, const Key& key) const {
+        auto optionalMatch = getPayloadReader<Checked>().template read<const Node*>(search.nodeOffset)->template match<Checked>(key);
+        search.nodeOffset = 0;
+        if (!optionalMatch) {
+            return;
+        }
+        auto match = optionalMatch.value();
+        if (holds_alternative<Node::ValueMatch>(match)) {
+            search.valueOffset = std::get<Node::ValueMatch>(match).valueOffset;
+            return;
+        }
+        search.nodeOffset = std::get<Node::DropDownMatch>(match).nodeOffset;
+        // nodes are usually spread over two cache lines
+        __builtin_prefetch(getPayloadAddress() + search.nodeOffset);
+        __builtin_prefetch(getPayloadAddress() + search.nodeOffset + 64);
+    }
+
+    priv::PendingRead priv::Tree::getPendingRead(const Search& search) const {
+        return {getPayloadAddress() + search.nodeOffset, sizeof(Node::SizeType), sizeof(Node::SizeType)};
+    }
+
+    // the checked steps are also run by `PagedDbFile`
+    template priv::Tree::Search priv::Tree::startSearch<true>() const;
+    template void priv::Tree::advance<true>(Search& search, const Key& key) const;
+
+    priv::Tree::Position priv::Tree::first() const {
+        auto rootOffset = getPayloadReader().read<Node::OffsetType>();
+        // the first node directly follows the root offset
+        return rootOffset == 0 ? 0 : sizeof(Node::OffsetType);
+    }
+
+    priv::Tree::Position priv::Tree::last() const {
+        return lastFrom(getPayloadReader().read<Node::OffsetType>());
+    }
+
+    priv::Tree::Position priv::Tree::seekGE(const Key& key) const {
+        return seekGEFrom(getPayloadReader().read<Node::OffsetType>(), key);
+    }
+
+    priv::Tree::Position priv::Tree::seekLT(const Key& key) const {
+        return seekLTFrom(getPayloadReader().read<Node::OffsetType>(), key);
+    }
+
+    priv::Tree::Position priv::Tree::lastFrom(Node::OffsetType rootOffset) const {
+        auto offset = rootOffset;
+        if (offset == 0) {
+            return 0;
+        }
+        while (auto rightOffset = getPayloadReader().read<const Node*>(offset)->getChildOffset(true)) {
+            offset = rightOffset;
+        }
+        return offset;
+    }
+
+    priv::Tree::Position priv::Tree::seekGEFrom(Node::OffsetType rootOffset, const Key& key) const {
+        Position result = 0;
+        auto offset = rootOffset;
+        while (offset != 0) {
+            const auto* node = getPayloadReader().read<const Node*>(offset);
+            auto keyCompareResult = node->getKey().operator<=>(key);
+            if (keyCompareResult == std::strong_ordering::less) {
+                offset = node->getChildOffset(true);
+                continue;
+            }
+            result = offset;
+            if (keyCompareResult == std::strong_ordering::equal) {
+                break;
+            }
+            offset = node->getChildOffset(false);
+        }
+        return result;
+    }
+
+    priv::Tree::Position priv::Tree::seekLTFrom(Node::OffsetType rootOffset, const Key& key) const {
+        Position result = 0;
+        auto offset = rootOffset;
+        while (offset != 0) {
+            const auto* node = getPayloadReader().read<const Node*>(offset);
+            if (node->getKey() < key) {
+                result = offset;
+                offset = node->getChildOffset(true);
+            } else {
+                offset = node->getChildOffset(false);
+            }
+        }
+        return result;
+    }
+
+    priv::Tree::Position priv::Tree::next(Position position) const {
+        auto nodeSize = getPayloadReader().read<const Node*>(position)->getSize();
+        uint64_t nextPosition = uint64_t(position) + sizeof(Node::SizeType) + nodeSize;
+        return nextPosition < getSize() ? static_cast<Position>(nextPosition) : 0;
+    }
+
+    priv::Tree::Position priv::Tree::prev(Position position) const {
+        return seekLT(getPayloadReader().read<const Node*>(position)->getKey());
+    }
+
+    priv::Tree::Position priv::Tree::prev(Position position, Path& path) const {
+        return prevFrom(getPayloadReader().read<Node::OffsetType>(), position, path);
+    }
+
+    priv::Tree::Position priv::Tree::prevFrom(Node::OffsetType rootOffset, Position position, Path& path) const {
+        const auto* node = getPayloadReader().read<const Node*>(position);
+        if (path.empty()) {
+            auto key = node->getKey();
+            for (auto offset = rootOffset; offset != position;) {
+                if (offset == 0) [[unlikely]] {
+                    throw Exceptions::data_corrupted_error("Tree node not found from the root");
+                }
+                path.push_back(offset);
+                const auto* ancestor = getPayloadReader().read<const Node*>(offset);
+                offset = ancestor->getChildOffset(ancestor->getKey() < key);
+            }
+        }
+
+        // the greatest node of the left subtree
+        if (auto offset = node->getChildOffset(false)) {
+            path.push_back(position);
+            while (auto rightOffset = getPayloadReader().read<const Node*>(offset)->getChildOffset(true)) {
+                path.push_back(offset);
+                offset = rightOffset;
+            }
+            return offset;
+        }
+        // else the closest ancestor whose right subtree the position is in
+        auto childOffset = position;
+        while (!path.empty()) {
+            auto offset = path.back();
+            path.pop_back();
+            if (getPayloadReader().read<const Node*>(offset)->getChildOffset(true) == childOffset) {
+                return offset;
+            }
+            childOffset = offset;
+        }
+        return 0;
+    }
+
+    Key priv::Tree::getKey(Position position, KeyBuffer&) const {
+        return getPayloadReader().read<const Node*>(position)->getKey();
+    }
+
+    template<bool Checked>
+    bool priv::Tree::hasKeyAt(Position position, const Key& key) const {
+        const auto* node = getPayloadReader<Checked>().template read<const Node*>(position);
+        ROFLDB_TRACE(visitNode(node, sizeof(Node::SizeType) + node->getSize(), false));
+        ROFLDB_TRACE(compareKeys(key, node->template getKey<Checked>()));
+        return node->template getKey<Checked>() == key;
+    }
+
+    template<bool Checked>
+    priv::ValueCollection::ValueOffsetType priv::Tree::getValueOffset(Position position) const {
+        return getPayloadReader<Checked>().template read<const Node*>(position)->template getValueOffset<Checked>();
+    }
+
+    bool priv::Tree::forEachNodeAtDepth(unsigned depth, const NodeCallback& callback) const {
+        bool visited = false;
+        bool stopped = false;
+        auto visit = [&](auto& visit, Node::OffsetType offset, unsigned nodeDepth) -> void {
+            if (offset == 0 || stopped) {
+                return;
+            }
+            const auto* node = getPayloadReader().read<const Node*>(offset);
+            if (nodeDepth == depth) {
+                visited = true;
+                stopped = !callback({reinterpret_cast<const std::byte*>(node), sizeof(Node::SizeType) + node->getSize()});
+                return;
+            }
+            visit(visit, node->getChildOffset(false), nodeDepth + 1);
+            visit(visit, node->getChildOffset(true), nodeDepth + 1);
+        };
+        visit(visit, getPayloadReader().read<Node::OffsetType>(), 0);
+        return visited && !stopped;
+    }
+
+    template<class IsChild>
+    const priv::Tree::Node* priv::Tree::verifyNode(const Verifier& verifier, Node::OffsetType nodeOffset, IsChild&& isChild) const {
+        const auto* payload = getPayloadAddress();
+        const auto* node = reinterpret_cast<const Node*>(payload + nodeOffset);
+        uint64_t nodeSize = node->getSize();
+        const auto* nodePayload = payload + nodeOffset + sizeof(Node::SizeType);
+        Verifier::require(nodeSize >= sizeof(Key::SizeType), "Tree key out of bounds");
+        uint64_t keySize = Utils::read<Key::SizeType>(nodePayload);
+        Verifier::require(nodeSize >= sizeof(Key::SizeType) + keySize + sizeof(ValueCollection::ValueOffsetType), "Tree key out of bounds");
+        auto childrenSize = nodeSize - sizeof(Key::SizeType) - keySize - sizeof(ValueCollection::ValueOffsetType);
+        if (ValueCollection::isInline(node->getValueOffset<false>())) {
+            Verifier::require(childrenSize >= sizeof(Value::SizeType), "Tree value out of bounds");
+            uint64_t valueSize = Utils::read<Value::SizeType>(nodePayload + nodeSize - childrenSize);
+            Verifier::require(childrenSize - sizeof(Value::SizeType) >= valueSize, "Tree value out of bounds");
+            childrenSize -= sizeof(Value::SizeType) + valueSize;
+        }
+        Verifier::require(childrenSize == 0 || childrenSize == sizeof(Node::OffsetType) || childrenSize == 2 * sizeof(Node::OffsetType), "Invalid tree node size");
+        verifier.checkValueOffset(node->getValueOffset<false>());
+        for (auto childOffset = childrenSize; childOffset > 0; childOffset -= sizeof(Node::OffsetType)) {
+            Verifier::require(isChild(Utils::read<Node::OffsetType>(nodePayload + nodeSize - childOffset)), "Tree child is not a node");
+        }
+        return node;
+    }
+
+    priv::PositionCheck priv::Tree::verify(const Verifier& verifier) const {
+        Verifier::require(getSize() >= sizeof(Node::OffsetType), "Tree out of bounds");
+        // the nodes follow the root offset
+        return verifyFrom(verifier, sizeof(Node::OffsetType), Utils::read<Node::OffsetType>(getPayloadAddress()));
+    }
+
+    priv::PositionCheck priv::Tree::verifyFrom(const Verifier& verifier, uint64_t nodesOffset, Node::OffsetType rootOffset) const {
+        uint64_t size = getSize();
+        const auto* payload = getPayloadAddress();
+
+        // The nodes follow one another in key order up to the end of the tree.
+        std::vector<Node::OffsetType> nodeOffsets;
+        for (uint64_t offset = nodesOffset; offset < size;) {
+            Verifier::require(size - offset >= sizeof(Node::SizeType), "Tree node out of bounds");
+            auto nodeSize = Utils::read<Node::SizeType>(payload + offset);
+            Verifier::require(size - offset - sizeof(Node::SizeType) >= nodeSize, "Tree node out of bounds");
+            nodeOffsets.push_back(static_cast<Node::OffsetType>(offset));
+            offset += sizeof(Node::SizeType) + nodeSize;
+        }
+        if (rootOffset == 0) {
+            Verifier::require(nodeOffsets.empty(), "Nodes in an empty tree");
+            return [](uint64_t) { return false; };
+        }
+        auto isNode = [&nodeOffsets](uint64_t offset) {
+            return std::binary_search(nodeOffsets.begin(), nodeOffsets.end(), offset);
+        };
+        Verifier::require(isNode(rootOffset), "Tree root is not a node");
+
+        // every node on its own, and its key against the key of the next node
+        verifier.parallelFor(nodeOffsets.size(), [&](uint64_t begin, uint64_t end) {
+            for (auto idx = begin; idx < end; idx++) {
+                const auto* node = verifyNode(verifier, nodeOffsets[idx], isNode);
+                if (idx + 1 < nodeOffsets.size()) {
+                    auto nextKey = reinterpret_cast<const Node*>(payload + nodeOffsets[idx + 1])->getKey<false>();
+                    Verifier::require(node->getKey<false>() < nextKey, "Tree keys out of order");
+                }
+            }
+        });
+
+        // As the nodes are in key order, a child has to be within the offsets range of its subtree: the lookups end and
+        // every node is reached once. The walk is split into subtrees for the threads.
+        struct Subtree {
+            Node::OffsetType offset;
+            // exclusive bounds of the node offsets
+            uint64_t lo;
+            uint64_t hi;
+        };
+        auto visit = [&](const Subtree& subtree, auto&& push) {
+            Verifier::require(subtree.lo < subtree.offset && subtree.offset < subtree.hi, "Tree keys out of order");
+            const auto* node = reinterpret_cast<const Node*>(payload + subtree.offset);
+            if (auto left = node->getChildOffset(false)) {
+                push(Subtree {left, subtree.lo, subtree.offset});
+            }
+            if (auto right = node->getChildOffset(true)) {
+                push(Subtree {right, subtree.offset, subtree.hi});
+            }
+        };
+        // subtrees handed to the threads
+        constexpr std::size_t SUBTREE_COUNT = 1024;
+        std::vector<Subtree> frontier {{rootOffset, 0, size}};
+        uint64_t visited = 0;
+        while (!frontier.empty() && frontier.size() < SUBTREE_COUNT) {
+            std::vector<Subtree> level;
+            for (const auto& subtree : frontier) {
+                visit(subtree, [&level](const Subtree& child) { level.push_back(child); });
+                visited++;
+            }
+            frontier = std::move(level);
+        }
+        std::atomic<uint64_t> subtreeVisited = 0;
+        verifier.parallelFor(frontier.size(), [&](uint64_t begin, uint64_t end) {
+            std::vector<Subtree> stack(frontier.begin() + static_cast<std::ptrdiff_t>(begin), frontier.begin() + static_cast<std::ptrdiff_t>(end));
+            uint64_t count = 0;
+            while (!stack.empty()) {
+                auto subtree = stack.back();
+                stack.pop_back();
+                visit(subtree, [&stack](const Subtree& child) { stack.push_back(child); });
+                count++;
+            }
+            subtreeVisited += count;
+        }, 1);
+        Verifier::require(visited + subtreeVisited == nodeOffsets.size(), "Tree nodes not reachable from the root");
+
+        return [nodeOffsets = std::move(nodeOffsets)](uint64_t packedPosition) {
+            return std::binary_search(nodeOffsets.begin(), nodeOffsets.end(), packedPosition);
+        };
+    }
+
 // END priv::Tree ======================================================================================================
 
 
-DbReader::DbReader(std::byte* memAddress, std::size_t memLength) {
-    Utils::PayloadReader payloadReader(memAddress, memLength);
-    if (std::memcmp(payloadReader.skip(sizeof MAGIC), MAGIC, sizeof MAGIC) != 0) {
-        throw Exceptions::magic_error("Invalid file magic");
+// priv::HotTree =======================================================================================================
+
+    priv::Tree::Node::OffsetType priv::HotTree::getOrderedRoot() const {
+        return getPayloadReader().read<Node::OffsetType>(sizeof(Node::OffsetType));
     }
 
-    auto version = payloadReader.read<uint16_t>();
-    if (version != 0) [[unlikely]] {
-        throw Exceptions::magic_error("Invalid format version");
+    priv::HotTree::Position priv::HotTree::first() const {
+        auto payloadReader = getPayloadReader();
+        auto orderedRoot = payloadReader.read<Node::OffsetType>(sizeof(Node::OffsetType));
+        // the offset of the first node in key order
+        return orderedRoot == 0 ? 0 : payloadReader.read<Node::OffsetType>();
     }
 
-    valueCollection = payloadReader.read<const priv::ValueCollection*>();
-    tree = payloadReader.read<const priv::Tree*>();
-}
+    priv::HotTree::Position priv::HotTree::last() const {
+        return lastFrom(getOrderedRoot());
+    }
 
-std::optional<Value> DbReader::get(const Key& key) const {
-    auto offset = tree->get(key);
-    if (!offset.has_value()) [[unlikely]] {
+    priv::HotTree::Position priv::HotTree::seekGE(const Key& key) const {
+        return seekGEFrom(getOrderedRoot(), key);
+    }
+
+    priv::HotTree::Position priv::HotTree::seekLT(const Key& key) const {
+        return seekLTFrom(getOrderedRoot(), key);
+    }
+
+    priv::HotTree::Position priv::HotTree::prev(Position position) const {
+        return seekLT(getPayloadReader().read<const Node*>(position)->getKey());
+    }
+
+    priv::HotTree::Position priv::HotTree::prev(Position position, Path& path) const {
+        return prevFrom(getOrderedRoot(), position, path);
+    }
+
+    priv::PositionCheck priv::HotTree::verify(const Verifier& verifier) const {
+        uint64_t size = getSize();
+        Verifier::require(size >= HEADER_SIZE, "Tree out of bounds");
+        const auto* payload = getPayloadAddress();
+        auto rootOffset = Utils::read<Node::OffsetType>(payload);
+        auto orderedRoot = Utils::read<Node::OffsetType>(payload + sizeof(Node::OffsetType));
+        uint64_t orderedOffset = Utils::read<Node::OffsetType>(payload + 2 * sizeof(Node::OffsetType));
+        Verifier::require(HEADER_SIZE <= orderedOffset && orderedOffset <= size, "Tree out of bounds");
+        auto isOrderedNode = verifyFrom(verifier, orderedOffset, orderedRoot);
+
+        std::vector<Node::OffsetType> hotOffsets;
+        for (uint64_t offset = HEADER_SIZE; offset < orderedOffset;) {
+            Verifier::require(orderedOffset - offset >= sizeof(Node::SizeType), "Tree node out of bounds");
+            auto nodeSize = Utils::read<Node::SizeType>(payload + offset);
+            Verifier::require(orderedOffset - offset - sizeof(Node::SizeType) >= nodeSize, "Tree node out of bounds");
+            hotOffsets.push_back(static_cast<Node::OffsetType>(offset));
+            offset += sizeof(Node::SizeType) + nodeSize;
+        }
+        Verifier::require(orderedRoot != 0 || hotOffsets.empty(), "Nodes in an empty tree");
+        auto isHotNode = [&hotOffsets](uint64_t offset) {
+            return std::binary_search(hotOffsets.begin(), hotOffsets.end(), offset);
+        };
+        Verifier::require(rootOffset == orderedRoot || isHotNode(rootOffset), "Tree root is not a node");
+
+        // A hot copy comes before its hot children, so the lookups go forward through the copies and end up in the
+        // nodes in key order (or end).
+        verifier.parallelFor(hotOffsets.size(), [&](uint64_t begin, uint64_t end) {
+            for (auto idx = begin; idx < end; idx++) {
+                auto offset = hotOffsets[idx];
+                (void) verifyNode(verifier, offset, [&](Node::OffsetType childOffset) {
+                    return (childOffset > offset && isHotNode(childOffset)) || isOrderedNode(childOffset);
+                });
+            }
+        });
+        return isOrderedNode;
+    }
+
+// END priv::HotTree ===================================================================================================
+
+
+// priv::EytzingerTree =================================================================================================
+
+    template<bool Checked>
+    std::optional<priv::ValueCollection::ValueOffsetType> priv::EytzingerTree::get(const Key& key) const {
+        auto payloadReader = getPayloadReader<Checked>();
+        uint64_t count = payloadReader.template read<CountType>();
+        const auto* nodeOffsets = payloadReader.getAddress();
+
+        uint64_t k = 1;
+        while (k <= count) [[likely]] {
+            // offsets of the descendants four levels down share a single cache line
+            __builtin_prefetch(nodeOffsets + 16 * k * sizeof(NodeOffsetType));
+
+            auto nodeOffset = Utils::BasicPayloadReader<Checked>(payloadReader).template read<NodeOffsetType>((k - 1) * sizeof(NodeOffsetType));
+            auto nodeReader = getPayloadReader<Checked>();
+            auto nodeKey = nodeReader.template read<Key>(nodeOffset);
+            auto keyCompareResult = key.operator<=>(nodeKey);
+            ROFLDB_TRACE(touch(nodeOffsets + (k - 1) * sizeof(NodeOffsetType), sizeof(NodeOffsetType)));
+            ROFLDB_TRACE(visitNode(getPayloadAddress() + nodeOffset, Utils::getReadSize<Key>(getPayloadAddress() + nodeOffset) + sizeof(ValueCollection::ValueOffsetType), true));
+            ROFLDB_TRACE(compareKeys(key, nodeKey));
+            if (keyCompareResult == std::strong_ordering::equal) [[unlikely]] {
+                return nodeReader.template read<ValueCollection::ValueOffsetType>();
+            }
+            k = 2 * k + (keyCompareResult == std::strong_ordering::greater);
+        }
         return std::nullopt;
     }
-    return valueCollection->getByOffset(*offset);
-}
 
-std::optional<Value> DbReader::get(const std::string& key) const {
-    return get(Key((std::byte*)key.c_str(), key.size()));
-}
+    template<bool Checked>
+    priv::EytzingerTree::Search priv::EytzingerTree::startSearch() const {
+        Search search {getPayloadReader<Checked>().template read<CountType>() > 0 ? 1u : 0u, 0, std::nullopt};
+        __builtin_prefetch(getPayloadAddress() + sizeof(CountType));
+        return search;
+    }
 
-std::optional<Value> DbReader::get(const std::vector<std::byte>& key) const {
-    return get(Key(key.data(), key.size()));
-}
+    template<bool Checked>
+    void priv::EytzingerTree::advance(Search& search, const Key& key) const {
+        auto payloadReader = getPayloadReader<Checked>();
+        uint64_t count = payloadReader.template read<CountType>();
+
+        if (search.nodeOffset == 0) {
+            // first half of the visit: the offsets table entry has arrived, start loading the node itself
+            search.nodeOffset = payloadReader.template read<NodeOffsetType>((search.k - 1) * sizeof(NodeOffsetType));
+            ROFLDB_TRACE(touch(payloadReader.getAddress() + (search.k - 1) * sizeof(NodeOffsetType), sizeof(NodeOffsetType)));
+            __builtin_prefetch(getPayloadAddress() + search.nodeOffset);
+            return;
+        }
+
+        auto nodeReader = getPayloadReader<Checked>();
+        auto nodeKey = nodeReader.template read<Key>(search.nodeOffset);
+        auto keyCompareResult = key.operator<=>(nodeKey);
+        ROFLDB_TRACE(visitNode(getPayloadAddress() + search.nodeOffset, Utils::getReadSize<Key>(getPayloadAddress() + search.nodeOffset) + sizeof(ValueCollection::ValueOffsetType), true));
+        ROFLDB_TRACE(compareKeys(key, nodeKey));
+        if (keyCompareResult == std::strong_ordering::equal) [[unlikely]] {
+            search.valueOffset = nodeReader.template read<ValueCollection::ValueOffsetType>();
+            search.k = 0;
+            return;
+        }
+
+        search.k = 2 * search.k + (keyCompareResult == std::strong_ordering::greater);
+        search.nodeOffset = 0;
+        if (search.k > count) {
+            search.k = 0;
+            return;
+        }
+        __builtin_prefetch(payloadReader.getAddress() + (search.k - 1) * sizeof(NodeOffsetType));
+    }
+
+    priv::PendingRead priv::EytzingerTree::getPendingRead(const Search& search) const {
+        if (search.nodeOffset == 0) {
+            return {getPayloadAddress() + sizeof(CountType) + (search.k - 1) * sizeof(NodeOffsetType), sizeof(NodeOffsetType)};
+        }
+        // the key and the value offset following it
+        return {getPayloadAddress() + search.nodeOffset, sizeof(Key::SizeType) + sizeof(ValueCollection::ValueOffsetType), sizeof(Key::SizeType)};
+    }
+
+    // the checked steps are also run by `PagedDbFile`
+    template priv::EytzingerTree::Search priv::EytzingerTree::startSearch<true>() const;
+    template void priv::EytzingerTree::advance<true>(Search& search, const Key& key) const;
+
+    uint64_t priv::EytzingerTree::getCount() const {
+        return getPayloadReader().read<CountType>();
+    }
+
+    template<bool Checked>
+    Utils::BasicPayloadReader<Checked> priv::EytzingerTree::getNodeReader(Position position) const {
+        auto payloadReader = getPayloadReader<Checked>();
+        auto nodeOffset = payloadReader.template read<NodeOffsetType>(sizeof(CountType) + (position - 1) * sizeof(NodeOffsetType));
+        auto nodeReader = getPayloadReader<Checked>();
+        nodeReader.skip(nodeOffset);
+        return nodeReader;
+    }
+
+    priv::EytzingerTree::Position priv::EytzingerTree::first() const {
+        auto count = getCount();
+        if (count == 0) {
+            return 0;
+        }
+        Position k = 1;
+        while (2 * k <= count) {
+            k = 2 * k;
+        }
+        return k;
+    }
+
+    priv::EytzingerTree::Position priv::EytzingerTree::last() const {
+        auto count = getCount();
+        if (count == 0) {
+            return 0;
+        }
+        Position k = 1;
+        while (2 * k + 1 <= count) {
+            k = 2 * k + 1;
+        }
+        return k;
+    }
+
+    priv::EytzingerTree::Position priv::EytzingerTree::seekGE(const Key& key) const {
+        auto count = getCount();
+        Position result = 0;
+        Position k = 1;
+        while (k <= count) {
+            auto keyCompareResult = getNodeReader(k).read<Key>().operator<=>(key);
+            if (keyCompareResult == std::strong_ordering::less) {
+                k = 2 * k + 1;
+                continue;
+            }
+            result = k;
+            if (keyCompareResult == std::strong_ordering::equal) {
+                break;
+            }
+            k = 2 * k;
+        }
+        return result;
+    }
+
+    priv::EytzingerTree::Position priv::EytzingerTree::seekLT(const Key& key) const {
+        auto count = getCount();
+        Position result = 0;
+        Position k = 1;
+        while (k <= count) {
+            if (getNodeReader(k).read<Key>() < key) {
+                result = k;
+                k = 2 * k + 1;
+            } else {
+                k = 2 * k;
+            }
+        }
+        return result;
+    }
+
+    priv::EytzingerTree::Position priv::EytzingerTree::next(Position position) const {
+        auto count = getCount();
+        if (2 * position + 1 <= count) {
+            // the leftmost node of the right subtree
+            position = 2 * position + 1;
+            while (2 * position <= count) {
+                position = 2 * position;
+            }
+            return position;
+        }
+        // go up while we are the right child, then once more to the parent
+        return position >> (std::countr_one(position) + 1);
+    }
+
+    priv::EytzingerTree::Position priv::EytzingerTree::prev(Position position) const {
+        auto count = getCount();
+        if (2 * position <= count) {
+            // the rightmost node of the left subtree
+            position = 2 * position;
+            while (2 * position + 1 <= count) {
+                position = 2 * position + 1;
+            }
+            return position;
+        }
+        // go up while we are the left child, then once more to the parent
+        return position >> (std::countr_zero(position) + 1);
+    }
+
+    Key priv::EytzingerTree::getKey(Position position, KeyBuffer&) const {
+        return getNodeReader(position).read<Key>();
+    }
+
+    template<bool Checked>
+    bool priv::EytzingerTree::hasKeyAt(Position position, const Key& key) const {
+        auto nodeReader = getNodeReader<Checked>(position);
+        ROFLDB_TRACE(touch(getPayloadAddress() + sizeof(CountType) + (position - 1) * sizeof(NodeOffsetType), sizeof(NodeOffsetType)));
+        ROFLDB_TRACE(visitNode(nodeReader.getAddress(), Utils::getReadSize<Key>(nodeReader.getAddress()) + sizeof(ValueCollection::ValueOffsetType), false));
+        auto nodeKey = nodeReader.template read<Key>();
+        ROFLDB_TRACE(compareKeys(key, nodeKey));
+        return nodeKey == key;
+    }
+
+    template<bool Checked>
+    priv::ValueCollection::ValueOffsetType priv::EytzingerTree::getValueOffset(Position position) const {
+        auto nodeReader = getNodeReader<Checked>(position);
+        nodeReader.skip(Utils::getReadSize<Key>(nodeReader.getAddress()));
+        return nodeReader.template read<ValueCollection::ValueOffsetType>();
+    }
+
+    bool priv::EytzingerTree::forEachNodeAtDepth(unsigned depth, const NodeCallback& callback) const {
+        auto count = getCount();
+        if (depth >= 64 || (Position(1) << depth) > count) {
+            return false;
+        }
+        Position levelBegin = Position(1) << depth;
+        Position levelEnd = std::min(2 * levelBegin - 1, count);
+        // the offsets of the level are contiguous, so are its nodes
+        if (!callback({getPayloadAddress() + sizeof(CountType) + (levelBegin - 1) * sizeof(NodeOffsetType),
+                       (levelEnd - levelBegin + 1) * sizeof(NodeOffsetType)})) {
+            return false;
+        }
+        for (auto k = levelBegin; k <= levelEnd; k++) {
+            const auto* node = getNodeReader(k).getAddress();
+            if (!callback({node, Utils::getReadSize<Key>(node) + sizeof(ValueCollection::ValueOffsetType)})) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    priv::PositionCheck priv::EytzingerTree::verify(const Verifier& verifier) const {
+        uint64_t size = getSize();
+        Verifier::require(size >= sizeof(CountType), "Tree out of bounds");
+        uint64_t count = getCount();
+        Verifier::require((size - sizeof(CountType)) / sizeof(NodeOffsetType) >= count, "Tree offsets out of bounds");
+
+        // every node on its own, and its key against the key of the next node in key order
+        auto getNodeKey = [this](Position position) {
+            return getNodeReader<false>(position).read<Key>();
+        };
+        verifier.parallelFor(count, [&](uint64_t begin, uint64_t end) {
+            for (auto position = begin + 1; position <= end; position++) {
+                auto nodeOffset = getPayloadReader<false>().read<NodeOffsetType>(sizeof(CountType) + (position - 1) * sizeof(NodeOffsetType));
+                Verifier::require(nodeOffset <= size && size - nodeOffset >= sizeof(Key::SizeType), "Tree key out of bounds");
+                uint64_t keySize = Utils::read<Key::SizeType>(getPayloadAddress() + nodeOffset);
+                Verifier::require(size - nodeOffset - sizeof(Key::SizeType) >= keySize + sizeof(ValueCollection::ValueOffsetType), "Tree node out of bounds");
+                verifier.checkValueOffset(getValueOffset<false>(position));
+            }
+        });
+        verifier.parallelFor(count, [&](uint64_t begin, uint64_t end) {
+            for (auto position = begin + 1; position <= end; position++) {
+                if (auto nextPosition = next(position)) {
+                    Verifier::require(getNodeKey(position) < getNodeKey(nextPosition), "Tree keys out of order");
+                }
+            }
+        });
+
+        // the children are computed, so any position up to the count is a node
+        return [count](uint64_t packedPosition) {
+            auto position = unpackPosition(packedPosition);
+            return position >= 1 && position <= count;
+        };
+    }
+
+// END priv::EytzingerTree =============================================================================================
+
+
+// priv::BasicWideTree::Node ===========================================================================================
+
+    template<class OffsetT>
+    template<bool Checked>
+    std::optional<typename priv::BasicWideTree<OffsetT>::Node::Match> priv::BasicWideTree<OffsetT>::Node::match(const Key& searchKey) const {
+        Utils::BasicPayloadReader<Checked> payloadReader = this->template getPayloadReader<Checked>();
+
+        auto kindByte = payloadReader.template read<uint8_t>();
+        auto kind = static_cast<Kind>(kindByte & ~COMPRESSED_KEYS);
+        unsigned count = payloadReader.template read<CountType>();
+        auto skip = payloadReader.template read<Key::SizeType>();
+
+        const auto* prefixes = payloadReader.skip(count * sizeof(uint64_t));
+        auto rank = Utils::rankPrefix(prefixes, count, Utils::getKeyPrefix(searchKey.get(), searchKey.size(), skip));
+        ROFLDB_TRACE(visitNode(this, prefixes + count * sizeof(uint64_t) - reinterpret_cast<const std::byte*>(this), true));
+        ROFLDB_TRACE(compareBytes(count * sizeof(uint64_t)));
+
+        auto entriesReader = payloadReader;
+        payloadReader.skip(count * (kind == Kind::LEAF ? sizeof(ValueCollection::ValueOffsetType) : sizeof(Node::OffsetType)));
+        // same as `getKeySuffix`, without decoding the header again
+        auto getNodeKeySuffix = [&](unsigned idx) {
+            auto keyOffset = Utils::BasicPayloadReader<Checked>(payloadReader).template read<uint32_t>(idx * sizeof(uint32_t));
+            auto key = this->template getPayloadReader<Checked>().template read<Key>(keyOffset);
+            ROFLDB_TRACE(touch(payloadReader.getAddress() + idx * sizeof(uint32_t), sizeof(uint32_t)));
+            ROFLDB_TRACE(touch(key.get(), key.size()));
+            return kindByte & COMPRESSED_KEYS ? key : Key(key.get() + skip, key.size() - skip);
+        };
+
+        auto searchSkip = std::min<std::size_t>(skip, searchKey.size());
+        Key searchSuffix(searchKey.get() + searchSkip, searchKey.size() - searchSkip);
+
+        if (kind == Kind::LEAF) {
+            for (auto idx = rank.less; idx < rank.lessOrEqual; idx++) {
+                auto suffix = getNodeKeySuffix(idx);
+                ROFLDB_TRACE(compareKeys(searchSuffix, suffix));
+                if (suffix == searchSuffix) {
+                    // the only place the skipped prefix is checked, see `WideTree`
+                    if (skip != searchSkip || std::memcmp(searchKey.get(), this->template getSharedPrefix<Checked>().get(), skip) != 0) {
+                        return std::nullopt;
+                    }
+                    return ValueMatch(entriesReader.template read<ValueCollection::ValueOffsetType>(idx * sizeof(ValueCollection::ValueOffsetType)));
+                }
+            }
+            return std::nullopt;
+        }
+
+        // the last child which smallest key is less than or equal to the searched one
+        auto childIdx = static_cast<int>(rank.less) - 1;
+        for (auto idx = rank.less; idx < rank.lessOrEqual; idx++) {
+            auto suffix = getNodeKeySuffix(idx);
+            ROFLDB_TRACE(compareKeys(searchSuffix, suffix));
+            if (suffix > searchSuffix) {
+                break;
+            }
+            childIdx = static_cast<int>(idx);
+        }
+        if (childIdx < 0) {
+            // less than anything in the subtree
+            return std::nullopt;
+        }
+        return DropDownMatch(entriesReader.template read<Node::OffsetType>(childIdx * sizeof(Node::OffsetType)));
+    }
+
+    template<class OffsetT>
+    void priv::BasicWideTree<OffsetT>::Node::prefetch() const {
+        // the header and the prefixes of a node with the default fanout
+        const auto* address = reinterpret_cast<const char*>(this);
+        __builtin_prefetch(address);
+        __builtin_prefetch(address + 64);
+        __builtin_prefetch(address + 128);
+        __builtin_prefetch(address + 192);
+    }
+
+    template<class OffsetT>
+    typename priv::BasicWideTree<OffsetT>::Node::Kind priv::BasicWideTree<OffsetT>::Node::getKind() const {
+        return static_cast<Kind>(this->getPayloadReader().template read<uint8_t>() & ~COMPRESSED_KEYS);
+    }
+
+    template<class OffsetT>
+    bool priv::BasicWideTree<OffsetT>::Node::hasCompressedKeys() const {
+        return this->getPayloadReader().template read<uint8_t>() & COMPRESSED_KEYS;
+    }
+
+    template<class OffsetT>
+    unsigned priv::BasicWideTree<OffsetT>::Node::getCount() const {
+        return this->getPayloadReader().template read<CountType>(sizeof(uint8_t));
+    }
+
+    template<class OffsetT>
+    template<bool Checked>
+    Key priv::BasicWideTree<OffsetT>::Node::getSharedPrefix() const {
+        Utils::BasicPayloadReader<Checked> payloadReader = this->template getPayloadReader<Checked>();
+        auto kindByte = payloadReader.template read<uint8_t>();
+        unsigned count = payloadReader.template read<CountType>();
+        auto skip = payloadReader.template read<Key::SizeType>();
+        if (!(kindByte & COMPRESSED_KEYS)) {
+            return {this->template getKeySuffix<Checked>(0).get() - skip, skip};
+        }
+        auto entrySize = static_cast<Kind>(kindByte & ~COMPRESSED_KEYS) == Kind::LEAF ? sizeof(ValueCollection::ValueOffsetType) : sizeof(Node::OffsetType);
+        payloadReader.skip(count * (sizeof(uint64_t) + entrySize + sizeof(uint32_t)));
+        return {payloadReader.getAddress(), skip};
+    }
+
+    template<class OffsetT>
+    template<bool Checked>
+    Key priv::BasicWideTree<OffsetT>::Node::getKeySuffix(unsigned idx) const {
+        Utils::BasicPayloadReader<Checked> payloadReader = this->template getPayloadReader<Checked>();
+        auto kindByte = payloadReader.template read<uint8_t>();
+        unsigned count = payloadReader.template read<CountType>();
+        auto skip = payloadReader.template read<Key::SizeType>();
+        auto entrySize = static_cast<Kind>(kindByte & ~COMPRESSED_KEYS) == Kind::LEAF ? sizeof(ValueCollection::ValueOffsetType) : sizeof(Node::OffsetType);
+        auto keyOffset = payloadReader.template read<uint32_t>(count * (sizeof(uint64_t) + entrySize) + idx * sizeof(uint32_t));
+        auto key = this->template getPayloadReader<Checked>().template read<Key>(keyOffset);
+        if (kindByte & COMPRESSED_KEYS) {
+            return key;
+        }
+        return {key.get() + skip, key.size() - skip};
+    }
+
+    template<class OffsetT>
+    Key priv::BasicWideTree<OffsetT>::Node::getKey(unsigned idx, KeyBuffer& buffer) const {
+        auto suffix = getKeySuffix(idx);
+        if (!hasCompressedKeys()) {
+            auto skip = this->getPayloadReader().template read<Key::SizeType>(sizeof(uint8_t) + sizeof(CountType));
+            return {suffix.get() - skip, skip + suffix.size()};
+        }
+        auto prefix = getSharedPrefix();
+        buffer.assign(prefix.get(), prefix.get() + prefix.size());
+        buffer.insert(buffer.end(), suffix.get(), suffix.get() + suffix.size());
+        return {buffer.data(), buffer.size()};
+    }
+
+    template<class OffsetT>
+    template<bool Checked>
+    priv::ValueCollection::ValueOffsetType priv::BasicWideTree<OffsetT>::Node::getValueOffset(unsigned idx) const {
+        auto payloadReader = this->template getPayloadReader<Checked>();
+        unsigned count = Utils::BasicPayloadReader<Checked>(payloadReader).template read<CountType>(sizeof(uint8_t));
+        auto entriesOffset = sizeof(uint8_t) + sizeof(CountType) + sizeof(Key::SizeType) + count * sizeof(uint64_t);
+        return payloadReader.template read<ValueCollection::ValueOffsetType>(entriesOffset + idx * sizeof(ValueCollection::ValueOffsetType));
+    }
+
+    template<class OffsetT>
+    typename priv::BasicWideTree<OffsetT>::Node::OffsetType priv::BasicWideTree<OffsetT>::Node::getChildOffset(unsigned idx) const {
+        auto entriesOffset = sizeof(uint8_t) + sizeof(CountType) + sizeof(Key::SizeType) + getCount() * sizeof(uint64_t);
+        return this->getPayloadReader().template read<Node::OffsetType>(entriesOffset + idx * sizeof(Node::OffsetType));
+    }
+
+    template<class OffsetT>
+    unsigned priv::BasicWideTree<OffsetT>::Node::countLess(const Key& key, bool orEqual) const {
+        Utils::PayloadReader payloadReader = this->getPayloadReader();
+        payloadReader.skip<uint8_t>();
+        unsigned count = payloadReader.read<CountType>();
+        auto skip = payloadReader.read<Key::SizeType>();
+
+        // Unlike the keys being looked up, the keys being sought do not necessarily share the prefix skipped by the
+        // node (they can fall between two subtrees), so that is checked first.
+        if (skip > 0) {
+            auto prefixCompareResult = std::memcmp(key.get(), getSharedPrefix().get(), std::min<std::size_t>(key.size(), skip));
+            if (prefixCompareResult < 0 || (prefixCompareResult == 0 && key.size() < skip)) {
+                return 0;
+            } else if (prefixCompareResult > 0) {
+                return count;
+            }
+        }
+
+        const auto* prefixes = payloadReader.skip(count * sizeof(uint64_t));
+        auto rank = Utils::rankPrefix(prefixes, count, Utils::getKeyPrefix(key.get(), key.size(), skip));
+        Key keySuffix(key.get() + skip, key.size() - skip);
+        auto idx = rank.less;
+        while (idx < rank.lessOrEqual) {
+            auto keyCompareResult = getKeySuffix(idx).operator<=>(keySuffix);
+            if (keyCompareResult == std::strong_ordering::greater || (keyCompareResult == std::strong_ordering::equal && !orEqual)) {
+                break;
+            }
+            idx++;
+        }
+        return idx;
+    }
+
+// END priv::BasicWideTree::Node =======================================================================================
+
+
+// priv::BasicWideTree =================================================================================================
+
+    template<class OffsetT>
+    template<bool Checked>
+    std::optional<priv::ValueCollection::ValueOffsetType> priv::BasicWideTree<OffsetT>::get(const Key& key) const {
+        typename Node::OffsetType offset = this->template getPayloadReader<Checked>().template read<typename Node::OffsetType>();
+        if (offset == 0) {
+            // empty tree
+            return std::nullopt;
+        }
+        while (auto optionalMatch = getNode<Checked>(offset)->template match<Checked>(key)) [[likely]] {
+            auto match = optionalMatch.value();
+            if (holds_alternative<typename Node::ValueMatch>(match)) {
+                return std::get<typename Node::ValueMatch>(match).valueOffset;
+            }
+            offset = std::get<typename Node::DropDownMatch>(match).nodeOffset;
+        }
+        return std::nullopt;
+    }
+
+    template<class OffsetT>
+    template<bool Checked>
+    typename priv::BasicWideTree<OffsetT>::Search priv::BasicWideTree<OffsetT>::startSearch() const {
+        Search search {this->template getPayloadReader<Checked>().template read<typename Node::OffsetType>(), std::nullopt};
+        reinterpret_cast<const Node*>(this->getPayloadAddress() + search.nodeOffset)->prefetch();
+        return search;
+    }
+
+    template<class OffsetT>
+    template<bool Checked>
+    void priv::BasicWideTree<OffsetT>::advance(Search& search, const Key& key) const {
+        auto optionalMatch = getNode<Checked>(search.nodeOffset)->template match<Checked>(key);
+        search.nodeOffset = 0;
+        if (!optionalMatch) {
+            return;
+        }
+        auto match = optionalMatch.value();
+        if (holds_alternative<typename Node::ValueMatch>(match)) {
+            search.valueOffset = std::get<typename Node::ValueMatch>(match).valueOffset;
+            return;
+        }
+        search.nodeOffset = std::get<typename Node::DropDownMatch>(match).nodeOffset;
+        reinterpret_cast<const Node*>(this->getPayloadAddress() + search.nodeOffset)->prefetch();
+    }
+
+    template<class OffsetT>
+    priv::PendingRead priv::BasicWideTree<OffsetT>::getPendingRead(const Search& search) const {
+        return {this->getPayloadAddress() + search.nodeOffset, sizeof(typename Node::SizeType), sizeof(typename Node::SizeType)};
+    }
+
+    template<class OffsetT>
+    template<bool Checked>
+    const typename priv::BasicWideTree<OffsetT>::Node* priv::BasicWideTree<OffsetT>::getNode(typename Node::OffsetType offset) const {
+        return this->template getPayloadReader<Checked>().template read<const Node*>(offset);
+    }
+
+    template<class OffsetT>
+    typename priv::BasicWideTree<OffsetT>::Position priv::BasicWideTree<OffsetT>::first() const {
+        auto offset = this->getPayloadReader().template read<typename Node::OffsetType>();
+        if (offset == 0) {
+            return {0, 0};
+        }
+        while (getNode(offset)->getKind() == Node::Kind::INTERNAL) {
+            offset = getNode(offset)->getChildOffset(0);
+        }
+        return {offset, 0};
+    }
+
+    template<class OffsetT>
+    typename priv::BasicWideTree<OffsetT>::Position priv::BasicWideTree<OffsetT>::last() const {
+        auto offset = this->getPayloadReader().template read<typename Node::OffsetType>();
+        if (offset == 0) {
+            return {0, 0};
+        }
+        while (getNode(offset)->getKind() == Node::Kind::INTERNAL) {
+            offset = getNode(offset)->getChildOffset(getNode(offset)->getCount() - 1);
+        }
+        return {offset, getNode(offset)->getCount() - 1};
+    }
+
+    template<class OffsetT>
+    typename priv::BasicWideTree<OffsetT>::Position priv::BasicWideTree<OffsetT>::seekGE(const Key& key) const {
+        auto offset = this->getPayloadReader().template read<typename Node::OffsetType>();
+        if (offset == 0) {
+            return {0, 0};
+        }
+        while (getNode(offset)->getKind() == Node::Kind::INTERNAL) {
+            // the last child which smallest key is less than or equal to the sought one (or the first child)
+            auto idx = getNode(offset)->countLess(key, true);
+            offset = getNode(offset)->getChildOffset(idx > 0 ? idx - 1 : 0);
+        }
+        auto idx = getNode(offset)->countLess(key, false);
+        if (idx < getNode(offset)->getCount()) {
+            return {offset, idx};
+        }
+        return next({offset, idx - 1});
+    }
+
+    template<class OffsetT>
+    typename priv::BasicWideTree<OffsetT>::Position priv::BasicWideTree<OffsetT>::seekLT(const Key& key) const {
+        auto offset = this->getPayloadReader().template read<typename Node::OffsetType>();
+        if (offset == 0) {
+            return {0, 0};
+        }
+        while (true) {
+            auto idx = getNode(offset)->countLess(key, false);
+            if (idx == 0) {
+                // only possible at the root, any other node was chosen because its smallest key is less
+                return {0, 0};
+            }
+            if (getNode(offset)->getKind() == Node::Kind::LEAF) {
+                return {offset, idx - 1};
+            }
+            offset = getNode(offset)->getChildOffset(idx - 1);
+        }
+    }
+
+    template<class OffsetT>
+    typename priv::BasicWideTree<OffsetT>::Position priv::BasicWideTree<OffsetT>::next(Position position) const {
+        const auto* leaf = getNode(position.leafOffset);
+        if (position.idx + 1 < leaf->getCount()) {
+            return {position.leafOffset, position.idx + 1};
+        }
+        uint64_t nextOffset = uint64_t(position.leafOffset) + sizeof(typename Node::SizeType) + leaf->getSize();
+        if (nextOffset >= this->getSize() || getNode(nextOffset)->getKind() != Node::Kind::LEAF) {
+            return {0, 0};
+        }
+        return {static_cast<typename Node::OffsetType>(nextOffset), 0};
+    }
+
+    template<class OffsetT>
+    typename priv::BasicWideTree<OffsetT>::Position priv::BasicWideTree<OffsetT>::prev(Position position) const {
+        if (position.idx > 0) {
+            return {position.leafOffset, position.idx - 1};
+        }
+        KeyBuffer buffer;
+        return seekLT(getKey(position, buffer));
+    }
+
+    template<class OffsetT>
+    Key priv::BasicWideTree<OffsetT>::getKey(Position position, KeyBuffer& buffer) const {
+        return getNode(position.leafOffset)->getKey(position.idx, buffer);
+    }
+
+    template<class OffsetT>
+    template<bool Checked>
+    bool priv::BasicWideTree<OffsetT>::hasKeyAt(Position position, const Key& key) const {
+        // compared in two parts, so that compressed keys do not have to be assembled
+        const auto* node = getNode<Checked>(position.leafOffset);
+        auto prefix = node->template getSharedPrefix<Checked>();
+        // the header, then the shared prefix and the key
+        ROFLDB_TRACE(visitNode(node, sizeof(typename Node::SizeType) + sizeof(uint8_t) + sizeof(typename Node::CountType) + sizeof(Key::SizeType), false));
+        ROFLDB_TRACE(touch(prefix.get(), prefix.size()));
+        ROFLDB_TRACE(compareBytes(std::min(key.size(), prefix.size())));
+        if (key.size() < prefix.size() || std::memcmp(key.get(), prefix.get(), prefix.size()) != 0) {
+            return false;
+        }
+        auto suffix = node->template getKeySuffix<Checked>(position.idx);
+        Key keySuffix(key.get() + prefix.size(), key.size() - prefix.size());
+        ROFLDB_TRACE(touch(suffix.get(), suffix.size()));
+        ROFLDB_TRACE(compareKeys(keySuffix, suffix));
+        return suffix == keySuffix;
+    }
+
+    template<class OffsetT>
+    template<bool Checked>
+    priv::ValueCollection::ValueOffsetType priv::BasicWideTree<OffsetT>::getValueOffset(Position position) const {
+        return getNode<Checked>(position.leafOffset)->template getValueOffset<Checked>(position.idx);
+    }
+
+    template<class OffsetT>
+    bool priv::BasicWideTree<OffsetT>::forEachNodeAtDepth(unsigned depth, const NodeCallback& callback) const {
+        bool visited = false;
+        bool stopped = false;
+        auto visit = [&](auto& visit, typename Node::OffsetType offset, unsigned nodeDepth) -> void {
+            const auto* node = getNode(offset);
+            if (nodeDepth == depth) {
+                visited = true;
+                stopped = !callback({reinterpret_cast<const std::byte*>(node), sizeof(typename Node::SizeType) + node->getSize()});
+                return;
+            }
+            if (node->getKind() == Node::Kind::LEAF) {
+                return;
+            }
+            for (unsigned idx = 0; idx < node->getCount() && !stopped; idx++) {
+                visit(visit, node->getChildOffset(idx), nodeDepth + 1);
+            }
+        };
+        if (auto rootOffset = this->getPayloadReader().template read<typename Node::OffsetType>()) {
+            visit(visit, rootOffset, 0);
+        }
+        return visited && !stopped;
+    }
+
+    template<class OffsetT>
+    priv::PositionCheck priv::BasicWideTree<OffsetT>::verify(const Verifier& verifier) const {
+        using NodeSizeType = typename Node::SizeType;
+        using NodeOffsetType = typename Node::OffsetType;
+        constexpr std::size_t HEADER_SIZE = sizeof(uint8_t) + sizeof(typename Node::CountType) + sizeof(Key::SizeType);
+
+        uint64_t size = this->getSize();
+        Verifier::require(size >= sizeof(NodeOffsetType), "Tree out of bounds");
+        const auto* payload = this->getPayloadAddress();
+        auto rootOffset = Utils::read<NodeOffsetType>(payload);
+
+        // The nodes follow the root offset one after another: the leaves in key order, then the internal nodes, every
+        // one after its children.
+        std::vector<NodeOffsetType> nodeOffsets;
+        uint64_t leafCount = 0;
+        for (uint64_t offset = sizeof(NodeOffsetType); offset < size;) {
+            Verifier::require(size - offset >= sizeof(NodeSizeType) + HEADER_SIZE, "Tree node out of bounds");
+            auto nodeSize = Utils::read<NodeSizeType>(payload + offset);
+            Verifier::require(size - offset - sizeof(NodeSizeType) >= nodeSize, "Tree node out of bounds");
+            auto kindByte = Utils::read<uint8_t>(payload + offset + sizeof(NodeSizeType));
+            auto kind = static_cast<typename Node::Kind>(kindByte & ~Node::COMPRESSED_KEYS);
+            Verifier::require(kind == Node::Kind::LEAF || kind == Node::Kind::INTERNAL, "Invalid tree node kind");
+            if (kind == Node::Kind::LEAF) {
+                Verifier::require(leafCount == nodeOffsets.size(), "Tree leaf after an internal node");
+                leafCount++;
+            }
+            nodeOffsets.push_back(static_cast<NodeOffsetType>(offset));
+            offset += sizeof(NodeSizeType) + nodeSize;
+        }
+        if (rootOffset == 0) {
+            Verifier::require(nodeOffsets.empty(), "Nodes in an empty tree");
+            return [](uint64_t) { return false; };
+        }
+        auto findNode = [&nodeOffsets](uint64_t offset) -> std::optional<std::size_t> {
+            auto found = std::lower_bound(nodeOffsets.begin(), nodeOffsets.end(), offset);
+            if (found == nodeOffsets.end() || *found != offset) {
+                return std::nullopt;
+            }
+            return found - nodeOffsets.begin();
+        };
+        Verifier::require(findNode(rootOffset).has_value(), "Tree root is not a node");
+        auto nodeAt = [&](std::size_t idx) {
+            return reinterpret_cast<const Node*>(payload + nodeOffsets[idx]);
+        };
+        auto getFullKey = [](const Node* node, unsigned keyIdx, KeyBuffer& buffer) {
+            auto prefix = node->template getSharedPrefix<false>();
+            auto suffix = node->template getKeySuffix<false>(keyIdx);
+            buffer.assign(prefix.get(), prefix.get() + prefix.size());
+            buffer.insert(buffer.end(), suffix.get(), suffix.get() + suffix.size());
+            return Key(buffer.data(), buffer.size());
+        };
+
+        // every node on its own
+        verifier.parallelFor(nodeOffsets.size(), [&](uint64_t begin, uint64_t end) {
+            for (auto idx = begin; idx < end; idx++) {
+                const auto* node = nodeAt(idx);
+                uint64_t nodeSize = node->getSize();
+                const auto* nodePayload = payload + nodeOffsets[idx] + sizeof(NodeSizeType);
+                auto kindByte = Utils::read<uint8_t>(nodePayload);
+                bool leaf = static_cast<typename Node::Kind>(kindByte & ~Node::COMPRESSED_KEYS) == Node::Kind::LEAF;
+                bool compressed = kindByte & Node::COMPRESSED_KEYS;
+                uint64_t count = Utils::read<typename Node::CountType>(nodePayload + sizeof(uint8_t));
+                uint64_t skip = Utils::read<Key::SizeType>(nodePayload + sizeof(uint8_t) + sizeof(typename Node::CountType));
+                Verifier::require(count > 0, "Empty tree node");
+                auto entrySize = leaf ? sizeof(ValueCollection::ValueOffsetType) : sizeof(NodeOffsetType);
+                auto keyOffsetsOffset = HEADER_SIZE + count * (sizeof(uint64_t) + entrySize);
+                auto keysOffset = keyOffsetsOffset + count * sizeof(uint32_t) + (compressed ? skip : 0);
+                Verifier::require(nodeSize >= keysOffset, "Tree node out of bounds");
+
+                for (unsigned keyIdx = 0; keyIdx < count; keyIdx++) {
+                    uint64_t keyOffset = Utils::read<uint32_t>(nodePayload + keyOffsetsOffset + keyIdx * sizeof(uint32_t));
+                    Verifier::require(keyOffset <= nodeSize && nodeSize - keyOffset >= sizeof(Key::SizeType), "Tree key out of bounds");
+                    uint64_t keySize = Utils::read<Key::SizeType>(nodePayload + keyOffset);
+                    Verifier::require(nodeSize - keyOffset - sizeof(Key::SizeType) >= keySize, "Tree key out of bounds");
+                    Verifier::require(compressed || keySize >= skip, "Tree key shorter than the shared prefix");
+                }
+                // now that the keys are within the node
+                auto sharedPrefix = node->template getSharedPrefix<false>();
+                for (unsigned keyIdx = 0; keyIdx < count; keyIdx++) {
+                    auto suffix = node->template getKeySuffix<false>(keyIdx);
+                    if (!compressed) {
+                        Verifier::require(std::memcmp(suffix.get() - skip, sharedPrefix.get(), skip) == 0, "Tree key without the shared prefix");
+                    }
+                    auto prefix = Utils::read<uint64_t>(nodePayload + HEADER_SIZE + keyIdx * sizeof(uint64_t));
+                    Verifier::require(prefix == Utils::getKeyPrefix(suffix.get(), suffix.size(), 0), "Tree key prefix mismatch");
+                    if (keyIdx > 0) {
+                        Verifier::require(node->template getKeySuffix<false>(keyIdx - 1) < suffix, "Tree keys out of order");
+                    }
+                    if (leaf) {
+                        verifier.checkValueOffset(node->template getValueOffset<false>(keyIdx));
+                    } else {
+                        auto childIdx = findNode(node->getChildOffset(keyIdx));
+                        Verifier::require(childIdx.has_value() && *childIdx < idx, "Tree child is not a node below");
+                    }
+                }
+            }
+        });
+        // then against the next leaf or the children
+        verifier.parallelFor(nodeOffsets.size(), [&](uint64_t begin, uint64_t end) {
+            KeyBuffer buffer;
+            KeyBuffer otherBuffer;
+            for (auto idx = begin; idx < end; idx++) {
+                const auto* node = nodeAt(idx);
+                if (idx + 1 < leafCount) {
+                    Verifier::require(getFullKey(node, node->getCount() - 1, buffer) < getFullKey(nodeAt(idx + 1), 0, otherBuffer), "Tree keys out of order");
+                }
+                if (idx < leafCount) {
+                    continue;
+                }
+                for (unsigned keyIdx = 0; keyIdx < node->getCount(); keyIdx++) {
+                    // the key of an internal node is the smallest key of the child
+                    Verifier::require(getFullKey(node, keyIdx, buffer) == getFullKey(nodeAt(*findNode(node->getChildOffset(keyIdx))), 0, otherBuffer),
+                                      "Tree key is not the smallest key of the child");
+                }
+            }
+        });
+
+        // Every node but the root has a single parent and the subtree of a child is the range of leaves between the
+        // ranges of its siblings, so the (sorted) leaves are in the tree order and the lookups end at the right leaf.
+        // The children precede their parents, so the ranges are known by the time a parent is reached.
+        struct LeafRange {
+            uint64_t begin;
+            uint64_t end;
+        };
+        std::vector<LeafRange> ranges(nodeOffsets.size());
+        std::vector<uint8_t> hasParent(nodeOffsets.size());
+        for (uint64_t idx = 0; idx < nodeOffsets.size(); idx++) {
+            const auto* node = nodeAt(idx);
+            if (idx < leafCount) {
+                ranges[idx] = {idx, idx + 1};
+                continue;
+            }
+            for (unsigned keyIdx = 0; keyIdx < node->getCount(); keyIdx++) {
+                auto childIdx = *findNode(node->getChildOffset(keyIdx));
+                Verifier::require(!hasParent[childIdx], "Tree node with many parents");
+                hasParent[childIdx] = true;
+                Verifier::require(keyIdx == 0 || ranges[childIdx].begin == ranges[idx].end, "Tree children out of order");
+                ranges[idx] = {keyIdx == 0 ? ranges[childIdx].begin : ranges[idx].begin, ranges[childIdx].end};
+            }
+        }
+        auto rootIdx = *findNode(rootOffset);
+        Verifier::require(ranges[rootIdx].begin == 0 && ranges[rootIdx].end == leafCount && !hasParent[rootIdx],
+                          "Tree leaves not reachable from the root");
+
+        nodeOffsets.resize(leafCount);
+        return [this, leaves = std::move(nodeOffsets)](uint64_t packedPosition) {
+            auto position = unpackPosition(packedPosition);
+            return std::binary_search(leaves.begin(), leaves.end(), position.leafOffset)
+                   && position.idx < getNode(position.leafOffset)->getCount();
+        };
+    }
+
+    template class priv::BasicWideTree<uint32_t>;
+    template class priv::BasicWideTree<uint64_t>;
+    // the checked steps are also run by `PagedDbFile`
+    template priv::WideTree::Search priv::WideTree::startSearch<true>() const;
+    template void priv::WideTree::advance<true>(Search& search, const Key& key) const;
+    template priv::WideTree64::Search priv::WideTree64::startSearch<true>() const;
+    template void priv::WideTree64::advance<true>(Search& search, const Key& key) const;
+
+// END priv::BasicWideTree =============================================================================================
+
+
+// priv::LearnedTree ===================================================================================================
+
+namespace {
+    // `idx`-th element of an array of `count` elements
+    template<class T, bool Checked>
+    T readElement(const std::byte* array, uint64_t count, uint64_t idx) {
+        return Utils::BasicPayloadReader<Checked>(array, count * sizeof(T)).template read<T>(idx * sizeof(T));
+    }
+}
+
+    template<bool Checked>
+    priv::LearnedTree::Layout priv::LearnedTree::getLayout() const {
+        auto payloadReader = getPayloadReader<Checked>();
+        Layout layout {};
+        layout.count = payloadReader.template read<uint64_t>();
+        layout.minKey = payloadReader.template read<uint64_t>();
+        layout.segmentCount = payloadReader.template read<uint64_t>();
+        layout.searchRadius = payloadReader.template read<uint32_t>();
+        layout.radixBits = payloadReader.template read<uint8_t>();
+        layout.radixShift = payloadReader.template read<uint8_t>();
+        auto paddingSize = payloadReader.template read<uint8_t>();
+        if constexpr (Checked) {
+            // the array sizes must not overflow, the arrays are checked to fit by the skips
+            auto remaining = payloadReader.getRemaining();
+            if (layout.radixBits > MAX_RADIX_BITS || layout.radixShift >= 64 || layout.searchRadius > MAX_SEARCH_RADIUS
+                || layout.segmentCount > remaining || layout.count > remaining) [[unlikely]] {
+                throw Exceptions::data_corrupted_error("Invalid learned tree header");
+            }
+        }
+        layout.radix = payloadReader.skip(((uint64_t(1) << layout.radixBits) + 1) * sizeof(uint32_t));
+        layout.segmentKeys = payloadReader.skip(layout.segmentCount * sizeof(uint64_t));
+        layout.segments = payloadReader.skip(layout.segmentCount * SEGMENT_SIZE);
+        payloadReader.skip(paddingSize);
+        layout.keys = payloadReader.skip(layout.count * sizeof(uint64_t));
+        layout.valueOffsets = payloadReader.skip(layout.count * sizeof(ValueCollection::ValueOffsetType));
+        return layout;
+    }
+
+    template<bool Checked>
+    std::pair<uint64_t, uint64_t> priv::LearnedTree::predictWindow(const Layout& layout, uint64_t key) const {
+        // the segments starting in the bucket of the key, and the last one starting before it
+        if (layout.count == 0 || key < layout.minKey) {
+            return {0, 0};
+        }
+        auto bucket = (key - layout.minKey) >> layout.radixShift;
+        auto bucketCount = uint64_t(1) << layout.radixBits;
+        if (bucket >= bucketCount) {
+            return {0, 0};
+        }
+        uint64_t begin = readElement<uint32_t, Checked>(layout.radix, bucketCount + 1, bucket);
+        uint64_t end = readElement<uint32_t, Checked>(layout.radix, bucketCount + 1, bucket + 1);
+        ROFLDB_TRACE(visitNode(layout.radix + bucket * sizeof(uint32_t), 2 * sizeof(uint32_t), true));
+        begin = begin > 0 ? begin - 1 : 0;
+        if constexpr (Checked) {
+            if (begin >= end || end > layout.segmentCount) [[unlikely]] {
+                throw Exceptions::data_corrupted_error("Invalid learned tree radix table");
+            }
+        }
+
+        // the key is in the last segment starting at or before it
+        while (end - begin > SEGMENT_SCAN_SIZE) {
+            auto middle = begin + (end - begin) / 2;
+            if (readElement<uint64_t, Checked>(layout.segmentKeys, layout.segmentCount, middle) <= key) {
+                begin = middle;
+            } else {
+                end = middle;
+            }
+        }
+        auto rank = Utils::rankPrefix(layout.segmentKeys + begin * sizeof(uint64_t), static_cast<unsigned>(end - begin), key);
+        auto segmentIdx = begin + std::max(rank.lessOrEqual, 1u) - 1;
+        ROFLDB_TRACE(compareBytes((end - begin) * sizeof(uint64_t)));
+
+        auto segmentKey = readElement<uint64_t, Checked>(layout.segmentKeys, layout.segmentCount, segmentIdx);
+        auto segmentReader = Utils::BasicPayloadReader<Checked>(layout.segments, layout.segmentCount * SEGMENT_SIZE);
+        segmentReader.skip(segmentIdx * SEGMENT_SIZE);
+        auto segmentBegin = segmentReader.template read<uint64_t>();
+        auto slope = std::bit_cast<double>(segmentReader.template read<uint64_t>());
+        auto segmentEnd = segmentIdx + 1 < layout.segmentCount ? segmentReader.template read<uint64_t>() : layout.count;
+        ROFLDB_TRACE(visitNode(layout.segments + segmentIdx * SEGMENT_SIZE, SEGMENT_SIZE, true));
+        if constexpr (Checked) {
+            if (segmentBegin >= segmentEnd || segmentEnd > layout.count || key < segmentKey) [[unlikely]] {
+                throw Exceptions::data_corrupted_error("Invalid learned tree segment");
+            }
+        }
+
+        auto prediction = segmentBegin + predict(slope, key - segmentKey, segmentEnd - segmentBegin);
+        return {prediction - std::min<uint64_t>(layout.searchRadius, prediction - segmentBegin),
+                std::min<uint64_t>(segmentEnd, prediction + layout.searchRadius + 1)};
+    }
+
+    std::optional<uint64_t> priv::LearnedTree::searchWindow(const Layout& layout, uint64_t begin, uint64_t end, uint64_t key) {
+        // bounded by the search radius, see `getLayout` and `verify`
+        auto rank = Utils::rankPrefix(layout.keys + begin * sizeof(uint64_t), static_cast<unsigned>(end - begin), key);
+        ROFLDB_TRACE(visitNode(layout.keys + begin * sizeof(uint64_t), (end - begin) * sizeof(uint64_t), true));
+        ROFLDB_TRACE(compareBytes((end - begin) * sizeof(uint64_t)));
+        if (rank.less == rank.lessOrEqual) {
+            return std::nullopt;
+        }
+        return begin + rank.less;
+    }
+
+    template<bool Checked>
+    std::optional<priv::ValueCollection::ValueOffsetType> priv::LearnedTree::get(const Key& key) const {
+        auto value = decodeKey(key);
+        if (!value) {
+            return std::nullopt;
+        }
+        auto layout = getLayout<Checked>();
+        auto [begin, end] = predictWindow<Checked>(layout, *value);
+        auto idx = searchWindow(layout, begin, end, *value);
+        if (!idx) {
+            return std::nullopt;
+        }
+        ROFLDB_TRACE(touch(layout.valueOffsets + *idx * sizeof(ValueCollection::ValueOffsetType), sizeof(ValueCollection::ValueOffsetType)));
+        return readElement<ValueCollection::ValueOffsetType, Checked>(layout.valueOffsets, layout.count, *idx);
+    }
+
+    template<bool Checked>
+    priv::LearnedTree::Search priv::LearnedTree::startSearch() const {
+        // the model is small and most likely cached, nothing to prefetch before the key is looked at
+        return {Search::Stage::PREDICT, 0, 0, 0, std::nullopt};
+    }
+
+    template<bool Checked>
+    void priv::LearnedTree::advance(Search& search, const Key& key) const {
+        auto layout = getLayout<Checked>();
+        switch (search.stage) {
+            case Search::Stage::PREDICT: {
+                auto value = decodeKey(key);
+                if (!value) {
+                    search.stage = Search::Stage::DONE;
+                    return;
+                }
+                search.key = *value;
+                std::tie(search.begin, search.end) = predictWindow<Checked>(layout, search.key);
+                for (auto offset = search.begin * sizeof(uint64_t); offset < search.end * sizeof(uint64_t); offset += 64) {
+                    __builtin_prefetch(layout.keys + offset);
+                }
+                search.stage = Search::Stage::SEARCH;
+                return;
+            }
+            case Search::Stage::SEARCH: {
+                auto idx = searchWindow(layout, search.begin, search.end, search.key);
+                if (!idx) {
+                    search.stage = Search::Stage::DONE;
+                    return;
+                }
+                search.begin = *idx;
+                __builtin_prefetch(layout.valueOffsets + *idx * sizeof(ValueCollection::ValueOffsetType));
+                search.stage = Search::Stage::READ_VALUE_OFFSET;
+                return;
+            }
+            case Search::Stage::READ_VALUE_OFFSET:
+                ROFLDB_TRACE(touch(layout.valueOffsets + search.begin * sizeof(ValueCollection::ValueOffsetType), sizeof(ValueCollection::ValueOffsetType)));
+                search.valueOffset = readElement<ValueCollection::ValueOffsetType, Checked>(layout.valueOffsets, layout.count, search.begin);
+                search.stage = Search::Stage::DONE;
+                return;
+            case Search::Stage::DONE:
+                return;
+        }
+    }
+
+    priv::PendingRead priv::LearnedTree::getPendingRead(const Search& search) const {
+        auto layout = getLayout();
+        switch (search.stage) {
+            case Search::Stage::PREDICT:
+                // the whole model, the part of it a prediction reads depends on the key
+                return {getPayloadAddress(), static_cast<std::size_t>(layout.keys - getPayloadAddress())};
+            case Search::Stage::SEARCH:
+                return {layout.keys + search.begin * sizeof(uint64_t), (search.end - search.begin) * sizeof(uint64_t)};
+            case Search::Stage::READ_VALUE_OFFSET:
+                return {layout.valueOffsets + search.begin * sizeof(ValueCollection::ValueOffsetType), sizeof(ValueCollection::ValueOffsetType)};
+            case Search::Stage::DONE:
+                break;
+        }
+        return {getPayloadAddress(), 0};
+    }
+
+    // the checked steps are also run by `PagedDbFile`
+    template priv::LearnedTree::Search priv::LearnedTree::startSearch<true>() const;
+    template void priv::LearnedTree::advance<true>(Search& search, const Key& key) const;
+
+    uint64_t priv::LearnedTree::countLess(uint64_t key, bool orEqual) const {
+        auto layout = getLayout();
+        uint64_t begin = 0, end = layout.count;
+        while (begin < end) {
+            auto middle = begin + (end - begin) / 2;
+            auto middleKey = readElement<uint64_t, Utils::CHECK_BOUNDS>(layout.keys, layout.count, middle);
+            if (middleKey < key || (orEqual && middleKey == key)) {
+                begin = middle + 1;
+            } else {
+                end = middle;
+            }
+        }
+        return begin;
+    }
+
+    priv::LearnedTree::Position priv::LearnedTree::first() const {
+        return getLayout().count > 0 ? 1 : 0;
+    }
+
+    priv::LearnedTree::Position priv::LearnedTree::last() const {
+        return getLayout().count;
+    }
+
+    priv::LearnedTree::Position priv::LearnedTree::seekGE(const Key& key) const {
+        // the stored keys equal to the first 8 bytes of a longer key are less than it
+        auto prefix = Utils::getKeyPrefix(key.get(), key.size(), 0);
+        auto position = countLess(prefix, key.size() > KEY_SIZE) + 1;
+        return position <= getLayout().count ? position : 0;
+    }
+
+    priv::LearnedTree::Position priv::LearnedTree::seekLT(const Key& key) const {
+        auto prefix = Utils::getKeyPrefix(key.get(), key.size(), 0);
+        return countLess(prefix, key.size() > KEY_SIZE);
+    }
+
+    priv::LearnedTree::Position priv::LearnedTree::next(Position position) const {
+        return position < getLayout().count ? position + 1 : 0;
+    }
+
+    priv::LearnedTree::Position priv::LearnedTree::prev(Position position) const {
+        return position - 1;
+    }
+
+    Key priv::LearnedTree::getKey(Position position, KeyBuffer& buffer) const {
+        auto layout = getLayout();
+        buffer.resize(KEY_SIZE);
+        encodeKey(readElement<uint64_t, Utils::CHECK_BOUNDS>(layout.keys, layout.count, position - 1), buffer.data());
+        return {buffer.data(), buffer.size()};
+    }
+
+    template<bool Checked>
+    bool priv::LearnedTree::hasKeyAt(Position position, const Key& key) const {
+        auto value = decodeKey(key);
+        if (!value) {
+            return false;
+        }
+        auto layout = getLayout<Checked>();
+        ROFLDB_TRACE(visitNode(layout.keys + (position - 1) * sizeof(uint64_t), sizeof(uint64_t), false));
+        ROFLDB_TRACE(compareBytes(sizeof(uint64_t)));
+        return readElement<uint64_t, Checked>(layout.keys, layout.count, position - 1) == *value;
+    }
+
+    template<bool Checked>
+    priv::ValueCollection::ValueOffsetType priv::LearnedTree::getValueOffset(Position position) const {
+        auto layout = getLayout<Checked>();
+        ROFLDB_TRACE(touch(layout.valueOffsets + (position - 1) * sizeof(ValueCollection::ValueOffsetType), sizeof(ValueCollection::ValueOffsetType)));
+        return readElement<ValueCollection::ValueOffsetType, Checked>(layout.valueOffsets, layout.count, position - 1);
+    }
+
+    bool priv::LearnedTree::forEachNodeAtDepth(unsigned depth, const NodeCallback& callback) const {
+        auto layout = getLayout();
+        switch (depth) {
+            case 0:
+                return callback({getPayloadAddress(), static_cast<std::size_t>(layout.segments + layout.segmentCount * SEGMENT_SIZE - getPayloadAddress())});
+            case 1:
+                return layout.count > 0 && callback({layout.keys, layout.count * sizeof(uint64_t)});
+            case 2:
+                return layout.count > 0 && callback({layout.valueOffsets, layout.count * sizeof(ValueCollection::ValueOffsetType)});
+            default:
+                return false;
+        }
+    }
+
+    priv::PositionCheck priv::LearnedTree::verify(const Verifier& verifier) const {
+        uint64_t size = getSize();
+        Verifier::require(size >= HEADER_SIZE, "Tree out of bounds");
+        auto layout = getLayout<true>();
+        const auto count = layout.count;
+        const auto segmentCount = layout.segmentCount;
+        const auto bucketCount = uint64_t(1) << layout.radixBits;
+        Verifier::require((count == 0) == (segmentCount == 0) && segmentCount <= count, "Invalid tree segment count");
+
+        auto getKeyAt = [&layout](uint64_t idx) {
+            return readElement<uint64_t, false>(layout.keys, layout.count, idx);
+        };
+        auto getSegmentKey = [&layout](uint64_t idx) {
+            return readElement<uint64_t, false>(layout.segmentKeys, layout.segmentCount, idx);
+        };
+        auto getSegmentBegin = [&layout](uint64_t idx) {
+            return Utils::read<uint64_t>(layout.segments + idx * SEGMENT_SIZE);
+        };
+
+        // the keys are sorted and the value offsets valid
+        verifier.parallelFor(count, [&](uint64_t begin, uint64_t end) {
+            for (auto idx = begin; idx < end; idx++) {
+                Verifier::require(idx + 1 == count || getKeyAt(idx) < getKeyAt(idx + 1), "Tree keys out of order");
+                verifier.checkValueOffset(readElement<ValueCollection::ValueOffsetType, false>(layout.valueOffsets, count, idx));
+            }
+        });
+        if (count == 0) {
+            return [](uint64_t) { return false; };
+        }
+        Verifier::require(layout.minKey == getKeyAt(0), "Invalid tree minimum key");
+        Verifier::require(((getKeyAt(count - 1) - layout.minKey) >> layout.radixShift) < bucketCount, "Tree keys past the radix table");
+
+        // the segments start at increasing positions, with the keys there, so they cover all the keys in order
+        Verifier::require(getSegmentBegin(0) == 0, "Invalid tree segment");
+        verifier.parallelFor(segmentCount, [&](uint64_t begin, uint64_t end) {
+            for (auto idx = begin; idx < end; idx++) {
+                auto segmentBegin = getSegmentBegin(idx);
+                auto segmentEnd = idx + 1 < segmentCount ? getSegmentBegin(idx + 1) : count;
+                Verifier::require(segmentBegin < segmentEnd && segmentEnd <= count && getSegmentKey(idx) == getKeyAt(segmentBegin),
+                                  "Invalid tree segment");
+            }
+        });
+
+        // the radix table counts the segments starting before every bucket
+        verifier.parallelFor(bucketCount + 1, [&](uint64_t begin, uint64_t end) {
+            for (auto bucket = begin; bucket < end; bucket++) {
+                uint64_t segmentIdx = readElement<uint32_t, false>(layout.radix, bucketCount + 1, bucket);
+                auto isBefore = [&](uint64_t idx) {
+                    return ((getSegmentKey(idx) - layout.minKey) >> layout.radixShift) < bucket;
+                };
+                Verifier::require(segmentIdx <= segmentCount && (segmentIdx == 0 || isBefore(segmentIdx - 1))
+                                  && (segmentIdx == segmentCount || !isBefore(segmentIdx)), "Invalid tree radix table");
+            }
+        });
+
+        // every key is found where it is: the model predicts it within the search radius
+        verifier.parallelFor(count, [&](uint64_t begin, uint64_t end) {
+            for (auto idx = begin; idx < end; idx++) {
+                auto key = getKeyAt(idx);
+                auto [windowBegin, windowEnd] = predictWindow<true>(layout, key);
+                Verifier::require(windowBegin <= idx && idx < windowEnd, "Tree key not found by the model");
+            }
+        });
+
+        return [count](uint64_t packedPosition) {
+            auto position = unpackPosition(packedPosition);
+            return position >= 1 && position <= count;
+        };
+    }
+
+// END priv::LearnedTree ===============================================================================================
+
+
+// priv::BloomFilter ===================================================================================================
+
+    template<bool Checked>
+    const std::byte* priv::BloomFilter::getBlock(uint64_t hash) const {
+        auto payloadReader = getPayloadReader<Checked>();
+        auto blockCount = payloadReader.template read<uint64_t>();
+        payloadReader.template skip<uint8_t>();  // hash count
+        auto paddingSize = payloadReader.template read<uint8_t>();
+        return payloadReader.getAddress() + paddingSize + getBlockIdx(hash, blockCount) * BLOCK_SIZE;
+    }
+
+    template<bool Checked>
+    bool priv::BloomFilter::mayContain(const Key& key) const {
+        return mayContain<Checked>(hashKey(key));
+    }
+
+    template<bool Checked>
+    bool priv::BloomFilter::mayContain(uint64_t hash) const {
+        const auto* block = getBlock<Checked>(hash);
+        ROFLDB_TRACE(touch(block, BLOCK_SIZE));
+        bool result = true;
+        forEachBit(hash, getHashCount<Checked>(), [block, &result](unsigned bitIdx) {
+            auto word = Utils::read<uint64_t>(block + bitIdx / 64 * sizeof(uint64_t));
+            result &= (word >> (bitIdx % 64)) & 1;
+        });
+        return result;
+    }
+
+    // the checked test is also run by `PagedDbFile`
+    template bool priv::BloomFilter::mayContain<true>(const Key& key) const;
+    template bool priv::BloomFilter::mayContain<false>(const Key& key) const;
+    template bool priv::BloomFilter::mayContain<true>(uint64_t hash) const;
+    template bool priv::BloomFilter::mayContain<false>(uint64_t hash) const;
+
+    void priv::BloomFilter::prefetch(uint64_t hash) const {
+        __builtin_prefetch(getBlock(hash));
+    }
+
+    uint64_t priv::BloomFilter::getBlockCount() const {
+        return getPayloadReader().read<uint64_t>();
+    }
+
+    template<bool Checked>
+    unsigned priv::BloomFilter::getHashCount() const {
+        return getPayloadReader<Checked>().template read<uint8_t>(sizeof(uint64_t));
+    }
+
+    void priv::BloomFilter::verify() const {
+        constexpr std::size_t HEADER_SIZE = sizeof(uint64_t) + 2 * sizeof(uint8_t);
+        uint64_t size = getSize();
+        Verifier::require(size >= HEADER_SIZE, "Bloom filter out of bounds");
+        auto payloadReader = getPayloadReader<false>();
+        auto blockCount = payloadReader.read<uint64_t>();
+        auto hashCount = payloadReader.read<uint8_t>();
+        auto paddingSize = payloadReader.read<uint8_t>();
+        Verifier::require(hashCount >= 1 && hashCount <= MAX_HASH_COUNT, "Invalid Bloom filter hash count");
+        Verifier::require(blockCount >= 1 && (size - HEADER_SIZE) >= paddingSize
+                          && (size - HEADER_SIZE - paddingSize) / BLOCK_SIZE >= blockCount, "Bloom filter blocks out of bounds");
+    }
+
+// END priv::BloomFilter ===============================================================================================
+
+
+// priv::PerfectHashIndex ==============================================================================================
+
+namespace {
+    // little endian number of `size` bytes (up to 8)
+    uint64_t readPacked(const std::byte* address, unsigned size) {
+        switch (size) {
+            case 1:
+                return Utils::read<uint8_t>(address);
+            case 2:
+                return Utils::read<uint16_t>(address);
+            case 4:
+                return Utils::read<uint32_t>(address);
+            case 8:
+                return Utils::read<uint64_t>(address);
+            default:
+                break;
+        }
+        std::byte bytes[sizeof(uint64_t)] = {};
+        std::memcpy(bytes, address, size);
+        return Utils::read<uint64_t>(bytes);
+    }
+}
+
+    template<bool Checked>
+    priv::PerfectHashIndex::Header priv::PerfectHashIndex::getHeader() const {
+        auto payloadReader = getPayloadReader<Checked>();
+        Header header {};
+        header.seed = payloadReader.template read<uint64_t>();
+        header.keyCount = payloadReader.template read<uint64_t>();
+        header.tableSize = payloadReader.template read<uint64_t>();
+        header.bucketCount = payloadReader.template read<uint64_t>();
+        header.pilotSize = payloadReader.template read<uint8_t>();
+        header.remapSize = payloadReader.template read<uint8_t>();
+        header.entrySize = payloadReader.template read<uint8_t>();
+        return header;
+    }
+
+    template<bool Checked>
+    bool priv::PerfectHashIndex::isEmpty() const {
+        return getPayloadReader<Checked>().template read<uint64_t>(sizeof(uint64_t)) == 0;
+    }
+
+    template<bool Checked>
+    uint64_t priv::PerfectHashIndex::hashKey(const Key& key) const {
+        return Utils::hashBytes(key.get(), key.size(), getPayloadReader<Checked>().template read<uint64_t>());
+    }
+
+    template<bool Checked>
+    const std::byte* priv::PerfectHashIndex::getPilotAddress(uint64_t hash) const {
+        auto header = getHeader<Checked>();
+        return getPayloadAddress() + PILOTS_OFFSET + getBucket(hash, header.bucketCount) * header.pilotSize;
+    }
+
+    template<bool Checked>
+    const std::byte* priv::PerfectHashIndex::getEntryAddress(uint64_t hash) const {
+        auto header = getHeader<Checked>();
+        auto pilot = readPacked(getPilotAddress<Checked>(hash), header.pilotSize);
+        auto slot = getSlot(hash, pilot, header.tableSize);
+
+        const auto* remap = getPayloadAddress() + PILOTS_OFFSET + header.bucketCount * header.pilotSize;
+        if (slot >= header.keyCount) [[unlikely]] {
+            slot = readPacked(remap + (slot - header.keyCount) * header.remapSize, header.remapSize);
+        }
+        const auto* entries = remap + (header.tableSize - header.keyCount) * header.remapSize;
+        return entries + slot * header.entrySize;
+    }
+
+    template<bool Checked>
+    uint64_t priv::PerfectHashIndex::getEntry(uint64_t hash) const {
+        auto header = getHeader<Checked>();
+        ROFLDB_TRACE(touch(getPilotAddress<Checked>(hash), header.pilotSize));
+        ROFLDB_TRACE(touch(getEntryAddress<Checked>(hash), header.entrySize));
+        return readPacked(getEntryAddress<Checked>(hash), header.entrySize);
+    }
+
+    template<bool Checked>
+    std::optional<uint64_t> priv::PerfectHashIndex::lookup(const Key& key) const {
+        if (isEmpty<Checked>()) [[unlikely]] {
+            return std::nullopt;
+        }
+        return getEntry<Checked>(hashKey<Checked>(key));
+    }
+
+    void priv::PerfectHashIndex::verify(const Verifier& verifier, const PositionCheck& isPosition) const {
+        uint64_t size = getSize();
+        Verifier::require(size >= PILOTS_OFFSET, "Perfect hash index out of bounds");
+        auto header = getHeader<false>();
+        if (header.keyCount == 0) {
+            return;
+        }
+        auto isPackedSize = [](unsigned packedSize) {
+            return packedSize >= 1 && packedSize <= sizeof(uint64_t);
+        };
+        Verifier::require(isPackedSize(header.pilotSize) && isPackedSize(header.remapSize) && isPackedSize(header.entrySize),
+                          "Invalid perfect hash index entry size");
+        Verifier::require(header.tableSize >= header.keyCount && header.bucketCount >= 1, "Invalid perfect hash index size");
+        // overflow-safe: every table has to fit into what is left after the previous one
+        uint64_t remaining = size - PILOTS_OFFSET;
+        for (auto [count, packedSize] : {std::pair {header.bucketCount, header.pilotSize},
+                                         std::pair {header.tableSize - header.keyCount, header.remapSize},
+                                         std::pair {header.keyCount, header.entrySize}}) {
+            Verifier::require(remaining / packedSize >= count, "Perfect hash index out of bounds");
+            remaining -= count * packedSize;
+        }
+
+        const auto* remap = getPayloadAddress() + PILOTS_OFFSET + header.bucketCount * header.pilotSize;
+        const auto* entries = remap + (header.tableSize - header.keyCount) * header.remapSize;
+        verifier.parallelFor(header.tableSize - header.keyCount, [&](uint64_t begin, uint64_t end) {
+            for (auto idx = begin; idx < end; idx++) {
+                Verifier::require(readPacked(remap + idx * header.remapSize, header.remapSize) < header.keyCount, "Perfect hash index remap out of bounds");
+            }
+        });
+        verifier.parallelFor(header.keyCount, [&](uint64_t begin, uint64_t end) {
+            for (auto idx = begin; idx < end; idx++) {
+                Verifier::require(isPosition(readPacked(entries + idx * header.entrySize, header.entrySize)), "Perfect hash index entry is not a tree position");
+            }
+        });
+    }
+
+// END priv::PerfectHashIndex ==========================================================================================
+
+
+// priv::ValueBlocks ===================================================================================================
+
+    std::span<const std::byte> priv::ValueBlocks::getDictionary() const {
+        auto payloadReader = getPayloadReader();
+        auto size = payloadReader.read<uint32_t>();
+        return {payloadReader.skip(size), size};
+    }
+
+    uint64_t priv::ValueBlocks::getBlockCount() const {
+        auto payloadReader = getPayloadReader();
+        return payloadReader.read<uint64_t>(payloadReader.read<uint32_t>());
+    }
+
+    uint64_t priv::ValueBlocks::getBlockOffset(uint64_t blockIdx) const {
+        auto payloadReader = getPayloadReader();
+        payloadReader.skip(payloadReader.read<uint32_t>());
+        if (blockIdx >= payloadReader.read<uint64_t>()) [[unlikely]] {
+            throw Exceptions::data_corrupted_error("Out of bounds");
+        }
+        return payloadReader.read<uint64_t>(blockIdx * sizeof(uint64_t));
+    }
+
+    void priv::ValueBlocks::verify(const ValueCollection* valueCollection) const {
+        uint64_t size = getSize();
+        Verifier::require(size >= sizeof(uint32_t), "Value blocks out of bounds");
+        auto payloadReader = getPayloadReader<false>();
+        uint64_t dictionarySize = payloadReader.read<uint32_t>();
+        Verifier::require(size - sizeof(uint32_t) >= dictionarySize + sizeof(uint64_t), "Value blocks dictionary out of bounds");
+        payloadReader.skip(dictionarySize);
+        auto blockCount = payloadReader.read<uint64_t>();
+        Verifier::require(payloadReader.getRemaining() / sizeof(uint64_t) >= blockCount, "Value block offsets out of bounds");
+
+        uint64_t valuesSize = valueCollection->getSize();
+        for (uint64_t blockIdx = 0; blockIdx < blockCount; blockIdx++) {
+            auto blockOffset = payloadReader.read<uint64_t>();
+            Verifier::require(blockOffset <= valuesSize && valuesSize - blockOffset >= BLOCK_HEADER_SIZE, "Value block out of bounds");
+            auto blockReader = valueCollection->getReaderAt(blockOffset);
+            blockReader.skip<uint8_t>();
+            blockReader.skip<uint32_t>();  // raw size
+            uint64_t storedSize = blockReader.read<uint32_t>();
+            Verifier::require(valuesSize - blockOffset - BLOCK_HEADER_SIZE >= storedSize, "Value block out of bounds");
+        }
+    }
+
+// END priv::ValueBlocks ===============================================================================================
+
+
+DbReader::DbReader(std::byte* memAddress, std::size_t memLength, Options options) {
+    file = {memAddress, memLength};
+    Utils::PayloadReader payloadReader(memAddress, memLength);
+    if (std::memcmp(payloadReader.skip(sizeof MAGIC), MAGIC, sizeof MAGIC) != 0) {
+        throw Exceptions::magic_error("Invalid file magic");
+    }
+
+    versionField = payloadReader.read<uint16_t>();
+    auto version = static_cast<FormatVersion>(versionField & ~(COMPRESSED_VALUES_FLAG | LARGE_TREE_FLAG | INLINE_VALUES_FLAG | HOT_NODES_FLAG));
+    valueCollection = payloadReader.read<const priv::ValueCollection*>();
+    switch (version) {
+        case FormatVersion::SORTED_BINARY_TREE:
+            if (versionField & HOT_NODES_FLAG) {
+                tree = payloadReader.read<const priv::HotTree*>();
+            } else {
+                tree = payloadReader.read<const priv::Tree*>();
+            }
+            break;
+        case FormatVersion::EYTZINGER_TREE:
+            tree = payloadReader.read<const priv::EytzingerTree*>();
+            break;
+        case FormatVersion::WIDE_TREE:
+        case FormatVersion::PREFIX_COMPRESSED_WIDE_TREE:
+            if (versionField & LARGE_TREE_FLAG) {
+                tree = payloadReader.read<const priv::WideTree64*>();
+            } else {
+                tree = payloadReader.read<const priv::WideTree*>();
+            }
+            break;
+        case FormatVersion::INTEGER_KEYS:
+            tree = payloadReader.read<const priv::LearnedTree*>();
+            break;
+        default: [[unlikely]]
+            throw Exceptions::magic_error("Invalid format version");
+    }
+    treePayload = std::visit([](const auto* tree) {
+        return std::span<const std::byte>(reinterpret_cast<const std::byte*>(tree) + sizeof(tree->getSize()), tree->getSize());
+    }, tree);
+
+    while (payloadReader) {
+        auto tag = static_cast<SectionTag>(payloadReader.read<uint16_t>());
+        switch (tag) {
+            case SectionTag::BLOOM_FILTER:
+                filter = payloadReader.read<const priv::BloomFilter*>();
+                break;
+            case SectionTag::PERFECT_HASH_INDEX:
+                index = payloadReader.read<const priv::PerfectHashIndex*>();
+                break;
+            case SectionTag::VALUE_BLOCKS:
+                valueBlocks = payloadReader.read<const priv::ValueBlocks*>();
+                break;
+            default:
+                payloadReader.skip(sizeof(uint64_t) + payloadReader.read<uint64_t>());
+                break;
+        }
+    }
+
+    if (versionField & COMPRESSED_VALUES_FLAG) {
+        if (valueBlocks == nullptr) [[unlikely]] {
+            throw Exceptions::data_corrupted_error("Compressed values without the value blocks section");
+        }
+        valueBlockCache = std::make_shared<priv::ValueBlockCache>(valueCollection, valueBlocks, options.valueBlockCacheSize);
+    }
+
+    if constexpr (INSTRUMENTED) {
+        lookupCounters = std::make_shared<priv::LookupCounters>();
+    }
+    if (options.accessSampleInterval > 0) {
+        accessLog = std::make_shared<priv::AccessLog>(options.accessSampleInterval, options.accessLogCapacity);
+    }
+}
+
+template<bool Checked>
+Value DbReader::getValue(priv::ValueCollection::ValueOffsetType offset) const {
+    if (priv::ValueCollection::isInline(offset)) {
+        auto value = Utils::BasicPayloadReader<Checked>(treePayload.data(), treePayload.size())
+            .template read<Value>(offset & ~priv::ValueCollection::INLINE_VALUE_BIT);
+        ROFLDB_TRACE(touch(value.get() - sizeof(Value::SizeType), sizeof(Value::SizeType) + value.size()));
+        return value;
+    }
+    if (valueBlockCache) {
+        return valueBlockCache->getValue(offset);
+    }
+    auto value = valueCollection->getByOffset<Checked>(offset);
+    ROFLDB_TRACE(touch(value.get() - sizeof(Value::SizeType), sizeof(Value::SizeType) + value.size()));
+    return value;
+}
+
+std::optional<Value> DbReader::get(const Key& key) const {
+    return lookup<Utils::CHECK_BOUNDS>(key);
+}
+
+template<bool Checked>
+std::optional<Value> DbReader::lookup(const Key& key) const {
+#if ROFLDB_INSTRUMENTATION
+    priv::LookupScope lookupScope(lookupCounters.get());
+#endif
+    if (accessLog) [[unlikely]] {
+        accessLog->record(key);
+    }
+    if (filter != nullptr && !filter->mayContain<Checked>(key)) {
+        return std::nullopt;
+    }
+    auto offset = std::visit([this, &key](const auto* tree) {
+        return index != nullptr ? getIndexed<Checked>(*tree, key) : tree->template get<Checked>(key);
+    }, tree);
+    if (!offset.has_value()) [[unlikely]] {
+        return std::nullopt;
+    }
+    ROFLDB_TRACE(setHit());
+    return getValue<Checked>(*offset);
+}
+
+template<bool Checked, class TreeT>
+std::optional<priv::ValueCollection::ValueOffsetType> DbReader::getIndexed(const TreeT& tree, const Key& key) const {
+    auto packedPosition = index->lookup<Checked>(key);
+    if (!packedPosition) [[unlikely]] {
+        return std::nullopt;
+    }
+    auto position = TreeT::unpackPosition(*packedPosition);
+    if (!tree.template hasKeyAt<Checked>(position, key)) {
+        return std::nullopt;
+    }
+    return tree.template getValueOffset<Checked>(position);
+}
+
+std::span<const std::byte> DbReader::getTreeSection() const {
+    return std::visit([](const auto* tree) {
+        return std::span<const std::byte>(reinterpret_cast<const std::byte*>(tree), sizeof(tree->getSize()) + tree->getSize());
+    }, tree);
+}
+
+bool DbReader::forEachTreeNodeAtDepth(unsigned depth, const priv::NodeCallback& callback) const {
+    return std::visit([&](const auto* tree) { return tree->forEachNodeAtDepth(depth, callback); }, tree);
+}
+
+std::vector<DbReader::Section> DbReader::getSections() const {
+    auto getBytes = [](const auto* section) {
+        return std::span<const std::byte>(reinterpret_cast<const std::byte*>(section), sizeof(section->getSize()) + section->getSize());
+    };
+    std::vector<Section> sections {{"values", getBytes(valueCollection)}, {"tree", getTreeSection()}};
+    if (filter != nullptr) {
+        sections.push_back({"bloom filter", getBytes(filter)});
+    }
+    if (index != nullptr) {
+        sections.push_back({"perfect hash index", getBytes(index)});
+    }
+    if (valueBlocks != nullptr) {
+        sections.push_back({"value blocks", getBytes(valueBlocks)});
+    }
+    std::sort(sections.begin(), sections.end(), [](const Section& a, const Section& b) {
+        return a.bytes.data() < b.bytes.data();
+    });
+    return sections;
+}
+
+DbReader::Unchecked DbReader::getUnchecked() const {
+    if (!verified) [[unlikely]] {
+        throw std::logic_error("The file has not been verified");
+    }
+    if (valueBlockCache) [[unlikely]] {
+        throw Exceptions::unsupported_error("Unchecked lookups of compressed values");
+    }
+    return Unchecked(this);
+}
+
+std::optional<Value> DbReader::Unchecked::get(const Key& key) const noexcept {
+    return dbReader->lookup<false>(key);
+}
+
+std::optional<Value> DbReader::Unchecked::get(const std::string& key) const noexcept {
+    return get(Key((std::byte*)key.c_str(), key.size()));
+}
+
+void DbReader::Unchecked::getMany(std::span<const Key> keys, std::span<std::optional<Value>> values) const noexcept {
+    dbReader->lookupMany<false>(keys, values);
+}
+
+void DbReader::verify(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (const auto& section : getSections()) {
+        if (section.bytes.data() < file.data() || section.bytes.data() + section.bytes.size() > file.data() + file.size()
+            || section.bytes.size() > file.size()) [[unlikely]] {
+            throw Exceptions::data_corrupted_error(std::string("Section out of bounds: ") + section.name);
+        }
+    }
+    if (valueBlocks != nullptr) {
+        valueBlocks->verify(valueCollection);
+    }
+    priv::Verifier verifier(valueCollection, valueBlocks, versionField & INLINE_VALUES_FLAG ? treePayload : std::span<const std::byte>(), threadCount);
+    auto isPosition = std::visit([&verifier](const auto* tree) { return tree->verify(verifier); }, tree);
+    if (filter != nullptr) {
+        filter->verify();
+    }
+    if (index != nullptr) {
+        index->verify(verifier, isPosition);
+    }
+    verified = true;
+}
+
+LookupStats DbReader::getLookupStats() const {
+    return lookupCounters ? lookupCounters->getStats() : LookupStats();
+}
+
+AccessProfile DbReader::getAccessProfile() const {
+    return accessLog ? accessLog->getProfile() : AccessProfile();
+}
+
+std::optional<Value> DbReader::get(const std::string& key) const {
+    return get(Key((std::byte*)key.c_str(), key.size()));
+}
+
+std::optional<Value> DbReader::get(const std::vector<std::byte>& key) const {
+    return get(Key(key.data(), key.size()));
+}
+
+std::optional<Value> DbReader::get(uint64_t key) const {
+    std::byte bytes[priv::LearnedTree::KEY_SIZE];
+    priv::LearnedTree::encodeKey(key, bytes);
+    return get(Key(bytes, sizeof bytes));
+}
+
+DbReader::Cursor DbReader::getCursor() const {
+    return Cursor(*this);
+}
+
+DbReader::PrefixScan DbReader::scanPrefix(const Key& prefix) const {
+    return {getCursor(), prefix};
+}
+
+void DbReader::getMany(std::span<const Key> keys, std::span<std::optional<Value>> values) const {
+    if (keys.size() != values.size()) [[unlikely]] {
+        throw std::invalid_argument("Keys and values counts differ");
+    }
+    lookupMany<Utils::CHECK_BOUNDS>(keys, values);
+}
+
+template<bool Checked>
+void DbReader::lookupMany(std::span<const Key> keys, std::span<std::optional<Value>> values) const {
+    if (accessLog) [[unlikely]] {
+        for (const auto& key : keys) {
+            accessLog->record(key);
+        }
+    }
+    std::visit([&](const auto* tree) {
+        if (index != nullptr) {
+            getManyIndexed<Checked>(*tree, keys, values);
+        } else {
+            getMany<Checked>(*tree, keys, values);
+        }
+    }, tree);
+}
+
+template<bool Checked, class TreeT>
+void DbReader::getManyIndexed(const TreeT& tree, std::span<const Key> keys, std::span<std::optional<Value>> values) const {
+    if (index->isEmpty<Checked>()) [[unlikely]] {
+        std::fill(values.begin(), values.end(), std::nullopt);
+        return;
+    }
+
+    // The lookups are done in groups, stage by stage: every stage prefetches what the next one reads for the whole
+    // group (the pilots, the entries, the values), so the misses of a group overlap.
+    std::array<uint64_t, GET_MANY_IN_FLIGHT> hashes;
+    std::array<std::optional<priv::ValueCollection::ValueOffsetType>, GET_MANY_IN_FLIGHT> valueOffsets;
+    std::array<bool, GET_MANY_IN_FLIGHT> active;
+#if ROFLDB_INSTRUMENTATION
+    std::array<priv::LookupTrace, GET_MANY_IN_FLIGHT> traces;
+#endif
+    for (std::size_t start = 0; start < keys.size(); start += GET_MANY_IN_FLIGHT) {
+        auto count = std::min(GET_MANY_IN_FLIGHT, keys.size() - start);
+        for (std::size_t idx = 0; idx < count; idx++) {
+            const auto& key = keys[start + idx];
+#if ROFLDB_INSTRUMENTATION
+            traces[idx] = {};
+            priv::LookupTrace::Activation activation(&traces[idx]);
+#endif
+            active[idx] = filter == nullptr || filter->mayContain<Checked>(key);
+            if (active[idx]) {
+                hashes[idx] = index->hashKey<Checked>(key);
+                __builtin_prefetch(index->getPilotAddress<Checked>(hashes[idx]));
+            }
+        }
+        for (std::size_t idx = 0; idx < count; idx++) {
+            if (active[idx]) {
+                __builtin_prefetch(index->getEntryAddress<Checked>(hashes[idx]));
+            }
+        }
+        for (std::size_t idx = 0; idx < count; idx++) {
+            valueOffsets[idx].reset();
+            if (!active[idx]) {
+                continue;
+            }
+#if ROFLDB_INSTRUMENTATION
+            priv::LookupTrace::Activation activation(&traces[idx]);
+#endif
+            auto position = TreeT::unpackPosition(index->getEntry<Checked>(hashes[idx]));
+            if (tree.template hasKeyAt<Checked>(position, keys[start + idx])) {
+                valueOffsets[idx] = tree.template getValueOffset<Checked>(position);
+                // an inline value is next to the key just read
+                if (!valueBlockCache && !priv::ValueCollection::isInline(*valueOffsets[idx])) {
+                    valueCollection->prefetch(*valueOffsets[idx]);
+                }
+            }
+        }
+        for (std::size_t idx = 0; idx < count; idx++) {
+#if ROFLDB_INSTRUMENTATION
+            priv::LookupTrace::Activation activation(&traces[idx]);
+#endif
+            if (valueOffsets[idx]) {
+                ROFLDB_TRACE(setHit());
+                values[start + idx].emplace(getValue<Checked>(*valueOffsets[idx]));
+            } else {
+                values[start + idx].reset();
+            }
+#if ROFLDB_INSTRUMENTATION
+            lookupCounters->record(traces[idx]);
+#endif
+        }
+    }
+}
+
+template<bool Checked, class TreeT>
+void DbReader::getMany(const TreeT& tree, std::span<const Key> keys, std::span<std::optional<Value>> values) const {
+    struct Slot {
+        typename TreeT::Search search;
+        std::size_t keyIdx;
+#if ROFLDB_INSTRUMENTATION
+        priv::LookupTrace trace;
+#endif
+    };
+    std::array<Slot, GET_MANY_IN_FLIGHT> slots;
+    std::size_t inFlight = 0;
+    std::size_t nextKeyIdx = 0;
+
+    // the filter block of a key is prefetched when the key is this far from being started
+    constexpr std::size_t FILTER_PREFETCH_DISTANCE = GET_MANY_IN_FLIGHT;
+    if (filter != nullptr) {
+        for (std::size_t idx = 0; idx < std::min(keys.size(), FILTER_PREFETCH_DISTANCE); idx++) {
+            filter->prefetch(priv::BloomFilter::hashKey(keys[idx]));
+        }
+    }
+
+    auto startNext = [&](Slot& slot) {
+        while (nextKeyIdx < keys.size()) {
+            auto keyIdx = nextKeyIdx++;
+#if ROFLDB_INSTRUMENTATION
+            slot.trace = {};
+            priv::LookupTrace::Activation activation(&slot.trace);
+#endif
+            if (filter != nullptr) {
+                if (keyIdx + FILTER_PREFETCH_DISTANCE < keys.size()) {
+                    filter->prefetch(priv::BloomFilter::hashKey(keys[keyIdx + FILTER_PREFETCH_DISTANCE]));
+                }
+                if (!filter->mayContain<Checked>(keys[keyIdx])) {
+                    values[keyIdx].reset();
+#if ROFLDB_INSTRUMENTATION
+                    lookupCounters->record(slot.trace);
+#endif
+                    continue;
+                }
+            }
+            slot.search = tree.template startSearch<Checked>();
+            slot.keyIdx = keyIdx;
+            return true;
+        }
+        return false;
+    };
+
+    while (inFlight < slots.size() && startNext(slots[inFlight])) {
+        inFlight++;
+    }
+    // round-robin over the lookups in flight, replacing every finished one with the next key
+    while (inFlight > 0) {
+        for (std::size_t idx = 0; idx < inFlight;) {
+            auto& slot = slots[idx];
+            if (!slot.search.isDone()) {
+#if ROFLDB_INSTRUMENTATION
+                priv::LookupTrace::Activation activation(&slot.trace);
+#endif
+                tree.template advance<Checked>(slot.search, keys[slot.keyIdx]);
+                if (slot.search.isDone() && slot.search.valueOffset && !valueBlockCache && !priv::ValueCollection::isInline(*slot.search.valueOffset)) {
+                    // the value itself is read on the next round, when it had the time to arrive
+                    valueCollection->prefetch(*slot.search.valueOffset);
+                }
+                idx++;
+                continue;
+            }
+
+            if (slot.search.valueOffset) {
+#if ROFLDB_INSTRUMENTATION
+                priv::LookupTrace::Activation activation(&slot.trace);
+#endif
+                ROFLDB_TRACE(setHit());
+                values[slot.keyIdx].emplace(getValue<Checked>(*slot.search.valueOffset));
+            } else {
+                values[slot.keyIdx].reset();
+            }
+#if ROFLDB_INSTRUMENTATION
+            lookupCounters->record(slot.trace);
+#endif
+            if (!startNext(slot)) {
+                slot = slots[--inFlight];
+            }
+        }
+    }
+}
+
+
+// DbReader::Cursor ====================================================================================================
+
+DbReader::Cursor::Cursor(const DbReader& dbReader)
+    : valueCollection(dbReader.valueCollection),
+      treePayload(dbReader.treePayload),
+      valueBlockCache(dbReader.valueBlockCache),
+      state(std::visit([](const auto* tree) -> decltype(state) {
+          return TreePosition<std::remove_cvref_t<decltype(*tree)>>{tree, {}};
+      }, dbReader.tree)) {}
+
+bool DbReader::Cursor::seekFirst() {
+    treePath.clear();
+    std::visit([](auto& treePosition) { treePosition.position = treePosition.tree->first(); }, state);
+    return isValid();
+}
+
+bool DbReader::Cursor::seekLast() {
+    treePath.clear();
+    std::visit([](auto& treePosition) { treePosition.position = treePosition.tree->last(); }, state);
+    return isValid();
+}
+
+bool DbReader::Cursor::seekGE(const Key& key) {
+    treePath.clear();
+    std::visit([&key](auto& treePosition) { treePosition.position = treePosition.tree->seekGE(key); }, state);
+    return isValid();
+}
+
+bool DbReader::Cursor::seekLE(const Key& key) {
+    treePath.clear();
+    std::visit([&key](auto& treePosition) {
+        const auto* tree = treePosition.tree;
+        auto position = tree->seekGE(key);
+        if (!position) {
+            position = tree->last();
+        } else if (priv::KeyBuffer buffer; tree->getKey(position, buffer) != key) {
+            position = tree->prev(position);
+        }
+        treePosition.position = position;
+    }, state);
+    return isValid();
+}
+
+bool DbReader::Cursor::next() {
+    treePath.clear();
+    std::visit([](auto& treePosition) {
+        if (treePosition.position) {
+            treePosition.position = treePosition.tree->next(treePosition.position);
+        }
+    }, state);
+    return isValid();
+}
+
+bool DbReader::Cursor::prev() {
+    std::visit([this](auto& treePosition) {
+        if (!treePosition.position) {
+            return;
+        }
+        if constexpr (std::is_base_of_v<priv::Tree, std::remove_cvref_t<decltype(*treePosition.tree)>>) {
+            treePosition.position = treePosition.tree->prev(treePosition.position, treePath);
+        } else {
+            treePosition.position = treePosition.tree->prev(treePosition.position);
+        }
+    }, state);
+    return isValid();
+}
+
+bool DbReader::Cursor::isValid() const {
+    return std::visit([](const auto& treePosition) { return static_cast<bool>(treePosition.position); }, state);
+}
+
+Key DbReader::Cursor::getKey() const {
+    if (!isValid()) [[unlikely]] {
+        throw std::out_of_range("Cursor is not positioned at a key");
+    }
+    return std::visit([this](const auto& treePosition) { return treePosition.tree->getKey(treePosition.position, keyBuffer); }, state);
+}
+
+Value DbReader::Cursor::getValue() const {
+    if (!isValid()) [[unlikely]] {
+        throw std::out_of_range("Cursor is not positioned at a key");
+    }
+    auto valueOffset = getValueOffset();
+    if (priv::ValueCollection::isInline(valueOffset)) {
+        return Utils::PayloadReader(treePayload.data(), treePayload.size()).read<Value>(valueOffset & ~priv::ValueCollection::INLINE_VALUE_BIT);
+    }
+    if (valueBlockCache) {
+        return valueBlockCache->getValue(valueOffset);
+    }
+    return valueCollection->getByOffset(valueOffset);
+}
+
+priv::ValueCollection::ValueOffsetType DbReader::Cursor::getValueOffset() const {
+    if (!isValid()) [[unlikely]] {
+        throw std::out_of_range("Cursor is not positioned at a key");
+    }
+    return std::visit([](const auto& treePosition) {
+        return treePosition.tree->getValueOffset(treePosition.position);
+    }, state);
+}
+
+// END DbReader::Cursor ================================================================================================
+
+
+// DbReader::PrefixScan ================================================================================================
+
+DbReader::PrefixScan::Iterator DbReader::PrefixScan::begin() {
+    cursor.seekGE(prefix);
+    return {&cursor, &prefix};
+}
+
+DbReader::PrefixScan::Iterator::value_type DbReader::PrefixScan::Iterator::operator*() const {
+    return {cursor->getKey(), cursor->getValue()};
+}
+
+DbReader::PrefixScan::Iterator& DbReader::PrefixScan::Iterator::operator++() {
+    cursor->next();
+    return *this;
+}
+
+bool DbReader::PrefixScan::Iterator::operator==(std::default_sentinel_t) const {
+    return !cursor->isValid() || !cursor->getKey().startsWith(*prefix);
+}
+
+// END DbReader::PrefixScan ============================================================================================
 
 }
@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+#include "../include/exceptions.h"
+#include "../include/merge.h"
+
+namespace RoflDb {
+
+namespace {
+    // the keys are streamed in blocks of up to this size between the range threads and the output
+    constexpr std::size_t RANGE_BUFFER_SIZE = 1024 * 1024;
+    // how many keys a range merges between the checks whether another range failed
+    constexpr uint64_t CANCELLATION_CHECK_INTERVAL = 4096;
+
+    // Tournament over `n` sorted sources: `nodes[0]` is the source with the smallest current key and every inner node
+    // `i` (with children `2i` and `2i + 1`, the sources being the leaves from `n` on) holds the loser of its match.
+    // Once the winner moves on, only the matches on its path to the root are replayed, a comparison per level.
+    template<class Before>
+    class LoserTree {
+        std::vector<std::size_t> nodes;
+        Before before;
+
+    public:
+        // `before(a, b)`: whether the current key of source `a` goes first
+        LoserTree(std::size_t n, Before before) : nodes(n), before(std::move(before)) {
+            std::vector<std::size_t> winners(2 * n);
+            for (std::size_t idx = 0; idx < n; idx++) {
+                winners[n + idx] = idx;
+            }
+            for (std::size_t node = n - 1; node > 0; node--) {
+                auto a = winners[2 * node];
+                auto b = winners[2 * node + 1];
+                winners[node] = this->before(b, a) ? b : a;
+                nodes[node] = this->before(b, a) ? a : b;
+            }
+            nodes[0] = n > 1 ? winners[1] : 0;
+        }
+
+        [[nodiscard]] inline std::size_t top() const {
+            return nodes[0];
+        }
+
+        // after the current key of `top()` changed
+        inline void replay() {
+            auto winner = nodes[0];
+            for (auto node = (nodes.size() + winner) / 2; node > 0; node /= 2) {
+                if (before(nodes[node], winner)) {
+                    std::swap(nodes[node], winner);
+                }
+            }
+            nodes[0] = winner;
+        }
+    };
+
+    // including its size field
+    std::span<const std::byte> getValueSection(const DbFile& file) {
+        for (const auto& section : file.getReader().getSections()) {
+            if (std::strcmp(section.name, "values") == 0) {
+                return section.bytes;
+            }
+        }
+        throw Exceptions::data_corrupted_error("File has no value section");
+    }
+
+    Key makeKey(const std::string& key) {
+        return {reinterpret_cast<const std::byte*>(key.data()), key.size()};
+    }
+}
+
+    struct DbMerger::Range {
+        // the keys from `lowerKey` (inclusive) up to `upperKey` (exclusive), unbounded if not set
+        std::optional<std::string> lowerKey;
+        std::optional<std::string> upperKey;
+
+        // repeated <key size><key><value offset><value size>, then the u32 index of the input whose value section the
+        // value offset is within, or the value itself if the value offset is `INLINE_VALUE_BIT`
+        Utils::FileDescriptor keyFile;
+        uint64_t keyBytes = 0;
+
+        uint64_t inputKeys = 0;
+        uint64_t droppedDuplicates = 0;
+        uint64_t droppedValueBytes = 0;
+        bool done = false;
+        std::exception_ptr error;
+    };
+
+    DbMerger::DbMerger(std::span<const std::filesystem::path> inputPaths, Options options) : options(std::move(options)) {
+        if (inputPaths.empty()) {
+            throw std::invalid_argument("No files to merge");
+        }
+        if (this->options.threadCount == 0) {
+            this->options.threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (const auto& path : inputPaths) {
+            inputs.push_back(std::make_unique<DbFile>(path, this->options.inputOptions));
+        }
+    }
+
+    std::vector<std::string> DbMerger::sampleSplitKeys(std::size_t rangeCount) const {
+        if (rangeCount <= 1) {
+            return {};
+        }
+
+        // every sample stands for `SAMPLE_INTERVAL` keys of its input, so the samples of all the inputs weigh the same
+        std::vector<std::vector<std::string>> inputSamples(inputs.size());
+        std::vector<std::exception_ptr> errors(inputs.size());
+        {
+            std::vector<std::jthread> threads;
+            for (std::size_t idx = 0; idx < inputs.size(); idx++) {
+                threads.emplace_back([this, idx, &inputSamples, &errors]() {
+                    try {
+                        auto cursor = inputs[idx]->getReader().getCursor();
+                        uint64_t position = 0;
+                        for (bool valid = cursor.seekFirst(); valid; valid = cursor.next(), position++) {
+                            if (position % SAMPLE_INTERVAL == SAMPLE_INTERVAL / 2) {
+                                auto key = cursor.getKey();
+                                inputSamples[idx].emplace_back(reinterpret_cast<const char*>(key.get()), key.size());
+                            }
+                        }
+                    } catch (...) {
+                        errors[idx] = std::current_exception();
+                    }
+                });
+            }
+        }
+        for (const auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        std::vector<std::string> samples;
+        for (auto& input : inputSamples) {
+            std::move(input.begin(), input.end(), std::back_inserter(samples));
+        }
+        std::sort(samples.begin(), samples.end());
+
+        std::vector<std::string> splitKeys;
+        for (std::size_t idx = 1; idx < rangeCount && !samples.empty(); idx++) {
+            const auto& key = samples[idx * samples.size() / rangeCount];
+            if (splitKeys.empty() || splitKeys.back() < key) {
+                splitKeys.push_back(key);
+            }
+        }
+        return splitKeys;
+    }
+
+    void DbMerger::mergeRange(Range& range, const std::vector<bool>& copiedInputs, const std::atomic<bool>& cancelled) const {
+        std::vector<DbReader::Cursor> cursors;
+        std::vector<std::optional<Key>> keys;
+        cursors.reserve(inputs.size());
+        for (const auto& input : inputs) {
+            cursors.push_back(input->getReader().getCursor());
+        }
+        std::optional<Key> upperKey;
+        if (range.upperKey) {
+            upperKey.emplace(makeKey(*range.upperKey));
+        }
+        auto load = [&](std::size_t idx, bool valid) {
+            keys[idx].reset();
+            if (valid) {
+                auto key = cursors[idx].getKey();
+                if (!upperKey || key < *upperKey) {
+                    keys[idx].emplace(key);
+                }
+            }
+        };
+        keys.resize(cursors.size());
+        for (std::size_t idx = 0; idx < cursors.size(); idx++) {
+            load(idx, range.lowerKey ? cursors[idx].seekGE(makeKey(*range.lowerKey)) : cursors[idx].seekFirst());
+        }
+
+        // the exhausted sources go last, the entries of the same key from the one kept first
+        bool newestFirst = options.duplicates == Duplicates::NEWEST;
+        LoserTree tree(cursors.size(), [&keys, newestFirst](std::size_t a, std::size_t b) {
+            if (!keys[a] || !keys[b]) {
+                return keys[a].has_value();
+            }
+            auto order = *keys[a] <=> *keys[b];
+            return order < 0 || (order == 0 && (newestFirst ? a > b : a < b));
+        });
+
+        range.keyFile = Utils::FileDescriptor::createTemporary(options.outputOptions.temporaryDirectory);
+        Utils::BufferedFileWriter keyWriter(range.keyFile.get(), RANGE_BUFFER_SIZE);
+        // the values stay where they are in the copied value sections, the offsets of the others are inline
+        auto getValueOffset = [&](std::size_t idx) {
+            auto valueOffset = cursors[idx].getValueOffset();
+            return copiedInputs[idx] && !priv::ValueCollection::isInline(valueOffset) ? valueOffset : priv::ValueCollection::INLINE_VALUE_BIT;
+        };
+
+        std::vector<std::byte> lastKey;
+        while (keys[tree.top()]) {
+            if (range.inputKeys % CANCELLATION_CHECK_INTERVAL == 0 && cancelled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            auto idx = tree.top();
+            const auto& key = *keys[idx];
+            auto valueOffset = getValueOffset(idx);
+            auto value = cursors[idx].getValue();
+            keyWriter.write<Key::SizeType>(key.size());
+            keyWriter.write(key.get(), key.size());
+            keyWriter.write<priv::ValueCollection::ValueOffsetType>(valueOffset);
+            keyWriter.write<Value::SizeType>(value.size());
+            if (priv::ValueCollection::isInline(valueOffset)) {
+                keyWriter.write(value.get(), value.size());
+            } else {
+                keyWriter.write<uint32_t>(idx);
+            }
+            range.inputKeys++;
+            lastKey.assign(key.get(), key.get() + key.size());
+
+            load(idx, cursors[idx].next());
+            tree.replay();
+            Key mergedKey(lastKey.data(), lastKey.size());
+            while (keys[tree.top()] && *keys[tree.top()] == mergedKey) {
+                if (options.duplicates == Duplicates::FAIL) [[unlikely]] {
+                    throw Exceptions::duplicate_key_error("Key found in several files to merge");
+                }
+                auto droppedIdx = tree.top();
+                if (!priv::ValueCollection::isInline(getValueOffset(droppedIdx))) {
+                    range.droppedValueBytes += sizeof(Value::SizeType) + cursors[droppedIdx].getValue().size();
+                }
+                range.inputKeys++;
+                range.droppedDuplicates++;
+                load(droppedIdx, cursors[droppedIdx].next());
+                tree.replay();
+            }
+        }
+
+        keyWriter.flush();
+        range.keyBytes = keyWriter.tell();
+    }
+
+    DbMerger::Stats DbMerger::merge(const std::filesystem::path& outputPath) {
+        auto startedAt = std::chrono::steady_clock::now();
+        // the ranges come in order, so their keys go straight to the tree
+        auto outputOptions = options.outputOptions;
+        outputOptions.presorted = true;
+        // Compressed values are put into blocks and inline values into the tree, neither can be copied as they are. The
+        // value sections are copied whole, the values of the dropped duplicates included.
+        bool copyValues = outputOptions.valueBlockSize == 0 && outputOptions.inlineValueSize == 0;
+        std::vector<bool> copiedInputs(inputs.size());
+        for (std::size_t idx = 0; idx < inputs.size(); idx++) {
+            copiedInputs[idx] = copyValues && !(inputs[idx]->getReader().getVersionField() & DbReader::COMPRESSED_VALUES_FLAG);
+        }
+
+        auto splitKeys = sampleSplitKeys(static_cast<std::size_t>(options.threadCount) * std::max(1u, options.rangesPerThread));
+        std::vector<Range> ranges(splitKeys.size() + 1);
+        for (std::size_t idx = 0; idx < splitKeys.size(); idx++) {
+            ranges[idx].upperKey = splitKeys[idx];
+            ranges[idx + 1].lowerKey = splitKeys[idx];
+        }
+
+        std::mutex mutex;
+        std::condition_variable rangeDone;
+        std::atomic<std::size_t> nextRange = 0;
+        std::atomic<bool> cancelled = false;
+        auto work = [&]() {
+            std::size_t idx;
+            while (!cancelled.load(std::memory_order_relaxed) && (idx = nextRange.fetch_add(1)) < ranges.size()) {
+                auto& range = ranges[idx];
+                std::exception_ptr error;
+                try {
+                    mergeRange(range, copiedInputs, cancelled);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                std::lock_guard lock(mutex);
+                range.error = error;
+                range.done = true;
+                rangeDone.notify_all();
+            }
+        };
+        std::vector<std::thread> threads;
+        auto stopThreads = [&]() {
+            cancelled = true;
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            threads.clear();
+        };
+
+        // a file already at `outputPath` stays until the merge succeeded
+        auto temporaryPath = outputPath;
+        auto temporaryFile = Utils::FileDescriptor::createUnique(temporaryPath);
+        Stats stats;
+        stats.ranges = ranges.size();
+        stats.copiedValueSections = std::count(copiedInputs.begin(), copiedInputs.end(), true);
+        try {
+            for (unsigned idx = 0; idx < std::min<std::size_t>(options.threadCount, ranges.size()); idx++) {
+                threads.emplace_back(work);
+            }
+
+            // the value sections are copied while the ranges are being merged, which are then appended in order
+            DbWriter writer(std::move(temporaryFile), outputOptions);
+            std::vector<DbWriter::ValueOffsetType> valueSectionOffsets(inputs.size());
+            for (std::size_t idx = 0; idx < inputs.size(); idx++) {
+                if (copiedInputs[idx]) {
+                    // the payload, after the size field
+                    auto section = getValueSection(*inputs[idx]).subspan(sizeof(priv::ValueCollection::SizeType));
+                    auto offset = static_cast<uint64_t>(section.data() - inputs[idx]->getData().data());
+                    valueSectionOffsets[idx] = writer.appendValues(inputs[idx]->getFileDescriptor(), offset, section.size());
+                }
+            }
+
+            std::vector<std::byte> record;
+            for (auto& range : ranges) {
+                {
+                    std::unique_lock lock(mutex);
+                    rangeDone.wait(lock, [&range]() { return range.done; });
+                }
+                if (range.error) {
+                    std::rethrow_exception(range.error);
+                }
+                stats.inputKeys += range.inputKeys;
+                stats.droppedDuplicates += range.droppedDuplicates;
+                stats.droppedValueBytes += range.droppedValueBytes;
+
+                Utils::BufferedFileReader keyReader(range.keyFile.get(), RANGE_BUFFER_SIZE, 0, range.keyBytes);
+                Key::SizeType keySize;
+                while (keyReader.read(keySize)) {
+                    DbWriter::ValueOffsetType valueOffset;
+                    Value::SizeType valueSize;
+                    record.resize(keySize);
+                    if ((keySize > 0 && !keyReader.read(record.data(), keySize)) || !keyReader.read(valueOffset) || !keyReader.read(valueSize)) {
+                        throw Exceptions::io_error("Truncated merged range");
+                    }
+                    if (!priv::ValueCollection::isInline(valueOffset)) {
+                        uint32_t inputIdx;
+                        if (!keyReader.read(inputIdx)) {
+                            throw Exceptions::io_error("Truncated merged range");
+                        }
+                        writer.putAppended(Key(record.data(), keySize), valueSectionOffsets[inputIdx] + valueOffset, valueSize);
+                        continue;
+                    }
+                    record.resize(keySize + valueSize);
+                    if (valueSize > 0 && !keyReader.read(record.data() + keySize, valueSize)) {
+                        throw Exceptions::io_error("Truncated merged range");
+                    }
+                    writer.put(Key(record.data(), keySize), Value(record.data() + keySize, valueSize));
+                }
+                range.keyFile = {};
+            }
+            stats.output = writer.finish();
+            std::filesystem::rename(temporaryPath, outputPath);
+        } catch (...) {
+            stopThreads();
+            std::error_code ignored;
+            std::filesystem::remove(temporaryPath, ignored);
+            throw;
+        }
+        stopThreads();
+
+        stats.output.elapsed = std::chrono::steady_clock::now() - startedAt;
+        return stats;
+    }
+
+}
@@ -0,0 +1,440 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <sys/mman.h>
+
+#include "../include/exceptions.h"
+#include "../include/paged.h"
+
+namespace RoflDb {
+
+namespace {
+    // the tree fields read by `startSearch` and by every step (the root offset, the node count or the learned tree
+    // header), following the size field
+    constexpr uint64_t TREE_HEADER_SIZE = 64;
+
+    constexpr uint64_t PAGE_COUNT_BITS = 8;
+}
+
+// PagedDbFile =========================================================================================================
+
+    PagedDbFile::PagedDbFile(const std::filesystem::path& path, Options options)
+        : options(options),
+          file(Utils::FileDescriptor::open(path, options.directIo)),
+          fileSize(file.size()),
+          mappingSize(std::max<uint64_t>(1, (fileSize + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE),
+          pages(mappingSize / PAGE_SIZE),
+          cachePages(std::max<uint64_t>(1, options.cacheBytes / PAGE_SIZE)) {
+        data = static_cast<std::byte*>(Utils::mapAnonymous(mappingSize));
+        // the pages are evicted one by one
+        ::madvise(data, mappingSize, MADV_NOHUGEPAGE);
+        try {
+            // the fields the `DbReader` constructor walks, and the filter which is checked before every lookup
+            loadPinned(0, sizeof DbReader::MAGIC + sizeof(uint16_t));
+            if (std::memcmp(data, DbReader::MAGIC, sizeof DbReader::MAGIC) != 0) {
+                throw Exceptions::magic_error("Invalid file magic");
+            }
+            auto versionField = readPinned<uint16_t>(sizeof DbReader::MAGIC);
+            if (versionField & DbReader::COMPRESSED_VALUES_FLAG) {
+                throw Exceptions::unsupported_error("Compressed values are not supported by PagedDbFile");
+            }
+            uint64_t offset = sizeof DbReader::MAGIC + sizeof(uint16_t);
+            auto valuesSize = readPinned<priv::ValueCollection::SizeType>(offset);
+            if (valuesSize > fileSize - offset - sizeof(priv::ValueCollection::SizeType)) {
+                throw Exceptions::data_corrupted_error("Out of bounds");
+            }
+            offset += sizeof(priv::ValueCollection::SizeType) + valuesSize;
+
+            uint64_t treeSize;
+            uint64_t treeSizeFieldSize;
+            switch (static_cast<FormatVersion>(versionField & ~(DbReader::COMPRESSED_VALUES_FLAG | DbReader::LARGE_TREE_FLAG | DbReader::INLINE_VALUES_FLAG
+                                                                | DbReader::HOT_NODES_FLAG))) {
+                case FormatVersion::SORTED_BINARY_TREE:
+                case FormatVersion::EYTZINGER_TREE:
+                    treeSizeFieldSize = sizeof(uint32_t);
+                    treeSize = readPinned<uint32_t>(offset);
+                    break;
+                case FormatVersion::WIDE_TREE:
+                case FormatVersion::PREFIX_COMPRESSED_WIDE_TREE:
+                case FormatVersion::INTEGER_KEYS:
+                    if (versionField & DbReader::LARGE_TREE_FLAG || static_cast<FormatVersion>(versionField & 0xFF) == FormatVersion::INTEGER_KEYS) {
+                        treeSizeFieldSize = sizeof(uint64_t);
+                        treeSize = readPinned<uint64_t>(offset);
+                    } else {
+                        treeSizeFieldSize = sizeof(uint32_t);
+                        treeSize = readPinned<uint32_t>(offset);
+                    }
+                    break;
+                default:
+                    throw Exceptions::magic_error("Invalid format version");
+            }
+            offset += treeSizeFieldSize;
+            loadPinned(offset, std::min(treeSize, TREE_HEADER_SIZE));
+            offset += std::min(treeSize, fileSize - offset);
+
+            while (offset < fileSize) {
+                auto tag = static_cast<SectionTag>(readPinned<uint16_t>(offset));
+                offset += sizeof(uint16_t);
+                auto size = readPinned<uint64_t>(offset);
+                if (size > fileSize - offset - sizeof(uint64_t)) {
+                    throw Exceptions::data_corrupted_error("Out of bounds");
+                }
+                if (tag == SectionTag::BLOOM_FILTER) {
+                    loadPinned(offset, sizeof(uint64_t) + size);
+                }
+                offset += sizeof(uint64_t) + size;
+            }
+            reader.emplace(data, fileSize);
+        } catch (...) {
+            Utils::unmap(data, mappingSize);
+            throw;
+        }
+
+        if (options.ioBackend == IoBackend::IO_URING) {
+            try {
+                ioRing = std::make_unique<Utils::IoRing>(std::max(1u, options.queueDepth));
+            } catch (const Exceptions::io_error&) {
+                // e.g. disabled by `kernel.io_uring_disabled` or by a seccomp filter
+            }
+        }
+    }
+
+    PagedDbFile::~PagedDbFile() {
+        // the kernel must not write into the pages once they are unmapped
+        if (ioRing != nullptr) {
+            ioRing->submitAndReap(UINT_MAX, [](uint64_t, int) {});
+        }
+        Utils::unmap(data, mappingSize);
+    }
+
+    void PagedDbFile::loadPinned(uint64_t offset, uint64_t size) {
+        if (offset > fileSize || size > fileSize - offset) {
+            throw Exceptions::data_corrupted_error("Out of bounds");
+        }
+        if (size == 0) {
+            return;
+        }
+        auto endPage = (offset + size - 1) / PAGE_SIZE + 1;
+        for (auto page = offset / PAGE_SIZE; page < endPage; page++) {
+            if (pages[page] & RESIDENT) {
+                if (!(pages[page] & PINNED)) {
+                    pages[page] |= PINNED;
+                    stats.pinnedPages++;
+                }
+            } else {
+                load(page, 1, true);
+            }
+        }
+    }
+
+    template<class T>
+    T PagedDbFile::readPinned(uint64_t offset) {
+        loadPinned(offset, sizeof(T));
+        return Utils::read<T>(data + offset);
+    }
+
+    bool PagedDbFile::ensure(Lookup& lookup, const priv::PendingRead& read, bool pin) {
+        auto begin = std::min<uint64_t>(read.address - data, fileSize);
+        auto size = read.size;
+        if (read.sizeFieldBytes > 0) {
+            auto fieldEnd = std::min<uint64_t>(begin + read.sizeFieldBytes, fileSize);
+            if (!ensureRange(lookup, begin, fieldEnd, pin)) {
+                return false;
+            }
+            // a truncated size field is left to the bounds checks of the step
+            if (fieldEnd - begin == read.sizeFieldBytes) {
+                uint64_t sizeField = 0;
+                for (unsigned i = 0; i < read.sizeFieldBytes; i++) {
+                    sizeField |= static_cast<uint64_t>(read.address[i]) << (8 * i);
+                }
+                size += std::min(sizeField, fileSize);
+            }
+        }
+        return ensureRange(lookup, begin, std::min(begin + size, fileSize), pin);
+    }
+
+    bool PagedDbFile::ensureRange(Lookup& lookup, uint64_t begin, uint64_t end, bool pin) {
+        if (begin >= end) {
+            return true;
+        }
+        protectedBegin = begin / PAGE_SIZE;
+        protectedEnd = (end - 1) / PAGE_SIZE + 1;
+        std::optional<uint64_t> missingPage;
+        for (auto page = protectedBegin; page < protectedEnd;) {
+            auto& flags = pages[page];
+            if (pin && !(flags & PINNED) && (flags & (RESIDENT | LOADING))) {
+                flags |= PINNED;
+                stats.pinnedPages++;
+            }
+            if (flags & RESIDENT) {
+                stats.pageHits++;
+                flags |= REFERENCED;
+                page++;
+                continue;
+            }
+            stats.pageMisses++;
+            if (!missingPage) {
+                missingPage = page;
+            }
+            if (flags & LOADING) {
+                page++;
+                continue;
+            }
+            // the adjacent missing pages are read at once
+            auto runEnd = page + 1;
+            while (runEnd < protectedEnd && runEnd - page < MAX_READ_PAGES && !(pages[runEnd] & (RESIDENT | LOADING))) {
+                runEnd++;
+            }
+            load(page, runEnd - page, pin);
+            page = runEnd;
+        }
+        if (!missingPage || ioRing == nullptr) {
+            // read synchronously, the range itself is not evicted meanwhile
+            return true;
+        }
+        waiters[*missingPage].push_back(&lookup);
+        return false;
+    }
+
+    void PagedDbFile::load(uint64_t firstPage, uint64_t pageCount, bool pin) {
+        makeRoom(pageCount);
+        for (auto page = firstPage; page < firstPage + pageCount; page++) {
+            pages[page] = LOADING | (pin ? PINNED : 0);
+        }
+        if (pin) {
+            stats.pinnedPages += pageCount;
+        }
+        loadingPages += pageCount;
+        stats.reads++;
+
+        auto offset = firstPage * PAGE_SIZE;
+        auto size = pageCount * PAGE_SIZE;
+        if (ioRing != nullptr) {
+            auto userData = (firstPage << PAGE_COUNT_BITS) | pageCount;
+            while (!ioRing->queueRead(file.get(), data + offset, size, offset, userData)) {
+                reap(1);
+            }
+            return;
+        }
+        completeRead((firstPage << PAGE_COUNT_BITS) | pageCount, static_cast<int>(Utils::readAt(file.get(), data + offset, size, offset)));
+    }
+
+    void PagedDbFile::completeRead(uint64_t userData, int result) {
+        if (result < 0) {
+            throw Exceptions::io_error(std::string("read failed: ") + std::strerror(-result));
+        }
+        auto firstPage = userData >> PAGE_COUNT_BITS;
+        auto pageCount = userData & ((uint64_t(1) << PAGE_COUNT_BITS) - 1);
+        auto offset = firstPage * PAGE_SIZE;
+        auto expected = std::min(pageCount * PAGE_SIZE, fileSize - offset);
+        uint64_t done = result;
+        if (done < expected) {
+            // short reads are allowed, rare on regular files
+            done += Utils::readAt(file.get(), data + offset + done, expected - done, offset + done);
+            if (done < expected) {
+                throw Exceptions::io_error("The file was truncated while being read");
+            }
+        }
+        stats.readBytes += done;
+        markLoaded(firstPage, pageCount);
+    }
+
+    void PagedDbFile::markLoaded(uint64_t firstPage, uint64_t pageCount) {
+        loadingPages -= pageCount;
+        stats.residentPages += pageCount;
+        for (auto page = firstPage; page < firstPage + pageCount; page++) {
+            pages[page] = (pages[page] & PINNED) | RESIDENT | REFERENCED;
+            if (!(pages[page] & PINNED)) {
+                clock.push_back(page);
+            }
+            auto pageWaiters = waiters.find(page);
+            if (pageWaiters != waiters.end()) {
+                ready.insert(ready.end(), pageWaiters->second.begin(), pageWaiters->second.end());
+                waiters.erase(pageWaiters);
+            }
+        }
+    }
+
+    void PagedDbFile::makeRoom(uint64_t pageCount) {
+        while (stats.residentPages + loadingPages + pageCount > cachePages && evictOne()) {}
+    }
+
+    bool PagedDbFile::evictOne() {
+        // every page gets a second chance, so two rounds find one unless all of them are pinned or protected
+        for (std::size_t visited = 0, limit = 2 * clock.size(); visited < limit && !clock.empty(); visited++) {
+            if (clockHand >= clock.size()) {
+                clockHand = 0;
+            }
+            auto page = clock[clockHand];
+            auto& flags = pages[page];
+            if (flags & PINNED) {
+                clock[clockHand] = clock.back();
+                clock.pop_back();
+                continue;
+            }
+            if (page >= protectedBegin && page < protectedEnd) {
+                clockHand++;
+                continue;
+            }
+            if (flags & REFERENCED) {
+                flags &= ~REFERENCED;
+                clockHand++;
+                continue;
+            }
+            ::madvise(data + page * PAGE_SIZE, PAGE_SIZE, MADV_DONTNEED);
+            flags = 0;
+            clock[clockHand] = clock.back();
+            clock.pop_back();
+            stats.residentPages--;
+            stats.evictions++;
+            return true;
+        }
+        return false;
+    }
+
+    bool PagedDbFile::resume(Lookup& lookup) {
+        Key key(lookup.keyAddress, lookup.keySize);
+        if (!lookup.filterChecked) {
+            lookup.filterChecked = true;
+            if (reader->filter != nullptr && !reader->filter->mayContain<true>(key)) {
+                lookup.callback(std::nullopt);
+                return true;
+            }
+        }
+        return std::visit([this, &lookup, &key](const auto* tree) {
+            using TreeT = std::remove_cvref_t<decltype(*tree)>;
+            auto& search = std::get<typename TreeT::Search>(lookup.search);
+            // an Eytzinger tree level takes two steps (the offset, then the node), the learned model is the top level
+            auto pinnedSteps = options.pinnedTreeLevels * (std::is_same_v<TreeT, priv::EytzingerTree> ? 2 : 1);
+            while (!search.isDone()) {
+                if (!ensure(lookup, tree->getPendingRead(search), lookup.step < pinnedSteps)) {
+                    return false;
+                }
+                tree->template advance<true>(search, key);
+                lookup.step++;
+            }
+            if (!search.valueOffset) {
+                lookup.callback(std::nullopt);
+                return true;
+            }
+            if (priv::ValueCollection::isInline(*search.valueOffset)) {
+                // usually on the page of the node just read
+                auto offset = *search.valueOffset & ~priv::ValueCollection::INLINE_VALUE_BIT;
+                const auto& treePayload = reader->treePayload;
+                if (!ensure(lookup, {treePayload.data() + std::min(offset, treePayload.size()), sizeof(Value::SizeType), sizeof(Value::SizeType)}, false)) {
+                    return false;
+                }
+                lookup.callback(Utils::BasicPayloadReader<true>(treePayload.data(), treePayload.size()).read<Value>(offset));
+                return true;
+            }
+            const auto* values = reader->valueCollection;
+            if (!ensure(lookup, values->getPendingRead(*search.valueOffset), false)) {
+                return false;
+            }
+            lookup.callback(values->getByOffsetChecked(*search.valueOffset));
+            return true;
+        }, reader->tree);
+    }
+
+    void PagedDbFile::release(Lookup* lookup) {
+        lookup->callback = nullptr;
+        freeLookups.push_back(lookup);
+    }
+
+    void PagedDbFile::drain() {
+        if (draining) {
+            return;
+        }
+        draining = true;
+        while (!ready.empty()) {
+            auto* lookup = ready.front();
+            ready.pop_front();
+            try {
+                if (resume(*lookup)) {
+                    release(lookup);
+                }
+            } catch (...) {
+                release(lookup);
+                draining = false;
+                throw;
+            }
+            if (ready.empty() && ioRing != nullptr) {
+                // submits the reads of the lookups and picks up the ones completed meanwhile
+                reap(0);
+            }
+        }
+        draining = false;
+    }
+
+    void PagedDbFile::reap(unsigned minCompleted) {
+        ioRing->submitAndReap(minCompleted, [this](uint64_t userData, int result) {
+            completeRead(userData, result);
+        });
+    }
+
+    void PagedDbFile::getAsync(const Key& key, Callback callback) {
+        Lookup* lookup;
+        if (freeLookups.empty()) {
+            lookups.push_back(std::make_unique<Lookup>());
+            lookup = lookups.back().get();
+        } else {
+            lookup = freeLookups.back();
+            freeLookups.pop_back();
+        }
+        lookup->keyAddress = key.get();
+        lookup->keySize = key.size();
+        lookup->callback = std::move(callback);
+        // reads the tree header only, which is pinned
+        lookup->search = std::visit([](const auto* tree) -> Search { return tree->template startSearch<true>(); }, reader->tree);
+        lookup->step = 0;
+        lookup->filterChecked = false;
+        stats.lookups++;
+        ready.push_back(lookup);
+        drain();
+    }
+
+    std::size_t PagedDbFile::poll() {
+        if (ioRing != nullptr) {
+            reap(0);
+        }
+        drain();
+        return lookups.size() - freeLookups.size();
+    }
+
+    void PagedDbFile::wait(std::size_t maxInFlight) {
+        drain();
+        while (lookups.size() - freeLookups.size() > maxInFlight) {
+            if (ioRing == nullptr) [[unlikely]] {
+                throw std::logic_error("Lookups waiting without reads in flight");
+            }
+            reap(1);
+            drain();
+        }
+    }
+
+    std::optional<Value> PagedDbFile::get(const Key& key) {
+        if (draining) {
+            throw std::logic_error("PagedDbFile::get called from a lookup callback");
+        }
+        std::optional<Value> result;
+        getAsync(key, [&result](std::optional<Value> value) {
+            if (value) {
+                auto copy = std::make_shared<std::vector<std::byte>>(value->get(), value->get() + value->size());
+                result.emplace(copy->data(), copy->size(), copy);
+            }
+        });
+        wait();
+        return result;
+    }
+
+    std::optional<Value> PagedDbFile::get(const std::string& key) {
+        return get(Key(reinterpret_cast<const std::byte*>(key.data()), key.size()));
+    }
+
+// END PagedDbFile =====================================================================================================
+
+}
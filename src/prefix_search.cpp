@@ -0,0 +1,96 @@
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "../include/mmaped.h"
+#include "../include/prefix_search.h"
+
+namespace RoflDb::Utils {
+
+namespace {
+    using PrefixRankKernel = PrefixRank (*)(const std::byte* prefixes, unsigned count, uint64_t prefix);
+
+    PrefixRank rankPrefixScalar(const std::byte* prefixes, unsigned count, uint64_t prefix) {
+        PrefixRank rank {0, 0};
+        for (unsigned i = 0; i < count; i++) {
+            auto nodePrefix = Utils::read<uint64_t>(prefixes + i * sizeof(uint64_t));
+            rank.less += nodePrefix < prefix;
+            rank.lessOrEqual += nodePrefix <= prefix;
+        }
+        return rank;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // There are only signed 64-bit comparisons, so both sides get their sign bit flipped to compare them as unsigned.
+    constexpr uint64_t SIGN_BIT = uint64_t(1) << 63;
+
+    __attribute__((target("sse4.2,popcnt")))
+    PrefixRank rankPrefixSse42(const std::byte* prefixes, unsigned count, uint64_t prefix) {
+        const auto signBit = _mm_set1_epi64x(static_cast<long long>(SIGN_BIT));
+        const auto searched = _mm_xor_si128(_mm_set1_epi64x(static_cast<long long>(prefix)), signBit);
+
+        unsigned less = 0, greater = 0;
+        unsigned i = 0;
+        for (; i + 2 <= count; i += 2) {
+            auto nodePrefixes = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prefixes + i * sizeof(uint64_t))), signBit);
+            less += std::popcount(static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(searched, nodePrefixes)))));
+            greater += std::popcount(static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(nodePrefixes, searched)))));
+        }
+        auto tail = rankPrefixScalar(prefixes + i * sizeof(uint64_t), count - i, prefix);
+        return {less + tail.less, i - greater + tail.lessOrEqual};
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    PrefixRank rankPrefixAvx2(const std::byte* prefixes, unsigned count, uint64_t prefix) {
+        const auto signBit = _mm256_set1_epi64x(static_cast<long long>(SIGN_BIT));
+        const auto searched = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(prefix)), signBit);
+
+        unsigned less = 0, greater = 0;
+        unsigned i = 0;
+        for (; i + 4 <= count; i += 4) {
+            auto nodePrefixes = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(prefixes + i * sizeof(uint64_t))), signBit);
+            less += std::popcount(static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(searched, nodePrefixes)))));
+            greater += std::popcount(static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(nodePrefixes, searched)))));
+        }
+        auto tail = rankPrefixScalar(prefixes + i * sizeof(uint64_t), count - i, prefix);
+        return {less + tail.less, i - greater + tail.lessOrEqual};
+    }
+#endif
+
+    struct Kernel {
+        PrefixRankKernel function;
+        const char* name;
+    };
+
+    Kernel selectKernel() {
+#if defined(__x86_64__) || defined(__i386__)
+        if constexpr (std::endian::native == std::endian::little) {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) {
+                return {rankPrefixAvx2, "avx2"};
+            }
+            if (__builtin_cpu_supports("sse4.2")) {
+                return {rankPrefixSse42, "sse4.2"};
+            }
+        }
+#endif
+        return {rankPrefixScalar, "scalar"};
+    }
+
+    const Kernel& getKernel() {
+        static const Kernel kernel = selectKernel();
+        return kernel;
+    }
+}
+
+    PrefixRank rankPrefix(const std::byte* prefixes, unsigned count, uint64_t prefix) {
+        return getKernel().function(prefixes, count, prefix);
+    }
+
+    const char* getPrefixRankKernelName() {
+        return getKernel().name;
+    }
+
+}
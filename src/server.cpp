@@ -0,0 +1,392 @@
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../include/exceptions.h"
+#include "../include/server.h"
+
+namespace RoflDb {
+
+namespace {
+    // read from a connection at once (at least)
+    constexpr std::size_t READ_SIZE = 64 * 1024;
+    constexpr int MAX_EVENTS = 64;
+    // `epoll_event::data` of the listening socket and of the stop event, the connections have their addresses there
+    constexpr uint64_t LISTENER_EVENT = 0;
+    constexpr uint64_t STOP_EVENT = 1;
+
+    Exceptions::io_error makeIoError(const std::string& what) {
+        return Exceptions::io_error(what + ": " + std::strerror(errno));
+    }
+
+    // only ever written by the thread owning the counter
+    void add(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    sockaddr_un makeAddress(const std::filesystem::path& path) {
+        sockaddr_un address {};
+        address.sun_family = AF_UNIX;
+        if (path.native().size() >= sizeof address.sun_path) {
+            throw std::invalid_argument("Socket path too long: " + path.string());
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.native().size() + 1);
+        return address;
+    }
+
+    bool isListening(const sockaddr_un& address) {
+        Utils::FileDescriptor probe(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (probe.get() < 0) {
+            throw makeIoError("socket failed");
+        }
+        return ::connect(probe.get(), reinterpret_cast<const sockaddr*>(&address), sizeof address) == 0;
+    }
+
+    void writeError(std::vector<std::byte>& output, uint32_t requestId, const std::string& message) {
+        Protocol::MessageWriter response(output);
+        auto size = std::min<std::size_t>(message.size(), Protocol::MAX_REQUEST_SIZE);
+        response.write<uint32_t>(sizeof(uint32_t) + sizeof(Protocol::Status) + size);
+        response.write(requestId);
+        response.write(Protocol::Status::ERROR);
+        response.write(reinterpret_cast<const std::byte*>(message.data()), size);
+    }
+}
+
+    struct DbServer::Connection {
+        Utils::FileDescriptor socket;
+        // the bytes received from the start of the first request not answered yet, up to `inputSize`
+        std::vector<std::byte> input;
+        std::size_t inputSize = 0;
+        // the client shut its side down, the connection is closed once the responses it is owed are sent
+        bool inputClosed = false;
+        // the responses, sent up to `outputSent`
+        std::vector<std::byte> output;
+        std::size_t outputSent = 0;
+        // the events the connection is registered for
+        uint32_t events = EPOLLIN;
+    };
+
+    DbServer::DbServer(const std::filesystem::path& socketPath, std::span<const std::filesystem::path> paths, Options options)
+        : options(std::move(options)), socketPath(socketPath) {
+        if (this->options.threadCount == 0) {
+            this->options.threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        if (paths.size() > std::numeric_limits<uint16_t>::max() + std::size_t(1)) {
+            throw std::invalid_argument("Too many files to serve");
+        }
+        for (const auto& path : paths) {
+            const auto& file = files.emplace_back(std::make_unique<DbFile>(path, this->options.fileOptions));
+            const auto& reader = file->getReader();
+            if (reader.isVerified() && !(reader.getVersionField() & DbReader::COMPRESSED_VALUES_FLAG)) {
+                uncheckedReaders.emplace_back(reader.getUnchecked());
+            } else {
+                uncheckedReaders.emplace_back();
+            }
+        }
+
+        auto address = makeAddress(socketPath);
+        if (isListening(address)) {
+            throw Exceptions::io_error("A server is listening at " + socketPath.string() + " already");
+        }
+        if (::unlink(socketPath.c_str()) != 0 && errno != ENOENT) {
+            throw makeIoError("Could not remove " + socketPath.string());
+        }
+        listener = Utils::FileDescriptor(::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+        if (listener.get() < 0) {
+            throw makeIoError("socket failed");
+        }
+        if (::bind(listener.get(), reinterpret_cast<const sockaddr*>(&address), sizeof address) != 0) {
+            throw makeIoError("Could not bind " + socketPath.string());
+        }
+        if (::listen(listener.get(), SOMAXCONN) != 0) {
+            ::unlink(socketPath.c_str());
+            throw makeIoError("listen failed");
+        }
+        stopEvent = Utils::FileDescriptor(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+        if (stopEvent.get() < 0) {
+            ::unlink(socketPath.c_str());
+            throw makeIoError("eventfd failed");
+        }
+        for (unsigned idx = 0; idx < this->options.threadCount; idx++) {
+            counters.push_back(std::make_unique<WorkerCounters>());
+        }
+    }
+
+    DbServer::~DbServer() {
+        ::unlink(socketPath.c_str());
+    }
+
+    void DbServer::run() {
+        std::mutex errorMutex;
+        std::exception_ptr error;
+        {
+            std::vector<std::jthread> workers;
+            for (const auto& workerCounters : counters) {
+                workers.emplace_back([&, workerCounters = workerCounters.get()]() {
+                    try {
+                        serve(*workerCounters);
+                    } catch (...) {
+                        std::lock_guard lock(errorMutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                        stop();
+                    }
+                });
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void DbServer::stop() const {
+        uint64_t increment = 1;
+        // can only fail if the counter would overflow, which is as good as signalled
+        [[maybe_unused]] auto written = ::write(stopEvent.get(), &increment, sizeof increment);
+    }
+
+    DbServer::Stats DbServer::getStats() const {
+        Stats stats;
+        for (const auto& workerCounters : counters) {
+            stats.connections += workerCounters->connections.load(std::memory_order_relaxed);
+            stats.requests += workerCounters->requests.load(std::memory_order_relaxed);
+            stats.keys += workerCounters->keys.load(std::memory_order_relaxed);
+            stats.errors += workerCounters->errors.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+    void DbServer::serve(WorkerCounters& workerCounters) const {
+        Utils::FileDescriptor epoll(::epoll_create1(EPOLL_CLOEXEC));
+        if (epoll.get() < 0) {
+            throw makeIoError("epoll_create1 failed");
+        }
+        auto control = [&epoll](int operation, int fd, uint32_t events, uint64_t data) {
+            epoll_event event {};
+            event.events = events;
+            event.data.u64 = data;
+            if (::epoll_ctl(epoll.get(), operation, fd, &event) != 0) {
+                throw makeIoError("epoll_ctl failed");
+            }
+        };
+        control(EPOLL_CTL_ADD, listener.get(), EPOLLIN | EPOLLEXCLUSIVE, LISTENER_EVENT);
+        control(EPOLL_CTL_ADD, stopEvent.get(), EPOLLIN, STOP_EVENT);
+        // closing a connection socket takes it out of the epoll set
+        std::unordered_map<Connection*, std::unique_ptr<Connection>> connections;
+
+        // `false` once the connection is to be closed
+        auto handle = [&](Connection& connection, uint32_t ready) {
+            auto pending = [&connection]() {
+                return connection.output.size() - connection.outputSent;
+            };
+            if ((ready & EPOLLIN) && !connection.inputClosed) {
+                // until there is nothing more to read, or until the client reads the responses piled up
+                while (pending() < options.maxPendingResponseBytes) {
+                    connection.input.resize(std::max(connection.input.size(), connection.inputSize + READ_SIZE));
+                    auto available = connection.input.size() - connection.inputSize;
+                    auto received = ::recv(connection.socket.get(), connection.input.data() + connection.inputSize, available, 0);
+                    if (received < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        break;
+                    }
+                    if (received < 0) {
+                        return false;
+                    }
+                    if (received == 0) {
+                        connection.inputClosed = true;
+                        break;
+                    }
+                    connection.inputSize += received;
+                    if (!answerRequests(connection, workerCounters)) {
+                        return false;
+                    }
+                    if (static_cast<std::size_t>(received) < available) {
+                        break;
+                    }
+                }
+            } else if (ready & (EPOLLERR | EPOLLHUP)) {
+                return false;
+            }
+
+            while (pending() > 0) {
+                auto sent = ::send(connection.socket.get(), connection.output.data() + connection.outputSent, pending(), MSG_NOSIGNAL);
+                if (sent < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break;
+                }
+                if (sent < 0) {
+                    return false;
+                }
+                connection.outputSent += sent;
+            }
+            if (connection.outputSent == connection.output.size()) {
+                connection.output.clear();
+                connection.outputSent = 0;
+            } else if (connection.outputSent > connection.output.size() / 2) {
+                connection.output.erase(connection.output.begin(), connection.output.begin() + static_cast<std::ptrdiff_t>(connection.outputSent));
+                connection.outputSent = 0;
+            }
+            if (connection.inputClosed && pending() == 0) {
+                return false;
+            }
+
+            uint32_t events = (!connection.inputClosed && pending() < options.maxPendingResponseBytes ? EPOLLIN : 0)
+                              | (pending() > 0 ? EPOLLOUT : 0);
+            if (events != connection.events) {
+                control(EPOLL_CTL_MOD, connection.socket.get(), events, reinterpret_cast<uint64_t>(&connection));
+                connection.events = events;
+            }
+            return true;
+        };
+
+        epoll_event events[MAX_EVENTS];
+        while (true) {
+            int count = ::epoll_wait(epoll.get(), events, MAX_EVENTS, -1);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw makeIoError("epoll_wait failed");
+            }
+            for (int idx = 0; idx < count; idx++) {
+                auto data = events[idx].data.u64;
+                if (data == STOP_EVENT) {
+                    return;
+                }
+                if (data == LISTENER_EVENT) {
+                    while (true) {
+                        int fd = ::accept4(listener.get(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                        if (fd < 0) {
+                            if (errno == EINTR || errno == ECONNABORTED) {
+                                continue;
+                            }
+                            // including running out of descriptors or memory, the client waits in the backlog then
+                            break;
+                        }
+                        auto connection = std::make_unique<Connection>();
+                        connection->socket = Utils::FileDescriptor(fd);
+                        control(EPOLL_CTL_ADD, fd, EPOLLIN, reinterpret_cast<uint64_t>(connection.get()));
+                        connections.emplace(connection.get(), std::move(connection));
+                        add(workerCounters.connections, 1);
+                    }
+                    continue;
+                }
+                auto* connection = reinterpret_cast<Connection*>(data);
+                if (!handle(*connection, events[idx].events)) {
+                    connections.erase(connection);
+                }
+            }
+        }
+    }
+
+    bool DbServer::answerRequests(Connection& connection, WorkerCounters& workerCounters) const {
+        std::size_t offset = 0;
+        while (connection.inputSize - offset >= sizeof(uint32_t)) {
+            uint64_t requestSize = Utils::read<uint32_t>(connection.input.data() + offset);
+            if (requestSize > Protocol::MAX_REQUEST_SIZE) {
+                return false;
+            }
+            if (connection.inputSize - offset - sizeof(uint32_t) < requestSize) {
+                break;
+            }
+            Utils::BasicPayloadReader<true> request(connection.input.data() + offset + sizeof(uint32_t), requestSize);
+            try {
+                auto opcode = static_cast<Protocol::Opcode>(request.read<uint8_t>());
+                auto requestId = request.read<uint32_t>();
+                switch (opcode) {
+                    case Protocol::Opcode::GET:
+                        answerGet(requestId, request, connection, workerCounters);
+                        break;
+                    default:
+                        writeError(connection.output, requestId, "Unknown opcode " + std::to_string(static_cast<unsigned>(opcode)));
+                        add(workerCounters.errors, 1);
+                        break;
+                }
+            } catch (const Exceptions::data_corrupted_error&) {
+                // truncated request
+                return false;
+            }
+            add(workerCounters.requests, 1);
+            offset += sizeof(uint32_t) + requestSize;
+        }
+        // the rest of a request goes to the start
+        std::memmove(connection.input.data(), connection.input.data() + offset, connection.inputSize - offset);
+        connection.inputSize -= offset;
+        return true;
+    }
+
+    void DbServer::answerGet(uint32_t requestId, Utils::BasicPayloadReader<true>& request, Connection& connection, WorkerCounters& workerCounters) const {
+        // reused by the requests of the thread
+        thread_local std::vector<Key> keys;
+        thread_local std::vector<std::optional<Value>> values;
+
+        auto fileIndex = request.read<uint16_t>();
+        auto keyCount = request.read<uint32_t>();
+        keys.clear();
+        for (uint32_t idx = 0; idx < keyCount; idx++) {
+            auto keySize = request.read<Key::SizeType>();
+            keys.emplace_back(request.skip(keySize), keySize);
+        }
+        if (fileIndex >= files.size()) {
+            writeError(connection.output, requestId, "Unknown file " + std::to_string(fileIndex));
+            add(workerCounters.errors, 1);
+            return;
+        }
+
+        values.clear();
+        values.resize(keys.size());
+        try {
+            if (uncheckedReaders[fileIndex]) {
+                uncheckedReaders[fileIndex]->getMany(keys, values);
+            } else {
+                files[fileIndex]->getReader().getMany(keys, values);
+            }
+        } catch (const std::exception& error) {
+            writeError(connection.output, requestId, error.what());
+            add(workerCounters.errors, 1);
+            return;
+        }
+        add(workerCounters.keys, keys.size());
+
+        Protocol::MessageWriter response(connection.output);
+        auto responseOffset = response.tell();
+        response.write<uint32_t>(0);  // will be filled in below
+        response.write(requestId);
+        response.write(Protocol::Status::OK);
+        response.write<uint32_t>(values.size());
+        for (const auto& value : values) {
+            if (!value) {
+                response.write(Protocol::Lookup::NOT_FOUND);
+                continue;
+            }
+            response.write(Protocol::Lookup::FOUND);
+            response.write<uint32_t>(value->size());
+            response.write(value->get(), value->size());
+        }
+        auto responseSize = response.tell() - responseOffset - sizeof(uint32_t);
+        if (responseSize > std::numeric_limits<uint32_t>::max()) [[unlikely]] {
+            connection.output.resize(responseOffset);
+            writeError(connection.output, requestId, "Response too large");
+            add(workerCounters.errors, 1);
+            return;
+        }
+        response.writeAt<uint32_t>(responseOffset, responseSize);
+    }
+
+}
@@ -0,0 +1,397 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "../include/exceptions.h"
+#include "../include/sharded.h"
+
+namespace RoflDb {
+
+namespace {
+    constexpr uint16_t MANIFEST_VERSION = 0;
+    constexpr std::size_t MANIFEST_BUFFER_SIZE = 64 * 1024;
+
+    Key makeKey(const std::string& key) {
+        return {reinterpret_cast<const std::byte*>(key.data()), key.size()};
+    }
+
+    template<class SizeT>
+    void appendSized(std::vector<std::byte>& batch, const std::byte* data, std::size_t size) {
+        auto sizeField = static_cast<SizeT>(size);
+        auto offset = batch.size();
+        batch.resize(offset + sizeof sizeField + size);
+        std::memcpy(batch.data() + offset, &sizeField, sizeof sizeField);
+        std::memcpy(batch.data() + offset + sizeof sizeField, data, size);
+    }
+
+    template<class SizeT>
+    std::pair<const std::byte*, std::size_t> takeSized(const std::vector<std::byte>& batch, std::size_t& offset) {
+        SizeT size;
+        std::memcpy(&size, batch.data() + offset, sizeof size);
+        offset += sizeof size + size;
+        return {batch.data() + offset - size, size};
+    }
+}
+
+// ShardManifest =======================================================================================================
+
+    ShardManifest ShardManifest::load(const std::filesystem::path& path) {
+        auto file = Utils::FileDescriptor::open(path);
+        Utils::BufferedFileReader reader(file.get(), MANIFEST_BUFFER_SIZE, 0, file.size());
+        auto truncated = [&path]() {
+            return Exceptions::data_corrupted_error("Truncated shard manifest " + path.string());
+        };
+        auto readString = [&]() {
+            uint16_t size;
+            std::string result;
+            if (!reader.read(size)) {
+                throw truncated();
+            }
+            result.resize(size);
+            if (size > 0 && !reader.read(reinterpret_cast<std::byte*>(result.data()), size)) {
+                throw truncated();
+            }
+            return result;
+        };
+
+        std::byte magic[sizeof MAGIC];
+        if (!reader.read(magic, sizeof magic) || std::memcmp(magic, MAGIC, sizeof MAGIC) != 0) {
+            throw Exceptions::magic_error("Not a shard manifest: " + path.string());
+        }
+        uint16_t version;
+        uint8_t partitioning;
+        uint32_t shardCount;
+        if (!reader.read(version) || !reader.read(partitioning) || !reader.read(shardCount)) {
+            throw truncated();
+        }
+        if (version != MANIFEST_VERSION) {
+            throw Exceptions::unsupported_error("Unsupported shard manifest version " + std::to_string(version));
+        }
+        if (partitioning > static_cast<uint8_t>(Partitioning::RANGE)) {
+            throw Exceptions::data_corrupted_error("Unknown partitioning in shard manifest " + path.string());
+        }
+
+        ShardManifest manifest;
+        manifest.partitioning = static_cast<Partitioning>(partitioning);
+        for (uint32_t idx = 0; idx < shardCount; idx++) {
+            manifest.shardPaths.emplace_back(readString());
+        }
+        if (manifest.partitioning == Partitioning::RANGE) {
+            for (uint32_t idx = 0; idx + 1 < shardCount; idx++) {
+                manifest.splitKeys.push_back(readString());
+            }
+        }
+        try {
+            manifest.validate();
+        } catch (const std::invalid_argument& error) {
+            throw Exceptions::data_corrupted_error("Invalid shard manifest " + path.string() + ": " + error.what());
+        }
+        return manifest;
+    }
+
+    void ShardManifest::save(const std::filesystem::path& path) const {
+        validate();
+        auto file = Utils::FileDescriptor::create(path);
+        Utils::BufferedFileWriter writer(file.get(), MANIFEST_BUFFER_SIZE);
+        auto writeString = [&writer](const std::string& string) {
+            writer.write<uint16_t>(string.size());
+            writer.write(reinterpret_cast<const std::byte*>(string.data()), string.size());
+        };
+
+        writer.write(MAGIC, sizeof MAGIC);
+        writer.write<uint16_t>(MANIFEST_VERSION);
+        writer.write<uint8_t>(static_cast<uint8_t>(partitioning));
+        writer.write<uint32_t>(shardPaths.size());
+        for (const auto& shardPath : shardPaths) {
+            writeString(shardPath.string());
+        }
+        for (const auto& splitKey : splitKeys) {
+            writeString(splitKey);
+        }
+        writer.flush();
+    }
+
+    void ShardManifest::validate() const {
+        if (shardPaths.empty() || shardPaths.size() > std::numeric_limits<uint32_t>::max()) {
+            throw std::invalid_argument("Shard count must be between 1 and 2^32 - 1");
+        }
+        for (const auto& shardPath : shardPaths) {
+            if (shardPath.empty() || shardPath.string().size() > std::numeric_limits<uint16_t>::max()) {
+                throw std::invalid_argument("Invalid shard path " + shardPath.string());
+            }
+        }
+        if (partitioning == Partitioning::HASH) {
+            if (!splitKeys.empty()) {
+                throw std::invalid_argument("Hash partitioning does not take split keys");
+            }
+            return;
+        }
+        if (splitKeys.size() != shardPaths.size() - 1) {
+            throw std::invalid_argument("Range partitioning takes a split key less than the shards");
+        }
+        for (std::size_t idx = 0; idx < splitKeys.size(); idx++) {
+            if (splitKeys[idx].size() > std::numeric_limits<Key::SizeType>::max()) {
+                throw std::invalid_argument("Split key is too long");
+            }
+            if (idx > 0 && makeKey(splitKeys[idx - 1]) >= makeKey(splitKeys[idx])) {
+                throw std::invalid_argument("Split keys must be increasing");
+            }
+        }
+    }
+
+    std::size_t ShardManifest::getShardIdx(const Key& key) const {
+        if (partitioning == Partitioning::HASH) {
+            return Utils::hashBytes(key.get(), key.size(), HASH_SEED) % shardPaths.size();
+        }
+        // the number of split keys not greater than the key
+        auto splitKey = std::upper_bound(splitKeys.begin(), splitKeys.end(), key, [](const Key& key, const std::string& splitKey) {
+            return key < makeKey(splitKey);
+        });
+        return splitKey - splitKeys.begin();
+    }
+
+// END ShardManifest ===================================================================================================
+
+// ShardedDbReader =====================================================================================================
+
+    ShardedDbReader::ShardedDbReader(const std::filesystem::path& manifestPath, const DbFile::Options& shardOptions)
+        : manifest(ShardManifest::load(manifestPath)) {
+        shards.reserve(manifest.shardPaths.size());
+        for (const auto& shardPath : manifest.shardPaths) {
+            shards.push_back(std::make_unique<DbFile>(manifestPath.parent_path() / shardPath, shardOptions));
+        }
+    }
+
+    std::optional<Value> ShardedDbReader::get(const Key& key) const {
+        return shards[manifest.getShardIdx(key)]->getReader().get(key);
+    }
+
+    std::optional<Value> ShardedDbReader::get(const std::string& key) const {
+        return get(makeKey(key));
+    }
+
+    std::optional<Value> ShardedDbReader::get(const std::vector<std::byte>& key) const {
+        return get(Key(key.data(), key.size()));
+    }
+
+    std::optional<Value> ShardedDbReader::get(uint64_t key) const {
+        std::byte bytes[priv::LearnedTree::KEY_SIZE];
+        priv::LearnedTree::encodeKey(key, bytes);
+        return get(Key(bytes, sizeof bytes));
+    }
+
+    void ShardedDbReader::getMany(std::span<const Key> keys, std::span<std::optional<Value>> values) const {
+        if (shards.size() == 1) {
+            shards.front()->getReader().getMany(keys, values);
+            return;
+        }
+
+        // counting sort of the keys by shard, keeping their order within a shard
+        std::vector<std::size_t> shardIdxs(keys.size());
+        std::vector<std::size_t> shardStarts(shards.size() + 1);
+        for (std::size_t idx = 0; idx < keys.size(); idx++) {
+            shardIdxs[idx] = manifest.getShardIdx(keys[idx]);
+            shardStarts[shardIdxs[idx] + 1]++;
+        }
+        for (std::size_t shardIdx = 0; shardIdx < shards.size(); shardIdx++) {
+            shardStarts[shardIdx + 1] += shardStarts[shardIdx];
+        }
+        std::vector<std::size_t> order(keys.size());
+        auto positions = shardStarts;
+        for (std::size_t idx = 0; idx < keys.size(); idx++) {
+            order[positions[shardIdxs[idx]]++] = idx;
+        }
+        std::vector<Key> groupedKeys;
+        groupedKeys.reserve(keys.size());
+        for (auto idx : order) {
+            groupedKeys.push_back(keys[idx]);
+        }
+
+        std::vector<std::optional<Value>> groupedValues(keys.size());
+        for (std::size_t shardIdx = 0; shardIdx < shards.size(); shardIdx++) {
+            auto begin = shardStarts[shardIdx], size = shardStarts[shardIdx + 1] - begin;
+            if (size > 0) {
+                shards[shardIdx]->getReader().getMany(std::span(groupedKeys).subspan(begin, size),
+                                                      std::span(groupedValues).subspan(begin, size));
+            }
+        }
+        for (std::size_t position = 0; position < order.size(); position++) {
+            auto& value = values[order[position]];
+            value.reset();
+            if (groupedValues[position]) {
+                value.emplace(std::move(*groupedValues[position]));
+            }
+        }
+    }
+
+// END ShardedDbReader =================================================================================================
+
+// ShardedDbWriter =====================================================================================================
+
+    ShardedDbWriter::ShardedDbWriter(const std::filesystem::path& manifestPath, Options options)
+        : options(std::move(options)),
+          manifestPath(manifestPath),
+          startedAt(std::chrono::steady_clock::now()) {
+        manifest.partitioning = this->options.partitioning;
+        manifest.splitKeys = this->options.splitKeys;
+        for (unsigned idx = 0; idx < this->options.shardCount; idx++) {
+            manifest.shardPaths.emplace_back(manifestPath.stem().string() + "." + std::to_string(idx) + ".rofldb");
+        }
+        manifest.validate();
+
+        try {
+            for (const auto& shardPath : manifest.shardPaths) {
+                shards.push_back(std::make_unique<Shard>(manifestPath.parent_path() / shardPath, this->options.shardOptions));
+                shards.back()->batch.reserve(this->options.batchSize);
+            }
+            for (auto& shard : shards) {
+                shard->thread = std::thread(&Shard::run, shard.get());
+            }
+        } catch (...) {
+            stopShards(true);
+            throw;
+        }
+    }
+
+    ShardedDbWriter::~ShardedDbWriter() {
+        stopShards(true);
+    }
+
+    void ShardedDbWriter::Shard::run() {
+        try {
+            while (true) {
+                std::vector<std::byte> records;
+                {
+                    std::unique_lock lock(mutex);
+                    changed.wait(lock, [this]() { return !queue.empty() || closed; });
+                    if (cancelled) {
+                        return;
+                    }
+                    if (queue.empty()) {
+                        break;
+                    }
+                    records = std::move(queue.front());
+                    queue.pop_front();
+                }
+                changed.notify_all();
+
+                for (std::size_t offset = 0; offset < records.size();) {
+                    auto [keyData, keySize] = takeSized<Key::SizeType>(records, offset);
+                    auto [valueData, valueSize] = takeSized<Value::SizeType>(records, offset);
+                    writer.put(Key(keyData, keySize), Value(valueData, valueSize));
+                }
+            }
+            stats = writer.finish();
+        } catch (...) {
+            {
+                std::lock_guard lock(mutex);
+                error = std::current_exception();
+                queue.clear();
+            }
+            changed.notify_all();
+        }
+    }
+
+    void ShardedDbWriter::submitBatch(Shard& shard) {
+        {
+            std::unique_lock lock(shard.mutex);
+            shard.changed.wait(lock, [&shard]() { return shard.queue.size() < MAX_QUEUED_BATCHES || shard.error; });
+            if (shard.error) {
+                std::rethrow_exception(shard.error);
+            }
+            shard.queue.push_back(std::move(shard.batch));
+        }
+        shard.changed.notify_all();
+        shard.batch = {};
+        shard.batch.reserve(options.batchSize);
+    }
+
+    void ShardedDbWriter::stopShards(bool cancel) {
+        for (auto& shard : shards) {
+            {
+                std::lock_guard lock(shard->mutex);
+                shard->closed = true;
+                shard->cancelled = cancel;
+            }
+            shard->changed.notify_all();
+        }
+        for (auto& shard : shards) {
+            if (shard->thread.joinable()) {
+                shard->thread.join();
+            }
+        }
+    }
+
+    void ShardedDbWriter::put(const Key& key, const Value& value) {
+        if (finished) [[unlikely]] {
+            throw std::logic_error("ShardedDbWriter is already finished");
+        }
+        // as `DbWriter::put`, here rather than on the shard thread, the batch records have 16-bit key sizes too
+        if (key.size() > DbWriter::MAX_KEY_SIZE) [[unlikely]] {
+            throw std::length_error("Key is too long");
+        }
+        if (value.size() > std::numeric_limits<Value::SizeType>::max()) [[unlikely]] {
+            throw std::length_error("Value is too long");
+        }
+        auto& shard = *shards[manifest.getShardIdx(key)];
+        appendSized<Key::SizeType>(shard.batch, key.get(), key.size());
+        appendSized<Value::SizeType>(shard.batch, value.get(), value.size());
+        if (shard.batch.size() >= options.batchSize) {
+            submitBatch(shard);
+        }
+    }
+
+    void ShardedDbWriter::put(std::string_view key, std::string_view value) {
+        put(Key(reinterpret_cast<const std::byte*>(key.data()), key.size()),
+            Value(reinterpret_cast<const std::byte*>(value.data()), value.size()));
+    }
+
+    void ShardedDbWriter::put(uint64_t key, const Value& value) {
+        std::byte bytes[priv::LearnedTree::KEY_SIZE];
+        priv::LearnedTree::encodeKey(key, bytes);
+        put(Key(bytes, sizeof bytes), value);
+    }
+
+    void ShardedDbWriter::put(uint64_t key, std::string_view value) {
+        put(key, Value(reinterpret_cast<const std::byte*>(value.data()), value.size()));
+    }
+
+    ShardedDbWriter::Stats ShardedDbWriter::finish() {
+        if (finished) [[unlikely]] {
+            throw std::logic_error("ShardedDbWriter is already finished");
+        }
+        finished = true;
+
+        for (auto& shard : shards) {
+            if (!shard->batch.empty()) {
+                submitBatch(*shard);
+            }
+        }
+        // the shard threads sort and write their files from here on, in parallel
+        stopShards(false);
+
+        Stats stats;
+        for (auto& shard : shards) {
+            if (shard->error) {
+                std::rethrow_exception(shard->error);
+            }
+            stats.keys += shard->stats.keys;
+            stats.valueBytes += shard->stats.valueBytes;
+            stats.storedValueBytes += shard->stats.storedValueBytes;
+            stats.inlineValues += shard->stats.inlineValues;
+            stats.treeBytes += shard->stats.treeBytes;
+            stats.hotNodes += shard->stats.hotNodes;
+            stats.filterBytes += shard->stats.filterBytes;
+            stats.indexBytes += shard->stats.indexBytes;
+            stats.fileBytes += shard->stats.fileBytes;
+            stats.spilledRuns += shard->stats.spilledRuns;
+        }
+        manifest.save(manifestPath);
+        stats.elapsed = std::chrono::steady_clock::now() - startedAt;
+        return stats;
+    }
+
+// END ShardedDbWriter =================================================================================================
+
+}
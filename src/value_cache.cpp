@@ -0,0 +1,74 @@
+#include <cstring>
+
+#include "../include/exceptions.h"
+#include "../include/value_cache.h"
+
+namespace RoflDb::priv {
+
+    ValueBlockCache::ValueBlockCache(const ValueCollection* valueCollection, const ValueBlocks* valueBlocks, std::size_t capacity)
+        : valueCollection(valueCollection),
+          valueBlocks(valueBlocks),
+          decompressor(valueBlocks->getDictionary()),
+          shardCapacity(capacity / SHARD_COUNT) {}
+
+    Value ValueBlockCache::getValue(ValueCollection::ValueOffsetType offset) {
+        auto blockIdx = offset >> ValueBlocks::BLOCK_OFFSET_BITS;
+        auto offsetInBlock = offset & (ValueBlocks::MAX_BLOCK_SIZE - 1);
+        if (blockIdx >= valueBlocks->getBlockCount()) [[unlikely]] {
+            throw Exceptions::data_corrupted_error("Out of bounds");
+        }
+
+        auto blockReader = valueCollection->getReaderAt(valueBlocks->getBlockOffset(blockIdx));
+        if (static_cast<ValueBlocks::BlockKind>(Utils::PayloadReader(blockReader).read<uint8_t>()) == ValueBlocks::BlockKind::RAW) {
+            // no copy, exactly as the uncompressed values
+            blockReader.skip(ValueBlocks::BLOCK_HEADER_SIZE);
+            return blockReader.read<Value>(offsetInBlock);
+        }
+
+        auto block = getBlock(blockIdx, blockReader);
+        Utils::PayloadReader valueReader(block->data(), block->size());
+        auto value = valueReader.read<Value>(offsetInBlock);
+        // copied out rather than sharing the block: many values held at once (e.g. by `getMany`) would pin as many
+        // blocks, decompressed again and again once the cache evicts them
+        auto copy = std::make_shared_for_overwrite<std::byte[]>(value.size());
+        std::memcpy(copy.get(), value.get(), value.size());
+        const auto* address = copy.get();
+        return {address, value.size(), std::move(copy)};
+    }
+
+    ValueBlockCache::Block ValueBlockCache::getBlock(uint64_t blockIdx, Utils::PayloadReader blockReader) {
+        auto& shard = shards[blockIdx % SHARD_COUNT];
+        {
+            std::lock_guard lock(shard.mutex);
+            if (auto found = shard.blockIdxs.find(blockIdx); found != shard.blockIdxs.end()) {
+                shard.blocks.splice(shard.blocks.begin(), shard.blocks, found->second);
+                return found->second->second;
+            }
+        }
+
+        blockReader.skip<uint8_t>();
+        auto rawSize = blockReader.read<uint32_t>();
+        auto storedSize = blockReader.read<uint32_t>();
+        auto decompressed = std::make_shared<std::vector<std::byte>>(rawSize);
+        decompressor.decompress({blockReader.skip(storedSize), storedSize}, *decompressed);
+        Block block = std::move(decompressed);
+
+        std::lock_guard lock(shard.mutex);
+        if (auto found = shard.blockIdxs.find(blockIdx); found != shard.blockIdxs.end()) {
+            // decompressed concurrently by another thread
+            return found->second->second;
+        }
+        shard.blocks.emplace_front(blockIdx, block);
+        shard.blockIdxs.emplace(blockIdx, shard.blocks.begin());
+        shard.size += block->size();
+        // the block just added stays even if it alone exceeds the capacity
+        while (shard.size > shardCapacity && shard.blocks.size() > 1) {
+            auto& [evictedIdx, evicted] = shard.blocks.back();
+            shard.size -= evicted->size();
+            shard.blockIdxs.erase(evictedIdx);
+            shard.blocks.pop_back();
+        }
+        return block;
+    }
+
+}
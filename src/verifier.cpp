@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "../include/verifier.h"
+
+namespace RoflDb::priv {
+
+    Verifier::Verifier(const ValueCollection* valueCollection, const ValueBlocks* valueBlocks, std::span<const std::byte> inlineValues,
+                       unsigned threadCount)
+        : valueCollection(valueCollection), valueBlocks(valueBlocks), inlineValues(inlineValues), threadCount(threadCount) {
+        if (valueBlocks == nullptr) {
+            return;
+        }
+        blockSizes.resize(valueBlocks->getBlockCount());
+        for (uint64_t blockIdx = 0; blockIdx < blockSizes.size(); blockIdx++) {
+            auto blockReader = valueCollection->getReaderAt(valueBlocks->getBlockOffset(blockIdx));
+            auto kind = static_cast<ValueBlocks::BlockKind>(blockReader.read<uint8_t>());
+            auto rawSize = blockReader.read<uint32_t>();
+            auto storedSize = blockReader.read<uint32_t>();
+            blockSizes[blockIdx] = kind == ValueBlocks::BlockKind::RAW ? storedSize : rawSize;
+        }
+    }
+
+    void Verifier::checkValueOffset(ValueCollection::ValueOffsetType offset) const {
+        if (ValueCollection::isInline(offset)) {
+            uint64_t size = inlineValues.size();
+            offset &= ~ValueCollection::INLINE_VALUE_BIT;
+            require(offset <= size && size - offset >= sizeof(Value::SizeType), "Value offset out of bounds");
+            auto valueSize = Utils::read<Value::SizeType>(inlineValues.data() + offset);
+            require(size - offset - sizeof(Value::SizeType) >= valueSize, "Value out of bounds");
+            return;
+        }
+        if (valueBlocks != nullptr) {
+            auto blockIdx = offset >> ValueBlocks::BLOCK_OFFSET_BITS;
+            auto offsetInBlock = offset & (ValueBlocks::MAX_BLOCK_SIZE - 1);
+            require(blockIdx < blockSizes.size() && offsetInBlock + sizeof(Value::SizeType) <= blockSizes[blockIdx],
+                    "Value offset out of bounds");
+            return;
+        }
+        uint64_t size = valueCollection->getSize();
+        require(offset <= size && size - offset >= sizeof(Value::SizeType), "Value offset out of bounds");
+        auto valueSize = Utils::read<Value::SizeType>(valueCollection->getReaderAt(offset).getAddress());
+        require(size - offset - sizeof(Value::SizeType) >= valueSize, "Value out of bounds");
+    }
+
+    void Verifier::parallelFor(uint64_t count, const std::function<void(uint64_t begin, uint64_t end)>& body,
+                               uint64_t minChunkSize) const {
+        auto chunkSize = std::max(minChunkSize, count / (uint64_t(threadCount) * 16) + 1);
+        auto chunkCount = (count + chunkSize - 1) / chunkSize;
+        auto workerCount = static_cast<unsigned>(std::min<uint64_t>(threadCount, chunkCount));
+        if (workerCount <= 1) {
+            if (count > 0) {
+                body(0, count);
+            }
+            return;
+        }
+
+        std::atomic<uint64_t> nextChunk = 0;
+        std::atomic<bool> failed = false;
+        std::exception_ptr exception;
+        std::mutex exceptionMutex;
+        auto work = [&]() {
+            for (auto chunk = nextChunk++; chunk < chunkCount && !failed; chunk = nextChunk++) {
+                try {
+                    body(chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize));
+                } catch (...) {
+                    std::lock_guard lock(exceptionMutex);
+                    if (!exception) {
+                        exception = std::current_exception();
+                    }
+                    failed = true;
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        for (unsigned idx = 1; idx < workerCount; idx++) {
+            threads.emplace_back(work);
+        }
+        work();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+}
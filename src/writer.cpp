@@ -0,0 +1,1634 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+
+#include "../include/access_profile.h"
+#include "../include/exceptions.h"
+#include "../include/prefix_search.h"
+#include "../include/writer.h"
+
+namespace RoflDb {
+
+namespace {
+    using ValueOffsetType = priv::ValueCollection::ValueOffsetType;
+    using NodeOffsetType = priv::Tree::Node::OffsetType;
+
+    constexpr std::size_t MIN_RUN_BUFFER_SIZE = 64 * 1024;
+
+    // the values the dictionary is trained on, relative to its capacity (zstd suggests about 100 times)
+    constexpr std::size_t DICTIONARY_SAMPLES_FACTOR = 100;
+
+    // "Level" is the height from the bottom at which the node with the given index (in key order) resides in the
+    // implicit binary tree: the position of the lowest set bit, with the special "0" level for the index `0`.
+    // See `get_btree_level` in build.py for the original derivation.
+    unsigned getBtreeLevel(uint64_t idx) {
+        return idx == 0 ? 0 : std::countr_zero(idx) + 1;
+    }
+
+    struct BtreeChildren {
+        std::optional<uint64_t> left;
+        std::optional<uint64_t> right;
+
+        [[nodiscard]] std::size_t count() const {
+            return left.has_value() + right.has_value();
+        }
+    };
+
+    BtreeChildren getBtreeChildren(uint64_t idx, uint64_t count) {
+        BtreeChildren children;
+        auto level = getBtreeLevel(idx);
+
+        // `idx` `1` is special because although it on level `1`, it should still reference `idx` `0` - otherwise
+        // the latter will not be accessible from anywhere
+        if (level > 1 || idx == 1) {
+            // the number of indexes to skip (both forward and backwards) to access the children on the lower level
+            uint64_t delta = level > 1 ? uint64_t(1) << (level - 2) : 1;
+            children.left = idx - delta;
+
+            if (level > 1) {
+                // if there is no child directly underneath, descend deeper
+                while (delta > 0 && idx + delta >= count) {
+                    delta >>= 1;
+                }
+                if (delta > 0) {
+                    children.right = idx + delta;
+                }
+            }
+        }
+        return children;
+    }
+
+    uint64_t getBtreeRoot(uint64_t count) {
+        // the topmost level node, it can access any other node
+        return std::bit_floor(count - 1);
+    }
+
+    std::size_t getNodePayloadSize(std::size_t keySize, const BtreeChildren& children) {
+        return sizeof(Key::SizeType) + keySize + sizeof(ValueOffsetType) + children.count() * sizeof(NodeOffsetType);
+    }
+
+    // with its size, as in the value collection; `0` unless the value is inline
+    std::size_t getInlineValueSize(ValueOffsetType valueOffset, const Value& inlineValue) {
+        return priv::ValueCollection::isInline(valueOffset) ? sizeof(Value::SizeType) + inlineValue.size() : 0;
+    }
+
+    // the value offset of an inline value stored at `offset` within the tree payload
+    ValueOffsetType getInlineValueOffset(uint64_t offset) {
+        return priv::ValueCollection::INLINE_VALUE_BIT | offset;
+    }
+
+    // a `priv::Tree` node stored at `nodeOffset` within the tree payload, with the offsets of its children (`0`: none)
+    void writeTreeNode(Utils::BufferedFileWriter& output, uint64_t nodeOffset, const Key& key, ValueOffsetType valueOffset,
+                       const Value& inlineValue, NodeOffsetType leftOffset, NodeOffsetType rightOffset) {
+        auto inlineValueSize = getInlineValueSize(valueOffset, inlineValue);
+        auto childrenSize = ((leftOffset != 0) + (rightOffset != 0)) * sizeof(NodeOffsetType);
+        output.write<priv::Tree::Node::SizeType>(sizeof(Key::SizeType) + key.size() + sizeof(ValueOffsetType) + inlineValueSize + childrenSize);
+        output.write<Key::SizeType>(key.size());
+        output.write(key.get(), key.size());
+        if (inlineValueSize > 0) {
+            // right after the value offset
+            output.write<ValueOffsetType>(getInlineValueOffset(nodeOffset + sizeof(priv::Tree::Node::SizeType)
+                                                               + sizeof(Key::SizeType) + key.size() + sizeof(ValueOffsetType)));
+            output.write<Value::SizeType>(inlineValue.size());
+            output.write(inlineValue.get(), inlineValue.size());
+        } else {
+            output.write<ValueOffsetType>(valueOffset);
+        }
+        if (leftOffset != 0) {
+            output.write<NodeOffsetType>(leftOffset);
+        }
+        if (rightOffset != 0) {
+            output.write<NodeOffsetType>(rightOffset);
+        }
+    }
+
+    // Shape of a binary tree over keys weighted by how often they are looked up (Mehlhorn's bisection): the root of
+    // every subtree is the key whose weight interval holds the middle of the subtree weight, so a key of weight `w`
+    // out of `W` is within a few levels of depth `log2(W / w)`. The nodes stay in key order, and a node with a single child
+    // has it on the left (as `priv::Tree::Node` stores it).
+    class WeightedShape {
+        // `prefixWeights[idx]` is the total weight of the keys before `idx`
+        const Utils::TemporaryArray<double>& prefixWeights;
+        // index of the child plus one, `0` for none
+        Utils::TemporaryArray<uint32_t> left;
+        Utils::TemporaryArray<uint32_t> right;
+        uint64_t root = 0;
+
+        [[nodiscard]] uint64_t pickRoot(uint64_t lo, uint64_t hi) const {
+            if (!(prefixWeights[hi] > prefixWeights[lo])) {
+                return lo + (hi - lo) / 2;
+            }
+            // the first key whose weight interval ends past the middle
+            auto middle = (prefixWeights[lo] + prefixWeights[hi]) / 2;
+            auto first = lo + 1;
+            auto last = hi;
+            while (first < last) {
+                auto pivot = first + (last - first) / 2;
+                if (prefixWeights[pivot] > middle) {
+                    last = pivot;
+                } else {
+                    first = pivot + 1;
+                }
+            }
+            // the first key of the subtree moves down to the left of the next one
+            return first - 1 == lo && hi - lo > 1 ? lo + 1 : first - 1;
+        }
+
+    public:
+        WeightedShape(const std::filesystem::path& temporaryDirectory, const Utils::TemporaryArray<double>& prefixWeights, uint64_t count)
+            : prefixWeights(prefixWeights), left(temporaryDirectory, count), right(temporaryDirectory, count) {
+            if (count == 0) {
+                return;
+            }
+            struct Subtree {
+                uint64_t lo;
+                uint64_t hi;
+                uint64_t parent;
+                bool greater;
+            };
+            root = pickRoot(0, count);
+            std::vector<Subtree> stack {{0, root, root, false}, {root + 1, count, root, true}};
+            while (!stack.empty()) {
+                auto subtree = stack.back();
+                stack.pop_back();
+                if (subtree.lo >= subtree.hi) {
+                    continue;
+                }
+                auto subtreeRoot = pickRoot(subtree.lo, subtree.hi);
+                (subtree.greater ? right : left)[subtree.parent] = static_cast<uint32_t>(subtreeRoot + 1);
+                stack.push_back({subtree.lo, subtreeRoot, subtreeRoot, false});
+                stack.push_back({subtreeRoot + 1, subtree.hi, subtreeRoot, true});
+            }
+        }
+
+        [[nodiscard]] uint64_t getRoot() const {
+            return root;
+        }
+
+        [[nodiscard]] BtreeChildren getChildren(uint64_t idx) const {
+            BtreeChildren children;
+            if (left[idx] != 0) {
+                children.left = left[idx] - 1;
+            }
+            if (right[idx] != 0) {
+                children.right = right[idx] - 1;
+            }
+            return children;
+        }
+    };
+
+    // Throws if keys are not passed in strictly increasing order (i.e. some key was put twice).
+    class OrderChecker {
+        std::vector<std::byte> previousKey;
+        bool hasPrevious = false;
+
+    public:
+        void check(const Key& key) {
+            if (hasPrevious && !(Key(previousKey.data(), previousKey.size()) < key)) [[unlikely]] {
+                throw Exceptions::duplicate_key_error("Duplicate key: " + std::string(reinterpret_cast<const char*>(key.get()), key.size()));
+            }
+            previousKey.assign(key.get(), key.get() + key.size());
+            hasPrevious = true;
+        }
+    };
+
+    // Enumerates the 1-based breadth-first indexes of a complete binary tree of `count` nodes in the in-order
+    // (i.e. key) order: the k-th call of `next` returns the Eytzinger position of the k-th smallest key.
+    class EytzingerInOrder {
+        uint64_t count;
+        uint64_t k = 1;
+
+        void descendLeft() {
+            while (2 * k <= count) {
+                k *= 2;
+            }
+        }
+
+    public:
+        explicit EytzingerInOrder(uint64_t count) : count(count) {
+            descendLeft();
+        }
+
+        uint64_t next() {
+            auto result = k;
+            if (2 * k + 1 <= count) {
+                k = 2 * k + 1;
+                descendLeft();
+            } else {
+                // go up while we are the right child, then once more to the parent
+                k >>= std::countr_one(k) + 1;
+            }
+            return result;
+        }
+    };
+
+    // Fits the segments of `priv::LearnedTree` to the keys added in order: a segment is extended with a key as long
+    // as some slope predicts all its keys within the error (the shrinking cone of the feasible slopes is not empty).
+    class SegmentsBuilder {
+    public:
+        struct Segment {
+            uint64_t key;
+            uint64_t position;
+            double slope;
+        };
+
+    private:
+        double maxError;
+        double minSlope = 0;
+        double maxSlope = 0;
+        uint64_t position = 0;
+
+    public:
+        std::vector<Segment> segments;
+
+        explicit SegmentsBuilder(unsigned maxError) : maxError(maxError) {}
+
+        void add(uint64_t key) {
+            if (!segments.empty()) {
+                auto& segment = segments.back();
+                auto keyDelta = static_cast<double>(key - segment.key);
+                auto positionDelta = static_cast<double>(position - segment.position);
+                auto low = (positionDelta - maxError) / keyDelta;
+                auto high = (positionDelta + maxError) / keyDelta;
+                bool single = position == segment.position + 1;
+                if (single || (low <= maxSlope && high >= minSlope)) {
+                    minSlope = single ? std::max(low, 0.0) : std::max(minSlope, low);
+                    maxSlope = single ? high : std::min(maxSlope, high);
+                    segment.slope = (minSlope + maxSlope) / 2;
+                    position++;
+                    return;
+                }
+            }
+            segments.push_back({key, position, 0});
+            position++;
+        }
+    };
+
+    std::size_t getCommonPrefixLength(const Key& a, const Key& b) {
+        auto size = std::min(a.size(), b.size());
+        return std::mismatch(a.get(), a.get() + size, b.get()).first - a.get();
+    }
+
+    // Splits `total` items into the least number of groups of at most `maxGroupSize` items, evenly.
+    class EvenGroups {
+        uint64_t base;
+        uint64_t extra;
+        uint64_t groupIdx = 0;
+
+    public:
+        EvenGroups(uint64_t total, uint64_t maxGroupSize) {
+            auto groups = std::max<uint64_t>(1, (total + maxGroupSize - 1) / maxGroupSize);
+            base = total / groups;
+            extra = total % groups;
+        }
+
+        uint64_t next() {
+            return base + (groupIdx++ < extra);
+        }
+    };
+
+    // Accumulates the entries of a single `priv::BasicWideTree::Node` and serializes it.
+    template<class Node>
+    class WideNodeBuilder {
+
+        std::vector<std::byte> keys;
+        std::vector<std::size_t> keyStarts;
+        // the inline value entries are offsets into `inlineValues` until written
+        std::vector<uint64_t> entries;
+        std::vector<std::byte> inlineValues;
+
+    public:
+        void add(const Key& key, uint64_t entry, const Value& inlineValue = {nullptr, 0}) {
+            keyStarts.push_back(keys.size());
+            keys.insert(keys.end(), key.get(), key.get() + key.size());
+            if (priv::ValueCollection::isInline(entry)) {
+                entry = getInlineValueOffset(inlineValues.size());
+                Value::SizeType size = inlineValue.size();
+                if constexpr (std::endian::native == std::endian::big) {
+                    size = __builtin_bswap32(size);
+                }
+                const auto* sizeBytes = reinterpret_cast<const std::byte*>(&size);
+                inlineValues.insert(inlineValues.end(), sizeBytes, sizeBytes + sizeof size);
+                inlineValues.insert(inlineValues.end(), inlineValue.get(), inlineValue.get() + inlineValue.size());
+            }
+            entries.push_back(entry);
+        }
+
+        [[nodiscard]] std::size_t size() const {
+            return entries.size();
+        }
+
+        [[nodiscard]] Key getKey(std::size_t idx) const {
+            auto end = idx + 1 < keyStarts.size() ? keyStarts[idx + 1] : keys.size();
+            return {keys.data() + keyStarts[idx], end - keyStarts[idx]};
+        }
+
+        // With `compressKeys` the `skip` bytes shared by all the keys are written once instead of with every key.
+        // `offset` is the node offset within the tree payload, the inline values are addressed from there.
+        void write(Utils::BufferedFileWriter& output, typename Node::Kind kind, std::size_t skip, bool compressKeys, uint64_t offset) const {
+            const auto count = size();
+            const auto entrySize = kind == Node::Kind::LEAF ? sizeof(ValueOffsetType) : sizeof(typename Node::OffsetType);
+            const auto headerSize = sizeof(uint8_t) + sizeof(typename Node::CountType) + sizeof(Key::SizeType);
+            const auto sharedPrefixOffset = headerSize + count * (sizeof(uint64_t) + entrySize + sizeof(uint32_t));
+            const auto keysOffset = sharedPrefixOffset + (compressKeys ? skip : 0);
+            const auto storedKeysSize = keys.size() - (compressKeys ? count * skip : 0);
+            const auto inlineValuesOffset = keysOffset + count * sizeof(Key::SizeType) + storedKeysSize;
+            const auto payloadSize = inlineValuesOffset + inlineValues.size();
+            if (payloadSize > std::numeric_limits<typename Node::SizeType>::max()) [[unlikely]] {
+                throw std::length_error("Tree node does not fit into the format");
+            }
+
+            output.write<typename Node::SizeType>(payloadSize);
+            output.write<uint8_t>(static_cast<uint8_t>(kind) | (compressKeys ? Node::COMPRESSED_KEYS : 0));
+            output.write<typename Node::CountType>(count);
+            output.write<Key::SizeType>(skip);
+            for (std::size_t idx = 0; idx < count; idx++) {
+                auto key = getKey(idx);
+                output.write<uint64_t>(Utils::getKeyPrefix(key.get(), key.size(), skip));
+            }
+            for (auto entry : entries) {
+                if (kind == Node::Kind::LEAF) {
+                    if (priv::ValueCollection::isInline(entry)) {
+                        entry += offset + sizeof(typename Node::SizeType) + inlineValuesOffset;
+                    }
+                    output.write<ValueOffsetType>(entry);
+                } else {
+                    output.write<typename Node::OffsetType>(entry);
+                }
+            }
+            const auto storedSkip = compressKeys ? skip : 0;
+            auto keyOffset = keysOffset;
+            for (std::size_t idx = 0; idx < count; idx++) {
+                output.write<uint32_t>(keyOffset);
+                keyOffset += sizeof(Key::SizeType) + getKey(idx).size() - storedSkip;
+            }
+            if (compressKeys && count > 0) {
+                output.write(getKey(0).get(), skip);
+            }
+            for (std::size_t idx = 0; idx < count; idx++) {
+                auto key = getKey(idx);
+                output.write<Key::SizeType>(key.size() - storedSkip);
+                output.write(key.get() + storedSkip, key.size() - storedSkip);
+            }
+            output.write(inlineValues.data(), inlineValues.size());
+        }
+
+        void clear() {
+            keys.clear();
+            keyStarts.clear();
+            entries.clear();
+            inlineValues.clear();
+        }
+    };
+
+    struct RunCursor {
+        Utils::BufferedFileReader reader;
+        std::vector<std::byte> key;
+        ValueOffsetType valueOffset = 0;
+        std::vector<std::byte> inlineValue;
+
+        bool next() {
+            Key::SizeType keySize;
+            if (!reader.read(keySize)) {
+                return false;
+            }
+            key.resize(keySize);
+            if (!reader.read(key.data(), keySize) || !reader.read(valueOffset)) {
+                throw Exceptions::io_error("Truncated sorted run");
+            }
+            inlineValue.resize(priv::ValueCollection::isInline(valueOffset) ? valueOffset & ~priv::ValueCollection::INLINE_VALUE_BIT : 0);
+            if (!inlineValue.empty() && !reader.read(inlineValue.data(), inlineValue.size())) {
+                throw Exceptions::io_error("Truncated sorted run");
+            }
+            return true;
+        }
+
+        [[nodiscard]] Key getKey() const {
+            return {key.data(), key.size()};
+        }
+
+        [[nodiscard]] Value getInlineValue() const {
+            return {inlineValue.data(), inlineValue.size()};
+        }
+    };
+
+    // a key of a sorted run, as read by `RunCursor`
+    void writeRunKey(Utils::BufferedFileWriter& run, const Key& key, ValueOffsetType valueOffset, const Value& inlineValue) {
+        run.write<Key::SizeType>(key.size());
+        run.write(key.get(), key.size());
+        run.write<ValueOffsetType>(valueOffset);
+        if (priv::ValueCollection::isInline(valueOffset)) {
+            run.write(inlineValue.get(), inlineValue.size());
+        }
+    }
+
+    // number of bytes for storing numbers up to `max`
+    unsigned getPackedSize(uint64_t max) {
+        return std::max<unsigned>((std::bit_width(max) + 7) / 8, 1);
+    }
+
+    // little endian number of `size` bytes
+    void writePacked(Utils::BufferedFileWriter& output, uint64_t value, unsigned size) {
+        std::byte bytes[sizeof(uint64_t)];
+        for (unsigned idx = 0; idx < size; idx++) {
+            bytes[idx] = static_cast<std::byte>(value >> (idx * 8));
+        }
+        output.write(bytes, size);
+    }
+
+    // Read-only use of a shared mapping of the file being written.
+    class FileMapping {
+        void* address;
+        std::size_t size;
+
+    public:
+        FileMapping(int fd, std::size_t size) : address(Utils::mapShared(fd, size)), size(size) {}
+        FileMapping(const FileMapping& other) = delete;
+        ~FileMapping() {
+            Utils::unmap(address, size);
+        }
+
+        [[nodiscard]] const std::byte* get() const {
+            return static_cast<const std::byte*>(address);
+        }
+    };
+
+    // Builds the pilots of `priv::PerfectHashIndex` for the given keys, see there.
+    class PerfectHashBuilder {
+        using Index = priv::PerfectHashIndex;
+
+        // buckets per key is this over `log2` of the key count
+        static constexpr double BUCKETS_FACTOR = 5.0;
+        // larger pilots are not searched, the build is retried with another seed instead
+        static constexpr uint64_t MAX_PILOT = uint64_t(1) << 24;
+
+        struct KeyRecord {
+            uint64_t hash;
+            uint64_t bucket;
+            uint64_t position;
+        };
+
+        struct Bucket {
+            uint64_t start;
+            uint64_t size;
+        };
+
+        Utils::TemporaryArray<KeyRecord> records;
+
+    public:
+        const uint64_t keyCount;
+        const uint64_t tableSize;
+        const uint64_t bucketCount;
+
+        // table slots: packed tree positions, the ones past `keyCount` are moved to `remap` by `build`
+        Utils::TemporaryArray<uint64_t> slots;
+        Utils::TemporaryArray<uint32_t> pilots;
+        std::vector<uint64_t> remap;
+        uint64_t maxPilot = 0;
+        uint64_t maxPosition = 0;
+
+        PerfectHashBuilder(const std::filesystem::path& temporaryDirectory, uint64_t keyCount)
+            : records(temporaryDirectory, keyCount),
+              keyCount(keyCount),
+              tableSize(keyCount == 0 ? 0 : std::max<uint64_t>(keyCount, std::ceil(keyCount / Index::LOAD_FACTOR))),
+              bucketCount(keyCount == 0 ? 0 : std::ceil(BUCKETS_FACTOR * keyCount / std::max(std::log2(keyCount), 1.0))),
+              slots(temporaryDirectory, tableSize),
+              pilots(temporaryDirectory, bucketCount) {}
+
+        void setKey(uint64_t idx, uint64_t hash, uint64_t position) {
+            records[idx] = {hash, Index::getBucket(hash, bucketCount), position};
+            maxPosition = std::max(maxPosition, position);
+        }
+
+        // `false` if some bucket needs too large a pilot (or two keys have the same hash), the keys have to be set
+        // again hashed with another seed then.
+        bool build() {
+            if (keyCount == 0) {
+                return true;
+            }
+            auto* recordsBegin = &records[0];
+            std::sort(recordsBegin, recordsBegin + keyCount, [](const KeyRecord& a, const KeyRecord& b) { return a.bucket < b.bucket; });
+
+            // the largest buckets first, while there are many free slots
+            std::vector<Bucket> buckets;
+            for (uint64_t start = 0; start < keyCount;) {
+                auto end = start + 1;
+                while (end < keyCount && records[end].bucket == records[start].bucket) {
+                    end++;
+                }
+                buckets.push_back({start, end - start});
+                start = end;
+            }
+            std::stable_sort(buckets.begin(), buckets.end(), [](const Bucket& a, const Bucket& b) { return a.size > b.size; });
+
+            std::vector<uint64_t> taken((tableSize + 63) / 64);
+            auto isTaken = [&taken](uint64_t slot) { return (taken[slot / 64] >> (slot % 64)) & 1; };
+            std::vector<uint64_t> bucketSlots;
+            maxPilot = 0;
+            for (const auto& bucket : buckets) {
+                uint64_t pilot = 0;
+                for (;; pilot++) {
+                    if (pilot > MAX_PILOT) [[unlikely]] {
+                        return false;
+                    }
+                    bucketSlots.clear();
+                    bool isFree = true;
+                    for (auto idx = bucket.start; idx < bucket.start + bucket.size; idx++) {
+                        auto slot = Index::getSlot(records[idx].hash, pilot, tableSize);
+                        if (isTaken(slot)) {
+                            isFree = false;
+                            break;
+                        }
+                        bucketSlots.push_back(slot);
+                    }
+                    if (!isFree) {
+                        continue;
+                    }
+                    auto sortedSlots = bucketSlots;
+                    std::sort(sortedSlots.begin(), sortedSlots.end());
+                    if (std::adjacent_find(sortedSlots.begin(), sortedSlots.end()) == sortedSlots.end()) {
+                        break;
+                    }
+                }
+                for (uint64_t idx = 0; idx < bucket.size; idx++) {
+                    taken[bucketSlots[idx] / 64] |= uint64_t(1) << (bucketSlots[idx] % 64);
+                    slots[bucketSlots[idx]] = records[bucket.start + idx].position;
+                }
+                pilots[records[bucket.start].bucket] = pilot;
+                maxPilot = std::max(maxPilot, pilot);
+            }
+
+            // the keys which landed past `keyCount` are moved to the free slots below it, in order
+            remap.assign(tableSize - keyCount, 0);
+            uint64_t freeSlot = 0;
+            for (auto slot = keyCount; slot < tableSize; slot++) {
+                if (!isTaken(slot)) {
+                    continue;
+                }
+                while (isTaken(freeSlot)) {
+                    freeSlot++;
+                }
+                remap[slot - keyCount] = freeSlot;
+                slots[freeSlot] = slots[slot];
+                freeSlot++;
+            }
+            return true;
+        }
+    };
+}
+
+
+// DbWriter::Stats =====================================================================================================
+
+    double DbWriter::Stats::keysPerSecond() const {
+        return static_cast<double>(keys) / std::chrono::duration<double>(elapsed).count();
+    }
+
+    double DbWriter::Stats::megabytesPerSecond() const {
+        return static_cast<double>(fileBytes) / (1024 * 1024) / std::chrono::duration<double>(elapsed).count();
+    }
+
+// END DbWriter::Stats =================================================================================================
+
+
+// DbWriter::SortedKeys ================================================================================================
+
+    // Iterates all the keys put so far in the sorted order, as many times as needed: either directly over the
+    // in-memory buffer (if nothing was spilled) or by k-way merging the sorted runs. The callback gets the key, the
+    // value offset and the inline value (empty unless the value offset is inline, see `PendingKey`).
+    class DbWriter::SortedKeys {
+        DbWriter& writer;
+
+    public:
+        explicit SortedKeys(DbWriter& writer) : writer(writer) {}
+
+        template<class Callback>
+        void forEach(Callback&& callback) {
+            if (writer.runs.empty()) {
+                for (const auto& pendingKey : writer.pendingKeys) {
+                    const auto* key = writer.keyArena.data() + pendingKey.arenaOffset;
+                    auto inlineSize = priv::ValueCollection::isInline(pendingKey.valueOffset) ? pendingKey.valueOffset & ~priv::ValueCollection::INLINE_VALUE_BIT : 0;
+                    callback(Key(key, pendingKey.size), pendingKey.valueOffset, Value(key + pendingKey.size, inlineSize));
+                }
+                return;
+            }
+
+            if (writer.runs.size() == 1) {
+                const auto& run = writer.runs.front();
+                RunCursor cursor {Utils::BufferedFileReader(run.file.get(), writer.options.ioBufferSize, 0, run.size), {}, 0, {}};
+                while (cursor.next()) {
+                    callback(cursor.getKey(), cursor.valueOffset, cursor.getInlineValue());
+                }
+                return;
+            }
+
+            auto bufferSize = std::clamp(writer.options.memoryLimit / writer.runs.size(), MIN_RUN_BUFFER_SIZE, writer.options.ioBufferSize);
+            std::vector<RunCursor> cursors;
+            cursors.reserve(writer.runs.size());
+            for (const auto& run : writer.runs) {
+                cursors.push_back({Utils::BufferedFileReader(run.file.get(), bufferSize, 0, run.size), {}, 0, {}});
+            }
+
+            auto greater = [](const RunCursor* a, const RunCursor* b) { return a->getKey() > b->getKey(); };
+            std::priority_queue<RunCursor*, std::vector<RunCursor*>, decltype(greater)> heap(greater);
+            for (auto& cursor : cursors) {
+                if (cursor.next()) {
+                    heap.push(&cursor);
+                }
+            }
+            while (!heap.empty()) {
+                auto* cursor = heap.top();
+                heap.pop();
+                callback(cursor->getKey(), cursor->valueOffset, cursor->getInlineValue());
+                if (cursor->next()) {
+                    heap.push(cursor);
+                }
+            }
+        }
+    };
+
+// END DbWriter::SortedKeys ============================================================================================
+
+
+// DbWriter ============================================================================================================
+
+    DbWriter::DbWriter(const std::filesystem::path& path, Options options)
+        : DbWriter(Utils::FileDescriptor::create(path), std::move(options)) {}
+
+    DbWriter::DbWriter(Utils::FileDescriptor file, Options options)
+        : options(std::move(options)),
+          file(std::move(file)),
+          output(this->file.get(), this->options.ioBufferSize),
+          startedAt(std::chrono::steady_clock::now()) {
+        if (this->options.valueBlockSize > priv::ValueBlocks::MAX_BLOCK_SIZE) {
+            throw std::invalid_argument("Value block size is too large");
+        }
+        if (this->options.valueBlockSize > 0 && !Utils::isCompressionSupported()) {
+            throw Exceptions::unsupported_error("Compressed values are not supported by this build (see ROFLDB_WITH_ZSTD)");
+        }
+
+        if (this->options.learnedTreeMaxError == 0 || this->options.learnedTreeMaxError > priv::LearnedTree::MAX_SEARCH_RADIUS / 2) {
+            throw std::invalid_argument("Learned tree error is out of range");
+        }
+        if (this->options.largeTree && this->options.version != FormatVersion::WIDE_TREE
+            && this->options.version != FormatVersion::PREFIX_COMPRESSED_WIDE_TREE) {
+            throw std::invalid_argument("Large trees are only supported by the wide tree format versions");
+        }
+        if (this->options.inlineValueSize > MAX_INLINE_VALUE_SIZE) {
+            throw std::invalid_argument("Inline value size is too large");
+        }
+        if (this->options.inlineValueSize > 0 && this->options.version == FormatVersion::INTEGER_KEYS) {
+            throw std::invalid_argument("Inline values are not supported by the integer keys format version");
+        }
+        if (this->options.accessProfile && this->options.version != FormatVersion::SORTED_BINARY_TREE) {
+            throw std::invalid_argument("Access profiles are only supported by the sorted binary tree format version");
+        }
+        if (!(this->options.accessProfileShare >= 0 && this->options.accessProfileShare < 1)) {
+            throw std::invalid_argument("Access profile share must be within [0, 1)");
+        }
+
+        output.write(DbReader::MAGIC, sizeof DbReader::MAGIC);
+        output.write<uint16_t>(static_cast<uint16_t>(this->options.version)
+                               | (this->options.valueBlockSize > 0 ? DbReader::COMPRESSED_VALUES_FLAG : 0)
+                               | (this->options.largeTree ? DbReader::LARGE_TREE_FLAG : 0)
+                               | (this->options.inlineValueSize > 0 ? DbReader::INLINE_VALUES_FLAG : 0)
+                               | (this->options.accessProfile && this->options.hotNodesSize > 0 ? DbReader::HOT_NODES_FLAG : 0));
+
+        valueCollectionOffset = output.tell();
+        output.write<priv::ValueCollection::SizeType>(0);  // will be filled in `finish`
+
+        if (this->options.filterBitsPerKey > 0) {
+            keyHashFile = Utils::FileDescriptor::createTemporary(this->options.temporaryDirectory);
+            keyHashes.emplace(keyHashFile.get(), this->options.ioBufferSize);
+        }
+        if (this->options.presorted) {
+            presortedFile = Utils::FileDescriptor::createTemporary(this->options.temporaryDirectory);
+            presortedKeys.emplace(presortedFile.get(), this->options.ioBufferSize);
+        }
+    }
+
+    void DbWriter::checkKey(const Key& key) const {
+        if (finished) [[unlikely]] {
+            throw std::logic_error("DbWriter is already finished");
+        }
+        if (key.size() > MAX_KEY_SIZE) [[unlikely]] {
+            throw std::length_error("Key is too long");
+        }
+        if (options.version == FormatVersion::INTEGER_KEYS && key.size() != priv::LearnedTree::KEY_SIZE) [[unlikely]] {
+            throw std::invalid_argument("Integer keys are 8 bytes long, see DbWriter::put(uint64_t, ...)");
+        }
+        // before the value is written, so that a key out of order leaves nothing behind
+        if (presortedKeys && stats.keys > 0) {
+            auto order = Key(lastKey.data(), lastKey.size()) <=> key;
+            if (order == 0) [[unlikely]] {
+                throw Exceptions::duplicate_key_error("Duplicate key: " + std::string(reinterpret_cast<const char*>(key.get()), key.size()));
+            }
+            if (order > 0) [[unlikely]] {
+                throw std::invalid_argument("Keys are not put in the sorted order");
+            }
+        }
+    }
+
+    void DbWriter::addPendingKey(const Key& key, ValueOffsetType valueOffset, const Value& inlineValue) {
+        if (keyHashes) {
+            keyHashes->write<uint64_t>(priv::BloomFilter::hashKey(key));
+        }
+        stats.keys++;
+        if (presortedKeys) {
+            writeRunKey(*presortedKeys, key, valueOffset, inlineValue);
+            lastKey.assign(key.get(), key.get() + key.size());
+            return;
+        }
+
+        pendingKeys.push_back({keyArena.size(), valueOffset, static_cast<Key::SizeType>(key.size())});
+        keyArena.insert(keyArena.end(), key.get(), key.get() + key.size());
+        if (priv::ValueCollection::isInline(valueOffset)) {
+            keyArena.insert(keyArena.end(), inlineValue.get(), inlineValue.get() + inlineValue.size());
+        }
+        if (keyArena.size() + pendingKeys.size() * sizeof(PendingKey) >= options.memoryLimit) {
+            spillRun();
+        }
+    }
+
+    void DbWriter::put(const Key& key, const Value& value) {
+        checkKey(key);
+        if (value.size() > std::numeric_limits<Value::SizeType>::max()) [[unlikely]] {
+            throw std::length_error("Value is too long");
+        }
+
+        // a `priv::Tree` node has to fit the inline value too
+        bool isInline = options.inlineValueSize > 0 && value.size() <= options.inlineValueSize
+                        && key.size() + sizeof(Value::SizeType) + value.size() <= MAX_KEY_SIZE;
+        ValueOffsetType valueOffset;
+        if (isInline) {
+            valueOffset = priv::ValueCollection::INLINE_VALUE_BIT | value.size();
+            stats.inlineValues++;
+        } else if (options.valueBlockSize > 0) {
+            // the block sizes are 32-bit too
+            if (value.size() > std::numeric_limits<uint32_t>::max() - sizeof(Value::SizeType) - priv::ValueBlocks::MAX_BLOCK_SIZE) [[unlikely]] {
+                throw std::length_error("Value is too long");
+            }
+            auto blockIdx = valueBlockOffsets.size() + untrainedBlocks.size();
+            valueOffset = (blockIdx << priv::ValueBlocks::BLOCK_OFFSET_BITS) | pendingBlock.size();
+
+            Value::SizeType size = value.size();
+            if constexpr (std::endian::native == std::endian::big) {
+                size = __builtin_bswap32(size);
+            }
+            const auto* sizeBytes = reinterpret_cast<const std::byte*>(&size);
+            pendingBlock.insert(pendingBlock.end(), sizeBytes, sizeBytes + sizeof size);
+            pendingBlock.insert(pendingBlock.end(), value.get(), value.get() + value.size());
+            if (pendingBlock.size() >= options.valueBlockSize) {
+                finishValueBlock();
+            }
+        } else {
+            valueOffset = output.tell() - valueCollectionOffset - sizeof(priv::ValueCollection::SizeType);
+            output.write<Value::SizeType>(value.size());
+            output.write(value.get(), value.size());
+        }
+
+        stats.valueBytes += value.size();
+        addPendingKey(key, valueOffset, value);
+    }
+
+    void DbWriter::put(std::string_view key, std::string_view value) {
+        put(Key(reinterpret_cast<const std::byte*>(key.data()), key.size()),
+            Value(reinterpret_cast<const std::byte*>(value.data()), value.size()));
+    }
+
+    void DbWriter::put(uint64_t key, const Value& value) {
+        std::byte bytes[priv::LearnedTree::KEY_SIZE];
+        priv::LearnedTree::encodeKey(key, bytes);
+        put(Key(bytes, sizeof bytes), value);
+    }
+
+    void DbWriter::put(uint64_t key, std::string_view value) {
+        put(key, Value(reinterpret_cast<const std::byte*>(value.data()), value.size()));
+    }
+
+    DbWriter::ValueOffsetType DbWriter::appendValues(int fd, uint64_t offset, uint64_t size) {
+        if (finished) [[unlikely]] {
+            throw std::logic_error("DbWriter is already finished");
+        }
+        if (options.valueBlockSize > 0) [[unlikely]] {
+            throw std::logic_error("Values can not be appended to compressed values");
+        }
+        ValueOffsetType valueOffset = output.tell() - valueCollectionOffset - sizeof(priv::ValueCollection::SizeType);
+        stats.kernelCopiedValueBytes += output.copyFrom(fd, offset, size);
+        stats.appendedValueBytes += size;
+        return valueOffset;
+    }
+
+    void DbWriter::putAppended(const Key& key, ValueOffsetType valueOffset, Value::SizeType valueSize) {
+        checkKey(key);
+        // within what is written so far, the values themselves are not read back
+        auto valueCollectionSize = output.tell() - valueCollectionOffset - sizeof(priv::ValueCollection::SizeType);
+        if (priv::ValueCollection::isInline(valueOffset) || valueOffset > valueCollectionSize
+            || valueCollectionSize - valueOffset < sizeof(Value::SizeType) + uint64_t(valueSize)) [[unlikely]] {
+            throw std::out_of_range("Appended value offset is out of range");
+        }
+        stats.valueBytes += valueSize;
+        addPendingKey(key, valueOffset, Value(nullptr, 0));
+    }
+
+    void DbWriter::finishValueBlock() {
+        if (pendingBlock.empty()) {
+            return;
+        }
+        if (compressor) {
+            writeValueBlock(pendingBlock);
+            pendingBlock.clear();
+            return;
+        }
+        untrainedBytes += pendingBlock.size();
+        untrainedBlocks.push_back(std::move(pendingBlock));
+        pendingBlock = {};
+        if (untrainedBytes >= options.valueDictionarySize * DICTIONARY_SAMPLES_FACTOR) {
+            trainValueDictionary();
+        }
+    }
+
+    void DbWriter::trainValueDictionary() {
+        if (options.valueDictionarySize > 0) {
+            // every value is a sample
+            std::vector<std::byte> samples;
+            std::vector<std::size_t> sampleSizes;
+            samples.reserve(untrainedBytes);
+            for (const auto& block : untrainedBlocks) {
+                Utils::PayloadReader blockReader(block.data(), block.size());
+                while (blockReader) {
+                    auto value = blockReader.read<Value>();
+                    samples.insert(samples.end(), value.get(), value.get() + value.size());
+                    sampleSizes.push_back(value.size());
+                }
+            }
+            valueDictionary = Utils::trainDictionary(samples, sampleSizes, options.valueDictionarySize);
+        }
+
+        compressor.emplace(valueDictionary, options.compressionLevel);
+        for (const auto& block : untrainedBlocks) {
+            writeValueBlock(block);
+        }
+        untrainedBlocks = {};
+        untrainedBytes = 0;
+    }
+
+    void DbWriter::writeValueBlock(std::span<const std::byte> block) {
+        using priv::ValueBlocks;
+        valueBlockOffsets.push_back(output.tell() - valueCollectionOffset - sizeof(priv::ValueCollection::SizeType));
+
+        // the raw blocks are read without copying, which is worth more than a few percent of the size
+        compressor->compress(block, compressedBlock);
+        auto kind = compressedBlock.size() <= block.size() - block.size() / 8 ? ValueBlocks::BlockKind::COMPRESSED : ValueBlocks::BlockKind::RAW;
+        auto stored = kind == ValueBlocks::BlockKind::COMPRESSED ? std::span<const std::byte>(compressedBlock) : block;
+
+        output.write<uint8_t>(static_cast<uint8_t>(kind));
+        output.write<uint32_t>(block.size());
+        output.write<uint32_t>(stored.size());
+        output.write(stored.data(), stored.size());
+    }
+
+    void DbWriter::writeValueBlocks() {
+        if (options.valueBlockSize == 0) {
+            return;
+        }
+
+        priv::ValueBlocks::SizeType size = sizeof(uint32_t) + valueDictionary.size() + sizeof(uint64_t) + valueBlockOffsets.size() * sizeof(uint64_t);
+        output.write<uint16_t>(static_cast<uint16_t>(SectionTag::VALUE_BLOCKS));
+        output.write<priv::ValueBlocks::SizeType>(size);
+        output.write<uint32_t>(valueDictionary.size());
+        output.write(valueDictionary.data(), valueDictionary.size());
+        output.write<uint64_t>(valueBlockOffsets.size());
+        for (auto offset : valueBlockOffsets) {
+            output.write<uint64_t>(offset);
+        }
+        stats.storedValueBytes += sizeof(uint16_t) + sizeof(priv::ValueBlocks::SizeType) + size;
+    }
+
+    void DbWriter::sortPendingKeys() {
+        const auto* arena = keyArena.data();
+        std::sort(pendingKeys.begin(), pendingKeys.end(), [arena](const PendingKey& a, const PendingKey& b) {
+            return Key(arena + a.arenaOffset, a.size) < Key(arena + b.arenaOffset, b.size);
+        });
+    }
+
+    void DbWriter::spillRun() {
+        if (pendingKeys.empty()) {
+            return;
+        }
+        sortPendingKeys();
+
+        auto runFile = Utils::FileDescriptor::createTemporary(options.temporaryDirectory);
+        Utils::BufferedFileWriter runWriter(runFile.get(), options.ioBufferSize);
+        for (const auto& pendingKey : pendingKeys) {
+            const auto* key = keyArena.data() + pendingKey.arenaOffset;
+            auto inlineSize = priv::ValueCollection::isInline(pendingKey.valueOffset) ? pendingKey.valueOffset & ~priv::ValueCollection::INLINE_VALUE_BIT : 0;
+            writeRunKey(runWriter, Key(key, pendingKey.size), pendingKey.valueOffset, Value(key + pendingKey.size, inlineSize));
+        }
+        runWriter.flush();
+        runs.push_back({std::move(runFile), runWriter.tell()});
+        stats.spilledRuns++;
+
+        keyArena.clear();
+        pendingKeys.clear();
+    }
+
+    void DbWriter::writeTree(SortedKeys& sortedKeys) {
+        switch (options.version) {
+            case FormatVersion::SORTED_BINARY_TREE:
+                if (options.accessProfile) {
+                    return writeWeightedBinaryTree(sortedKeys);
+                }
+                return writeBinaryTree(sortedKeys);
+            case FormatVersion::EYTZINGER_TREE:
+                return writeEytzingerTree(sortedKeys);
+            case FormatVersion::WIDE_TREE:
+            case FormatVersion::PREFIX_COMPRESSED_WIDE_TREE:
+                if (options.largeTree) {
+                    return writeWideTree<priv::WideTree64>(sortedKeys);
+                }
+                return writeWideTree<priv::WideTree>(sortedKeys);
+            case FormatVersion::INTEGER_KEYS:
+                return writeLearnedTree(sortedKeys);
+        }
+        throw std::invalid_argument("Unknown format version");
+    }
+
+    void DbWriter::writeBinaryTree(SortedKeys& sortedKeys) {
+        const auto count = stats.keys;
+        Utils::TemporaryArray<NodeOffsetType> nodeOffsets(options.temporaryDirectory, count);
+
+        // first pass: check the order and lay the nodes out, so that the second pass never needs to seek back
+        uint64_t offset = sizeof(NodeOffsetType);  // root node offset goes first
+        uint64_t idx = 0;
+        OrderChecker orderChecker;
+        sortedKeys.forEach([&](const Key& key, ValueOffsetType valueOffset, const Value& inlineValue) {
+            orderChecker.check(key);
+
+            nodeOffsets[idx] = offset;
+            offset += sizeof(priv::Tree::Node::SizeType) + getNodePayloadSize(key.size(), getBtreeChildren(idx, count))
+                      + getInlineValueSize(valueOffset, inlineValue);
+            if (offset > std::numeric_limits<priv::Tree::SizeType>::max()) [[unlikely]] {
+                throw std::length_error("Tree does not fit into the format");
+            }
+            idx++;
+        });
+
+        // second pass: write the nodes sequentially
+        stats.treeBytes = sizeof(priv::Tree::SizeType) + offset;
+        output.write<priv::Tree::SizeType>(offset);
+        output.write<NodeOffsetType>(count > 0 ? nodeOffsets[getBtreeRoot(count)] : 0);  // `0` means empty tree
+
+        idx = 0;
+        sortedKeys.forEach([&](const Key& key, ValueOffsetType valueOffset, const Value& inlineValue) {
+            auto children = getBtreeChildren(idx, count);
+            writeTreeNode(output, nodeOffsets[idx], key, valueOffset, inlineValue,
+                          children.left ? nodeOffsets[*children.left] : 0, children.right ? nodeOffsets[*children.right] : 0);
+            idx++;
+        });
+    }
+
+    void DbWriter::writeWeightedBinaryTree(SortedKeys& sortedKeys) {
+        const auto count = stats.keys;
+        if (count > std::numeric_limits<uint32_t>::max()) [[unlikely]] {
+            throw std::length_error("Tree does not fit into the format");
+        }
+        const bool hotTree = options.hotNodesSize > 0;
+        const uint64_t headerSize = hotTree ? priv::HotTree::HEADER_SIZE : sizeof(NodeOffsetType);
+
+        // first pass: check the order and find the lookup count of every key (kept in `prefixWeights[idx + 1]` for now)
+        const auto& profile = options.accessProfile->getEntries();
+        auto getProfileKey = [](const AccessProfile::Entry& entry) {
+            return Key(reinterpret_cast<const std::byte*>(entry.key.data()), entry.key.size());
+        };
+        Utils::TemporaryArray<double> prefixWeights(options.temporaryDirectory, count + 1);
+        auto profiled = profile.begin();
+        uint64_t lookupCount = 0;
+        uint64_t idx = 0;
+        OrderChecker orderChecker;
+        sortedKeys.forEach([&](const Key& key, ValueOffsetType, const Value&) {
+            orderChecker.check(key);
+            while (profiled != profile.end() && getProfileKey(*profiled) < key) {
+                profiled++;
+            }
+            uint64_t keyLookups = profiled != profile.end() && getProfileKey(*profiled) == key ? profiled->count : 0;
+            prefixWeights[idx + 1] = static_cast<double>(keyLookups);
+            lookupCount += keyLookups;
+            idx++;
+        });
+        // the share of the lookups of the key, plus an even share of the rest
+        auto share = lookupCount > 0 ? options.accessProfileShare : 0.0;
+        prefixWeights[0] = 0;
+        for (idx = 0; idx < count; idx++) {
+            auto lookupShare = lookupCount > 0 ? prefixWeights[idx + 1] / static_cast<double>(lookupCount) : 0.0;
+            prefixWeights[idx + 1] = prefixWeights[idx] + share * lookupShare + (1 - share) / static_cast<double>(count);
+        }
+        WeightedShape shape(options.temporaryDirectory, prefixWeights, count);
+
+        // second pass: lay the nodes out in key order, relative to the first one
+        Utils::TemporaryArray<NodeOffsetType> nodeOffsets(options.temporaryDirectory, count + 1);
+        uint64_t offset = 0;
+        idx = 0;
+        sortedKeys.forEach([&](const Key& key, ValueOffsetType valueOffset, const Value& inlineValue) {
+            nodeOffsets[idx] = static_cast<NodeOffsetType>(offset);
+            offset += sizeof(priv::Tree::Node::SizeType) + getNodePayloadSize(key.size(), shape.getChildren(idx))
+                      + getInlineValueSize(valueOffset, inlineValue);
+            if (offset > std::numeric_limits<priv::Tree::SizeType>::max()) [[unlikely]] {
+                throw std::length_error("Tree does not fit into the format");
+            }
+            idx++;
+        });
+        nodeOffsets[count] = static_cast<NodeOffsetType>(offset);
+
+        // The lookups of a whole subtree visit its root, so the most visited nodes are picked by their subtree weights,
+        // every one after its parent (which weighs at least as much).
+        struct Candidate {
+            double weight;
+            uint64_t idx;
+            // the keys of its subtree
+            uint64_t lo;
+            uint64_t hi;
+
+            bool operator<(const Candidate& other) const {
+                return weight < other.weight;
+            }
+        };
+        std::priority_queue<Candidate> candidates;
+        if (hotTree && count > 0) {
+            candidates.push({prefixWeights[count], shape.getRoot(), 0, count});
+        }
+        std::vector<uint64_t> hotOrder;
+        uint64_t hotSize = 0;
+        while (!candidates.empty()) {
+            auto candidate = candidates.top();
+            candidates.pop();
+            uint64_t nodeSize = nodeOffsets[candidate.idx + 1] - nodeOffsets[candidate.idx];
+            if (hotSize + nodeSize > options.hotNodesSize) {
+                break;
+            }
+            hotOrder.push_back(candidate.idx);
+            hotSize += nodeSize;
+            auto children = shape.getChildren(candidate.idx);
+            if (children.left) {
+                candidates.push({prefixWeights[candidate.idx] - prefixWeights[candidate.lo], *children.left, candidate.lo, candidate.idx});
+            }
+            if (children.right) {
+                candidates.push({prefixWeights[candidate.hi] - prefixWeights[candidate.idx + 1], *children.right, candidate.idx + 1, candidate.hi});
+            }
+        }
+        const uint64_t orderedOffset = headerSize + hotSize;
+        const uint64_t treeSize = orderedOffset + offset;
+        if (treeSize > std::numeric_limits<priv::Tree::SizeType>::max()) [[unlikely]] {
+            throw std::length_error("Tree does not fit into the format");
+        }
+
+        // the hot copies by key index: their offset and their position in `hotOrder`
+        struct HotNode {
+            uint64_t idx;
+            NodeOffsetType offset;
+            std::size_t position;
+        };
+        std::vector<HotNode> hotNodes;
+        uint64_t hotOffset = headerSize;
+        for (std::size_t position = 0; position < hotOrder.size(); position++) {
+            hotNodes.push_back({hotOrder[position], static_cast<NodeOffsetType>(hotOffset), position});
+            hotOffset += nodeOffsets[hotOrder[position] + 1] - nodeOffsets[hotOrder[position]];
+        }
+        std::sort(hotNodes.begin(), hotNodes.end(), [](const HotNode& a, const HotNode& b) { return a.idx < b.idx; });
+        auto findHotNode = [&hotNodes](uint64_t childIdx) {
+            auto found = std::lower_bound(hotNodes.begin(), hotNodes.end(), childIdx, [](const HotNode& hotNode, uint64_t idx) { return hotNode.idx < idx; });
+            return found != hotNodes.end() && found->idx == childIdx ? &*found : nullptr;
+        };
+        auto getOrderedOffset = [&](std::optional<uint64_t> childIdx) -> NodeOffsetType {
+            return childIdx ? static_cast<NodeOffsetType>(orderedOffset + nodeOffsets[*childIdx]) : 0;
+        };
+        // a hot copy points to the hot copies of its children, if any
+        auto getHotOffset = [&](std::optional<uint64_t> childIdx) -> NodeOffsetType {
+            if (!childIdx) {
+                return 0;
+            }
+            const auto* hotNode = findHotNode(*childIdx);
+            return hotNode != nullptr ? hotNode->offset : getOrderedOffset(childIdx);
+        };
+
+        // third pass: the keys and the inline values of the hot copies, which go first
+        struct HotNodeBytes {
+            std::vector<std::byte> key;
+            ValueOffsetType valueOffset;
+            std::vector<std::byte> inlineValue;
+        };
+        std::vector<HotNodeBytes> hotNodeBytes(hotOrder.size());
+        if (!hotNodes.empty()) {
+            auto nextHotNode = hotNodes.begin();
+            idx = 0;
+            sortedKeys.forEach([&](const Key& key, ValueOffsetType valueOffset, const Value& inlineValue) {
+                if (nextHotNode != hotNodes.end() && nextHotNode->idx == idx) {
+                    auto& bytes = hotNodeBytes[nextHotNode->position];
+                    bytes.key.assign(key.get(), key.get() + key.size());
+                    bytes.valueOffset = valueOffset;
+                    if (priv::ValueCollection::isInline(valueOffset)) {
+                        bytes.inlineValue.assign(inlineValue.get(), inlineValue.get() + inlineValue.size());
+                    }
+                    nextHotNode++;
+                }
+                idx++;
+            });
+        }
+
+        // fourth pass: write the header, the hot copies and the nodes in key order
+        stats.treeBytes = sizeof(priv::Tree::SizeType) + treeSize;
+        stats.hotNodes = hotOrder.size();
+        output.write<priv::Tree::SizeType>(treeSize);
+        auto orderedRoot = count > 0 ? getOrderedOffset(shape.getRoot()) : 0;  // `0` means empty tree
+        if (hotTree) {
+            // the hot copy of the root comes first
+            output.write<NodeOffsetType>(hotOrder.empty() ? orderedRoot : static_cast<NodeOffsetType>(headerSize));
+            output.write<NodeOffsetType>(orderedRoot);
+            output.write<NodeOffsetType>(static_cast<NodeOffsetType>(orderedOffset));
+            hotOffset = headerSize;
+            for (std::size_t position = 0; position < hotOrder.size(); position++) {
+                const auto& bytes = hotNodeBytes[position];
+                auto children = shape.getChildren(hotOrder[position]);
+                writeTreeNode(output, hotOffset, Key(bytes.key.data(), bytes.key.size()), bytes.valueOffset,
+                              Value(bytes.inlineValue.data(), bytes.inlineValue.size()), getHotOffset(children.left), getHotOffset(children.right));
+                hotOffset += nodeOffsets[hotOrder[position] + 1] - nodeOffsets[hotOrder[position]];
+            }
+        } else {
+            output.write<NodeOffsetType>(orderedRoot);
+        }
+
+        idx = 0;
+        sortedKeys.forEach([&](const Key& key, ValueOffsetType valueOffset, const Value& inlineValue) {
+            auto children = shape.getChildren(idx);
+            writeTreeNode(output, orderedOffset + nodeOffsets[idx], key, valueOffset, inlineValue,
+                          getOrderedOffset(children.left), getOrderedOffset(children.right));
+            idx++;
+        });
+    }
+
+    void DbWriter::writeEytzingerTree(SortedKeys& sortedKeys) {
+        using priv::EytzingerTree;
+        const auto count = stats.keys;
+        if (count > std::numeric_limits<EytzingerTree::CountType>::max()) [[unlikely]] {
+            throw std::length_error("Tree does not fit into the format");
+        }
+
+        // Breadth-first order within a single level is the key order, so a single pass over the sorted keys appends
+        // every node to the scratch file of its level; the levels are then concatenated top to bottom.
+        struct Level {
+            Utils::FileDescriptor file;
+            Utils::BufferedFileWriter writer;
+        };
+        std::vector<Level> levels;
+        Utils::TemporaryArray<EytzingerTree::NodeOffsetType> offsetsInLevel(options.temporaryDirectory, count);
+
+        // The inline values are addressed from the tree payload start, which takes the level sizes upfront.
+        const uint64_t offsetsEnd = sizeof(EytzingerTree::CountType) + count * sizeof(EytzingerTree::NodeOffsetType);
+        std::vector<uint64_t> inlineLevelBases;
+        if (options.inlineValueSize > 0) {
+            EytzingerInOrder sizingPositions(count);
+            std::vector<uint64_t> levelSizes;
+            sortedKeys.forEach([&](const Key& key, ValueOffsetType valueOffset, const Value& inlineValue) {
+                auto depth = static_cast<std::size_t>(std::bit_width(sizingPositions.next()) - 1);
+                levelSizes.resize(std::max(levelSizes.size(), depth + 1));
+                levelSizes[depth] += sizeof(Key::SizeType) + key.size() + sizeof(ValueOffsetType) + getInlineValueSize(valueOffset, inlineValue);
+            });
+            auto base = offsetsEnd;
+            for (auto levelSize : levelSizes) {
+                inlineLevelBases.push_back(base);
+                base += levelSize;
+            }
+        }
+
+        EytzingerInOrder positions(count);
+        OrderChecker orderChecker;
+        sortedKeys.forEach([&](const Key& key, ValueOffsetType valueOffset, const Value& inlineValue) {
+            orderChecker.check(key);
+
+            auto k = positions.next();
+            auto depth = static_cast<std::size_t>(std::bit_width(k) - 1);
+            while (levels.size() <= depth) {
+                auto levelFile = Utils::FileDescriptor::createTemporary(options.temporaryDirectory);
+                auto bufferSize = std::min<std::size_t>(options.ioBufferSize, std::size_t(64) << levels.size());
+                Utils::BufferedFileWriter levelWriter(levelFile.get(), bufferSize);
+                levels.push_back({std::move(levelFile), std::move(levelWriter)});
+            }
+
+            auto& writer = levels[depth].writer;
+            if (writer.tell() > std::numeric_limits<EytzingerTree::NodeOffsetType>::max()) [[unlikely]] {
+                throw std::length_error("Tree does not fit into the format");
+            }
+            offsetsInLevel[k - 1] = writer.tell();
+            writer.write<Key::SizeType>(key.size());
+            writer.write(key.get(), key.size());
+            if (priv::ValueCollection::isInline(valueOffset)) {
+                // right after the value offset
+                writer.write<ValueOffsetType>(getInlineValueOffset(inlineLevelBases[depth] + writer.tell() + sizeof(ValueOffsetType)));
+                writer.write<Value::SizeType>(inlineValue.size());
+                writer.write(inlineValue.get(), inlineValue.size());
+            } else {
+                writer.write<ValueOffsetType>(valueOffset);
+            }
+        });
+
+        uint64_t size = offsetsEnd;
+        std::vector<uint64_t> levelBases;
+        for (auto& level : levels) {
+            level.writer.flush();
+            levelBases.push_back(size);
+            size += level.writer.tell();
+        }
+        if (size > std::numeric_limits<EytzingerTree::SizeType>::max()) [[unlikely]] {
+            throw std::length_error("Tree does not fit into the format");
+        }
+
+        stats.treeBytes = sizeof(EytzingerTree::SizeType) + size;
+        output.write<EytzingerTree::SizeType>(size);
+        output.write<EytzingerTree::CountType>(count);
+        for (uint64_t k = 1; k <= count; k++) {
+            output.write<EytzingerTree::NodeOffsetType>(levelBases[std::bit_width(k) - 1] + offsetsInLevel[k - 1]);
+        }
+
+        std::vector<std::byte> copyBuffer(options.ioBufferSize);
+        for (auto& level : levels) {
+            Utils::BufferedFileReader reader(level.file.get(), copyBuffer.size(), 0, level.writer.tell());
+            uint64_t remaining = level.writer.tell();
+            while (remaining > 0) {
+                auto chunk = static_cast<std::size_t>(std::min<uint64_t>(copyBuffer.size(), remaining));
+                reader.read(copyBuffer.data(), chunk);
+                output.write(copyBuffer.data(), chunk);
+                remaining -= chunk;
+            }
+        }
+    }
+
+    template<class WideTree>
+    void DbWriter::writeWideTree(SortedKeys& sortedKeys) {
+        using Node = typename WideTree::Node;
+        const auto count = stats.keys;
+        const auto fanout = options.wideTreeFanout;
+        const bool compressKeys = options.version == FormatVersion::PREFIX_COMPRESSED_WIDE_TREE;
+        if (fanout < 2 || fanout > std::numeric_limits<typename Node::CountType>::max()) [[unlikely]] {
+            throw std::invalid_argument("Wide tree fanout must be between 2 and 255");
+        }
+
+        // Leaves are written first, in key order, then every upper level is built from the list of its children
+        // (offset, smallest and largest key) spilled while writing the level below, until only the root is left.
+        // The tree size and the root offset are the only fields filled in afterwards.
+        const auto treeOffset = output.tell();
+        const auto payloadOffset = treeOffset + sizeof(typename WideTree::SizeType);
+        output.write<typename WideTree::SizeType>(0);
+        output.write<typename Node::OffsetType>(0);
+
+        auto startNode = [&]() {
+            auto offset = output.tell() - payloadOffset;
+            if (offset > std::numeric_limits<typename Node::OffsetType>::max()) [[unlikely]] {
+                throw std::length_error("Tree does not fit into the format, see DbWriter::Options::largeTree");
+            }
+            return static_cast<typename Node::OffsetType>(offset);
+        };
+        auto writeChild = [](Utils::BufferedFileWriter& children, typename Node::OffsetType offset, const Key& minKey, const Key& maxKey) {
+            children.write<typename Node::OffsetType>(offset);
+            children.write<Key::SizeType>(minKey.size());
+            children.write(minKey.get(), minKey.size());
+            children.write<Key::SizeType>(maxKey.size());
+            children.write(maxKey.get(), maxKey.size());
+        };
+
+        auto childrenFile = Utils::FileDescriptor::createTemporary(options.temporaryDirectory);
+        Utils::BufferedFileWriter children(childrenFile.get(), options.ioBufferSize);
+        uint64_t childrenCount = 0;
+
+        WideNodeBuilder<Node> builder;
+        EvenGroups leafSizes(count, fanout);
+        uint64_t leafSize = leafSizes.next();
+        OrderChecker orderChecker;
+        sortedKeys.forEach([&](const Key& key, ValueOffsetType valueOffset, const Value& inlineValue) {
+            orderChecker.check(key);
+            builder.add(key, valueOffset, inlineValue);
+            if (builder.size() == leafSize) {
+                auto minKey = builder.getKey(0), maxKey = builder.getKey(builder.size() - 1);
+                auto offset = startNode();
+                builder.write(output, Node::Kind::LEAF, getCommonPrefixLength(minKey, maxKey), compressKeys, offset);
+                writeChild(children, offset, minKey, maxKey);
+                childrenCount++;
+                builder.clear();
+                leafSize = leafSizes.next();
+            }
+        });
+
+        typename Node::OffsetType rootOffset = 0;  // `0` means empty tree
+        while (childrenCount > 1) {
+            children.flush();
+            Utils::BufferedFileReader childrenReader(childrenFile.get(), options.ioBufferSize, 0, children.tell());
+
+            auto parentsFile = Utils::FileDescriptor::createTemporary(options.temporaryDirectory);
+            Utils::BufferedFileWriter parents(parentsFile.get(), options.ioBufferSize);
+            uint64_t parentsCount = 0;
+
+            EvenGroups nodeSizes(childrenCount, fanout);
+            std::vector<std::byte> maxKey;
+            for (uint64_t childIdx = 0; childIdx < childrenCount;) {
+                auto nodeSize = nodeSizes.next();
+                for (uint64_t idx = 0; idx < nodeSize; idx++, childIdx++) {
+                    typename Node::OffsetType childOffset;
+                    Key::SizeType keySize;
+                    std::vector<std::byte> minKey;
+                    childrenReader.read(childOffset);
+                    childrenReader.read(keySize);
+                    minKey.resize(keySize);
+                    childrenReader.read(minKey.data(), keySize);
+                    childrenReader.read(keySize);
+                    maxKey.resize(keySize);
+                    childrenReader.read(maxKey.data(), keySize);
+                    builder.add(Key(minKey.data(), minKey.size()), childOffset);
+                }
+
+                auto nodeMinKey = builder.getKey(0);
+                Key nodeMaxKey(maxKey.data(), maxKey.size());
+                auto offset = startNode();
+                builder.write(output, Node::Kind::INTERNAL, getCommonPrefixLength(nodeMinKey, nodeMaxKey), compressKeys, offset);
+                writeChild(parents, offset, nodeMinKey, nodeMaxKey);
+                parentsCount++;
+                builder.clear();
+            }
+
+            parents.flush();
+            childrenFile = std::move(parentsFile);
+            children = std::move(parents);
+            childrenCount = parentsCount;
+        }
+        if (childrenCount == 1) {
+            children.flush();
+            Utils::BufferedFileReader childrenReader(childrenFile.get(), sizeof(typename Node::OffsetType), 0, sizeof(typename Node::OffsetType));
+            childrenReader.read(rootOffset);
+        }
+
+        auto size = output.tell() - payloadOffset;
+        if (size > std::numeric_limits<typename WideTree::SizeType>::max()) [[unlikely]] {
+            throw std::length_error("Tree does not fit into the format, see DbWriter::Options::largeTree");
+        }
+        stats.treeBytes = sizeof(typename WideTree::SizeType) + size;
+        output.writeAt<typename WideTree::SizeType>(treeOffset, size);
+        output.writeAt<typename Node::OffsetType>(payloadOffset, rootOffset);
+    }
+
+    void DbWriter::writeLearnedTree(SortedKeys& sortedKeys) {
+        using priv::LearnedTree;
+        const auto count = stats.keys;
+
+        // first pass: fit the model, its size and the padding of the keys follow from the segments
+        SegmentsBuilder builder(options.learnedTreeMaxError);
+        uint64_t minKey = 0, maxKey = 0;
+        OrderChecker orderChecker;
+        sortedKeys.forEach([&](const Key& key, ValueOffsetType, const Value&) {
+            orderChecker.check(key);
+            maxKey = *LearnedTree::decodeKey(key);
+            if (builder.segments.empty()) {
+                minKey = maxKey;
+            }
+            builder.add(maxKey);
+        });
+        const auto& segments = builder.segments;
+
+        // about two buckets per segment, so that a bucket holds few segments unless the keys are skewed
+        unsigned radixBits = std::min<unsigned>(std::bit_width(segments.size()) + 1, LearnedTree::MAX_RADIX_BITS);
+        unsigned radixShift = std::max<int>(std::bit_width(maxKey - minKey) - static_cast<int>(radixBits), 0);
+        auto bucketCount = uint64_t(1) << radixBits;
+        if (segments.size() > std::numeric_limits<uint32_t>::max()) [[unlikely]] {
+            throw std::length_error("Tree does not fit into the format");
+        }
+
+        const auto treeOffset = output.tell();
+        const auto modelSize = LearnedTree::HEADER_SIZE + (bucketCount + 1) * sizeof(uint32_t)
+                               + segments.size() * (sizeof(uint64_t) + LearnedTree::SEGMENT_SIZE);
+        const auto keysOffset = treeOffset + sizeof(LearnedTree::SizeType) + modelSize;
+        const auto paddingSize = (LearnedTree::KEYS_ALIGNMENT - keysOffset % LearnedTree::KEYS_ALIGNMENT) % LearnedTree::KEYS_ALIGNMENT;
+        const auto size = modelSize + paddingSize + count * (sizeof(uint64_t) + sizeof(ValueOffsetType));
+
+        stats.treeBytes = sizeof(LearnedTree::SizeType) + size;
+        output.write<LearnedTree::SizeType>(size);
+        output.write<uint64_t>(count);
+        output.write<uint64_t>(minKey);
+        output.write<uint64_t>(segments.size());
+        output.write<uint32_t>(0);  // the search radius, measured by the second pass
+        output.write<uint8_t>(radixBits);
+        output.write<uint8_t>(radixShift);
+        output.write<uint8_t>(paddingSize);
+        std::size_t segmentIdx = 0;
+        for (uint64_t bucket = 0; bucket <= bucketCount; bucket++) {
+            while (segmentIdx < segments.size() && ((segments[segmentIdx].key - minKey) >> radixShift) < bucket) {
+                segmentIdx++;
+            }
+            output.write<uint32_t>(segmentIdx);
+        }
+        for (const auto& segment : segments) {
+            output.write<uint64_t>(segment.key);
+        }
+        for (const auto& segment : segments) {
+            output.write<uint64_t>(segment.position);
+            output.write<uint64_t>(std::bit_cast<uint64_t>(segment.slope));
+        }
+        const std::byte padding[LearnedTree::KEYS_ALIGNMENT] = {};
+        output.write(padding, paddingSize);
+
+        // second pass: the keys, and how far from the predictions they are
+        Utils::TemporaryArray<ValueOffsetType> valueOffsets(options.temporaryDirectory, count);
+        uint64_t searchRadius = 0;
+        uint64_t idx = 0;
+        segmentIdx = 0;
+        sortedKeys.forEach([&](const Key& key, ValueOffsetType valueOffset, const Value&) {
+            auto value = *LearnedTree::decodeKey(key);
+            output.write<uint64_t>(value);
+            valueOffsets[idx] = valueOffset;
+
+            if (segmentIdx + 1 < segments.size() && segments[segmentIdx + 1].position == idx) {
+                segmentIdx++;
+            }
+            const auto& segment = segments[segmentIdx];
+            auto segmentEnd = segmentIdx + 1 < segments.size() ? segments[segmentIdx + 1].position : count;
+            auto prediction = segment.position + LearnedTree::predict(segment.slope, value - segment.key, segmentEnd - segment.position);
+            searchRadius = std::max(searchRadius, prediction > idx ? prediction - idx : idx - prediction);
+            idx++;
+        });
+        for (idx = 0; idx < count; idx++) {
+            output.write<ValueOffsetType>(valueOffsets[idx]);
+        }
+
+        if (searchRadius > LearnedTree::MAX_SEARCH_RADIUS) [[unlikely]] {
+            throw std::length_error("Tree does not fit into the format, see DbWriter::Options::learnedTreeMaxError");
+        }
+        output.writeAt<uint32_t>(treeOffset + sizeof(LearnedTree::SizeType) + 3 * sizeof(uint64_t), searchRadius);
+    }
+
+    void DbWriter::writeFilter() {
+        using priv::BloomFilter;
+        if (!keyHashes) {
+            return;
+        }
+        keyHashes->flush();
+
+        // the optimal number of hashes is `ln 2` per bit per key
+        auto hashCount = std::clamp<unsigned>(options.filterBitsPerKey * 69 / 100, 1, BloomFilter::MAX_HASH_COUNT);
+        auto blockCount = std::max<uint64_t>((stats.keys * options.filterBitsPerKey + BloomFilter::BLOCK_BITS - 1) / BloomFilter::BLOCK_BITS, 1);
+        constexpr auto wordsPerBlock = BloomFilter::BLOCK_SIZE / sizeof(uint64_t);
+
+        Utils::TemporaryArray<uint64_t> words(options.temporaryDirectory, blockCount * wordsPerBlock);
+        Utils::BufferedFileReader hashReader(keyHashFile.get(), options.ioBufferSize, 0, keyHashes->tell());
+        uint64_t hash;
+        while (hashReader.read(hash)) {
+            auto* block = &words[BloomFilter::getBlockIdx(hash, blockCount) * wordsPerBlock];
+            BloomFilter::forEachBit(hash, hashCount, [block](unsigned bitIdx) {
+                block[bitIdx / 64] |= uint64_t(1) << (bitIdx % 64);
+            });
+        }
+        keyHashes.reset();
+        keyHashFile = {};
+
+        // tag, size, block count, hash count and padding size go before the padding
+        constexpr auto headerSize = sizeof(uint16_t) + sizeof(BloomFilter::SizeType) + sizeof(uint64_t) + 2 * sizeof(uint8_t);
+        auto paddingSize = (BloomFilter::BLOCK_SIZE - (output.tell() + headerSize) % BloomFilter::BLOCK_SIZE) % BloomFilter::BLOCK_SIZE;
+        BloomFilter::SizeType size = sizeof(uint64_t) + 2 * sizeof(uint8_t) + paddingSize + blockCount * BloomFilter::BLOCK_SIZE;
+
+        output.write<uint16_t>(static_cast<uint16_t>(SectionTag::BLOOM_FILTER));
+        output.write<BloomFilter::SizeType>(size);
+        output.write<uint64_t>(blockCount);
+        output.write<uint8_t>(hashCount);
+        output.write<uint8_t>(paddingSize);
+        const std::byte padding[BloomFilter::BLOCK_SIZE] = {};
+        output.write(padding, paddingSize);
+        for (uint64_t idx = 0; idx < words.size(); idx++) {
+            output.write<uint64_t>(words[idx]);
+        }
+        stats.filterBytes = sizeof(uint16_t) + sizeof(BloomFilter::SizeType) + size;
+    }
+
+    void DbWriter::writePerfectHashIndex(uint64_t treeOffset) {
+        if (!options.perfectHashIndex) {
+            return;
+        }
+        constexpr unsigned MAX_ATTEMPTS = 16;
+
+        // the keys and their positions are read back from the tree just written
+        output.flush();
+        FileMapping mapping(file.get(), output.tell());
+        const auto* treeAddress = mapping.get() + treeOffset;
+
+        PerfectHashBuilder builder(options.temporaryDirectory, stats.keys);
+        uint64_t seed = 1;
+        auto setKeys = [&builder, &seed](const auto* tree) {
+            priv::KeyBuffer buffer;
+            uint64_t idx = 0;
+            for (auto position = tree->first(); position; position = tree->next(position)) {
+                auto key = tree->getKey(position, buffer);
+                builder.setKey(idx++, Utils::hashBytes(key.get(), key.size(), seed), tree->packPosition(position));
+            }
+        };
+        for (;; seed++) {
+            if (seed > MAX_ATTEMPTS) [[unlikely]] {
+                throw std::runtime_error("Could not build the perfect hash index");
+            }
+            switch (options.version) {
+                case FormatVersion::SORTED_BINARY_TREE:
+                    if (options.accessProfile && options.hotNodesSize > 0) {
+                        setKeys(reinterpret_cast<const priv::HotTree*>(treeAddress));
+                    } else {
+                        setKeys(reinterpret_cast<const priv::Tree*>(treeAddress));
+                    }
+                    break;
+                case FormatVersion::EYTZINGER_TREE:
+                    setKeys(reinterpret_cast<const priv::EytzingerTree*>(treeAddress));
+                    break;
+                case FormatVersion::WIDE_TREE:
+                case FormatVersion::PREFIX_COMPRESSED_WIDE_TREE:
+                    if (options.largeTree) {
+                        setKeys(reinterpret_cast<const priv::WideTree64*>(treeAddress));
+                    } else {
+                        setKeys(reinterpret_cast<const priv::WideTree*>(treeAddress));
+                    }
+                    break;
+                case FormatVersion::INTEGER_KEYS:
+                    setKeys(reinterpret_cast<const priv::LearnedTree*>(treeAddress));
+                    break;
+            }
+            if (builder.build()) {
+                break;
+            }
+        }
+
+        auto pilotSize = getPackedSize(builder.maxPilot);
+        auto remapSize = getPackedSize(builder.keyCount);
+        auto entrySize = getPackedSize(builder.maxPosition);
+        priv::PerfectHashIndex::SizeType size = 4 * sizeof(uint64_t) + 3 * sizeof(uint8_t)
+            + builder.bucketCount * pilotSize + builder.remap.size() * remapSize + builder.keyCount * entrySize;
+
+        output.write<uint16_t>(static_cast<uint16_t>(SectionTag::PERFECT_HASH_INDEX));
+        output.write<priv::PerfectHashIndex::SizeType>(size);
+        output.write<uint64_t>(seed);
+        output.write<uint64_t>(builder.keyCount);
+        output.write<uint64_t>(builder.tableSize);
+        output.write<uint64_t>(builder.bucketCount);
+        output.write<uint8_t>(pilotSize);
+        output.write<uint8_t>(remapSize);
+        output.write<uint8_t>(entrySize);
+        for (uint64_t idx = 0; idx < builder.bucketCount; idx++) {
+            writePacked(output, builder.pilots[idx], pilotSize);
+        }
+        for (auto slot : builder.remap) {
+            writePacked(output, slot, remapSize);
+        }
+        for (uint64_t idx = 0; idx < builder.keyCount; idx++) {
+            writePacked(output, builder.slots[idx], entrySize);
+        }
+        stats.indexBytes = sizeof(uint16_t) + sizeof(priv::PerfectHashIndex::SizeType) + size;
+    }
+
+    DbWriter::Stats DbWriter::finish() {
+        if (finished) [[unlikely]] {
+            throw std::logic_error("DbWriter is already finished");
+        }
+        finished = true;
+
+        if (options.valueBlockSize > 0) {
+            finishValueBlock();
+            if (!compressor) {
+                trainValueDictionary();
+            }
+        }
+        auto valueCollectionSize = output.tell() - valueCollectionOffset - sizeof(priv::ValueCollection::SizeType);
+        if (presortedKeys) {
+            presortedKeys->flush();
+            runs.push_back({std::move(presortedFile), presortedKeys->tell()});
+            presortedKeys.reset();
+        } else if (runs.empty()) {
+            sortPendingKeys();
+        } else {
+            spillRun();
+        }
+
+        SortedKeys sortedKeys(*this);
+        auto treeOffset = output.tell();
+        writeTree(sortedKeys);
+        writeFilter();
+        writePerfectHashIndex(treeOffset);
+        writeValueBlocks();
+        output.writeAt<priv::ValueCollection::SizeType>(valueCollectionOffset, valueCollectionSize);
+        output.flush();
+        stats.storedValueBytes += sizeof(priv::ValueCollection::SizeType) + valueCollectionSize;
+
+        keyArena = {};
+        pendingKeys = {};
+        runs.clear();
+
+        stats.fileBytes = output.tell();
+        stats.elapsed = std::chrono::steady_clock::now() - startedAt;
+        return stats;
+    }
+
+// END DbWriter ========================================================================================================
+
+}
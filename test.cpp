@@ -1,15 +1,11 @@
 #include <cstddef>
 #include <cstdio>
-#include <sys/mman.h>
-#include <sys/stat.h>
 #include <cstring>
 #include <iostream>
 #include <map>
 #include <chrono>
 
-#include "include/library.h"
-
-#define MAP_HUGE_8MB    (23 << MAP_HUGE_SHIFT)
+#include "include/db_file.h"
 
 int main(int argc, char* argv[]) {
     using clock = std::chrono::steady_clock;
@@ -32,32 +28,25 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    std::FILE* file = fopen64(argv[1], "rb");
-    if (errno) {
-        throw std::runtime_error(std::strerror(errno));
-    }
-    struct stat64 fileStat {};
-    fstat64(fileno(file), &fileStat);
+    RoflDb::DbFile dbFile(argv[1]);
+    const auto& dbReader = dbFile.getReader();
+    std::cout << "Filter: " << (dbReader.hasFilter() ? "yes" : "no") << "\n";
 
-    auto* data = static_cast<std::byte*>(mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE | MAP_HUGE_8MB, fileno(file), 0));
-    if (data == MAP_FAILED) {
-        throw std::runtime_error(std::strerror(errno));
-    }
-    fclose(file);
-
-    RoflDb::DbReader dbReader(data, fileStat.st_size);
-    start = clock::now();
-    for (long long i = 0; i < 1000000; i++) {
-        auto key = "key" + std::to_string(i);
-        if (auto res = dbReader.get(key)) {
-//            std::cerr << "Key '" << key << "' found: " << std::string(reinterpret_cast<const char*>(res->get()), res->size()) << "\n";
-        } else {
-//            std::cerr << "Not found key '" << key << "'!\n";
+    // hits and misses are timed separately, as the filter only speeds up the latter
+    const long long lookups = 1000000;
+    for (const char* keyPrefix : {"key", "absent-key"}) {
+        long long found = 0;
+        start = clock::now();
+        for (long long i = 0; i < lookups; i++) {
+            auto key = keyPrefix + std::to_string(i);
+            if (auto res = dbReader.get(key)) {
+                found++;
+//                std::cerr << "Key '" << key << "' found: " << std::string(reinterpret_cast<const char*>(res->get()), res->size()) << "\n";
+            }
         }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+        std::cout << "Read " << lookups << " '" << keyPrefix << "N' (" << found << " found): "
+                  << elapsed.count() / 1000000 << " ms, " << elapsed.count() / lookups << " ns per lookup\n";
     }
-    std::cout << "Read " << 1000000 << ": " << std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count() << " ms\n";
-    std::cin.get();
-    munmap(data, fileStat.st_size);
-    std::cin.get();
     return 0;
 }
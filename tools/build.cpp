@@ -0,0 +1,174 @@
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "access_profile.h"
+#include "sharded.h"
+#include "writer.h"
+
+static int usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [options] OUTPUT [INPUT]\n"
+              << "Builds a .rofldb file from unsorted records read from INPUT (or stdin).\n"
+              << "\n"
+              << "  --format=tsv       one \"key<TAB>value\" record per line (default)\n"
+              << "  --format=binary    repeated <u32 key size><key><u32 value size><value>, little endian\n"
+              << "  --format-version=N tree layout, see RoflDb::FormatVersion (default: 0); the TSV keys of version 4\n"
+              << "                     (integer keys) are decimal numbers, the binary ones 8-byte big endian numbers\n"
+              << "  --memory-limit=MB  memory for buffering keys before spilling a sorted run (default: 256)\n"
+              << "  --temp-dir=DIR     where sorted runs are spilled (default: system temporary directory)\n"
+              << "  --perfect-hash     add a perfect hash index for point lookups in a few memory accesses\n"
+              << "  --filter-bits=N    add a Bloom filter with N bits per key for fast negative lookups (default: 0, none)\n"
+              << "  --value-block-size=KB\n"
+              << "                     compress the values in blocks of KB kibibytes (default: 0, uncompressed)\n"
+              << "  --compression-level=N\n"
+              << "                     zstd level for the value blocks (default: 3)\n"
+              << "  --large-tree       64-bit tree offsets, for trees over 4 GiB (format versions 2 and 3)\n"
+              << "  --inline-values=N  store the values of up to N bytes within the tree nodes (default: 0, none)\n"
+              << "  --access-profile=FILE\n"
+              << "                     weight-balance the tree by the lookup counts of RoflDb::AccessProfile FILE\n"
+              << "                     (format version 0)\n"
+              << "  --hot-nodes-size=KB\n"
+              << "                     with --access-profile, copy the KB kibibytes of the most visited nodes to the\n"
+              << "                     start of the tree (default: 2048, 0 for none)\n"
+              << "  --shards=N         split into N shards by key hash, built in parallel; OUTPUT is the shard manifest\n"
+              << "                     and the memory limit is shared by the shards (default: 0, a single file)\n";
+    return 2;
+}
+
+static bool readBinary(std::FILE* input, std::vector<char>& buffer) {
+    uint32_t size;
+    if (std::fread(&size, sizeof size, 1, input) != 1) {
+        return false;
+    }
+    buffer.resize(size);
+    if (size > 0 && std::fread(buffer.data(), size, 1, input) != 1) {
+        throw std::runtime_error("Truncated input record");
+    }
+    return true;
+}
+
+static uint64_t parseIntegerKey(std::string_view key) {
+    uint64_t result;
+    auto [end, error] = std::from_chars(key.data(), key.data() + key.size(), result);
+    if (error != std::errc() || end != key.data() + key.size()) {
+        throw std::runtime_error("Key is not a 64-bit number: " + std::string(key));
+    }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    RoflDb::DbWriter::Options options;
+    unsigned shardCount = 0;
+    std::string_view format = "tsv";
+    std::vector<const char*> positional;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg.starts_with("--format=")) {
+            format = arg.substr(std::strlen("--format="));
+        } else if (arg.starts_with("--format-version=")) {
+            options.version = static_cast<RoflDb::FormatVersion>(std::stoul(std::string(arg.substr(std::strlen("--format-version=")))));
+        } else if (arg.starts_with("--memory-limit=")) {
+            options.memoryLimit = std::stoull(std::string(arg.substr(std::strlen("--memory-limit=")))) * 1024 * 1024;
+        } else if (arg == "--perfect-hash") {
+            options.perfectHashIndex = true;
+        } else if (arg.starts_with("--filter-bits=")) {
+            options.filterBitsPerKey = std::stoul(std::string(arg.substr(std::strlen("--filter-bits="))));
+        } else if (arg.starts_with("--value-block-size=")) {
+            options.valueBlockSize = std::stoull(std::string(arg.substr(std::strlen("--value-block-size=")))) * 1024;
+        } else if (arg.starts_with("--compression-level=")) {
+            options.compressionLevel = std::stoi(std::string(arg.substr(std::strlen("--compression-level="))));
+        } else if (arg == "--large-tree") {
+            options.largeTree = true;
+        } else if (arg.starts_with("--inline-values=")) {
+            options.inlineValueSize = std::stoull(std::string(arg.substr(std::strlen("--inline-values="))));
+        } else if (arg.starts_with("--access-profile=")) {
+            options.accessProfile = std::make_shared<const RoflDb::AccessProfile>(RoflDb::AccessProfile::load(arg.substr(std::strlen("--access-profile="))));
+        } else if (arg.starts_with("--hot-nodes-size=")) {
+            options.hotNodesSize = std::stoull(std::string(arg.substr(std::strlen("--hot-nodes-size=")))) * 1024;
+        } else if (arg.starts_with("--shards=")) {
+            shardCount = std::stoul(std::string(arg.substr(std::strlen("--shards="))));
+        } else if (arg.starts_with("--temp-dir=")) {
+            options.temporaryDirectory = arg.substr(std::strlen("--temp-dir="));
+        } else if (arg.starts_with("--") && arg != "--") {
+            return usage(argv[0]);
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    if (positional.empty() || positional.size() > 2 || (format != "tsv" && format != "binary")) {
+        return usage(argv[0]);
+    }
+
+    std::FILE* input = stdin;
+    if (positional.size() == 2 && std::strcmp(positional[1], "-") != 0) {
+        input = std::fopen(positional[1], "rb");
+        if (!input) {
+            throw std::runtime_error(std::strerror(errno));
+        }
+    }
+    static char inputBuffer[4 * 1024 * 1024];
+    std::setvbuf(input, inputBuffer, _IOFBF, sizeof inputBuffer);
+
+    auto build = [&](auto& writer) {
+        if (format == "tsv") {
+            char* line = nullptr;
+            std::size_t capacity = 0;
+            ssize_t length;
+            while ((length = getline(&line, &capacity, input)) >= 0) {
+                std::string_view record(line, length);
+                if (record.ends_with('\n')) {
+                    record.remove_suffix(1);
+                }
+                auto separator = record.find('\t');
+                if (separator == std::string_view::npos) {
+                    throw std::runtime_error("Record without a TAB separator: " + std::string(record));
+                }
+                auto key = record.substr(0, separator);
+                if (options.version == RoflDb::FormatVersion::INTEGER_KEYS) {
+                    writer.put(parseIntegerKey(key), record.substr(separator + 1));
+                } else {
+                    writer.put(key, record.substr(separator + 1));
+                }
+            }
+            std::free(line);
+        } else {
+            std::vector<char> key, value;
+            while (readBinary(input, key)) {
+                if (!readBinary(input, value)) {
+                    throw std::runtime_error("Truncated input record");
+                }
+                writer.put(std::string_view(key.data(), key.size()), std::string_view(value.data(), value.size()));
+            }
+        }
+        if (input != stdin) {
+            std::fclose(input);
+        }
+        return writer.finish();
+    };
+
+    RoflDb::DbWriter::Stats stats;
+    if (shardCount > 0) {
+        RoflDb::ShardedDbWriter::Options shardedOptions;
+        shardedOptions.shardCount = shardCount;
+        shardedOptions.shardOptions = options;
+        shardedOptions.shardOptions.memoryLimit = options.memoryLimit / shardCount;
+        RoflDb::ShardedDbWriter writer(positional[0], shardedOptions);
+        stats = build(writer);
+    } else {
+        RoflDb::DbWriter writer(positional[0], options);
+        stats = build(writer);
+    }
+    std::cerr << "Built " << stats.keys << " keys into " << positional[0] << ": "
+              << stats.fileBytes << " bytes (values " << stats.valueBytes << ", stored " << stats.storedValueBytes << ", tree " << stats.treeBytes << ", filter " << stats.filterBytes << ", index " << stats.indexBytes << "), "
+              << stats.inlineValues << " values inline, " << stats.hotNodes << " hot nodes, " << stats.spilledRuns << " sorted runs spilled, "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(stats.elapsed).count() << " ms, "
+              << static_cast<uint64_t>(stats.keysPerSecond()) << " keys/s, "
+              << stats.megabytesPerSecond() << " MiB/s\n";
+    return 0;
+}
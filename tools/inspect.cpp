@@ -0,0 +1,159 @@
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "db_file.h"
+
+static int usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " FILE\n"
+              << "Prints the format, the section sizes and the shape of the tree of a .rofldb file.\n";
+    return 2;
+}
+
+static const char* getFormatName(RoflDb::FormatVersion version) {
+    switch (version) {
+        case RoflDb::FormatVersion::SORTED_BINARY_TREE:
+            return "sorted binary tree";
+        case RoflDb::FormatVersion::EYTZINGER_TREE:
+            return "Eytzinger tree";
+        case RoflDb::FormatVersion::WIDE_TREE:
+            return "wide tree";
+        case RoflDb::FormatVersion::PREFIX_COMPRESSED_WIDE_TREE:
+            return "prefix compressed wide tree";
+        case RoflDb::FormatVersion::INTEGER_KEYS:
+            return "integer keys with a learned index";
+    }
+    return "unknown";
+}
+
+static void printRow(const std::vector<std::string>& cells) {
+    for (std::size_t idx = 0; idx < cells.size(); idx++) {
+        std::printf(idx == 0 ? "  %-20s" : " %14s", cells[idx].c_str());
+    }
+    std::printf("\n");
+}
+
+static std::string formatPercent(double part, double whole) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof buffer, "%.1f%%", whole > 0 ? 100 * part / whole : 0.0);
+    return buffer;
+}
+
+static std::string formatAverage(uint64_t sum, uint64_t count) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof buffer, "%.1f", count > 0 ? static_cast<double>(sum) / count : 0.0);
+    return buffer;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2 || std::string_view(argv[1]).starts_with("--")) {
+        return usage(argv[0]);
+    }
+    RoflDb::DbFile dbFile(argv[1]);
+    const auto& reader = dbFile.getReader();
+
+    auto versionField = reader.getVersionField();
+    auto version = static_cast<RoflDb::FormatVersion>(versionField & 0xFF);
+    bool eytzinger = version == RoflDb::FormatVersion::EYTZINGER_TREE;
+    bool wide = version == RoflDb::FormatVersion::WIDE_TREE || version == RoflDb::FormatVersion::PREFIX_COMPRESSED_WIDE_TREE;
+    bool learned = version == RoflDb::FormatVersion::INTEGER_KEYS;
+    std::printf("%s: format version %u (%s)%s%s%s%s%s%s\n", argv[1],
+                static_cast<unsigned>(version), getFormatName(version),
+                versionField & RoflDb::DbReader::COMPRESSED_VALUES_FLAG ? ", compressed values" : "",
+                versionField & RoflDb::DbReader::LARGE_TREE_FLAG ? ", 64-bit tree offsets" : "",
+                versionField & RoflDb::DbReader::INLINE_VALUES_FLAG ? ", inline values" : "",
+                versionField & RoflDb::DbReader::HOT_NODES_FLAG ? ", hot nodes first" : "",
+                reader.hasFilter() ? ", Bloom filter" : "",
+                reader.hasIndex() ? ", perfect hash index" : "");
+
+    std::printf("\nsections:\n");
+    auto file = dbFile.getData();
+    printRow({"", "offset", "bytes", "share"});
+    for (const auto& section : reader.getSections()) {
+        printRow({section.name, std::to_string(section.bytes.data() - file.data()),
+                  std::to_string(section.bytes.size()), formatPercent(section.bytes.size(), file.size())});
+    }
+    printRow({"file", "", std::to_string(file.size()), ""});
+
+    // Keys found at a depth are the nodes of a binary tree, and the keys of the leaves of a wide tree (where the
+    // entries of the internal nodes are their children). The learned index is the model (with the segments as its
+    // entries), then the keys array and the value offsets array.
+    struct Level {
+        uint64_t nodes = 0;
+        uint64_t bytes = 0;
+        uint64_t entries = 0;
+        uint64_t keys = 0;
+    };
+    std::vector<Level> levels;
+    // node counts by the power of two at or above the node size
+    std::map<uint64_t, uint64_t> nodeSizes;
+    uint64_t keyCount = 0;
+    for (unsigned depth = 0;; depth++) {
+        Level level;
+        bool offsetsTable = eytzinger;
+        bool visited = reader.forEachTreeNodeAtDepth(depth, [&](std::span<const std::byte> node) {
+            if (offsetsTable) {
+                // the offsets of the level come first
+                offsetsTable = false;
+                level.bytes += node.size();
+                return true;
+            }
+            level.nodes++;
+            level.bytes += node.size();
+            nodeSizes[std::bit_ceil(node.size())]++;
+            if (learned && depth == 0) {
+                // u64 count, u64 min key, u64 segment count
+                uint64_t segmentCount;
+                std::memcpy(&segmentCount, node.data() + 2 * sizeof(uint64_t), sizeof segmentCount);
+                level.entries += segmentCount;
+            } else if (learned) {
+                level.entries += node.size() / sizeof(uint64_t);
+                level.keys += depth == 1 ? node.size() / sizeof(uint64_t) : 0;
+            } else if (wide) {
+                // u32 size, u8 kind, u8 count
+                auto kind = std::to_integer<uint8_t>(node[4]) & ~RoflDb::priv::WideTree::Node::COMPRESSED_KEYS;
+                auto count = std::to_integer<uint8_t>(node[5]);
+                level.entries += count;
+                if (kind == static_cast<uint8_t>(RoflDb::priv::WideTree::Node::Kind::LEAF)) {
+                    level.keys += count;
+                }
+            } else {
+                level.entries++;
+                level.keys++;
+            }
+            return true;
+        });
+        if (!visited) {
+            break;
+        }
+        keyCount += level.keys;
+        levels.push_back(level);
+    }
+
+    std::printf("\ntree: %zu levels, %llu keys\n", levels.size(), static_cast<unsigned long long>(keyCount));
+    printRow({"depth", "nodes", "bytes", "entries/node", "keys", "keys share"});
+    uint64_t depthSum = 0;
+    for (std::size_t depth = 0; depth < levels.size(); depth++) {
+        const auto& level = levels[depth];
+        depthSum += depth * level.keys;
+        printRow({std::to_string(depth), std::to_string(level.nodes), std::to_string(level.bytes),
+                  formatAverage(level.entries, level.nodes), std::to_string(level.keys), formatPercent(level.keys, keyCount)});
+    }
+    std::printf("  mean depth of a key (the root is 0): %s\n", formatAverage(depthSum, keyCount).c_str());
+
+    std::printf("\nnode sizes:\n");
+    printRow({"bytes", "nodes", "share"});
+    uint64_t nodeCount = 0;
+    for (auto [size, count] : nodeSizes) {
+        nodeCount += count;
+    }
+    for (auto [size, count] : nodeSizes) {
+        printRow({"<= " + std::to_string(size), std::to_string(count), formatPercent(count, nodeCount)});
+    }
+    return 0;
+}
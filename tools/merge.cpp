@@ -0,0 +1,103 @@
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "merge.h"
+
+static int usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [options] OUTPUT INPUT...\n"
+              << "Merges .rofldb files into OUTPUT, the INPUTs ordered from the oldest to the newest.\n"
+              << "\n"
+              << "  --duplicates=RULE  entry kept of a key found in several inputs: newest (default), oldest, or fail\n"
+              << "  --threads=N        threads merging key ranges (default: 0, all the hardware threads)\n"
+              << "  --format-version=N tree layout of the output, see RoflDb::FormatVersion (default: 0)\n"
+              << "  --memory-limit=MB  memory for buffering keys before spilling a sorted run (default: 256)\n"
+              << "  --temp-dir=DIR     where the merged ranges and sorted runs are stored (default: system temporary\n"
+              << "                     directory), on the file system of OUTPUT the values may be copied by reference\n"
+              << "  --perfect-hash     add a perfect hash index for point lookups in a few memory accesses\n"
+              << "  --filter-bits=N    add a Bloom filter with N bits per key for fast negative lookups (default: 0, none)\n"
+              << "  --value-block-size=KB\n"
+              << "                     compress the values in blocks of KB kibibytes (default: 0, uncompressed)\n"
+              << "  --compression-level=N\n"
+              << "                     zstd level for the value blocks (default: 3)\n"
+              << "  --large-tree       64-bit tree offsets, for trees over 4 GiB (format versions 2 and 3)\n"
+              << "  --inline-values=N  store the values of up to N bytes within the tree nodes (default: 0, none)\n";
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
+    RoflDb::DbMerger::Options options;
+    auto& outputOptions = options.outputOptions;
+    std::vector<std::filesystem::path> positional;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg.starts_with("--duplicates=")) {
+            auto rule = arg.substr(std::strlen("--duplicates="));
+            if (rule == "newest") {
+                options.duplicates = RoflDb::DbMerger::Duplicates::NEWEST;
+            } else if (rule == "oldest") {
+                options.duplicates = RoflDb::DbMerger::Duplicates::OLDEST;
+            } else if (rule == "fail") {
+                options.duplicates = RoflDb::DbMerger::Duplicates::FAIL;
+            } else {
+                return usage(argv[0]);
+            }
+        } else if (arg.starts_with("--threads=")) {
+            options.threadCount = std::stoul(std::string(arg.substr(std::strlen("--threads="))));
+        } else if (arg.starts_with("--format-version=")) {
+            outputOptions.version = static_cast<RoflDb::FormatVersion>(std::stoul(std::string(arg.substr(std::strlen("--format-version=")))));
+        } else if (arg.starts_with("--memory-limit=")) {
+            outputOptions.memoryLimit = std::stoull(std::string(arg.substr(std::strlen("--memory-limit=")))) * 1024 * 1024;
+        } else if (arg == "--perfect-hash") {
+            outputOptions.perfectHashIndex = true;
+        } else if (arg.starts_with("--filter-bits=")) {
+            outputOptions.filterBitsPerKey = std::stoul(std::string(arg.substr(std::strlen("--filter-bits="))));
+        } else if (arg.starts_with("--value-block-size=")) {
+            outputOptions.valueBlockSize = std::stoull(std::string(arg.substr(std::strlen("--value-block-size=")))) * 1024;
+        } else if (arg.starts_with("--compression-level=")) {
+            outputOptions.compressionLevel = std::stoi(std::string(arg.substr(std::strlen("--compression-level="))));
+        } else if (arg == "--large-tree") {
+            outputOptions.largeTree = true;
+        } else if (arg.starts_with("--inline-values=")) {
+            outputOptions.inlineValueSize = std::stoull(std::string(arg.substr(std::strlen("--inline-values="))));
+        } else if (arg.starts_with("--temp-dir=")) {
+            outputOptions.temporaryDirectory = arg.substr(std::strlen("--temp-dir="));
+        } else if (arg.starts_with("--") && arg != "--") {
+            return usage(argv[0]);
+        } else {
+            positional.emplace_back(argv[i]);
+        }
+    }
+    if (positional.size() < 2) {
+        return usage(argv[0]);
+    }
+
+    auto inputs = std::span(positional).subspan(1);
+    RoflDb::DbMerger::Stats stats;
+    try {
+        RoflDb::DbMerger merger(inputs, options);
+        stats = merger.merge(positional[0]);
+    } catch (const std::exception& error) {
+        std::cerr << "Merge failed: " << error.what() << "\n";
+        return 1;
+    }
+    const auto& output = stats.output;
+    std::cerr << "Merged " << inputs.size() << " files (" << stats.inputKeys << " keys, " << stats.droppedDuplicates << " duplicates dropped) into "
+              << positional[0].string() << " in " << stats.ranges << " key ranges: "
+              << output.keys << " keys, " << output.fileBytes << " bytes (values " << output.valueBytes << ", stored " << output.storedValueBytes
+              << ", tree " << output.treeBytes << ", filter " << output.filterBytes << ", index " << output.indexBytes << "), "
+              << (stats.copiedValueSections > 0
+                      ? std::to_string(stats.copiedValueSections) + " value sections copied (" + std::to_string(output.kernelCopiedValueBytes) + " of "
+                        + std::to_string(output.appendedValueBytes) + " bytes by copy_file_range, " + std::to_string(stats.droppedValueBytes)
+                        + " bytes of dropped duplicates), "
+                      : std::string("values rewritten, "))
+              << std::chrono::duration_cast<std::chrono::milliseconds>(output.elapsed).count() << " ms, "
+              << static_cast<uint64_t>(output.keysPerSecond()) << " keys/s, "
+              << output.megabytesPerSecond() << " MiB/s\n";
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "server.h"
+
+static const RoflDb::DbServer* runningServer = nullptr;
+
+static void handleSignal(int) {
+    if (runningServer) {
+        runningServer->stop();
+    }
+}
+
+static int usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [options] SOCKET FILE...\n"
+              << "Answers the gets of RoflDb::DbClient in the .rofldb FILEs (numbered from 0 in this order) at the Unix\n"
+              << "socket SOCKET, until SIGINT or SIGTERM.\n"
+              << "\n"
+              << "  --threads=N        worker threads (default: 0, all the hardware threads)\n"
+              << "  --no-populate      do not read the files into memory up front\n"
+              << "  --lock-tree        lock the trees in memory\n"
+              << "  --warmup           read the trees in the background\n"
+              << "  --verify           verify the files up front, their lookups skip the bounds checks then\n";
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
+    RoflDb::DbServer::Options options;
+    auto& fileOptions = options.fileOptions;
+    std::vector<std::filesystem::path> positional;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg.starts_with("--threads=")) {
+            options.threadCount = std::stoul(std::string(arg.substr(std::strlen("--threads="))));
+        } else if (arg == "--no-populate") {
+            fileOptions.populate = false;
+        } else if (arg == "--lock-tree") {
+            fileOptions.lockTree = true;
+        } else if (arg == "--warmup") {
+            fileOptions.warmupTree = true;
+        } else if (arg == "--verify") {
+            fileOptions.verify = true;
+        } else if (arg.starts_with("--") && arg != "--") {
+            return usage(argv[0]);
+        } else {
+            positional.emplace_back(argv[i]);
+        }
+    }
+    if (positional.size() < 2) {
+        return usage(argv[0]);
+    }
+
+    auto files = std::span(positional).subspan(1);
+    RoflDb::DbServer server(positional[0], files, options);
+    runningServer = &server;
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+    std::cerr << "Serving " << files.size() << " files at " << positional[0].string() << "\n";
+    server.run();
+    runningServer = nullptr;
+
+    auto stats = server.getStats();
+    std::cerr << "Served " << stats.connections << " connections, " << stats.requests << " requests, " << stats.keys
+              << " keys (" << stats.errors << " errors)\n";
+    return 0;
+}